@@ -9,8 +9,34 @@ UnitUpdater::UnitUpdater()
     mServerPort				= 0;
 	mCloseRequested			= false;
 	mUpdateInProgress		= false;
+	mUpdateBytesReceived	= 0;
+	mBytesSinceCheckpoint	= 0;
 	mUdp					= new Essentials::Communications::UDP_Client();
+	mTcp					= nullptr;
+	mMulticast				= new Essentials::Communications::UDP_Client();
+	mReliableUdp			= new Essentials::Communications::UDP_Client();
+	mReliableReceiver		= new Essentials::Communications::ReliableReceiver(
+		[this](const uint64_t transferId, const uint64_t totalSize, const uint64_t offset, const uint8_t* data, const size_t size) {
+			return HandleReliableChunk(transferId, totalSize, offset, data, size);
+		},
+		[this](const uint64_t transferId, std::string& result) {
+			return HandleReliableComplete(transferId, result);
+		}, MAX_OFS_IMAGE_SIZE);
 	mTimer					= Essentials::Utilities::Timer::GetInstance();
+	mStartupUSec			= mTimer->GetUSecTicks64();
+	mListenerArmedUSec		= 0;
+	mSettings				= std::make_shared<const Settings>();
+	mSettingsWakeFD			= -1;
+	mOfsWriter				= new Essentials::Utilities::AsyncFileWriter(Essentials::Utilities::FILE_WRITER_DEFAULT_BLOCK_SIZE, OFS_WRITER_BLOCK_COUNT, OFS_WRITER_THREAD_COUNT);
+	mDeltaPatcher			= new Essentials::Utilities::DeltaPatcher();
+	mTimerWheel				= new Essentials::Utilities::TimerWheel();
+	mVerifier				= new Essentials::Utilities::ChunkVerifier();
+	mFecDecoder				= new Essentials::Utilities::FecDecoder();
+	mVerifyUpload			= false;
+	mUploadSource			= UploadSource::STREAM;
+	mMulticastDone			= false;
+	mMulticastDoneId		= 0;
+	mMulticastRebuilt		= 0;
 
 	// Welcome message
 	std::cout << "------------------------------------\n";
@@ -27,23 +53,28 @@ UnitUpdater::UnitUpdater(int bPort, int tPort) : UnitUpdater()
 UnitUpdater::~UnitUpdater()
 {
 	Close();
+	delete mDeltaPatcher;
+	delete mOfsWriter;
+	delete mTimerWheel;
+	delete mVerifier;
+	delete mFecDecoder;
+	delete mMulticast;
+	delete mReliableReceiver;
+	delete mReliableUdp;
 }
 
 int UnitUpdater::Setup(std::string filepath, int preferredBroadcastPort, int preferredCommsPort)
 {
-	// Attempt to load the settings from filepath.
-	std::ifstream settingsFile(filepath);
-	if (settingsFile.is_open())
+	// Attempt to load the settings from filepath, using the binary snapshot next to it when it is current.
+	auto settings = std::make_shared<Settings>();
+	if (settings->LoadFromFile(filepath))
 	{
-		nlohmann::json settingsJson;
-		settingsFile >> settingsJson;
-		settingsFile.close();
-		mSettings.LoadFromJson(settingsJson);
-
 		std::cout << "[UPDATER] Settings Loaded Successfully\n";
-		mBroadcastPort = mSettings.broadcastPort;
-		mServerPort = mSettings.communicationPort;
-		mMaxBroadcastListeningTimeInMSec = mSettings.broadcastTimeoutMSec;
+		mSettings = settings;
+		mSettingsPath = filepath;
+		mBroadcastPort = settings->broadcastPort;
+		mServerPort = settings->communicationPort;
+		mMaxBroadcastListeningTimeInMSec = settings->broadcastTimeoutMSec;
 	}
 	else
 	{
@@ -55,8 +86,14 @@ int UnitUpdater::Setup(std::string filepath, int preferredBroadcastPort, int pre
 	if (preferredBroadcastPort != 0) mBroadcastPort = preferredBroadcastPort;
 	if (preferredCommsPort != 0) mServerPort = preferredCommsPort;
 
+	// Open the interrupt listener before anything else so the window starts as early as possible
+	if (ArmInterruptListener() < 0)
+	{
+		std::cout << "[UPDATER] Failed to open the interrupt listener\n";
+	}
+
 	// Setup TCP to serve on any network interface
-	mTcp = new Essentials::Communications::TCP_Server(mSettings.maximumConnections, "0.0.0.0", mServerPort);
+	mTcp = new Essentials::Communications::TCP_Server(settings->maximumConnections, "0.0.0.0", mServerPort);
 
 	if (mTcp == nullptr) 
 	{
@@ -70,6 +107,49 @@ int UnitUpdater::Setup(std::string filepath, int preferredBroadcastPort, int pre
 	};
 	mTcp->SetMessageCallback(handleMessageCallback);
 
+	auto handleDisconnectCallback = [this](const int clientFd) {
+		return HandleDisconnect(clientFd);
+	};
+	mTcp->SetDisconnectCallback(handleDisconnectCallback);
+
+	auto handleConnectionCallback = [this](const int clientFd) {
+		return HandleConnection(clientFd);
+	};
+	mTcp->SetConnectionCallback(handleConnectionCallback);
+
+	// Client timeouts run off the timer wheel, serviced by the server's event loop
+	if (mTimerWheel->GetFD() != -1)
+	{
+		mTcp->AddEventSource(mTimerWheel->GetFD(), [this]() { mTimerWheel->HandleEvent(); });
+	}
+
+	// Manifest checks finish on the verifier threads and are picked up by the event loop
+	if (mVerifier->GetFD() != -1)
+	{
+		mTcp->AddEventSource(mVerifier->GetFD(), [this]() { HandleVerifyResults(); });
+	}
+
+	// Fleet updates arrive on the multicast group when one is configured
+	if (!settings->multicastGroup.empty() && StartMulticastReceiver(settings->multicastGroup, settings->multicastPort) < 0)
+	{
+		std::cout << "[UPDATER] Failed to join multicast group " << settings->multicastGroup << ":" << settings->multicastPort << "\n";
+	}
+
+	// Uploads over lossy links come in as reliable UDP on the communication port
+	if (StartReliableReceiver(mServerPort) < 0)
+	{
+		std::cout << "[UPDATER] Failed to open reliable UDP receiver on port " << mServerPort << "\n";
+	}
+
+#ifndef WIN32
+	// Pick up edits to the settings file while running
+	if (!mSettingsThread.joinable())
+	{
+		mSettingsWakeFD = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+		mSettingsThread = std::thread(&UnitUpdater::WatchSettings, this);
+	}
+#endif
+
 	// Default return
 	return 0;
 }
@@ -94,68 +174,55 @@ int UnitUpdater::StartServer()
 		return -1;
 	}
 
-	while(!mCloseRequested)
+	// Block in the server's event loop until a CLOSE command stops it.
+	int rtn = mTcp->Run();
+	if (rtn < 0)
 	{
-		// tcp server running
+		std::cerr << "[UPDATER] Server event loop failed." << std::endl;
+		std::cout << mTcp->GetLastError();
 	}
 
 	mTcp->Stop();
-	return 0;
+	return rtn;
 }
 
 int UnitUpdater::HandleMessage(const int clientFD, const std::string& data)
 {
-	if (IsPacketValid(reinterpret_cast<const uint8_t*>(data.c_str())))
+	// TCP splits and joins messages, let this client's assembler find the frame boundaries
+	FrameAssembler& assembler = mAssemblers[clientFD];
+	ResetIdleTimer(clientFD);
+
+	auto handleFrame = [this, clientFD](const uint8_t* frame, const uint32_t size) {
+		if (!mCloseRequested)
+		{
+			HandleFrame(clientFD, frame, size);
+		}
+	};
+
+	return assembler.Push(reinterpret_cast<const uint8_t*>(data.data()), data.size(), handleFrame);
+}
+
+int UnitUpdater::HandleFrame(const int clientFD, const uint8_t* frame, const size_t size)
+{
+	if (IsPacketValid(frame, size))
 	{
-		UPDATER_ACTION_MESSAGE msg = { 0 };
-		memcpy(&msg, data.c_str(), sizeof(msg));
+		UPDATER_ACTION_MESSAGE msg = GetMessageFromBuffer(frame);
 
 		switch (msg.action)
 		{
 		case ACTION_COMMAND::CLOSE:					
 			mCloseRequested = true;
+
+			// Returns control to StartServer as soon as this callback completes
+			mTcp->Stop();
 			break;
 		case ACTION_COMMAND::BOOT_INTERRUPT:
 			// Handled in ListenForInterrupt()
 			break;
 		case ACTION_COMMAND::GET_AS_BUILT:
-			{
-				std::string response;
-				RESPONSE_MSG msgOut;
-
-				// Read the contents of the JSON file
-				std::ifstream inputFile(mSettings.asBuiltLocation);
-
-				if (inputFile.is_open()) 
-				{
-					std::string line;
-
-					while (getline(inputFile, line)) 
-					{
-						response += line;
-					}
-					inputFile.close();
-
-					msgOut.action = ACTION_COMMAND::GET_AS_BUILT;
-					msgOut.status = ACTION_STATUS::SUCCESS;
-					msgOut.data = response;
-				}
-				else 
-				{
-					// Error opening file - respond with failure
-					msgOut.action = ACTION_COMMAND::GET_AS_BUILT;
-					msgOut.status = ACTION_STATUS::FAIL;
-					msgOut.data = response;
-				}
-
-				std::string serializedData = SerializeResponseMsg(msgOut);
-				mTcp->SendBufferToClient(clientFD, reinterpret_cast<const uint8_t*>(serializedData.data()), serializedData.size());
-			}
-			break;
+			return SendFileResponse(clientFD, ACTION_COMMAND::GET_AS_BUILT, GetSettings()->asBuiltLocation);
 		case ACTION_COMMAND::UPDATE_OFS:
-			mUpdateInProgress = true;
-			// @todo - write bytes to a temp file until we have received all the bytes
-			break;
+			return HandleOfsChunk(clientFD, frame, size);
 		case ACTION_COMMAND::UPDATE_CONFIG:
 		{
 			// @todo - take the received data and validate it and then write to the file if its good. 
@@ -164,7 +231,7 @@ int UnitUpdater::HandleMessage(const int clientFD, const std::string& data)
 			RESPONSE_MSG msgOut;
 
 			// Read the contents of the JSON file
-			std::ifstream inputFile(mSettings.ofsLocation);
+			std::ifstream inputFile(GetSettings()->ofsLocation);
 
 			if (inputFile.is_open())
 			{
@@ -188,8 +255,7 @@ int UnitUpdater::HandleMessage(const int clientFD, const std::string& data)
 				msgOut.data = response;
 			}
 
-			std::string serializedData = SerializeResponseMsg(msgOut);
-			mTcp->SendBufferToClient(clientFD, reinterpret_cast<const uint8_t*>(serializedData.data()), serializedData.size());
+			SendResponse(clientFD, msgOut.action, msgOut.status, msgOut.data);
 		}
 		break;
 		case ACTION_COMMAND::GET_LOG_NAMES:
@@ -199,160 +265,1544 @@ int UnitUpdater::HandleMessage(const int clientFD, const std::string& data)
 			break;
 		case ACTION_COMMAND::GET_SPECIFIC_LOG:
 			{
+				// The log name sits between the action and the footer
+				constexpr size_t nameOffset = sizeof(UPDATER_HEADER) + sizeof(uint32_t);
+				std::string name(reinterpret_cast<const char*>(frame) + nameOffset, msg.header.msgSize - nameOffset - sizeof(UPDATER_FOOTER));
 
+				return SendFileResponse(clientFD, ACTION_COMMAND::GET_SPECIFIC_LOG, GetLogPath(name));
 			}
-			break;
-		case ACTION_COMMAND::GET_LAST_FLIGHT_LOG:
+		case ACTION_COMMAND::RESUME_SPECIFIC_LOG:
 			{
+				// The offset and then the log name sit between the action and the footer
+				constexpr size_t requestOffset = sizeof(UPDATER_HEADER) + sizeof(uint32_t);
+				constexpr size_t nameOffset = requestOffset + sizeof(RESUME_LOG_REQUEST);
+				if (msg.header.msgSize < nameOffset + sizeof(UPDATER_FOOTER))
+				{
+					return SendResponse(clientFD, ACTION_COMMAND::RESUME_SPECIFIC_LOG, ACTION_STATUS::FAIL);
+				}
 
+				RESUME_LOG_REQUEST request = { 0 };
+				memcpy(&request, frame + requestOffset, sizeof(request));
+				std::string name(reinterpret_cast<const char*>(frame) + nameOffset, msg.header.msgSize - nameOffset - sizeof(UPDATER_FOOTER));
+
+				return SendFileResponse(clientFD, ACTION_COMMAND::RESUME_SPECIFIC_LOG, GetLogPath(name), request.offset);
 			}
-			break;
+		case ACTION_COMMAND::GET_LAST_FLIGHT_LOG:
+			return SendFileResponse(clientFD, ACTION_COMMAND::GET_LAST_FLIGHT_LOG, FindLastFlightLog());
+		case ACTION_COMMAND::GET_OFS_SIGNATURE:
+			return HandleOfsSignature(clientFD, frame, size);
+		case ACTION_COMMAND::UPDATE_OFS_DELTA:
+			return HandleOfsDelta(clientFD, frame, size);
+		case ACTION_COMMAND::RESUME_OFS:
+			return HandleOfsResume(clientFD, frame, size);
+		case ACTION_COMMAND::UPDATE_OFS_MANIFEST:
+			return HandleOfsManifest(clientFD, frame, size);
 		}
 	}
 
 	return -1;
 }
 
-int UnitUpdater::ListenForInterrupt()
+int UnitUpdater::HandleConnection(const int clientFD)
 {
-	// Validate we have a broadcast port and attempt to add the listener. 
-	if (mBroadcastPort <= 0 ||
-		mUdp->AddBroadcastListener(mBroadcastPort) < 0)
+	ResetIdleTimer(clientFD);
+	return 0;
+}
+
+int UnitUpdater::HandleDisconnect(const int clientFD)
+{
+	mAssemblers.erase(clientFD);
+
+	auto timer = mIdleTimers.find(clientFD);
+	if (timer != mIdleTimers.end())
 	{
-		return -1;
+		mTimerWheel->Cancel(timer->second.wheelId);
+		mIdleTimers.erase(timer);
+	}
+
+	// A dropped upload is kept with a checkpoint so the client can resume it, a delta can't be resumed.
+	// While other streams are still feeding the upload it carries on without this one.
+	if (mUpdateInProgress && mUpdateClients.erase(clientFD) > 0)
+	{
+		if (mDeltaPatcher->IsActive())
+		{
+			std::cout << "[UPDATER] Client disconnected during OFS delta update, discarding partial image\n";
+			mDeltaPatcher->Abort();
+			mOfsWriter->Abort();
+			mUpdateInProgress = false;
+			mUpdateClients.clear();
+		}
+		else if (mUpdateClients.empty() && mUploadSource == UploadSource::STREAM)
+		{
+			std::cout << "[UPDATER] Client disconnected during OFS update, keeping partial image for resume\n";
+			SuspendUpload();
+		}
+		else
+		{
+			ReportUploadGaps();
+		}
+	}
+
+	return 0;
+}
+
+void UnitUpdater::ResetIdleTimer(const int clientFD)
+{
+	uint64_t now = mTimer->GetMSecTicks64();
+
+	// A receive only notes the time, the deadline already on the wheel moves itself when it fires
+	auto timer = mIdleTimers.find(clientFD);
+	if (timer != mIdleTimers.end())
+	{
+		timer->second.lastReceiveMSec = now;
+		return;
+	}
+
+	uint64_t wheelId = mTimerWheel->Schedule(CLIENT_IDLE_TIMEOUT_MSEC, [this, clientFD]() { CheckIdleTimer(clientFD); });
+	mIdleTimers[clientFD] = { wheelId, now };
+}
+
+void UnitUpdater::CheckIdleTimer(const int clientFD)
+{
+	auto timer = mIdleTimers.find(clientFD);
+	if (timer == mIdleTimers.end())
+	{
+		return;
 	}
 
-	uint8_t buffer[200];					// buffer to hold data received
-	int size = sizeof(buffer);				// size of the buffer
-	int start = mTimer->GetMSecTicks();		// time of start
-	int elapsed = 0;						// time elapsed count
-	bool packetReceived = false;			// Verify the packet is what we desire
+	// Heard from since the deadline was set, sleep until the one the last receive gives
+	uint64_t idle = mTimer->GetMSecTicks64() - timer->second.lastReceiveMSec;
+	if (idle < CLIENT_IDLE_TIMEOUT_MSEC)
+	{
+		timer->second.wheelId = mTimerWheel->Schedule(CLIENT_IDLE_TIMEOUT_MSEC - idle, [this, clientFD]() { CheckIdleTimer(clientFD); });
+		return;
+	}
+
+	std::cout << "[UPDATER] Client idle for " << idle << "ms, disconnecting\n";
+	mIdleTimers.erase(timer);
+	mTcp->DisconnectClient(clientFD);
+}
 
-	// While the time length hasnt elapsed
-	while (elapsed <= mMaxBroadcastListeningTimeInMSec)
+int UnitUpdater::HandleOfsChunk(const int clientFD, const uint8_t* buffer, const size_t size)
+{
+	constexpr size_t chunkOffset = sizeof(UPDATER_HEADER) + sizeof(uint32_t);
+
+	UPDATER_CHUNK_HEADER chunk = { 0 };
+	int result = 0;
+
+	// A damaged chunk is refused before it can restart, join or touch the upload
+	if (!ReadChunk(clientFD, ACTION_COMMAND::UPDATE_OFS, buffer, size, chunk, result))
 	{
-		int bytesReceived = mUdp->ReceiveBroadcastFromListenerPort(buffer, size, mBroadcastPort);
+		return result;
+	}
 
-		if (bytesReceived == -1)
+	// Every stream of a parallel upload starts with a first chunk, the streams after the first join it
+	bool joining = (chunk.flags & CHUNK_FLAG_FIRST) && mUpdateInProgress && !mDeltaPatcher->IsActive() &&
+		chunk.transferId == mUploadCheckpoint.GetTransferId() && chunk.totalSize == mUploadCheckpoint.GetTotalSize();
+
+	if (joining)
+	{
+		mUpdateClients[clientFD] = false;
+	}
+	// The first chunk opens a temp file next to the OFS, restarting any update already underway
+	else if (chunk.flags & CHUNK_FLAG_FIRST)
+	{
+		if (mUpdateInProgress)
 		{
-			std::cout << mUdp->GetLastError() << std::endl;
-			return -1;
+			mDeltaPatcher->Abort();
+			mOfsWriter->Abort();
 		}
-		else if (bytesReceived >= sizeof(UPDATER_ACTION_MESSAGE) && IsPacketValid(buffer))
+
+		// A new upload replaces any suspended one
+		mUpdateTarget = GetSettings()->ofsLocation;
+		Essentials::Utilities::TransferCheckpoint::Remove(GetCheckpointPath(mUpdateTarget));
+
+		// Streams write all over the file, reserving it whole keeps it in one piece
+		if (mOfsWriter->Open(mUpdateTarget) < 0 || mOfsWriter->Preallocate(chunk.totalSize) < 0)
 		{
-			UPDATER_ACTION_MESSAGE msg = GetMessageFromBuffer(buffer);
+			std::cout << "[UPDATER] " << mOfsWriter->GetLastError() << "\n";
+			mOfsWriter->Abort();
+			mUploadCheckpoint.Clear();
+			mUpdateInProgress = false;
+			mUploadSource = UploadSource::STREAM;
+			mUpdateClients.clear();
+			return SendResponse(clientFD, ACTION_COMMAND::UPDATE_OFS, ACTION_STATUS::FAIL);
+		}
 
-			if (msg.action == ACTION_COMMAND::BOOT_INTERRUPT)
-			{
-				// Get the senders info
-				std::string ip;
-				int port;
-				mUdp->GetLastSendersInfo(ip, port);
-				mUdp->ConfigureThisClient("", 8080);
-				mUdp->OpenUnicast();
-
-				// Respond to sender with ack
-				int rtn = SendAcknowledgement("127.0.0.1", 8080, MSG_TYPE::BOOT_INTERRUPT);
-				if (rtn < 0)
-				{
-					std::cout << "[UPDATER] Failed to send broadcast response";
-					return -1;
-				}
+		mUploadCheckpoint.Reset(chunk.transferId, chunk.totalSize);
+		mUpdateInProgress = true;
+		mUploadSource = UploadSource::STREAM;
+		mUpdateClients.clear();
+		mUpdateClients[clientFD] = false;
+		mBytesSinceCheckpoint = 0;
+		StartVerifying();
+	}
 
-				std::cout << "[UPDATER] Broadcast Ack sent to " + ip + ":" + std::to_string(port) + "\n";
-				return 1;
-			}
-			else
-			{
-				// Not a boot interrupt message, disregard it. 
-				// Do I want to send an ack here even if its not a boot interrupt message  ?
-				continue;
-			}
+	// Full image chunks can't continue a delta update
+	if (!mUpdateInProgress || mUpdateClients.count(clientFD) == 0 || mDeltaPatcher->IsActive() ||
+		chunk.transferId != mUploadCheckpoint.GetTransferId() || chunk.totalSize != mUploadCheckpoint.GetTotalSize() ||
+		chunk.offset > chunk.totalSize || chunk.length > chunk.totalSize - chunk.offset ||
+		(mVerifyUpload && !mManifest.IsAligned(chunk.offset, chunk.length)))
+	{
+		return SendResponse(clientFD, ACTION_COMMAND::UPDATE_OFS, ACTION_STATUS::FAIL);
+	}
+
+	// Hand the bytes to the write-behind buffer. When it is full this blocks, which stops us 
+	// reading the socket and lets TCP flow control slow the sender down to the disk speed.
+	if (mOfsWriter->Write(chunk.offset, buffer + chunkOffset + sizeof(chunk), chunk.length) < 0)
+	{
+		FailUpload();
+		return -1;
+	}
+
+	// With a manifest the range only counts once its leaves have been checked
+	if (mVerifyUpload)
+	{
+		if (mVerifier->Submit(clientFD, chunk.offset, buffer + chunkOffset + sizeof(chunk), chunk.length) < 0)
+		{
+			return RejectChunk(clientFD, ACTION_COMMAND::UPDATE_OFS, chunk);
+		}
+
+		if (chunk.flags & CHUNK_FLAG_LAST)
+		{
+			mUpdateClients[clientFD] = true;
+		}
+
+		// Without an event to wake us the results have to be collected here
+		if (mVerifier->GetFD() == -1)
+		{
+			mVerifier->WaitIdle();
+			return HandleVerifyResults();
 		}
 
-		elapsed = mTimer->GetMSecTicks() - start;
+		return 0;
+	}
+
+	mUploadCheckpoint.AddRange(chunk.offset, chunk.length);
+
+	// Periodically make what we have durable so a dropped link only costs what arrived since
+	mBytesSinceCheckpoint += chunk.length;
+	if (mBytesSinceCheckpoint >= TRANSFER_CHECKPOINT_INTERVAL && CheckpointUpload() < 0)
+	{
+		std::cout << "[UPDATER] Failed to checkpoint OFS update\n";
+	}
+
+	// Whichever stream fills the last gap finishes the upload for all of them
+	if (mUploadCheckpoint.IsComplete())
+	{
+		return CompleteUpload();
+	}
+
+	if (chunk.flags & CHUNK_FLAG_LAST)
+	{
+		mUpdateClients[clientFD] = true;
+		ReportUploadGaps();
 	}
 
-	// Default return
 	return 0;
 }
 
-bool UnitUpdater::IsPacketValid(const uint8_t* buffer)
+bool UnitUpdater::ReadChunk(const int clientFD, const uint32_t action, const uint8_t* buffer, const size_t size, UPDATER_CHUNK_HEADER& chunk, int& result)
 {
-	if (buffer[0] == SYNC1 &&
-		buffer[1] == SYNC2 &&
-		buffer[2] == SYNC3 &&
-		buffer[3] == SYNC4 &&
-		buffer[4] == sizeof(UPDATER_ACTION_MESSAGE)
-		)
+	constexpr size_t chunkOffset = sizeof(UPDATER_HEADER) + sizeof(uint32_t);
+	constexpr size_t overhead = chunkOffset + sizeof(UPDATER_CHUNK_HEADER) + sizeof(UPDATER_FOOTER);
+
+	// Framing, length and CRC32C checks shared by every chunked upload message, the client is answered here on failure
+	UPDATER_HEADER header = { 0 };
+	memcpy(&header, buffer, sizeof(header));
+
+	if (size < overhead || header.msgSize < overhead)
 	{
-		UPDATER_ACTION_MESSAGE msg = GetMessageFromBuffer(buffer);
+		result = SendResponse(clientFD, action, ACTION_STATUS::FAIL);
+		return false;
+	}
 
-		switch (msg.action)
+	memcpy(&chunk, buffer + chunkOffset, sizeof(chunk));
+	if (chunk.length != header.msgSize - overhead)
+	{
+		result = SendResponse(clientFD, action, ACTION_STATUS::FAIL);
+		return false;
+	}
+
+	if (!IsChunkIntact(chunk, buffer + chunkOffset))
+	{
+		result = RejectChunk(clientFD, action, chunk);
+		return false;
+	}
+
+	return true;
+}
+
+bool UnitUpdater::IsChunkIntact(const UPDATER_CHUNK_HEADER& chunk, const uint8_t* chunkStart)
+{
+	if ((chunk.flags & CHUNK_FLAG_CRC32C) == 0)
+	{
+		return true;
+	}
+
+	// Covers the header, so a damaged offset can't put good data in the wrong place
+	constexpr size_t covered = offsetof(UPDATER_CHUNK_HEADER, crc32c);
+	uint32_t crc = Essentials::Utilities::Crc32c(chunkStart, covered);
+	crc = Essentials::Utilities::Crc32c(chunkStart + sizeof(UPDATER_CHUNK_HEADER), chunk.length, crc);
+
+	return crc == chunk.crc32c;
+}
+
+int UnitUpdater::RejectChunk(const int clientFD, const uint32_t action, const UPDATER_CHUNK_HEADER& chunk)
+{
+	std::cout << "[UPDATER] Chunk at offset " << chunk.offset << " failed its CRC32C check\n";
+
+	TRANSFER_RANGE range = { chunk.offset, chunk.length };
+	return SendResponse(clientFD, action, ACTION_STATUS::FAIL, std::string(reinterpret_cast<const char*>(&range), sizeof(range)));
+}
+
+int UnitUpdater::CompleteUpload(std::string* digestOut)
+{
+	std::map<int, bool> clients;
+	clients.swap(mUpdateClients);
+	mUpdateInProgress = false;
+	UploadSource source = mUploadSource;
+	mUploadSource = UploadSource::STREAM;
+
+	uint64_t transferId = mUploadCheckpoint.GetTransferId();
+	uint64_t imageSize = mUploadCheckpoint.GetTotalSize();
+	mUploadCheckpoint.Clear();
+	Essentials::Utilities::TransferCheckpoint::Remove(GetCheckpointPath(mUpdateTarget));
+
+	uint32_t status = ACTION_STATUS::SUCCESS;
+	std::string digest;
+	if (mOfsWriter->Commit() < 0)
+	{
+		std::cout << "[UPDATER] " << mOfsWriter->GetLastError() << "\n";
+		status = ACTION_STATUS::FAIL;
+	}
+	else
+	{
+		std::cout << "[UPDATER] OFS updated, " << imageSize << " bytes written over " << clients.size() << " stream(s)" <<
+			(source == UploadSource::MULTICAST ? " and multicast\n" : source == UploadSource::RELIABLE_UDP ? " and reliable UDP\n" : "\n");
+		digest = GetImageDigest();
+	}
+
+	for (const auto& client : clients)
+	{
+		SendResponse(client.first, ACTION_COMMAND::UPDATE_OFS, status, digest);
+	}
+
+	if (digestOut != nullptr)
+	{
+		*digestOut = digest;
+	}
+
+	// The group's sender hears straight away rather than at its next poll
+	if (source == UploadSource::MULTICAST)
+	{
+		mMulticastDone = status == ACTION_STATUS::SUCCESS;
+		mMulticastDoneId = transferId;
+		mMulticastDigest = digest;
+		SendMulticastResponse(mMulticastSender, status, digest);
+	}
+
+	return status == ACTION_STATUS::SUCCESS ? 0 : -1;
+}
+
+void UnitUpdater::ReportUploadGaps()
+{
+	// Leaves still being checked may fill the gaps
+	if (mUpdateClients.empty() || (mVerifyUpload && mVerifier->GetPendingCount() > 0))
+	{
+		return;
+	}
+
+	for (const auto& client : mUpdateClients)
+	{
+		if (!client.second)
 		{
-		case ACTION_COMMAND::CLOSE:
-		case ACTION_COMMAND::BOOT_INTERRUPT:
-		case ACTION_COMMAND::GET_AS_BUILT:
-		case ACTION_COMMAND::UPDATE_OFS:
-		case ACTION_COMMAND::UPDATE_CONFIG:
-		case ACTION_COMMAND::GET_LOG_NAMES:
-		case ACTION_COMMAND::GET_SPECIFIC_LOG:
-		case ACTION_COMMAND::GET_LAST_FLIGHT_LOG:
-			return true;
+			// Someone is still sending, the gaps may yet be filled
+			return;
 		}
 	}
-	return false;
+
+	// Every stream has finished with gaps left, keep the upload open and tell them what is missing
+	std::cout << "[UPDATER] OFS update incomplete, received " << mUploadCheckpoint.GetReceivedBytes() << " of " << mUploadCheckpoint.GetTotalSize() << " bytes\n";
+	std::string status = mUploadCheckpoint.GetStatus();
+	for (auto& client : mUpdateClients)
+	{
+		client.second = false;
+		SendResponse(client.first, ACTION_COMMAND::UPDATE_OFS, ACTION_STATUS::FAIL, status);
+	}
 }
 
-std::string UnitUpdater::SerializeResponseMsg(const RESPONSE_MSG& responseMsg)
+void UnitUpdater::FailUpload()
 {
-	std::stringstream ss;
-
-	// Serialize the structure members into a buffer
-	ss.write(reinterpret_cast<const char*>(&responseMsg.header), sizeof(responseMsg.header));
-	ss.write(reinterpret_cast<const char*>(&responseMsg.action), sizeof(responseMsg.action));
-	ss.write(reinterpret_cast<const char*>(&responseMsg.status), sizeof(responseMsg.status));
+	std::cout << "[UPDATER] " << mOfsWriter->GetLastError() << "\n";
+	mOfsWriter->Abort();
+	mUploadCheckpoint.Clear();
+	Essentials::Utilities::TransferCheckpoint::Remove(GetCheckpointPath(mUpdateTarget));
+	mUpdateInProgress = false;
+	mUploadSource = UploadSource::STREAM;
+	for (const auto& client : mUpdateClients)
+	{
+		SendResponse(client.first, ACTION_COMMAND::UPDATE_OFS, ACTION_STATUS::FAIL);
+	}
+	mUpdateClients.clear();
+}
 
-	// Serialize the 'data' string separately
-	size_t dataSize = responseMsg.data.size();
-	ss.write(reinterpret_cast<const char*>(&dataSize), sizeof(dataSize));
-	ss.write(responseMsg.data.c_str(), dataSize);
+int UnitUpdater::StartMulticastReceiver(const std::string& group, const int port)
+{
+	if (!mMulticastArena.empty())
+	{
+		return 0;
+	}
 
-	ss.write(reinterpret_cast<const char*>(&responseMsg.footer), sizeof(responseMsg.footer));
+	// Answers to the sender's polls go out of the unicast socket, the image comes in on the group
+	if (mMulticast->ConfigureThisClient("", 0) < 0 || mMulticast->OpenUnicast() < 0 ||
+		mMulticast->EnableMulticast(group, static_cast<int16_t>(port)) != 0 || mMulticast->GetWaitFD() == -1)
+	{
+		std::cout << mMulticast->GetLastError() << std::endl;
+		return -1;
+	}
 
-	// Get the serialized data as a string
-	return ss.str();
+	mMulticastArena.resize(static_cast<size_t>(MULTICAST_RECEIVE_BATCH) * MULTICAST_MAX_DATAGRAM_SIZE);
+	std::cout << "[UPDATER] Listening for OFS updates on multicast group " << group << ":" << port << "\n";
+	return mTcp->AddEventSource(mMulticast->GetWaitFD(), [this]() { HandleMulticastReadable(); });
 }
 
-UPDATER_ACTION_MESSAGE UnitUpdater::GetMessageFromBuffer(const uint8_t* buffer)
+void UnitUpdater::HandleMulticastReadable()
 {
-	UPDATER_ACTION_MESSAGE msg = { 0 };
-	memcpy(&msg, buffer, sizeof(msg));
-	return msg;
+	Essentials::Communications::ReadySocket ready[4];
+	Essentials::Communications::Datagram datagrams[MULTICAST_RECEIVE_BATCH];
+
+	// The event loop is edge triggered, keep reading until every socket is empty
+	int32_t numReady = 0;
+	while ((numReady = mMulticast->WaitForReadable(ready, sizeof(ready) / sizeof(ready[0]), 0)) > 0)
+	{
+		for (int32_t i = 0; i < numReady; i++)
+		{
+			int32_t count = mMulticast->ReceiveReadyBatch(ready[i], mMulticastArena.data(), MULTICAST_MAX_DATAGRAM_SIZE, datagrams, MULTICAST_RECEIVE_BATCH);
+			if (count < 0)
+			{
+				std::cout << mMulticast->GetLastError() << std::endl;
+				return;
+			}
+
+			// Nothing is expected on the unicast socket, whatever turns up there is just drained
+			for (int32_t j = 0; j < count && ready[i].type == Essentials::Communications::SocketType::MULTICAST; j++)
+			{
+				if (IsPacketValid(datagrams[j].data, datagrams[j].size) &&
+					GetMessageFromBuffer(datagrams[j].data).action == ACTION_COMMAND::UPDATE_OFS_MULTICAST)
+				{
+					HandleMulticastChunk(datagrams[j].sender, datagrams[j].data, datagrams[j].size);
+				}
+			}
+		}
+	}
+
+	if (numReady < 0)
+	{
+		std::cout << mMulticast->GetLastError() << std::endl;
+	}
 }
 
-int UnitUpdater::SendAcknowledgement(const std::string ip, const int port, const MSG_TYPE type)
+int UnitUpdater::HandleMulticastChunk(const Essentials::Communications::Endpoint& sender, const uint8_t* buffer, const size_t size)
 {
-	int rtn = -1;
-	UPDATER_ACTION_ACK msg = { SYNC1, SYNC2, SYNC3, SYNC4, sizeof(UPDATER_ACTION_MESSAGE), 0, ACKNOWLEDGE, 0 };
+	constexpr size_t chunkOffset = sizeof(UPDATER_HEADER) + sizeof(uint32_t);
+	constexpr size_t overhead = chunkOffset + sizeof(UPDATER_CHUNK_HEADER) + sizeof(UPDATER_FOOTER);
 
-	switch (type)
+	UPDATER_HEADER header = { 0 };
+	UPDATER_CHUNK_HEADER chunk = { 0 };
+	memcpy(&header, buffer, sizeof(header));
+
+	if (size < overhead || header.msgSize != size)
 	{
-	case MSG_TYPE::BOOT_INTERRUPT:
-		msg.action = BOOT_INTERRUPT;
-		rtn = mUdp->SendUnicast(reinterpret_cast<char*>(&msg), sizeof(msg), ip, port);
-		break;
-	case MSG_TYPE::UPDATE_OFS:				break;
-	case MSG_TYPE::UPDATE_CONFIG:			break;
-	case MSG_TYPE::GET_LOG_NAMES:			break;
-	case MSG_TYPE::GET_SPECIFIC_LOG:		break;
-	case MSG_TYPE::GET_LAST_FLIGHT_LOG:		break;
+		return -1;
 	}
 
-	return rtn;
+	memcpy(&chunk, buffer + chunkOffset, sizeof(chunk));
+	if (chunk.length != size - overhead || chunk.offset > chunk.totalSize)
+	{
+		return -1;
+	}
+
+	// Nobody is waiting on a datagram, a damaged one is dropped and its range asked for at the next poll
+	if (!IsChunkIntact(chunk, buffer + chunkOffset))
+	{
+		return -1;
+	}
+
+	const uint8_t* data = buffer + chunkOffset + sizeof(chunk);
+	uint32_t length = chunk.length;
+	MULTICAST_FEC_HEADER fec = { 0 };
+	if (chunk.flags & CHUNK_FLAG_FEC)
+	{
+		if (length < sizeof(fec))
+		{
+			return -1;
+		}
+		memcpy(&fec, data, sizeof(fec));
+		data += sizeof(fec);
+		length -= sizeof(fec);
+	}
+	else if (chunk.flags & CHUNK_FLAG_REPAIR)
+	{
+		return -1;
+	}
+
+	// A repair symbol isn't image data, its chunk offset only names the block
+	bool repair = (chunk.flags & CHUNK_FLAG_REPAIR) != 0;
+	if (!repair && length > chunk.totalSize - chunk.offset)
+	{
+		return -1;
+	}
+
+	// Already installed, the sender may still be serving units that aren't
+	if (mMulticastDone && chunk.transferId == mMulticastDoneId)
+	{
+		return (chunk.flags & CHUNK_FLAG_POLL) ? SendMulticastStatus(sender, chunk.transferId) : 0;
+	}
+
+	if (!JoinDatagramUpload(chunk.transferId, chunk.totalSize, UploadSource::MULTICAST))
+	{
+		return (chunk.flags & CHUNK_FLAG_POLL) ? SendMulticastStatus(sender, chunk.transferId) : -1;
+	}
+	mMulticastSender = sender;
+
+	// Repeats sent for other units are skipped rather than written again
+	if (!repair && length > 0 && !mUploadCheckpoint.Contains(chunk.offset, length) && StoreMulticastData(chunk.offset, data, length) < 0)
+	{
+		return SendMulticastResponse(sender, ACTION_STATUS::FAIL);
+	}
+
+	if ((chunk.flags & CHUNK_FLAG_FEC) && DecodeMulticastBlock(chunk, fec, data, length) < 0)
+	{
+		return SendMulticastResponse(sender, ACTION_STATUS::FAIL);
+	}
+
+	if (mUploadCheckpoint.IsComplete())
+	{
+		if (mMulticastRebuilt > 0)
+		{
+			std::cout << "[UPDATER] " << mMulticastRebuilt << " bytes of the OFS update rebuilt from repair symbols\n";
+		}
+		return CompleteUpload();
+	}
+
+	return (chunk.flags & CHUNK_FLAG_POLL) ? SendMulticastStatus(sender, chunk.transferId) : 0;
+}
+
+int UnitUpdater::StoreMulticastData(const uint64_t offset, const uint8_t* data, const uint32_t length)
+{
+	if (mOfsWriter->Write(offset, data, length) < 0)
+	{
+		FailUpload();
+		return -1;
+	}
+
+	mUploadCheckpoint.AddRange(offset, length);
+
+	mBytesSinceCheckpoint += length;
+	if (mBytesSinceCheckpoint >= TRANSFER_CHECKPOINT_INTERVAL && CheckpointUpload() < 0)
+	{
+		std::cout << "[UPDATER] Failed to checkpoint OFS update\n";
+	}
+
+	return 0;
+}
+
+int UnitUpdater::DecodeMulticastBlock(const UPDATER_CHUNK_HEADER& chunk, const MULTICAST_FEC_HEADER& fec, const uint8_t* data, const uint32_t length)
+{
+	const uint64_t totalSize = chunk.totalSize;
+	const uint64_t symbolSize = fec.symbolSize;
+	const bool repair = (chunk.flags & CHUNK_FLAG_REPAIR) != 0;
+
+	// A symbol that doesn't describe its block consistently is still good image data, it just can't be coded with.
+	// Every source symbol has to start inside the image.
+	if (symbolSize == 0 || fec.sourceCount == 0 || repair != (fec.symbolIndex >= fec.sourceCount) ||
+		fec.blockOffset >= totalSize || (fec.sourceCount - 1) * symbolSize >= totalSize - fec.blockOffset)
+	{
+		return 0;
+	}
+
+	if (repair ? (chunk.offset != fec.blockOffset || length != symbolSize) :
+		(chunk.offset != fec.blockOffset + fec.symbolIndex * symbolSize || length != std::min(symbolSize, totalSize - chunk.offset)))
+	{
+		return 0;
+	}
+
+	// Everything in the block arrived by itself, nothing left to rebuild
+	const uint64_t blockSize = std::min(fec.sourceCount * symbolSize, totalSize - fec.blockOffset);
+	if (mUploadCheckpoint.Contains(fec.blockOffset, blockSize))
+	{
+		mFecDecoder->Forget(fec.blockOffset);
+		return 0;
+	}
+
+	std::vector<Essentials::Utilities::FecRecovered> recovered;
+	if (mFecDecoder->AddSymbol(chunk.transferId, fec.blockOffset, fec.symbolSize, fec.sourceCount, fec.symbolIndex, data, length, recovered) <= 0)
+	{
+		return 0;
+	}
+
+	for (const auto& symbol : recovered)
+	{
+		uint64_t offset = symbol.blockOffset + symbol.index * symbolSize;
+		uint32_t size = static_cast<uint32_t>(std::min(symbolSize, totalSize - offset));
+		if (!mUploadCheckpoint.Contains(offset, size))
+		{
+			if (StoreMulticastData(offset, symbol.data, size) < 0)
+			{
+				return -1;
+			}
+			mMulticastRebuilt += size;
+		}
+	}
+
+	return 0;
+}
+
+bool UnitUpdater::JoinDatagramUpload(const uint64_t transferId, const uint64_t totalSize, const UploadSource source)
+{
+	// Nothing on the wire is trusted to size the file we reserve
+	if (totalSize == 0 || totalSize > MAX_OFS_IMAGE_SIZE)
+	{
+		return false;
+	}
+
+	if (mUpdateInProgress)
+	{
+		if (mUploadSource == source && transferId == mUploadCheckpoint.GetTransferId() && totalSize == mUploadCheckpoint.GetTotalSize())
+		{
+			return true;
+		}
+
+		// An upload sent to this unit alone takes priority over the group
+		if (mUploadSource == UploadSource::STREAM || mDeltaPatcher->IsActive() ||
+			(mUploadSource == UploadSource::RELIABLE_UDP && source == UploadSource::MULTICAST))
+		{
+			return false;
+		}
+
+		// The sender has moved on to another image
+		mOfsWriter->Abort();
+		for (const auto& client : mUpdateClients)
+		{
+			SendResponse(client.first, ACTION_COMMAND::UPDATE_OFS, ACTION_STATUS::FAIL);
+		}
+		mUpdateClients.clear();
+		mUpdateInProgress = false;
+	}
+
+	// A unit restarted part way through picks up from its checkpoint if the sender is still going
+	std::string target = GetSettings()->ofsLocation;
+	std::error_code ec;
+	bool resuming = mUploadCheckpoint.Load(GetCheckpointPath(target)) == 0 &&
+		mUploadCheckpoint.GetTransferId() == transferId && mUploadCheckpoint.GetTotalSize() == totalSize &&
+		std::filesystem::exists(target + Essentials::Utilities::FILE_WRITER_TEMP_EXTENSION, ec) &&
+		mOfsWriter->Open(target, true) == 0;
+
+	if (resuming)
+	{
+		for (const auto& range : mUploadCheckpoint.GetRanges())
+		{
+			mOfsWriter->MarkWritten(range.first, range.second - range.first);
+		}
+	}
+	else
+	{
+		Essentials::Utilities::TransferCheckpoint::Remove(GetCheckpointPath(target));
+		if (mOfsWriter->Open(target) < 0 || mOfsWriter->Preallocate(totalSize) < 0)
+		{
+			std::cout << "[UPDATER] " << mOfsWriter->GetLastError() << "\n";
+			mOfsWriter->Abort();
+			mUploadCheckpoint.Clear();
+			return false;
+		}
+		mUploadCheckpoint.Reset(transferId, totalSize);
+	}
+
+	mUpdateTarget = target;
+	mUpdateInProgress = true;
+	mUploadSource = source;
+	mVerifyUpload = false;
+	mUpdateClients.clear();
+	mBytesSinceCheckpoint = 0;
+	mMulticastRebuilt = 0;
+	mFecDecoder->Reset();
+
+	std::cout << "[UPDATER] Receiving OFS update " << (source == UploadSource::MULTICAST ? "from multicast group, " : "over reliable UDP, ") << mUploadCheckpoint.GetReceivedBytes() << " of " << mUploadCheckpoint.GetTotalSize() << " bytes already received\n";
+	return true;
+}
+
+int UnitUpdater::SendMulticastStatus(const Essentials::Communications::Endpoint& sender, const uint64_t transferId)
+{
+	if (mMulticastDone && transferId == mMulticastDoneId)
+	{
+		return SendMulticastResponse(sender, ACTION_STATUS::SUCCESS, mMulticastDigest);
+	}
+
+	// Only what is missing is listed, the sender builds its next pass from every unit's answer
+	if (mUpdateInProgress && mUploadSource == UploadSource::MULTICAST && transferId == mUploadCheckpoint.GetTransferId())
+	{
+		return SendMulticastResponse(sender, ACTION_STATUS::FAIL, mUploadCheckpoint.GetMissing(MULTICAST_MAX_NACK_RANGES));
+	}
+
+	// Busy with an upload of its own, the sender should count this unit out
+	return SendMulticastResponse(sender, ACTION_STATUS::FAIL);
+}
+
+int UnitUpdater::SendMulticastResponse(const Essentials::Communications::Endpoint& sender, const uint32_t status, const std::string& data)
+{
+	constexpr UPDATER_FOOTER footer = { EOB };
+	RESPONSE_PREFIX prefix = SerializeResponseMsg(ACTION_COMMAND::UPDATE_OFS_MULTICAST, status, data.size());
+
+	std::string message(reinterpret_cast<const char*>(&prefix), sizeof(prefix));
+	message.append(data);
+	message.append(reinterpret_cast<const char*>(&footer), sizeof(footer));
+
+	// Best effort, a lost answer is made up for at the sender's next poll
+	mMulticast->SendUnicast(message.data(), static_cast<uint32_t>(message.size()), sender.ipAddress, sender.port);
+	return 0;
+}
+
+int UnitUpdater::StartReliableReceiver(const int port)
+{
+	if (!mReliableArena.empty())
+	{
+		return 0;
+	}
+
+	if (mReliableUdp->ConfigureThisClient("", static_cast<int16_t>(port)) < 0 || mReliableUdp->OpenUnicast() < 0 || mReliableUdp->GetWaitFD() == -1)
+	{
+		std::cout << mReliableUdp->GetLastError() << std::endl;
+		return -1;
+	}
+
+	mReliableArena.resize(static_cast<size_t>(RELIABLE_UDP_RECEIVE_BATCH) * Essentials::Communications::RUDP_MAX_PACKET_SIZE);
+	return mTcp->AddEventSource(mReliableUdp->GetWaitFD(), [this]() { HandleReliableReadable(); });
+}
+
+void UnitUpdater::HandleReliableReadable()
+{
+	Essentials::Communications::ReadySocket ready[1];
+	Essentials::Communications::Datagram datagrams[RELIABLE_UDP_RECEIVE_BATCH];
+	std::string reply;
+
+	// The event loop is edge triggered, keep reading until the socket is empty
+	int32_t numReady = 0;
+	while ((numReady = mReliableUdp->WaitForReadable(ready, 1, 0)) > 0)
+	{
+		int32_t count = mReliableUdp->ReceiveReadyBatch(ready[0], mReliableArena.data(), Essentials::Communications::RUDP_MAX_PACKET_SIZE, datagrams, RELIABLE_UDP_RECEIVE_BATCH);
+		if (count < 0)
+		{
+			std::cout << mReliableUdp->GetLastError() << std::endl;
+			return;
+		}
+
+		// Answers go straight back to whoever sent the datagram, a lost one is covered by the sender's timers
+		for (int32_t i = 0; i < count; i++)
+		{
+			if (mReliableReceiver->HandleDatagram(datagrams[i].sender, datagrams[i].data, datagrams[i].size, reply) > 0)
+			{
+				mReliableUdp->SendUnicast(reply.data(), static_cast<uint32_t>(reply.size()), datagrams[i].sender.ipAddress, datagrams[i].sender.port);
+			}
+		}
+	}
+
+	if (numReady < 0)
+	{
+		std::cout << mReliableUdp->GetLastError() << std::endl;
+	}
+}
+
+int UnitUpdater::HandleReliableChunk(const uint64_t transferId, const uint64_t totalSize, const uint64_t offset, const uint8_t* data, const size_t size)
+{
+	if (!JoinDatagramUpload(transferId, totalSize, UploadSource::RELIABLE_UDP))
+	{
+		return -1;
+	}
+
+	// Ranges kept from before a restart are already on disk
+	if (mUploadCheckpoint.Contains(offset, size))
+	{
+		return 0;
+	}
+
+	if (mOfsWriter->Write(offset, data, size) < 0)
+	{
+		FailUpload();
+		return -1;
+	}
+
+	mUploadCheckpoint.AddRange(offset, size);
+
+	mBytesSinceCheckpoint += size;
+	if (mBytesSinceCheckpoint >= TRANSFER_CHECKPOINT_INTERVAL && CheckpointUpload() < 0)
+	{
+		std::cout << "[UPDATER] Failed to checkpoint OFS update\n";
+	}
+
+	return 0;
+}
+
+int UnitUpdater::HandleReliableComplete(const uint64_t transferId, std::string& result)
+{
+	// Every chunk has been seen, the checkpoint has the final say on whether the image is whole
+	if (!mUpdateInProgress || mUploadSource != UploadSource::RELIABLE_UDP ||
+		transferId != mUploadCheckpoint.GetTransferId() || !mUploadCheckpoint.IsComplete())
+	{
+		return -1;
+	}
+
+	// The digest goes back with DONE so the sender can check what was installed
+	return CompleteUpload(&result);
+}
+
+int UnitUpdater::HandleOfsResume(const int clientFD, const uint8_t* buffer, const size_t size)
+{
+	constexpr size_t idOffset = sizeof(UPDATER_HEADER) + sizeof(uint32_t);
+
+	UPDATER_HEADER header = { 0 };
+	memcpy(&header, buffer, sizeof(header));
+
+	uint64_t transferId = 0;
+	if (size < idOffset + sizeof(transferId) + sizeof(UPDATER_FOOTER) || header.msgSize != idOffset + sizeof(transferId) + sizeof(UPDATER_FOOTER))
+	{
+		return SendResponse(clientFD, ACTION_COMMAND::RESUME_OFS, ACTION_STATUS::FAIL);
+	}
+	memcpy(&transferId, buffer + idOffset, sizeof(transferId));
+
+	if (mUpdateInProgress)
+	{
+		if (mDeltaPatcher->IsActive() || transferId != mUploadCheckpoint.GetTransferId())
+		{
+			return SendResponse(clientFD, ACTION_COMMAND::RESUME_OFS, ACTION_STATUS::FAIL);
+		}
+
+		// A stream reconnected, possibly before we noticed its old connection drop, add it to the upload
+		if (CheckpointUpload() < 0)
+		{
+			return SendResponse(clientFD, ACTION_COMMAND::RESUME_OFS, ACTION_STATUS::FAIL);
+		}
+		mUpdateClients[clientFD] = false;
+	}
+	else
+	{
+		// After a restart only the checkpoint on disk knows about the upload
+		std::string target = GetSettings()->ofsLocation;
+		if ((!mUploadCheckpoint.IsActive() || mUploadCheckpoint.GetTransferId() != transferId) &&
+			mUploadCheckpoint.Load(GetCheckpointPath(target)) < 0)
+		{
+			return SendResponse(clientFD, ACTION_COMMAND::RESUME_OFS, ACTION_STATUS::FAIL);
+		}
+
+		std::error_code ec;
+		if (mUploadCheckpoint.GetTransferId() != transferId ||
+			!std::filesystem::exists(target + Essentials::Utilities::FILE_WRITER_TEMP_EXTENSION, ec) ||
+			mOfsWriter->Open(target, true) < 0)
+		{
+			return SendResponse(clientFD, ACTION_COMMAND::RESUME_OFS, ACTION_STATUS::FAIL);
+		}
+
+		// What arrived before the break is read back into the digest as the file fills in behind it
+		for (const auto& range : mUploadCheckpoint.GetRanges())
+		{
+			mOfsWriter->MarkWritten(range.first, range.second - range.first);
+		}
+
+		mUpdateTarget = target;
+		mUpdateInProgress = true;
+		mUploadSource = UploadSource::STREAM;
+		mUpdateClients.clear();
+		mUpdateClients[clientFD] = false;
+		mBytesSinceCheckpoint = 0;
+		StartVerifying();
+	}
+
+	std::cout << "[UPDATER] Resuming OFS update with " << mUploadCheckpoint.GetReceivedBytes() << " of " << mUploadCheckpoint.GetTotalSize() << " bytes received\n";
+	return SendResponse(clientFD, ACTION_COMMAND::RESUME_OFS, ACTION_STATUS::SUCCESS, mUploadCheckpoint.GetStatus());
+}
+
+int UnitUpdater::HandleOfsManifest(const int clientFD, const uint8_t* buffer, const size_t size)
+{
+	constexpr size_t manifestOffset = sizeof(UPDATER_HEADER) + sizeof(uint32_t);
+
+	UPDATER_HEADER header = { 0 };
+	memcpy(&header, buffer, sizeof(header));
+
+	if (size < manifestOffset + sizeof(UPDATER_FOOTER) || header.msgSize != size)
+	{
+		return SendResponse(clientFD, ACTION_COMMAND::UPDATE_OFS_MANIFEST, ACTION_STATUS::FAIL);
+	}
+
+	if (mManifest.Parse(buffer + manifestOffset, size - manifestOffset - sizeof(UPDATER_FOOTER)) < 0)
+	{
+		std::cout << "[UPDATER] " << mManifest.GetLastError() << "\n";
+		return SendResponse(clientFD, ACTION_COMMAND::UPDATE_OFS_MANIFEST, ACTION_STATUS::FAIL);
+	}
+
+	// Normally sent ahead of the first chunk, but a resumed upload can be given one too
+	if (mUpdateInProgress && !mDeltaPatcher->IsActive() && mUploadSource == UploadSource::STREAM)
+	{
+		StartVerifying();
+	}
+
+	std::cout << "[UPDATER] Manifest of " << mManifest.GetLeafCount() << " leaves for a " << mManifest.GetImageSize() << " byte image\n";
+	return SendResponse(clientFD, ACTION_COMMAND::UPDATE_OFS_MANIFEST, ACTION_STATUS::SUCCESS);
+}
+
+void UnitUpdater::StartVerifying()
+{
+	mVerifyUpload = mManifest.IsActive() && mManifest.GetTransferId() == mUploadCheckpoint.GetTransferId() &&
+		mManifest.GetImageSize() == mUploadCheckpoint.GetTotalSize();
+
+	if (mVerifyUpload)
+	{
+		mVerifier->SetManifest(mManifest);
+	}
+}
+
+int UnitUpdater::HandleVerifyResults()
+{
+	for (const auto& result : mVerifier->TakeResults())
+	{
+		// Results for an upload that has since been restarted or finished are stale
+		if (!mUpdateInProgress || !mVerifyUpload || result.transferId != mUploadCheckpoint.GetTransferId())
+		{
+			continue;
+		}
+
+		if (result.ok)
+		{
+			mUploadCheckpoint.AddRange(result.offset, result.length);
+			mBytesSinceCheckpoint += result.length;
+			continue;
+		}
+
+		// Ask for just this leaf again, on the stream that sent it if it is still here
+		std::cout << "[UPDATER] Leaf at offset " << result.offset << " doesn't match the manifest\n";
+		int clientFD = mUpdateClients.count(result.clientFD) ? result.clientFD : (mUpdateClients.empty() ? -1 : mUpdateClients.begin()->first);
+		if (clientFD != -1)
+		{
+			mUpdateClients[clientFD] = false;
+			TRANSFER_RANGE range = { result.offset, result.length };
+			SendResponse(clientFD, ACTION_COMMAND::UPDATE_OFS, ACTION_STATUS::FAIL, std::string(reinterpret_cast<const char*>(&range), sizeof(range)));
+		}
+	}
+
+	if (!mUpdateInProgress || !mVerifyUpload)
+	{
+		return 0;
+	}
+
+	if (mBytesSinceCheckpoint >= TRANSFER_CHECKPOINT_INTERVAL && CheckpointUpload() < 0)
+	{
+		std::cout << "[UPDATER] Failed to checkpoint OFS update\n";
+	}
+
+	if (mUploadCheckpoint.IsComplete())
+	{
+		return CompleteUpload();
+	}
+
+	ReportUploadGaps();
+	return 0;
+}
+
+int UnitUpdater::CheckpointUpload()
+{
+	// The data has to be on disk before a checkpoint claims it is
+	mBytesSinceCheckpoint = 0;
+	if (mOfsWriter->Flush() < 0)
+	{
+		std::cout << "[UPDATER] " << mOfsWriter->GetLastError() << "\n";
+		return -1;
+	}
+
+	return mUploadCheckpoint.Save(GetCheckpointPath(mUpdateTarget));
+}
+
+void UnitUpdater::SuspendUpload()
+{
+	if (!mUpdateInProgress || mDeltaPatcher->IsActive())
+	{
+		return;
+	}
+
+	mUpdateInProgress = false;
+	mUpdateClients.clear();
+
+	if (mOfsWriter->Suspend() < 0 || mUploadCheckpoint.Save(GetCheckpointPath(mUpdateTarget)) < 0)
+	{
+		// Can't vouch for what is on disk, start again next time
+		std::cout << "[UPDATER] Failed to save OFS update for resume, discarding partial image\n";
+		std::error_code ec;
+		std::filesystem::remove(mUpdateTarget + Essentials::Utilities::FILE_WRITER_TEMP_EXTENSION, ec);
+		Essentials::Utilities::TransferCheckpoint::Remove(GetCheckpointPath(mUpdateTarget));
+		mUploadCheckpoint.Clear();
+	}
+}
+
+std::string UnitUpdater::GetCheckpointPath(const std::string& ofsLocation)
+{
+	return ofsLocation + Essentials::Utilities::FILE_WRITER_TEMP_EXTENSION + Essentials::Utilities::TRANSFER_CHECKPOINT_EXTENSION;
+}
+
+std::string UnitUpdater::GetLogPath(const std::string& name)
+{
+	// Only serve files from the log folder, never a path the client made up
+	if (name.empty() || name == "." || name == ".." || std::filesystem::path(name).filename().string() != name)
+	{
+		return "";
+	}
+
+	return (std::filesystem::path(GetSettings()->sdcardLocation) / name).string();
+}
+
+int UnitUpdater::HandleOfsSignature(const int clientFD, const uint8_t* buffer, const size_t size)
+{
+	constexpr size_t blockSizeOffset = sizeof(UPDATER_HEADER) + sizeof(uint32_t);
+
+	UPDATER_HEADER header = { 0 };
+	memcpy(&header, buffer, sizeof(header));
+
+	if (size < sizeof(UPDATER_ACTION_MESSAGE) || header.msgSize != size)
+	{
+		return SendResponse(clientFD, ACTION_COMMAND::GET_OFS_SIGNATURE, ACTION_STATUS::FAIL);
+	}
+
+	// The block size is optional, a plain action message gets the default
+	uint32_t blockSize = DELTA_DEFAULT_BLOCK_SIZE;
+	if (header.msgSize == blockSizeOffset + sizeof(blockSize) + sizeof(UPDATER_FOOTER))
+	{
+		memcpy(&blockSize, buffer + blockSizeOffset, sizeof(blockSize));
+	}
+	else if (header.msgSize != sizeof(UPDATER_ACTION_MESSAGE))
+	{
+		return SendResponse(clientFD, ACTION_COMMAND::GET_OFS_SIGNATURE, ACTION_STATUS::FAIL);
+	}
+
+	std::string signature;
+	if (mDeltaPatcher->GenerateSignature(GetSettings()->ofsLocation, blockSize, signature) < 0)
+	{
+		std::cout << "[UPDATER] " << mDeltaPatcher->GetLastError() << "\n";
+		return SendResponse(clientFD, ACTION_COMMAND::GET_OFS_SIGNATURE, ACTION_STATUS::FAIL);
+	}
+
+	return SendResponse(clientFD, ACTION_COMMAND::GET_OFS_SIGNATURE, ACTION_STATUS::SUCCESS, signature);
+}
+
+int UnitUpdater::HandleOfsDelta(const int clientFD, const uint8_t* buffer, const size_t size)
+{
+	constexpr size_t chunkOffset = sizeof(UPDATER_HEADER) + sizeof(uint32_t);
+
+	UPDATER_CHUNK_HEADER chunk = { 0 };
+	int result = 0;
+
+	// The delta is applied strictly in order, a damaged chunk leaves it waiting for the same offset again
+	if (!ReadChunk(clientFD, ACTION_COMMAND::UPDATE_OFS_DELTA, buffer, size, chunk, result))
+	{
+		return result;
+	}
+
+	// The first chunk opens a temp file next to the OFS and the current OFS to copy unchanged blocks from
+	if (chunk.flags & CHUNK_FLAG_FIRST)
+	{
+		if (mUpdateInProgress)
+		{
+			mDeltaPatcher->Abort();
+			mOfsWriter->Abort();
+		}
+
+		// A delta replaces any suspended upload
+		std::string ofsLocation = GetSettings()->ofsLocation;
+		Essentials::Utilities::TransferCheckpoint::Remove(GetCheckpointPath(ofsLocation));
+		mUploadCheckpoint.Clear();
+
+		if (mOfsWriter->Open(ofsLocation) < 0)
+		{
+			std::cout << "[UPDATER] " << mOfsWriter->GetLastError() << "\n";
+			return SendResponse(clientFD, ACTION_COMMAND::UPDATE_OFS_DELTA, ACTION_STATUS::FAIL);
+		}
+
+		if (mDeltaPatcher->Begin(ofsLocation, mOfsWriter, chunk.totalSize) < 0)
+		{
+			std::cout << "[UPDATER] " << mDeltaPatcher->GetLastError() << "\n";
+			mOfsWriter->Abort();
+			return SendResponse(clientFD, ACTION_COMMAND::UPDATE_OFS_DELTA, ACTION_STATUS::FAIL);
+		}
+
+		mUpdateInProgress = true;
+		mUploadSource = UploadSource::STREAM;
+		mUpdateClients.clear();
+		mUpdateClients[clientFD] = false;
+		mUpdateBytesReceived = 0;
+	}
+
+	if (!mUpdateInProgress || mUpdateClients.count(clientFD) == 0 || !mDeltaPatcher->IsActive())
+	{
+		return SendResponse(clientFD, ACTION_COMMAND::UPDATE_OFS_DELTA, ACTION_STATUS::FAIL);
+	}
+
+	if (mDeltaPatcher->Apply(chunk.offset, buffer + chunkOffset + sizeof(chunk), chunk.length) < 0)
+	{
+		std::cout << "[UPDATER] " << mDeltaPatcher->GetLastError() << "\n";
+		mDeltaPatcher->Abort();
+		mOfsWriter->Abort();
+		mUpdateInProgress = false;
+		mUpdateClients.clear();
+		return SendResponse(clientFD, ACTION_COMMAND::UPDATE_OFS_DELTA, ACTION_STATUS::FAIL);
+	}
+	mUpdateBytesReceived += chunk.length;
+
+	if (chunk.flags & CHUNK_FLAG_LAST)
+	{
+		mUpdateInProgress = false;
+		mUpdateClients.clear();
+
+		uint64_t imageSize = mDeltaPatcher->GetOutputOffset();
+		if (mDeltaPatcher->Finish() < 0)
+		{
+			std::cout << "[UPDATER] " << mDeltaPatcher->GetLastError() << "\n";
+			mOfsWriter->Abort();
+			return SendResponse(clientFD, ACTION_COMMAND::UPDATE_OFS_DELTA, ACTION_STATUS::FAIL);
+		}
+
+		if (mOfsWriter->Commit() < 0)
+		{
+			std::cout << "[UPDATER] " << mOfsWriter->GetLastError() << "\n";
+			return SendResponse(clientFD, ACTION_COMMAND::UPDATE_OFS_DELTA, ACTION_STATUS::FAIL);
+		}
+
+		std::cout << "[UPDATER] OFS updated from delta, " << imageSize << " bytes written from " << mUpdateBytesReceived << " bytes received\n";
+		return SendResponse(clientFD, ACTION_COMMAND::UPDATE_OFS_DELTA, ACTION_STATUS::SUCCESS, GetImageDigest());
+	}
+
+	return 0;
+}
+
+std::string UnitUpdater::GetImageDigest()
+{
+	// Worked out by the writer as the image arrived, there is nothing left to read
+	Essentials::Utilities::Sha256Digest digest = { 0 };
+	if (!mOfsWriter->GetDigest(digest))
+	{
+		std::cout << "[UPDATER] No digest available for the new OFS\n";
+		return "";
+	}
+
+	std::cout << "[UPDATER] OFS SHA-256 " << Essentials::Utilities::Sha256::ToHex(digest) << "\n";
+	return std::string(reinterpret_cast<const char*>(digest.data()), digest.size());
+}
+
+int UnitUpdater::SendResponse(const int clientFD, const uint32_t action, const uint32_t status, const std::string& data)
+{
+	static constexpr UPDATER_FOOTER footer = { EOB };
+	RESPONSE_PREFIX prefix = SerializeResponseMsg(action, status, data.size());
+
+	// The prefix lives on the stack and the data is sent from where it is, no serialized copy is built
+	iovec buffers[] = {
+		{ &prefix, sizeof(prefix) },
+		{ const_cast<char*>(data.data()), data.size() },
+		{ const_cast<UPDATER_FOOTER*>(&footer), sizeof(footer) },
+	};
+
+	return mTcp->SendBuffersToClient(clientFD, buffers, sizeof(buffers) / sizeof(buffers[0]));
+}
+
+int UnitUpdater::SendFileResponse(const int clientFD, const uint32_t action, const std::string& filePath, const uint64_t offset)
+{
+	std::error_code ec;
+	uint64_t fileSize = filePath.empty() ? 0 : std::filesystem::file_size(filePath, ec);
+
+	if (filePath.empty() || ec || offset > fileSize || fileSize - offset > UINT32_MAX - sizeof(RESPONSE_PREFIX) - sizeof(UPDATER_FOOTER))
+	{
+		return SendResponse(clientFD, action, ACTION_STATUS::FAIL);
+	}
+
+	// Resumed downloads only get what the client doesn't already have
+	fileSize -= offset;
+	RESPONSE_PREFIX prefix = SerializeResponseMsg(action, ACTION_STATUS::SUCCESS, static_cast<size_t>(fileSize));
+	UPDATER_FOOTER footer = { EOB };
+
+	// The file body goes from the page cache to the socket, only the prefix and footer come from us
+	if (mTcp->SendFileToClient(clientFD, filePath, offset, fileSize, reinterpret_cast<const uint8_t*>(&prefix), sizeof(prefix),
+		reinterpret_cast<const uint8_t*>(&footer), sizeof(footer)) < 0)
+	{
+		// Part of the response may be out already, drop the client rather than leave it out of step
+		std::cout << "[UPDATER] Failed to send " << filePath << ": " << mTcp->GetLastError() << "\n";
+		mTcp->DisconnectClient(clientFD);
+		return -1;
+	}
+
+	return 0;
+}
+
+std::string UnitUpdater::FindLastFlightLog()
+{
+	std::error_code ec;
+	std::filesystem::path newest;
+	std::filesystem::file_time_type newestTime = std::filesystem::file_time_type::min();
+
+	std::shared_ptr<const Settings> settings = GetSettings();
+	for (const auto& entry : std::filesystem::directory_iterator(settings->sdcardLocation, ec))
+	{
+		if (entry.is_regular_file(ec) && entry.last_write_time(ec) > newestTime)
+		{
+			newestTime = entry.last_write_time(ec);
+			newest = entry.path();
+		}
+	}
+
+	return newest.string();
+}
+
+int UnitUpdater::ArmInterruptListener()
+{
+	if (mListenerArmedUSec != 0)
+	{
+		return 0;
+	}
+
+	// Validate we have a broadcast port and attempt to add the listener. 
+	if (mBroadcastPort <= 0 ||
+		mUdp->AddBroadcastListener(mBroadcastPort) < 0)
+	{
+		return -1;
+	}
+
+	// Open an ephemeral unicast socket now so the ack can go out the moment an interrupt arrives.
+	if (mUdp->ConfigureThisClient("", 0) < 0 || mUdp->OpenUnicast() < 0)
+	{
+		std::cout << mUdp->GetLastError() << std::endl;
+	}
+
+	// Stamped on arrival so the ack can report how long the interrupt waited on the unit, the listener works without it
+	if (mUdp->EnableReceiveTimestamps() < 0)
+	{
+		std::cout << mUdp->GetLastError() << std::endl;
+	}
+
+	// The listening window runs from here, anything arriving while setup finishes still counts.
+	mListenerArmedUSec = mTimer->GetUSecTicks64();
+	return 0;
+}
+
+int UnitUpdater::ListenForInterrupt()
+{
+	if (ArmInterruptListener() < 0)
+	{
+		return -1;
+	}
+
+	uint8_t buffer[200];																// buffer to hold data received
+	Essentials::Communications::ReadySocket ready[4];								// sockets with data waiting
+	int rtn = 0;
+
+	// The window is measured from when the listener was armed, carried over onto the clock the receive waits on
+	uint64_t windowEnd = mListenerArmedUSec + static_cast<uint64_t>(mMaxBroadcastListeningTimeInMSec) * 1000;
+	uint64_t now = mTimer->GetUSecTicks64();
+	Essentials::Communications::Deadline deadline = std::chrono::steady_clock::now() + std::chrono::microseconds(windowEnd > now ? windowEnd - now : 0);
+
+	while (rtn == 0)
+	{
+		// Sleep until a datagram arrives or the window closes, waking exactly on the close rather than rounded to a millisecond
+		int32_t numReady = mUdp->WaitForReadable(ready, sizeof(ready) / sizeof(ready[0]), deadline);
+
+		if (numReady < 0)
+		{
+			std::cout << mUdp->GetLastError() << std::endl;
+			return -1;
+		}
+
+		if (numReady == 0)
+		{
+			break;
+		}
+
+		for (int32_t i = 0; i < numReady && rtn == 0; i++)
+		{
+			if (ready[i].type != Essentials::Communications::SocketType::BROADCAST_LISTENER ||
+				ready[i].endpoint.port != mBroadcastPort)
+			{
+				continue;
+			}
+
+			Essentials::Communications::Endpoint sender;
+			Essentials::Communications::RxTimestamp received;
+			int32_t bytesReceived = mUdp->ReceiveReady(ready[i], buffer, sizeof(buffer), sender, received);
+
+			if (bytesReceived < 0)
+			{
+				std::cout << mUdp->GetLastError() << std::endl;
+				return -1;
+			}
+			else if (bytesReceived < static_cast<int32_t>(sizeof(UPDATER_ACTION_MESSAGE)) || !IsPacketValid(buffer, bytesReceived))
+			{
+				continue;
+			}
+
+			UPDATER_ACTION_MESSAGE msg = GetMessageFromBuffer(buffer);
+
+			// Not a boot interrupt message, disregard it. 
+			if (msg.action != ACTION_COMMAND::BOOT_INTERRUPT)
+			{
+				continue;
+			}
+
+			// Respond to the sender with an ack
+			if (SendAcknowledgement(sender.ipAddress, sender.port, MSG_TYPE::BOOT_INTERRUPT) < 0)
+			{
+				std::cout << "[UPDATER] Failed to send broadcast response";
+				return -1;
+			}
+
+			std::cout << "[UPDATER] Broadcast Ack sent to " + sender.ipAddress + ":" + std::to_string(static_cast<uint16_t>(sender.port)) + "\n";
+
+			// Software stamps are on the wall clock, what is left is the time from the wire to the ack on this unit
+			if (received.source == Essentials::Communications::TimestampSource::SOFTWARE)
+			{
+				int64_t nowNSec = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::system_clock::now().time_since_epoch()).count();
+				std::cout << "[UPDATER] Interrupt acknowledged " << (nowNSec - received.nsec) / 1000 << "us after it arrived\n";
+			}
+			rtn = 1;
+		}
+	}
+
+	std::cout << "[UPDATER] Stopped listening for interrupt " << GetStartupElapsedMSec() << "ms after startup\n";
+	return rtn;
+}
+
+uint64_t UnitUpdater::GetStartupElapsedMSec()
+{
+	return (mTimer->GetUSecTicks64() - mStartupUSec) / 1000;
+}
+
+bool UnitUpdater::IsPacketValid(const uint8_t* buffer, const size_t size)
+{
+	if (size < sizeof(UPDATER_ACTION_MESSAGE))
+	{
+		return false;
+	}
+
+	UPDATER_HEADER header = { 0 };
+	memcpy(&header, buffer, sizeof(header));
+
+	// Plain actions are fixed size, actions that carry data may be larger.
+	if (header.sync1 == SYNC1 &&
+		header.sync2 == SYNC2 &&
+		header.sync3 == SYNC3 &&
+		header.sync4 == SYNC4 &&
+		header.msgSize >= sizeof(UPDATER_ACTION_MESSAGE) &&
+		header.msgSize <= size
+		)
+	{
+		UPDATER_ACTION_MESSAGE msg = GetMessageFromBuffer(buffer);
+
+		if (header.msgSize != sizeof(UPDATER_ACTION_MESSAGE) && 
+			msg.action != ACTION_COMMAND::UPDATE_OFS && 
+			msg.action != ACTION_COMMAND::UPDATE_OFS_DELTA &&
+			msg.action != ACTION_COMMAND::GET_OFS_SIGNATURE &&
+			msg.action != ACTION_COMMAND::RESUME_OFS &&
+			msg.action != ACTION_COMMAND::RESUME_SPECIFIC_LOG &&
+			msg.action != ACTION_COMMAND::UPDATE_OFS_MANIFEST &&
+			msg.action != ACTION_COMMAND::UPDATE_OFS_MULTICAST &&
+			msg.action != ACTION_COMMAND::GET_SPECIFIC_LOG)
+		{
+			return false;
+		}
+
+		switch (msg.action)
+		{
+		case ACTION_COMMAND::CLOSE:
+		case ACTION_COMMAND::BOOT_INTERRUPT:
+		case ACTION_COMMAND::GET_AS_BUILT:
+		case ACTION_COMMAND::UPDATE_OFS:
+		case ACTION_COMMAND::UPDATE_CONFIG:
+		case ACTION_COMMAND::GET_LOG_NAMES:
+		case ACTION_COMMAND::GET_SPECIFIC_LOG:
+		case ACTION_COMMAND::GET_LAST_FLIGHT_LOG:
+		case ACTION_COMMAND::GET_OFS_SIGNATURE:
+		case ACTION_COMMAND::UPDATE_OFS_DELTA:
+		case ACTION_COMMAND::RESUME_OFS:
+		case ACTION_COMMAND::RESUME_SPECIFIC_LOG:
+		case ACTION_COMMAND::UPDATE_OFS_MANIFEST:
+		case ACTION_COMMAND::UPDATE_OFS_MULTICAST:
+			return true;
+		}
+	}
+	return false;
+}
+
+RESPONSE_PREFIX UnitUpdater::SerializeResponseMsg(const uint32_t action, const uint32_t status, const size_t dataSize)
+{
+	// Same layout as RESPONSE_MSG on the wire, the data and footer are sent after this
+	RESPONSE_PREFIX prefix = { { SYNC1, SYNC2, SYNC3, SYNC4, 0 }, action, status, dataSize };
+	prefix.header.msgSize = static_cast<uint32_t>(sizeof(prefix) + dataSize + sizeof(UPDATER_FOOTER));
+	return prefix;
+}
+
+UPDATER_ACTION_MESSAGE UnitUpdater::GetMessageFromBuffer(const uint8_t* buffer)
+{
+	UPDATER_ACTION_MESSAGE msg = { 0 };
+	memcpy(&msg, buffer, sizeof(msg));
+	return msg;
+}
+
+int UnitUpdater::SendAcknowledgement(const std::string ip, const int port, const MSG_TYPE type)
+{
+	int rtn = -1;
+	UPDATER_ACTION_ACK msg = { SYNC1, SYNC2, SYNC3, SYNC4, sizeof(UPDATER_ACTION_MESSAGE), 0, ACKNOWLEDGE, 0 };
+
+	switch (type)
+	{
+	case MSG_TYPE::BOOT_INTERRUPT:
+		msg.action = BOOT_INTERRUPT;
+		rtn = mUdp->SendUnicast(reinterpret_cast<char*>(&msg), sizeof(msg), ip, port);
+		break;
+	case MSG_TYPE::UPDATE_OFS:				break;
+	case MSG_TYPE::UPDATE_CONFIG:			break;
+	case MSG_TYPE::GET_LOG_NAMES:			break;
+	case MSG_TYPE::GET_SPECIFIC_LOG:		break;
+	case MSG_TYPE::GET_LAST_FLIGHT_LOG:		break;
+	case MSG_TYPE::GET_OFS_SIGNATURE:		break;
+	case MSG_TYPE::UPDATE_OFS_DELTA:		break;
+	case MSG_TYPE::RESUME_OFS:				break;
+	case MSG_TYPE::RESUME_SPECIFIC_LOG:		break;
+	case MSG_TYPE::UPDATE_OFS_MANIFEST:		break;
+	case MSG_TYPE::UPDATE_OFS_MULTICAST:	break;
+	}
+
+	return rtn;
+}
+
+std::shared_ptr<const Settings> UnitUpdater::GetSettings() const
+{
+	// Not lock free, libstdc++ guards the atomic shared_ptr with a short spinlock. A reload only
+	// takes it for the swap, and the snapshot held stays valid even if a reload replaces it.
+	return mSettings.load(std::memory_order_acquire);
+}
+
+int UnitUpdater::ReloadSettings()
+{
+	// Build the new settings completely before anyone can see them
+	auto next = std::make_shared<Settings>();
+	if (!next->LoadFromFile(mSettingsPath))
+	{
+		std::cout << "[UPDATER] Failed to reload settings, keeping current settings\n";
+		return -1;
+	}
+
+	std::shared_ptr<const Settings> current = GetSettings();
+	if (*next == *current)
+	{
+		return 0;
+	}
+
+	if (next->maximumConnections != current->maximumConnections && mTcp != nullptr)
+	{
+		mTcp->SetMaxClients(next->maximumConnections);
+	}
+
+	if (next->broadcastPort != current->broadcastPort || next->communicationPort != current->communicationPort ||
+		next->multicastGroup != current->multicastGroup || next->multicastPort != current->multicastPort)
+	{
+		std::cout << "[UPDATER] Port and multicast group changes take effect on the next restart\n";
+	}
+
+	mMaxBroadcastListeningTimeInMSec = next->broadcastTimeoutMSec;
+
+	// Publish, handlers pick up the new settings on their next request
+	mSettings.store(std::move(next), std::memory_order_release);
+	std::cout << "[UPDATER] Settings reloaded\n";
+	return 0;
+}
+
+void UnitUpdater::WatchSettings()
+{
+#ifndef WIN32
+	// Watch the directory rather than the file, editors commonly save by renaming a new file over the old one
+	std::filesystem::path path(mSettingsPath);
+	std::string directory = path.parent_path().empty() ? "." : path.parent_path().string();
+	std::string fileName = path.filename().string();
+
+	int notifyFD = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+	if (notifyFD < 0 || inotify_add_watch(notifyFD, directory.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO) < 0)
+	{
+		std::cout << "[UPDATER] Unable to watch settings for changes\n";
+		if (notifyFD >= 0)
+		{
+			close(notifyFD);
+		}
+		return;
+	}
+
+	pollfd fds[2] = { { notifyFD, POLLIN, 0 }, { mSettingsWakeFD, POLLIN, 0 } };
+	alignas(inotify_event) char buffer[4096];
+
+	while (true)
+	{
+		if (poll(fds, 2, -1) < 0)
+		{
+			if (errno == EINTR)
+			{
+				continue;
+			}
+			break;
+		}
+
+		if (fds[1].revents != 0)
+		{
+			break;
+		}
+
+		bool changed = false;
+		ssize_t length = 0;
+		while ((length = read(notifyFD, buffer, sizeof(buffer))) > 0)
+		{
+			for (char* position = buffer; position < buffer + length; )
+			{
+				inotify_event* event = reinterpret_cast<inotify_event*>(position);
+				if (event->len > 0 && fileName == event->name)
+				{
+					changed = true;
+				}
+				position += sizeof(inotify_event) + event->len;
+			}
+		}
+
+		if (changed)
+		{
+			ReloadSettings();
+		}
+	}
+
+	close(notifyFD);
+#endif
+}
+
+void UnitUpdater::StopWatchingSettings()
+{
+#ifndef WIN32
+	if (mSettingsThread.joinable())
+	{
+		uint64_t one = 1;
+		ssize_t rtn = write(mSettingsWakeFD, &one, sizeof(one));
+		(void)rtn;
+		mSettingsThread.join();
+	}
+
+	if (mSettingsWakeFD != -1)
+	{
+		close(mSettingsWakeFD);
+		mSettingsWakeFD = -1;
+	}
+#endif
 }
 
 void UnitUpdater::Close()
 {
+	StopWatchingSettings();
+	SuspendUpload();
+	mDeltaPatcher->Abort();
+	mOfsWriter->Abort();
 	mTimer->ReleaseInstance();
 }
\ No newline at end of file
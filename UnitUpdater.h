@@ -1,13 +1,52 @@
 ﻿#pragma once
 
 #include <iostream>
+#include <map>
+#include <atomic>
+#include <memory>
+#include <thread>
+#include <filesystem>
+#ifndef WIN32
+#include <poll.h>
+#include <sys/inotify.h>
+#include <sys/eventfd.h>
+#endif
 #include "tcp_server.h"
 #include "udp_client.h"
+#include "reliable_udp.h"
 #include "timer.h"
+#include "file_writer.h"
+#include "frame_assembler.h"
+#include "ofs_delta.h"
+#include "crc32c.h"
+#include "merkle_manifest.h"
+#include "reed_solomon.h"
+#include "transfer_checkpoint.h"
 #include "project_messages.h"
 #include "project_settings.h"
 
 constexpr int DEFAULT_TIMELENGTH_MSEC = 1000;
+constexpr int CLIENT_IDLE_TIMEOUT_MSEC = 60000;   // Clients silent for this long are disconnected
+constexpr size_t OFS_WRITER_BLOCK_COUNT = 16;     // Write-behind blocks shared by every stream of an upload
+constexpr size_t OFS_WRITER_THREAD_COUNT = 4;     // Writes kept in flight to the flash at once
+constexpr uint32_t MULTICAST_RECEIVE_BATCH = 16;  // Multicast datagrams taken from the socket per read
+constexpr uint32_t RELIABLE_UDP_RECEIVE_BATCH = 16;   // Reliable UDP datagrams taken from the socket per read
+constexpr uint64_t MAX_OFS_IMAGE_SIZE = 4ull * 1024 * 1024 * 1024;    // Largest OFS image a datagram upload may announce
+
+/// @brief Where the upload in progress is coming from
+enum class UploadSource : uint8_t
+{
+    STREAM,         // TCP connections in mUpdateClients
+    MULTICAST,      // The multicast group
+    RELIABLE_UDP,   // A reliable UDP sender on the communication port
+};
+
+/// @brief A client's idle deadline on the timer wheel, receives only note the time
+struct IdleTimer
+{
+    uint64_t    wheelId;            // Deadline on the timer wheel
+    uint64_t    lastReceiveMSec;    // Timer ticks of the client's last receive
+};
 
 class UnitUpdater
 {
@@ -19,24 +58,98 @@ public:
     void    SetMaxBroadcastListeningTime(int mSecTimeout);
     int     StartServer();
     int     HandleMessage(const int clientFD, const std::string& msg);
+    int     HandleConnection(const int clientFD);
+    int     HandleDisconnect(const int clientFD);
+    int     ArmInterruptListener();
     int     ListenForInterrupt();
+    std::shared_ptr<const Settings> GetSettings() const;
+    uint64_t GetStartupElapsedMSec();
     void    Close();
 protected:
 private:
-    bool    IsPacketValid(const uint8_t* buffer);
-    std::string SerializeResponseMsg(const RESPONSE_MSG& msg);
+    void    ResetIdleTimer(const int clientFD);
+    void    CheckIdleTimer(const int clientFD);
+    int     ReloadSettings();
+    void    WatchSettings();
+    void    StopWatchingSettings();
+    bool    IsPacketValid(const uint8_t* buffer, const size_t size);
+    int     HandleFrame(const int clientFD, const uint8_t* frame, const size_t size);
+    int     HandleOfsChunk(const int clientFD, const uint8_t* buffer, const size_t size);
+    bool    ReadChunk(const int clientFD, const uint32_t action, const uint8_t* buffer, const size_t size, UPDATER_CHUNK_HEADER& chunk, int& result);
+    bool    IsChunkIntact(const UPDATER_CHUNK_HEADER& chunk, const uint8_t* chunkStart);
+    int     RejectChunk(const int clientFD, const uint32_t action, const UPDATER_CHUNK_HEADER& chunk);
+    int     HandleOfsSignature(const int clientFD, const uint8_t* buffer, const size_t size);
+    int     HandleOfsDelta(const int clientFD, const uint8_t* buffer, const size_t size);
+    int     HandleOfsResume(const int clientFD, const uint8_t* buffer, const size_t size);
+    int     HandleOfsManifest(const int clientFD, const uint8_t* buffer, const size_t size);
+    int     HandleVerifyResults();
+    void    StartVerifying();
+    int     CheckpointUpload();
+    void    SuspendUpload();
+    int     CompleteUpload(std::string* digestOut = nullptr);
+    void    ReportUploadGaps();
+    void    FailUpload();
+    int     StartMulticastReceiver(const std::string& group, const int port);
+    void    HandleMulticastReadable();
+    int     HandleMulticastChunk(const Essentials::Communications::Endpoint& sender, const uint8_t* buffer, const size_t size);
+    int     StoreMulticastData(const uint64_t offset, const uint8_t* data, const uint32_t length);
+    int     DecodeMulticastBlock(const UPDATER_CHUNK_HEADER& chunk, const MULTICAST_FEC_HEADER& fec, const uint8_t* data, const uint32_t length);
+    bool    JoinDatagramUpload(const uint64_t transferId, const uint64_t totalSize, const UploadSource source);
+    int     SendMulticastStatus(const Essentials::Communications::Endpoint& sender, const uint64_t transferId);
+    int     SendMulticastResponse(const Essentials::Communications::Endpoint& sender, const uint32_t status, const std::string& data = "");
+    int     StartReliableReceiver(const int port);
+    void    HandleReliableReadable();
+    int     HandleReliableChunk(const uint64_t transferId, const uint64_t totalSize, const uint64_t offset, const uint8_t* data, const size_t size);
+    int     HandleReliableComplete(const uint64_t transferId, std::string& result);
+    std::string GetImageDigest();
+    std::string GetCheckpointPath(const std::string& ofsLocation);
+    std::string GetLogPath(const std::string& name);
+    int     SendResponse(const int clientFD, const uint32_t action, const uint32_t status, const std::string& data = "");
+    int     SendFileResponse(const int clientFD, const uint32_t action, const std::string& filePath, const uint64_t offset = 0);
+    std::string FindLastFlightLog();
+    RESPONSE_PREFIX SerializeResponseMsg(const uint32_t action, const uint32_t status, const size_t dataSize);
     UPDATER_ACTION_MESSAGE GetMessageFromBuffer(const uint8_t* buffer);
     int     SendAcknowledgement(const std::string ip, const int port, const MSG_TYPE type);
 
     int     mLastError;
-    int     mMaxBroadcastListeningTimeInMSec;
+    std::atomic<int> mMaxBroadcastListeningTimeInMSec;
     int     mBroadcastPort;
     int     mServerPort;
     bool    mCloseRequested;
     bool    mUpdateInProgress;
+    std::map<int, bool> mUpdateClients; // Connections feeding the update, true once they sent their last chunk
+    uint64_t mUpdateBytesReceived;
+    uint64_t mBytesSinceCheckpoint;
+    std::string mUpdateTarget;      // OFS location the upload in progress will replace
+    bool    mVerifyUpload;          // Chunks of the upload in progress are checked against mManifest
+    UploadSource mUploadSource;     // Where the upload in progress is coming from
+    bool    mMulticastDone;         // mMulticastDoneId has been installed, polls for it are answered with mMulticastDigest
+    uint64_t mMulticastDoneId;      // Transfer id of the last multicast upload installed
+    std::string mMulticastDigest;   // SHA-256 of the last multicast upload installed
+    uint64_t mMulticastRebuilt;     // Bytes of the multicast upload in progress rebuilt from repair symbols
+    uint64_t mStartupUSec;          // Timer ticks when the updater was created
+    uint64_t mListenerArmedUSec;    // Timer ticks when the interrupt listener was opened, 0 if not open
 
     Essentials::Communications::UDP_Client* mUdp;
     Essentials::Communications::TCP_Server* mTcp;
+    Essentials::Communications::UDP_Client* mMulticast;
+    Essentials::Communications::UDP_Client* mReliableUdp;
+    Essentials::Communications::ReliableReceiver* mReliableReceiver;
     Essentials::Utilities::Timer*           mTimer;
-    Settings                                mSettings;
+    Essentials::Utilities::AsyncFileWriter* mOfsWriter;
+    Essentials::Utilities::DeltaPatcher*    mDeltaPatcher;
+    Essentials::Utilities::TimerWheel*      mTimerWheel;
+    Essentials::Utilities::ChunkVerifier*   mVerifier;
+    Essentials::Utilities::FecDecoder*      mFecDecoder;
+    std::atomic<std::shared_ptr<const Settings>> mSettings;    // Current settings, replaced whole on reload, readers briefly serialise on the load
+    std::string                             mSettingsPath;  // Settings json being watched
+    std::thread                             mSettingsThread;// Reloads the settings when the file changes
+    int                                     mSettingsWakeFD;// Stops the settings thread
+    std::map<int, FrameAssembler>           mAssemblers;    // Per client stream reassembly
+    Essentials::Utilities::TransferCheckpoint mUploadCheckpoint;    // Ranges of the upload received so far
+    Essentials::Utilities::MerkleManifest   mManifest;      // Leaf hashes of the upload the client announced
+    std::map<int, IdleTimer>                mIdleTimers;    // Per client idle timeout on the timer wheel
+    std::vector<uint8_t>                    mMulticastArena;// Batch receive buffer for the multicast group
+    Essentials::Communications::Endpoint    mMulticastSender;   // Where the multicast upload in progress is coming from
+    std::vector<uint8_t>                    mReliableArena; // Batch receive buffer for the reliable UDP socket
 };
\ No newline at end of file
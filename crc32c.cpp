@@ -0,0 +1,164 @@
+///////////////////////////////////////////////////////////////////////////////
+//! @file		crc32c.cpp
+//! @brief		Implementation of the CRC32C functions
+//! @author		Chip Brommer
+///////////////////////////////////////////////////////////////////////////////
+
+///////////////////////////////////////////////////////////////////////////////
+//
+//  Includes:
+//          name                        reason included
+//          --------------------        ---------------------------------------
+#include	"crc32c.h"					// CRC32C functions
+//
+///////////////////////////////////////////////////////////////////////////////
+
+namespace Essentials
+{
+	namespace Utilities
+	{
+		namespace
+		{
+			constexpr uint32_t CRC32C_POLYNOMIAL = 0x82F63B78;	// Castagnoli polynomial, reflected
+
+			using Crc32cTables = std::array<std::array<uint32_t, 256>, 8>;
+
+			/// @brief Builds the slicing-by-8 tables, table n advances a byte n positions further back
+			constexpr Crc32cTables MakeTables()
+			{
+				Crc32cTables tables = {};
+				for (uint32_t i = 0; i < 256; i++)
+				{
+					uint32_t crc = i;
+					for (int bit = 0; bit < 8; bit++)
+					{
+						crc = (crc & 1) ? (crc >> 1) ^ CRC32C_POLYNOMIAL : crc >> 1;
+					}
+					tables[0][i] = crc;
+				}
+
+				for (size_t n = 1; n < tables.size(); n++)
+				{
+					for (uint32_t i = 0; i < 256; i++)
+					{
+						tables[n][i] = (tables[n - 1][i] >> 8) ^ tables[0][tables[n - 1][i] & 0xFF];
+					}
+				}
+				return tables;
+			}
+
+			constexpr Crc32cTables CRC32C_TABLES = MakeTables();
+
+			uint32_t Crc32cTable(const uint8_t* data, size_t size, uint32_t crc)
+			{
+				while (size >= 8)
+				{
+					uint64_t word = 0;
+					memcpy(&word, data, sizeof(word));
+					word ^= crc;
+
+					crc = CRC32C_TABLES[7][word & 0xFF] ^ CRC32C_TABLES[6][(word >> 8) & 0xFF] ^
+						CRC32C_TABLES[5][(word >> 16) & 0xFF] ^ CRC32C_TABLES[4][(word >> 24) & 0xFF] ^
+						CRC32C_TABLES[3][(word >> 32) & 0xFF] ^ CRC32C_TABLES[2][(word >> 40) & 0xFF] ^
+						CRC32C_TABLES[1][(word >> 48) & 0xFF] ^ CRC32C_TABLES[0][word >> 56];
+
+					data += 8;
+					size -= 8;
+				}
+
+				while (size-- > 0)
+				{
+					crc = (crc >> 8) ^ CRC32C_TABLES[0][(crc ^ *data++) & 0xFF];
+				}
+				return crc;
+			}
+
+#if defined(CRC32C_HAVE_SSE42)
+#ifndef _MSC_VER
+			__attribute__((target("sse4.2")))
+#endif
+			uint32_t Crc32cHardware(const uint8_t* data, size_t size, uint32_t crc)
+			{
+				uint64_t crc64 = crc;
+				while (size >= 8)
+				{
+					uint64_t word = 0;
+					memcpy(&word, data, sizeof(word));
+					crc64 = _mm_crc32_u64(crc64, word);
+					data += 8;
+					size -= 8;
+				}
+
+				crc = static_cast<uint32_t>(crc64);
+				while (size-- > 0)
+				{
+					crc = _mm_crc32_u8(crc, *data++);
+				}
+				return crc;
+			}
+
+			bool HasCrcInstructions()
+			{
+#ifdef _MSC_VER
+				int info[4] = { 0 };
+				__cpuid(info, 1);
+				return (info[2] & (1 << 20)) != 0;
+#else
+				return __builtin_cpu_supports("sse4.2");
+#endif
+			}
+#elif defined(CRC32C_HAVE_ARMV8)
+#if defined(__clang__)
+			__attribute__((target("crc")))
+#else
+			__attribute__((target("+crc")))
+#endif
+			uint32_t Crc32cHardware(const uint8_t* data, size_t size, uint32_t crc)
+			{
+				while (size >= 8)
+				{
+					uint64_t word = 0;
+					memcpy(&word, data, sizeof(word));
+					crc = __crc32cd(crc, word);
+					data += 8;
+					size -= 8;
+				}
+
+				while (size-- > 0)
+				{
+					crc = __crc32cb(crc, *data++);
+				}
+				return crc;
+			}
+
+			bool HasCrcInstructions()
+			{
+				return (getauxval(AT_HWCAP) & HWCAP_CRC32) != 0;
+			}
+#endif
+
+			using Crc32cFunction = uint32_t(*)(const uint8_t*, size_t, uint32_t);
+
+			/// @brief Picks the implementation once, on first use
+			Crc32cFunction GetImplementation()
+			{
+#if defined(CRC32C_HAVE_SSE42) || defined(CRC32C_HAVE_ARMV8)
+				static const Crc32cFunction implementation = HasCrcInstructions() ? Crc32cHardware : Crc32cTable;
+#else
+				static const Crc32cFunction implementation = Crc32cTable;
+#endif
+				return implementation;
+			}
+		}
+
+		uint32_t Crc32c(const uint8_t* data, const size_t size, const uint32_t crc)
+		{
+			return ~GetImplementation()(data, size, ~crc);
+		}
+
+		bool Crc32cIsAccelerated()
+		{
+			return GetImplementation() != Crc32cTable;
+		}
+	}
+}
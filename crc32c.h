@@ -0,0 +1,57 @@
+///////////////////////////////////////////////////////////////////////////////
+//! @file		crc32c.h
+//! @brief		CRC32C (Castagnoli) checksum using the CPU's CRC instructions when present
+//! @author		Chip Brommer
+///////////////////////////////////////////////////////////////////////////////
+#pragma once
+///////////////////////////////////////////////////////////////////////////////
+//
+//  Includes:
+//          name                        reason included
+//          --------------------        ---------------------------------------
+#if !defined(CRC32C_PORTABLE_ONLY) && (defined(__x86_64__) || defined(_M_X64))
+#ifdef _MSC_VER
+#include <intrin.h>						// __cpuid, _mm_crc32_u64
+#else
+#include <nmmintrin.h>					// _mm_crc32_u64
+#endif
+#define CRC32C_HAVE_SSE42
+#elif !defined(CRC32C_PORTABLE_ONLY) && defined(__aarch64__) && defined(__linux__)
+#include <arm_acle.h>					// __crc32cd
+#include <sys/auxv.h>					// getauxval
+#include <asm/hwcap.h>					// HWCAP_CRC32
+#define CRC32C_HAVE_ARMV8
+#endif
+#include <cstdint>						// Standard integer types
+#include <cstddef>						// size_t
+#include <cstring>						// memcpy
+#include <array>						// Lookup tables
+//
+//	Defines:
+//          name                        reason defined
+//          --------------------        ---------------------------------------
+#ifndef     CPP_CRC32C					// Define the cpp crc32c functions.
+#define     CPP_CRC32C
+//
+///////////////////////////////////////////////////////////////////////////////
+
+namespace Essentials
+{
+	namespace Utilities
+	{
+		/// @brief Computes or extends a CRC32C. SSE4.2 on x86-64 and the ARMv8 CRC extension are used
+		/// when the CPU has them, otherwise a slicing-by-8 table. All give the same result. Define
+		/// CRC32C_PORTABLE_ONLY to always use the table.
+		/// @param data -[in]- Data to checksum
+		/// @param size -[in]- Number of bytes
+		/// @param crc -[in]- CRC of the data before this, 0 to start a new one
+		/// @return CRC32C of everything so far
+		uint32_t Crc32c(const uint8_t* data, const size_t size, const uint32_t crc = 0);
+
+		/// @brief Check if Crc32c is using CPU instructions rather than the table
+		/// @return true if accelerated
+		bool Crc32cIsAccelerated();
+	}
+}
+
+#endif		// CPP_CRC32C
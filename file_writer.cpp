@@ -0,0 +1,731 @@
+///////////////////////////////////////////////////////////////////////////////
+//! @file		file_writer.cpp
+//! @brief		Implementation of the write-behind file writer class
+//! @author		Chip Brommer
+///////////////////////////////////////////////////////////////////////////////
+
+///////////////////////////////////////////////////////////////////////////////
+//
+//  Includes:
+//          name                        reason included
+//          --------------------        ---------------------------------------
+#include	"file_writer.h"				// Write-behind file writer class
+//
+///////////////////////////////////////////////////////////////////////////////
+
+namespace Essentials
+{
+	namespace Utilities
+	{
+		AsyncFileWriter::AsyncFileWriter(const size_t blockSize, const size_t blockCount, const size_t threadCount)
+		{
+			mLastError	= FileWriterError::NONE;
+			mFd			= -1;
+			mReadFd		= -1;
+			mFillBlock	= -1;
+			mStopping	= false;
+			mFailed		= false;
+			mDigestOffset	= 0;
+			mDigestFailed	= false;
+			mFinalDigest	= {};
+			mDigestReady	= false;
+
+#ifdef WIN32
+			// Windows writes seek then write, which can't be shared between threads
+			mThreadCount = 1;
+#else
+			mThreadCount = threadCount > 0 ? threadCount : 1;
+#endif
+
+			mBlocks.resize(blockCount > 0 ? blockCount : 1);
+			for (auto& block : mBlocks)
+			{
+				block.data.resize(blockSize > 0 ? blockSize : FILE_WRITER_DEFAULT_BLOCK_SIZE);
+				block.used = 0;
+				block.offset = 0;
+				block.holds = 0;
+				block.hashed = false;
+			}
+		}
+
+		AsyncFileWriter::~AsyncFileWriter()
+		{
+			Abort();
+		}
+
+		int AsyncFileWriter::Open(const std::string& filePath, const bool resume)
+		{
+			if (IsOpen())
+			{
+				mLastError = FileWriterError::ALREADY_OPEN;
+				return -1;
+			}
+
+			mFilePath = filePath;
+			mTempPath = filePath + FILE_WRITER_TEMP_EXTENSION;
+
+#ifdef WIN32
+			mFd = _open(mTempPath.c_str(), _O_WRONLY | _O_CREAT | (resume ? 0 : _O_TRUNC) | _O_BINARY, _S_IREAD | _S_IWRITE);
+#else
+			// Keep the permissions of the file being replaced, an OFS image needs to stay executable.
+			mode_t mode = 0755;
+			struct stat existing {};
+			if (stat(mFilePath.c_str(), &existing) == 0)
+			{
+				mode = existing.st_mode & 07777;
+			}
+
+			mFd = open(mTempPath.c_str(), O_WRONLY | O_CREAT | (resume ? 0 : O_TRUNC) | O_CLOEXEC, mode);
+#endif
+			if (mFd < 0)
+			{
+				mFd = -1;
+				mLastError = FileWriterError::OPEN_FAILED;
+				return -1;
+			}
+
+			// A second descriptor lets the digest read back without disturbing the writers
+#ifdef WIN32
+			mReadFd = _open(mTempPath.c_str(), _O_RDONLY | _O_BINARY);
+#else
+			mReadFd = open(mTempPath.c_str(), O_RDONLY | O_CLOEXEC);
+#endif
+			if (mReadFd < 0)
+			{
+				mReadFd = -1;
+				CloseFile();
+				mLastError = FileWriterError::OPEN_FAILED;
+				return -1;
+			}
+
+			// Reset the block pool
+			mFreeBlocks.clear();
+			mPendingBlocks.clear();
+			for (size_t i = 0; i < mBlocks.size(); i++)
+			{
+				mFreeBlocks.push_back(i);
+			}
+			mFillBlock = -1;
+			mStopping = false;
+			mFailed = false;
+
+			// Reset the digest
+			mHashBlocks.clear();
+			mUnhashed.clear();
+			mDigest.Reset();
+			mDigestOffset = 0;
+			mDigestFailed = false;
+			mDigestReady = false;
+
+			for (size_t i = 0; i < mThreadCount; i++)
+			{
+				mThreads.emplace_back(&AsyncFileWriter::WriterThread, this);
+			}
+			mHashThread = std::thread(&AsyncFileWriter::DigestThread, this);
+
+			return 0;
+		}
+
+		int AsyncFileWriter::Preallocate(const uint64_t size)
+		{
+			if (!IsOpen())
+			{
+				mLastError = FileWriterError::NOT_OPEN;
+				return -1;
+			}
+
+#ifdef WIN32
+			int result = _chsize_s(mFd, static_cast<__int64>(size));
+#else
+			int result = fallocate(mFd, 0, 0, static_cast<off_t>(size));
+			if (result != 0 && (errno == EOPNOTSUPP || errno == ENOSYS))
+			{
+				// The filesystem can't reserve blocks, at least size the file
+				result = ftruncate(mFd, static_cast<off_t>(size));
+			}
+#endif
+			if (result != 0)
+			{
+				mLastError = FileWriterError::ALLOCATE_FAILED;
+				return -1;
+			}
+
+			return 0;
+		}
+
+		void AsyncFileWriter::MarkWritten(const uint64_t offset, const uint64_t length)
+		{
+			if (length == 0)
+			{
+				return;
+			}
+
+			{
+				std::lock_guard<std::mutex> lock(mMutex);
+				uint64_t& end = mUnhashed[offset];
+				end = std::max(end, offset + length);
+			}
+			mHashCondition.notify_one();
+		}
+
+		int AsyncFileWriter::Write(const uint64_t offset, const uint8_t* data, const size_t size)
+		{
+			if (!IsOpen())
+			{
+				mLastError = FileWriterError::NOT_OPEN;
+				return -1;
+			}
+
+			uint64_t position = offset;
+			size_t remaining = size;
+
+			while (remaining > 0)
+			{
+				Block* block = nullptr;
+				{
+					std::unique_lock<std::mutex> lock(mMutex);
+
+					// Start a new block if this data doesn't continue the one being filled
+					if (mFillBlock != -1)
+					{
+						Block& fill = mBlocks[mFillBlock];
+						if (position != fill.offset + fill.used || fill.used == fill.data.size())
+						{
+							SubmitFillBlock();
+						}
+					}
+
+					if (mFillBlock == -1)
+					{
+						// Back pressure - wait for the writer thread to hand a block back
+						mFreeCondition.wait(lock, [this] { return !mFreeBlocks.empty() || mFailed; });
+
+						if (mFailed)
+						{
+							mLastError = FileWriterError::WRITE_FAILED;
+							return -1;
+						}
+
+						mFillBlock = static_cast<int>(mFreeBlocks.front());
+						mFreeBlocks.pop_front();
+						mBlocks[mFillBlock].used = 0;
+						mBlocks[mFillBlock].offset = position;
+					}
+
+					block = &mBlocks[mFillBlock];
+				}
+
+				// The fill block belongs to the caller until it is submitted, copy outside the lock
+				size_t count = std::min(remaining, block->data.size() - block->used);
+				memcpy(block->data.data() + block->used, data + (size - remaining), count);
+				block->used += count;
+				position += count;
+				remaining -= count;
+
+				if (block->used == block->data.size())
+				{
+					std::lock_guard<std::mutex> lock(mMutex);
+					SubmitFillBlock();
+				}
+			}
+
+			return 0;
+		}
+
+		int AsyncFileWriter::Flush()
+		{
+			if (!IsOpen())
+			{
+				mLastError = FileWriterError::NOT_OPEN;
+				return -1;
+			}
+
+			{
+				// Every block back in the free list means nothing is queued or being written
+				std::unique_lock<std::mutex> lock(mMutex);
+				SubmitFillBlock();
+				mFreeCondition.wait(lock, [this] { return mFreeBlocks.size() == mBlocks.size() || mFailed; });
+			}
+
+			if (mFailed)
+			{
+				mLastError = FileWriterError::WRITE_FAILED;
+				return -1;
+			}
+
+			if (SyncFile() != 0)
+			{
+				mLastError = FileWriterError::SYNC_FAILED;
+				return -1;
+			}
+
+			return 0;
+		}
+
+		int AsyncFileWriter::Commit()
+		{
+			if (!IsOpen())
+			{
+				mLastError = FileWriterError::NOT_OPEN;
+				return -1;
+			}
+
+			StopWriter();
+
+			if (mFailed)
+			{
+				mLastError = FileWriterError::WRITE_FAILED;
+				Abort();
+				return -1;
+			}
+
+			FinishDigest();
+			int syncResult = SyncFile();
+			CloseFile();
+
+			if (syncResult != 0)
+			{
+				mLastError = FileWriterError::SYNC_FAILED;
+				Abort();
+				return -1;
+			}
+
+			std::error_code ec;
+			std::filesystem::rename(mTempPath, mFilePath, ec);
+			if (ec)
+			{
+				mLastError = FileWriterError::RENAME_FAILED;
+				Abort();
+				return -1;
+			}
+
+#ifndef WIN32
+			// Sync the directory so the rename itself survives a power loss
+			std::string directory = std::filesystem::path(mFilePath).parent_path().string();
+			int dirFd = open(directory.empty() ? "." : directory.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+			if (dirFd >= 0)
+			{
+				fsync(dirFd);
+				close(dirFd);
+			}
+#endif
+
+			mTempPath.clear();
+			return 0;
+		}
+
+		int AsyncFileWriter::Suspend()
+		{
+			if (!IsOpen())
+			{
+				mLastError = FileWriterError::NOT_OPEN;
+				return -1;
+			}
+
+			// The digest starts again from the file when it is resumed, don't wait for it
+			{
+				std::lock_guard<std::mutex> lock(mMutex);
+				mDigestFailed = true;
+			}
+
+			StopWriter();
+			int syncResult = SyncFile();
+			CloseFile();
+
+			// Forget the temporary file so a later Abort leaves it for the resume
+			mTempPath.clear();
+
+			if (mFailed)
+			{
+				mLastError = FileWriterError::WRITE_FAILED;
+				return -1;
+			}
+
+			if (syncResult != 0)
+			{
+				mLastError = FileWriterError::SYNC_FAILED;
+				return -1;
+			}
+
+			return 0;
+		}
+
+		void AsyncFileWriter::Abort()
+		{
+			{
+				std::lock_guard<std::mutex> lock(mMutex);
+				mDigestFailed = true;
+			}
+
+			StopWriter();
+			CloseFile();
+
+			if (!mTempPath.empty())
+			{
+				std::error_code ec;
+				std::filesystem::remove(mTempPath, ec);
+				mTempPath.clear();
+			}
+		}
+
+		bool AsyncFileWriter::IsOpen() const
+		{
+			return mFd != -1;
+		}
+
+		bool AsyncFileWriter::GetDigest(Sha256Digest& digest) const
+		{
+			if (!mDigestReady)
+			{
+				return false;
+			}
+
+			digest = mFinalDigest;
+			return true;
+		}
+
+		std::string AsyncFileWriter::GetTempPath() const
+		{
+			return mTempPath;
+		}
+
+		std::string AsyncFileWriter::GetLastError()
+		{
+			return FileWriterErrorMap[mLastError];
+		}
+
+		void AsyncFileWriter::WriterThread()
+		{
+			while (true)
+			{
+				size_t index = 0;
+				{
+					std::unique_lock<std::mutex> lock(mMutex);
+					mPendingCondition.wait(lock, [this] { return !mPendingBlocks.empty() || mStopping; });
+
+					if (mPendingBlocks.empty())
+					{
+						// Stopping and nothing left to write
+						return;
+					}
+
+					index = mPendingBlocks.front();
+					mPendingBlocks.pop_front();
+				}
+
+				Block& block = mBlocks[index];
+				if (!mFailed && WriteAt(block.data.data(), block.used, block.offset) < 0)
+				{
+					mFailed = true;
+				}
+
+				std::lock_guard<std::mutex> lock(mMutex);
+				ReleaseBlock(index);
+			}
+		}
+
+		void AsyncFileWriter::DigestThread()
+		{
+			std::unique_lock<std::mutex> lock(mMutex);
+
+			while (true)
+			{
+				// Once stopping, finish only when the writers have handed every block back
+				mHashCondition.wait(lock, [this] { return !mHashBlocks.empty() || CanCatchUp() ||
+					(mStopping && mFreeBlocks.size() == mBlocks.size()); });
+
+				if (!mHashBlocks.empty())
+				{
+					size_t index = mHashBlocks.front();
+					mHashBlocks.pop_front();
+
+					Block& block = mBlocks[index];
+					uint64_t end = block.offset + block.used;
+
+					if (!mDigestFailed && block.offset == mDigestOffset)
+					{
+						// Next in the file, hash it straight from the block while the writers have it too
+						lock.unlock();
+						mDigest.Update(block.data.data(), block.used);
+						lock.lock();
+
+						mDigestOffset = end;
+						block.hashed = true;
+					}
+					else if (block.offset < mDigestOffset)
+					{
+						// Rewrites bytes already hashed, the file is hashed again when committed
+						mDigestFailed = true;
+						block.hashed = true;
+					}
+					else
+					{
+						// Ahead of the digest, read back once it has been written and the gap before it fills
+						block.hashed = mDigestFailed;
+					}
+
+					ReleaseBlock(index);
+				}
+				else if (CanCatchUp())
+				{
+					CatchUpDigest(lock);
+				}
+				else
+				{
+					return;
+				}
+			}
+		}
+
+		void AsyncFileWriter::CatchUpDigest(std::unique_lock<std::mutex>& lock)
+		{
+			auto range = mUnhashed.begin();
+			uint64_t start = range->first;
+			uint64_t end = range->second;
+			mUnhashed.erase(range);
+
+			if (start < mDigestOffset)
+			{
+				// Rewrites bytes already hashed, the file is hashed again when committed
+				mDigestFailed = true;
+				return;
+			}
+
+			lock.unlock();
+
+			if (mReadBuffer.empty())
+			{
+				mReadBuffer.resize(mBlocks.front().data.size());
+			}
+
+			bool ok = true;
+			for (uint64_t position = start; ok && position < end;)
+			{
+				size_t count = static_cast<size_t>(std::min<uint64_t>(end - position, mReadBuffer.size()));
+				ok = ReadAt(mReadBuffer.data(), count, position) == 0;
+				if (ok)
+				{
+					mDigest.Update(mReadBuffer.data(), count);
+					position += count;
+				}
+			}
+
+			lock.lock();
+
+			if (ok)
+			{
+				mDigestOffset = end;
+			}
+			else
+			{
+				mDigestFailed = true;
+			}
+		}
+
+		bool AsyncFileWriter::CanCatchUp() const
+		{
+			return !mDigestFailed && !mUnhashed.empty() && mUnhashed.begin()->first <= mDigestOffset;
+		}
+
+		void AsyncFileWriter::ReleaseBlock(const size_t index)
+		{
+			Block& block = mBlocks[index];
+			if (--block.holds > 0)
+			{
+				return;
+			}
+
+			// Only now is the data safe to read back from the file
+			if (!block.hashed)
+			{
+				uint64_t& end = mUnhashed[block.offset];
+				end = std::max(end, block.offset + block.used);
+			}
+
+			mFreeBlocks.push_back(index);
+			mFreeCondition.notify_one();
+			mHashCondition.notify_one();
+		}
+
+		int AsyncFileWriter::ReadAt(uint8_t* data, size_t size, uint64_t offset)
+		{
+			while (size > 0)
+			{
+#ifdef WIN32
+				if (_lseeki64(mReadFd, static_cast<__int64>(offset), SEEK_SET) < 0)
+				{
+					return -1;
+				}
+				int count = _read(mReadFd, data, static_cast<unsigned int>(size));
+#else
+				ssize_t count = pread(mReadFd, data, size, static_cast<off_t>(offset));
+				if (count < 0 && errno == EINTR)
+				{
+					continue;
+				}
+#endif
+				if (count <= 0)
+				{
+					return -1;
+				}
+
+				data += count;
+				size -= static_cast<size_t>(count);
+				offset += static_cast<uint64_t>(count);
+			}
+
+			return 0;
+		}
+
+		int AsyncFileWriter::WriteAt(const uint8_t* data, size_t size, uint64_t offset)
+		{
+			while (size > 0)
+			{
+#ifdef WIN32
+				if (_lseeki64(mFd, static_cast<__int64>(offset), SEEK_SET) < 0)
+				{
+					return -1;
+				}
+				int written = _write(mFd, data, static_cast<unsigned int>(size));
+#else
+				ssize_t written = pwrite(mFd, data, size, static_cast<off_t>(offset));
+				if (written < 0 && errno == EINTR)
+				{
+					continue;
+				}
+#endif
+				if (written <= 0)
+				{
+					return -1;
+				}
+
+				data += written;
+				size -= static_cast<size_t>(written);
+				offset += static_cast<uint64_t>(written);
+			}
+
+			return 0;
+		}
+
+		void AsyncFileWriter::SubmitFillBlock()
+		{
+			if (mFillBlock == -1)
+			{
+				return;
+			}
+
+			if (mBlocks[mFillBlock].used > 0)
+			{
+				// Held by a writer and the digest until both are done with it
+				mBlocks[mFillBlock].holds = 2;
+				mBlocks[mFillBlock].hashed = false;
+				mPendingBlocks.push_back(static_cast<size_t>(mFillBlock));
+				mHashBlocks.push_back(static_cast<size_t>(mFillBlock));
+				mPendingCondition.notify_one();
+				mHashCondition.notify_one();
+			}
+			else
+			{
+				mFreeBlocks.push_back(static_cast<size_t>(mFillBlock));
+			}
+
+			mFillBlock = -1;
+		}
+
+		void AsyncFileWriter::StopWriter()
+		{
+			if (mThreads.empty())
+			{
+				return;
+			}
+
+			{
+				std::lock_guard<std::mutex> lock(mMutex);
+				SubmitFillBlock();
+				mStopping = true;
+			}
+			mPendingCondition.notify_all();
+
+			for (auto& thread : mThreads)
+			{
+				thread.join();
+			}
+			mThreads.clear();
+
+			mHashCondition.notify_all();
+			mHashThread.join();
+		}
+
+		int AsyncFileWriter::SyncFile()
+		{
+#ifdef WIN32
+			return _commit(mFd);
+#else
+			return fsync(mFd);
+#endif
+		}
+
+		void AsyncFileWriter::FinishDigest()
+		{
+			mDigestReady = false;
+
+#ifdef WIN32
+			uint64_t fileSize = static_cast<uint64_t>(_filelengthi64(mFd));
+#else
+			struct stat info {};
+			uint64_t fileSize = fstat(mFd, &info) == 0 ? static_cast<uint64_t>(info.st_size) : UINT64_MAX;
+#endif
+			if (fileSize == UINT64_MAX)
+			{
+				return;
+			}
+
+			// Only when parts of the file were written twice does it need reading again
+			if (mDigestFailed || mDigestOffset != fileSize)
+			{
+				if (mReadBuffer.empty())
+				{
+					mReadBuffer.resize(mBlocks.front().data.size());
+				}
+
+				mDigest.Reset();
+				for (uint64_t position = 0; position < fileSize;)
+				{
+					size_t count = static_cast<size_t>(std::min<uint64_t>(fileSize - position, mReadBuffer.size()));
+					if (ReadAt(mReadBuffer.data(), count, position) < 0)
+					{
+						return;
+					}
+					mDigest.Update(mReadBuffer.data(), count);
+					position += count;
+				}
+			}
+
+			mFinalDigest = mDigest.Final();
+			mDigestReady = true;
+		}
+
+		void AsyncFileWriter::CloseFile()
+		{
+			if (mReadFd != -1)
+			{
+#ifdef WIN32
+				_close(mReadFd);
+#else
+				close(mReadFd);
+#endif
+				mReadFd = -1;
+			}
+
+			if (mFd != -1)
+			{
+#ifdef WIN32
+				_close(mFd);
+#else
+				close(mFd);
+#endif
+				mFd = -1;
+			}
+		}
+	}
+}
@@ -0,0 +1,250 @@
+///////////////////////////////////////////////////////////////////////////////
+//! @file		file_writer.h
+//! @brief		A write-behind file writer that streams data to disk on its own thread
+//! @author		Chip Brommer
+///////////////////////////////////////////////////////////////////////////////
+#pragma once
+///////////////////////////////////////////////////////////////////////////////
+//
+//  Includes:
+//          name                        reason included
+//          --------------------        ---------------------------------------
+#ifdef WIN32
+#include <io.h>							// _open, _write, _commit
+#include <fcntl.h>						// File open flags
+#include <sys/stat.h>					// File permissions
+#else
+#include <fcntl.h>						// open
+#include <unistd.h>						// pwrite, fsync, close
+#include <sys/stat.h>					// File permissions
+#include <cerrno>						// errno
+#endif
+#include <cstdint>						// Standard integer types
+#include <cstring>						// memcpy
+#include <map>							// Error enum to strings.
+#include <string>						// Strings
+#include <vector>						// Block pool
+#include <deque>						// Block queues
+#include <thread>						// Writer thread
+#include <mutex>						// Queue protection
+#include <condition_variable>			// Queue signalling
+#include <atomic>						// Writer failure flag
+#include <filesystem>					// Atomic rename
+#include "sha256.h"					// Digest of the file as it is written
+//
+//	Defines:
+//          name                        reason defined
+//          --------------------        ---------------------------------------
+#ifndef     CPP_FILE_WRITER				// Define the cpp file writer class.
+#define     CPP_FILE_WRITER
+//
+///////////////////////////////////////////////////////////////////////////////
+
+namespace Essentials
+{
+	namespace Utilities
+	{
+		constexpr static size_t		FILE_WRITER_DEFAULT_BLOCK_SIZE	= 1024 * 1024;	// Size of each write-behind block
+		constexpr static size_t		FILE_WRITER_DEFAULT_BLOCK_COUNT	= 4;			// Number of write-behind blocks
+		constexpr static size_t		FILE_WRITER_DEFAULT_THREAD_COUNT = 1;			// Number of writer threads
+		constexpr static const char* FILE_WRITER_TEMP_EXTENSION		= ".part";		// Extension of the in-progress file
+
+		/// @brief enum for error codes
+		enum class FileWriterError : uint8_t
+		{
+			NONE,
+			ALREADY_OPEN,
+			NOT_OPEN,
+			OPEN_FAILED,
+			WRITE_FAILED,
+			SYNC_FAILED,
+			RENAME_FAILED,
+			ALLOCATE_FAILED,
+		};
+
+		/// @brief Error enum to string map
+		static std::map<FileWriterError, std::string> FileWriterErrorMap
+		{
+			{FileWriterError::NONE,
+			std::string("Error Code " + std::to_string((uint8_t)FileWriterError::NONE) + ": No error.")},
+			{FileWriterError::ALREADY_OPEN,
+			std::string("Error Code " + std::to_string((uint8_t)FileWriterError::ALREADY_OPEN) + ": File already open.")},
+			{FileWriterError::NOT_OPEN,
+			std::string("Error Code " + std::to_string((uint8_t)FileWriterError::NOT_OPEN) + ": File not open.")},
+			{FileWriterError::OPEN_FAILED,
+			std::string("Error Code " + std::to_string((uint8_t)FileWriterError::OPEN_FAILED) + ": Failed to open temporary file.")},
+			{FileWriterError::WRITE_FAILED,
+			std::string("Error Code " + std::to_string((uint8_t)FileWriterError::WRITE_FAILED) + ": Write to disk failed.")},
+			{FileWriterError::SYNC_FAILED,
+			std::string("Error Code " + std::to_string((uint8_t)FileWriterError::SYNC_FAILED) + ": Sync to disk failed.")},
+			{FileWriterError::RENAME_FAILED,
+			std::string("Error Code " + std::to_string((uint8_t)FileWriterError::RENAME_FAILED) + ": Rename into place failed.")},
+			{FileWriterError::ALLOCATE_FAILED,
+			std::string("Error Code " + std::to_string((uint8_t)FileWriterError::ALLOCATE_FAILED) + ": Failed to reserve disk space.")},
+		};
+
+		/// @brief Writes a file through a fixed pool of write-behind blocks into a temporary file that
+		/// is renamed over the destination on Commit
+		class AsyncFileWriter
+		{
+		public:
+			/// @brief Constructor
+			/// @param blockSize -[in]- Size of each write-behind block
+			/// @param blockCount -[in]- Number of write-behind blocks
+			/// @param threadCount -[in]- Number of writer threads, more than one keeps several writes in flight
+			AsyncFileWriter(const size_t blockSize = FILE_WRITER_DEFAULT_BLOCK_SIZE, const size_t blockCount = FILE_WRITER_DEFAULT_BLOCK_COUNT,
+				const size_t threadCount = FILE_WRITER_DEFAULT_THREAD_COUNT);
+
+			/// @brief Deconstructor, aborts any file still open
+			~AsyncFileWriter();
+
+			/// @brief Prevent copying
+			AsyncFileWriter(const AsyncFileWriter&) = delete;
+			AsyncFileWriter& operator=(const AsyncFileWriter&) = delete;
+
+			/// @brief Opens a temporary file next to the destination and starts the writer thread
+			/// @param filePath -[in]- Final location of the file
+			/// @param resume -[in]- Keep the contents of a temporary file left by Suspend rather than starting empty
+			/// @return 0 if successful, -1 if fails. Call AsyncFileWriter::GetLastError to find out more.
+			int Open(const std::string& filePath, const bool resume = false);
+
+			/// @brief Reserves disk space for the whole file up front, so writes arriving out of order
+			/// don't fragment it and a full disk is found before any data is received
+			/// @param size -[in]- Final size of the file
+			/// @return 0 if successful, -1 if fails. Call AsyncFileWriter::GetLastError to find out more.
+			int Preallocate(const uint64_t size);
+
+			/// @brief Tells the digest about a range already in the file before it was reopened with resume
+			/// @param offset -[in]- Offset of the range
+			/// @param length -[in]- Length of the range
+			void MarkWritten(const uint64_t offset, const uint64_t length);
+
+			/// @brief Queues data to be written at an offset in the file. Blocks while all blocks are in flight,
+			/// which keeps memory use constant no matter how large the file is.
+			/// @param offset -[in]- Offset in the file to write the data to
+			/// @param data -[in]- Data to be written
+			/// @param size -[in]- Number of bytes to be written
+			/// @return 0 if successful, -1 if fails. Call AsyncFileWriter::GetLastError to find out more.
+			int Write(const uint64_t offset, const uint8_t* data, const size_t size);
+
+			/// @brief Waits until everything written so far is on disk. The file stays open.
+			/// @return 0 if successful, -1 if fails. Call AsyncFileWriter::GetLastError to find out more.
+			int Flush();
+
+			/// @brief Flushes all queued data, syncs the file and renames it over the destination
+			/// @return 0 if successful, -1 if fails. Call AsyncFileWriter::GetLastError to find out more.
+			int Commit();
+
+			/// @brief Flushes all queued data, syncs and closes the file but leaves the temporary file
+			/// in place so a later Open with resume can carry on from it
+			/// @return 0 if successful, -1 if fails. Call AsyncFileWriter::GetLastError to find out more.
+			int Suspend();
+
+			/// @brief Stops writing and removes the temporary file
+			void Abort();
+
+			/// @brief Check if a file is currently open
+			/// @return true if open
+			bool IsOpen() const;
+
+			/// @brief Get the SHA-256 of the last committed file, hashed alongside the writes so it is
+			/// ready as soon as the last one is
+			/// @param digest -[out]- Digest of the file
+			/// @return true if the digest covers the whole file
+			bool GetDigest(Sha256Digest& digest) const;
+
+			/// @brief Get the path of the temporary file being written
+			/// @return path of the temporary file, empty if not open
+			std::string GetTempPath() const;
+
+			/// @brief Get the last error in string format
+			/// @return The last error in a formatted string
+			std::string GetLastError();
+
+		protected:
+		private:
+			/// @brief A single write-behind block
+			struct Block
+			{
+				std::vector<uint8_t>	data;		// Block storage
+				size_t					used;		// Number of bytes filled
+				uint64_t				offset;		// File offset of the first byte
+				int						holds;		// Stages still using the block
+				bool					hashed;		// Digest took the data from the block
+			};
+
+			/// @brief Writer thread main loop
+			void WriterThread();
+
+			/// @brief Digest thread main loop, hashes each block while it waits to be written
+			void DigestThread();
+
+			/// @brief Hashes ranges read back from the file that now follow on from the digest. Blocks that
+			/// arrive ahead of the digest are read back once the gap before them fills.
+			/// @param lock -[in]- Held lock on the queues, released while reading
+			void CatchUpDigest(std::unique_lock<std::mutex>& lock);
+
+			/// @brief Check if a range waiting to be read back follows on from the digest
+			/// @return true if the digest can move on
+			bool CanCatchUp() const;
+
+			/// @brief Drops a stage's hold on a block, returning it to the pool when none are left
+			/// @param index -[in]- Block to release
+			void ReleaseBlock(const size_t index);
+
+			/// @brief Reads a range of the file back for the digest, retrying short reads
+			/// @return 0 if successful, -1 if fails
+			int ReadAt(uint8_t* data, size_t size, uint64_t offset);
+
+			/// @brief Writes a whole buffer at an offset, retrying short writes
+			/// @return 0 if successful, -1 if fails
+			int WriteAt(const uint8_t* data, size_t size, uint64_t offset);
+
+			/// @brief Hands the block being filled to the writer thread
+			void SubmitFillBlock();
+
+			/// @brief Stops the writer and digest threads once the queues are drained
+			void StopWriter();
+
+			/// @brief Syncs the temporary file to disk
+			/// @return 0 if successful
+			int SyncFile();
+
+			/// @brief Finishes the digest, hashing the file again if the running digest was lost because
+			/// bytes already hashed were written again
+			void FinishDigest();
+
+			/// @brief Closes the temporary file
+			void CloseFile();
+
+			FileWriterError				mLastError;			// Last error for this utility
+			std::string					mFilePath;			// Destination file path
+			std::string					mTempPath;			// Temporary file path
+			int							mFd;				// Temporary file descriptor
+			int							mReadFd;			// Temporary file descriptor the digest reads back through
+			std::vector<Block>			mBlocks;			// Block pool
+			std::deque<size_t>			mFreeBlocks;		// Blocks ready to be filled
+			std::deque<size_t>			mPendingBlocks;		// Blocks waiting to be written
+			int							mFillBlock;			// Block currently being filled, -1 if none
+			std::mutex					mMutex;				// Queue protection
+			std::condition_variable		mFreeCondition;		// Signalled when a block is returned
+			std::condition_variable		mPendingCondition;	// Signalled when a block is queued
+			std::vector<std::thread>	mThreads;			// Writer threads
+			size_t						mThreadCount;		// Number of writer threads to start
+			bool						mStopping;			// Writer threads stop request
+			std::atomic<bool>			mFailed;			// Set by a writer thread on a failed write
+			std::deque<size_t>			mHashBlocks;		// Blocks waiting to be hashed
+			std::condition_variable		mHashCondition;		// Signalled when the digest has work
+			std::thread					mHashThread;		// Digest thread
+			Sha256						mDigest;			// Running digest of the file from the start
+			uint64_t					mDigestOffset;		// Bytes of the file in the digest
+			std::map<uint64_t, uint64_t> mUnhashed;			// Written ranges ahead of the digest, start to end
+			std::vector<uint8_t>		mReadBuffer;		// Buffer read backs go through
+			bool						mDigestFailed;		// Running digest lost, hash the file again on Commit
+			Sha256Digest				mFinalDigest;		// Digest of the last committed file
+			bool						mDigestReady;		// mFinalDigest covers the whole file
+		};
+	}
+}
+
+#endif		// CPP_FILE_WRITER
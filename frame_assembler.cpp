@@ -0,0 +1,170 @@
+///////////////////////////////////////////////////////////////////////////////
+//! @file		frame_assembler.cpp
+//! @brief		Implementation of the frame assembler class
+//! @author		Chip Brommer
+///////////////////////////////////////////////////////////////////////////////
+
+///////////////////////////////////////////////////////////////////////////////
+//
+//  Includes:
+//          name                        reason included
+//          --------------------        ---------------------------------------
+#include	"frame_assembler.h"			// Frame assembler class
+//
+///////////////////////////////////////////////////////////////////////////////
+
+FrameAssembler::FrameAssembler(const uint32_t maxFrameSize)
+{
+	mHead			= 0;
+	mTail			= 0;
+	mMaxFrameSize	= maxFrameSize;
+	mDroppedBytes	= 0;
+}
+
+int FrameAssembler::Push(const uint8_t* data, size_t size, const FrameHandler& handler)
+{
+	int frames = 0;
+
+	while (size > 0)
+	{
+		// Nothing buffered - frame straight out of the callers buffer and only keep the remainder
+		if (mHead == mTail)
+		{
+			size_t consumed = Extract(data, size, handler, frames);
+			data += consumed;
+			size -= consumed;
+
+			if (size == 0)
+			{
+				break;
+			}
+		}
+
+		// The buffer is only allocated once a connection actually splits a frame
+		if (mBuffer.empty())
+		{
+			mBuffer.resize(mMaxFrameSize);
+		}
+
+		// Slide the partial frame back to the start when we run out of room at the end
+		if (mTail == mBuffer.size() && mHead > 0)
+		{
+			memmove(mBuffer.data(), mBuffer.data() + mHead, mTail - mHead);
+			mTail -= mHead;
+			mHead = 0;
+		}
+
+		size_t count = std::min(size, mBuffer.size() - mTail);
+		if (count == 0)
+		{
+			// Can't happen with a valid frame as the buffer holds the largest frame allowed
+			mDroppedBytes += mTail - mHead;
+			Reset();
+			continue;
+		}
+
+		memcpy(mBuffer.data() + mTail, data, count);
+		mTail += count;
+		data += count;
+		size -= count;
+
+		mHead += Extract(mBuffer.data() + mHead, mTail - mHead, handler, frames);
+		if (mHead == mTail)
+		{
+			mHead = 0;
+			mTail = 0;
+		}
+	}
+
+	return frames;
+}
+
+void FrameAssembler::Reset()
+{
+	mHead = 0;
+	mTail = 0;
+}
+
+uint64_t FrameAssembler::GetDroppedBytes() const
+{
+	return mDroppedBytes;
+}
+
+size_t FrameAssembler::Extract(const uint8_t* data, const size_t size, const FrameHandler& handler, int& frames)
+{
+	constexpr uint32_t minimumFrame = sizeof(UPDATER_HEADER) + sizeof(UPDATER_FOOTER);
+	size_t position = 0;
+
+	while (position < size)
+	{
+		// Skip anything that can't be the start of a frame
+		size_t sync = FindSync(data, size, position);
+		mDroppedBytes += sync - position;
+		position = sync;
+
+		if (size - position < sizeof(UPDATER_HEADER))
+		{
+			break;
+		}
+
+		UPDATER_HEADER header = { 0 };
+		memcpy(&header, data + position, sizeof(header));
+
+		if (header.msgSize < minimumFrame || header.msgSize > mMaxFrameSize)
+		{
+			// Bad length, the sync bytes were a false match
+			mDroppedBytes++;
+			position++;
+			continue;
+		}
+
+		if (size - position < header.msgSize)
+		{
+			// Wait for the rest of the frame
+			break;
+		}
+
+		UPDATER_FOOTER footer = { 0 };
+		memcpy(&footer, data + position + header.msgSize - sizeof(footer), sizeof(footer));
+
+		if (footer.eob != EOB)
+		{
+			mDroppedBytes++;
+			position++;
+			continue;
+		}
+
+		handler(data + position, header.msgSize);
+		frames++;
+		position += header.msgSize;
+	}
+
+	return position;
+}
+
+size_t FrameAssembler::FindSync(const uint8_t* data, const size_t size, size_t from) const
+{
+	constexpr uint8_t pattern[] = { SYNC1, SYNC2, SYNC3, SYNC4 };
+
+	while (from < size)
+	{
+		const uint8_t* candidate = static_cast<const uint8_t*>(memchr(data + from, SYNC1, size - from));
+		if (candidate == nullptr)
+		{
+			return size;
+		}
+
+		from = static_cast<size_t>(candidate - data);
+
+		// A pattern cut off by the end of the buffer may still be a frame, keep it until more arrives
+		size_t available = std::min(size - from, sizeof(pattern));
+		if (memcmp(data + from, pattern, available) == 0)
+		{
+			return from;
+		}
+
+		from++;
+	}
+
+	return size;
+}
@@ -0,0 +1,71 @@
+///////////////////////////////////////////////////////////////////////////////
+//! @file		frame_assembler.h
+//! @brief		Reassembles UnitUpdater messages from a TCP byte stream
+//! @author		Chip Brommer
+///////////////////////////////////////////////////////////////////////////////
+#pragma once
+///////////////////////////////////////////////////////////////////////////////
+//
+//  Includes:
+//          name                        reason included
+//          --------------------        ---------------------------------------
+#include <cstdint>                      // standard types
+#include <cstring>                      // memcpy, memmove, memchr
+#include <algorithm>                    // std::min
+#include <vector>                       // frame buffer
+#include <functional>                   // frame callback
+#include "project_messages.h"           // message framing
+//
+///////////////////////////////////////////////////////////////////////////////
+
+/// @brief Called for every complete frame. The frame is only valid for the duration of the call.
+using FrameHandler = std::function<void(const uint8_t* frame, const uint32_t size)>;
+
+/// @brief Incrementally splits a client's byte stream into frames using the UPDATER_HEADER sync
+/// bytes and msgSize, checking each frame ends with the UPDATER_FOOTER eob. Frames that arrive
+/// whole are handed straight out of the receive buffer, only a trailing partial frame is kept in
+/// the connection's buffer until the rest of it arrives. Corrupt data is skipped by scanning for
+/// the next SYNC1..SYNC4 pattern.
+class FrameAssembler
+{
+public:
+    /// @brief Constructor
+    /// @param maxFrameSize - largest frame accepted, anything claiming to be bigger is treated as corrupt
+    FrameAssembler(const uint32_t maxFrameSize = MAX_MESSAGE_SIZE);
+
+    /// @brief Adds received bytes and passes every completed frame to the handler
+    /// @param data - received bytes
+    /// @param size - number of received bytes
+    /// @param handler - called for each complete frame
+    /// @return number of frames completed
+    int Push(const uint8_t* data, size_t size, const FrameHandler& handler);
+
+    /// @brief Drops any partially received frame
+    void Reset();
+
+    /// @brief Get the number of bytes discarded while resynchronizing
+    /// @return number of bytes discarded
+    uint64_t GetDroppedBytes() const;
+
+private:
+    /// @brief Hands out every complete frame at the start of a buffer
+    /// @param data - buffer to frame
+    /// @param size - size of the buffer
+    /// @param handler - called for each complete frame
+    /// @param frames - incremented for each complete frame
+    /// @return number of bytes consumed from the buffer
+    size_t Extract(const uint8_t* data, const size_t size, const FrameHandler& handler, int& frames);
+
+    /// @brief Finds the next position that could start a frame
+    /// @param data - buffer to search
+    /// @param size - size of the buffer
+    /// @param from - position to start searching at
+    /// @return position of the next possible frame start, or size if none
+    size_t FindSync(const uint8_t* data, const size_t size, size_t from) const;
+
+    std::vector<uint8_t>    mBuffer;        // Holds a partial frame between receives
+    size_t                  mHead;          // Start of the buffered data
+    size_t                  mTail;          // End of the buffered data
+    uint32_t                mMaxFrameSize;  // Largest frame accepted
+    uint64_t                mDroppedBytes;  // Bytes skipped while resynchronizing
+};
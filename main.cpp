@@ -30,7 +30,7 @@ int main()
 	if (!interruptReceived)
 	{
 		std::cout << "\nNOTICE: \tBroadcast not found!\n";
-		std::cout << "\t\tStarting OFS!\n" << std::endl;
+		std::cout << "\t\tStarting OFS " << uu.GetStartupElapsedMSec() << "ms after startup!\n" << std::endl;
 	}
 	else
 	{
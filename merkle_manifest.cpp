@@ -0,0 +1,374 @@
+///////////////////////////////////////////////////////////////////////////////
+//! @file		merkle_manifest.cpp
+//! @brief		Implementation of the merkle manifest classes
+//! @author		Chip Brommer
+///////////////////////////////////////////////////////////////////////////////
+
+///////////////////////////////////////////////////////////////////////////////
+//
+//  Includes:
+//          name                        reason included
+//          --------------------        ---------------------------------------
+#include	"merkle_manifest.h"			// Merkle manifest classes
+//
+///////////////////////////////////////////////////////////////////////////////
+
+namespace Essentials
+{
+	namespace Utilities
+	{
+		MerkleManifest::MerkleManifest()
+		{
+			mLastError = MerkleError::NONE;
+			Clear();
+		}
+
+		int MerkleManifest::Parse(const uint8_t* data, const size_t size)
+		{
+			Clear();
+
+			MERKLE_MANIFEST_HEADER header = { 0 };
+			if (size < sizeof(header))
+			{
+				mLastError = MerkleError::BAD_SIZE;
+				return -1;
+			}
+			memcpy(&header, data, sizeof(header));
+
+			if (header.chunkSize < MERKLE_MIN_CHUNK_SIZE || header.chunkSize > MERKLE_MAX_CHUNK_SIZE)
+			{
+				mLastError = MerkleError::BAD_CHUNK_SIZE;
+				return -1;
+			}
+
+			if (header.leafCount != (header.imageSize + header.chunkSize - 1) / header.chunkSize)
+			{
+				mLastError = MerkleError::LEAF_COUNT_MISMATCH;
+				return -1;
+			}
+
+			if (size != sizeof(header) + static_cast<size_t>(header.leafCount) * SHA256_DIGEST_SIZE)
+			{
+				mLastError = MerkleError::BAD_SIZE;
+				return -1;
+			}
+
+			std::vector<Sha256Digest> leaves(header.leafCount);
+			for (uint32_t i = 0; i < header.leafCount; i++)
+			{
+				memcpy(leaves[i].data(), data + sizeof(header) + static_cast<size_t>(i) * SHA256_DIGEST_SIZE, SHA256_DIGEST_SIZE);
+			}
+
+			// The leaves are only worth trusting if they add up to the root
+			Sha256Digest root = ComputeRoot(leaves);
+			if (memcmp(root.data(), header.root, SHA256_DIGEST_SIZE) != 0)
+			{
+				mLastError = MerkleError::ROOT_MISMATCH;
+				return -1;
+			}
+
+			mActive		= true;
+			mTransferId	= header.transferId;
+			mImageSize	= header.imageSize;
+			mChunkSize	= header.chunkSize;
+			mLeaves.swap(leaves);
+			return 0;
+		}
+
+		void MerkleManifest::Clear()
+		{
+			mActive		= false;
+			mTransferId	= 0;
+			mImageSize	= 0;
+			mChunkSize	= 0;
+			mLeaves.clear();
+		}
+
+		bool MerkleManifest::IsActive() const
+		{
+			return mActive;
+		}
+
+		uint64_t MerkleManifest::GetTransferId() const
+		{
+			return mTransferId;
+		}
+
+		uint64_t MerkleManifest::GetImageSize() const
+		{
+			return mImageSize;
+		}
+
+		uint32_t MerkleManifest::GetChunkSize() const
+		{
+			return mChunkSize;
+		}
+
+		uint32_t MerkleManifest::GetLeafCount() const
+		{
+			return static_cast<uint32_t>(mLeaves.size());
+		}
+
+		const Sha256Digest& MerkleManifest::GetLeaf(const uint32_t index) const
+		{
+			return mLeaves[index];
+		}
+
+		bool MerkleManifest::IsAligned(const uint64_t offset, const uint64_t length) const
+		{
+			if (!mActive || offset % mChunkSize != 0 || offset > mImageSize || length > mImageSize - offset)
+			{
+				return false;
+			}
+
+			// Only the last leaf may be short
+			return length % mChunkSize == 0 || offset + length == mImageSize;
+		}
+
+		Sha256Digest MerkleManifest::HashLeaf(const uint8_t* data, const size_t size)
+		{
+			Sha256 hash;
+			hash.Update(&MERKLE_LEAF_PREFIX, 1);
+			hash.Update(data, size);
+			return hash.Final();
+		}
+
+		Sha256Digest MerkleManifest::HashNode(const Sha256Digest& left, const Sha256Digest& right)
+		{
+			Sha256 hash;
+			hash.Update(&MERKLE_NODE_PREFIX, 1);
+			hash.Update(left.data(), left.size());
+			hash.Update(right.data(), right.size());
+			return hash.Final();
+		}
+
+		Sha256Digest MerkleManifest::ComputeRoot(std::vector<Sha256Digest> level)
+		{
+			if (level.empty())
+			{
+				return HashLeaf(nullptr, 0);
+			}
+
+			while (level.size() > 1)
+			{
+				size_t parents = 0;
+				for (size_t i = 0; i < level.size(); i += 2)
+				{
+					// An odd node out is carried up unchanged
+					level[parents++] = (i + 1 < level.size()) ? HashNode(level[i], level[i + 1]) : level[i];
+				}
+				level.resize(parents);
+			}
+
+			return level.front();
+		}
+
+		std::string MerkleManifest::GetLastError()
+		{
+			return MerkleErrorMap[mLastError];
+		}
+
+		ChunkVerifier::ChunkVerifier(const size_t threadCount, const size_t maxJobs)
+		{
+			mBusyJobs		= 0;
+			mPendingLeaves	= 0;
+			mStopping		= false;
+#ifdef WIN32
+			mEventFD		= -1;
+#else
+			mEventFD		= eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+#endif
+
+			mJobs.resize(maxJobs > 0 ? maxJobs : 1);
+			for (size_t i = 0; i < mJobs.size(); i++)
+			{
+				mJobs[i].size = 0;
+				mJobs[i].offset = 0;
+				mJobs[i].clientFD = -1;
+				mFreeJobs.push_back(i);
+			}
+
+			size_t count = threadCount > 0 ? threadCount : std::min<size_t>(std::thread::hardware_concurrency(), CHUNK_VERIFIER_MAX_THREADS);
+			mThreadCount	= std::max<size_t>(count, 1);
+		}
+
+		ChunkVerifier::~ChunkVerifier()
+		{
+			{
+				std::lock_guard<std::mutex> lock(mMutex);
+				mStopping = true;
+			}
+			mJobCondition.notify_all();
+			mFreeCondition.notify_all();
+
+			for (auto& thread : mThreads)
+			{
+				thread.join();
+			}
+
+#ifndef WIN32
+			if (mEventFD != -1)
+			{
+				close(mEventFD);
+			}
+#endif
+		}
+
+		void ChunkVerifier::SetManifest(const MerkleManifest& manifest)
+		{
+			// The threads read the manifest without the lock, only swap it while they are idle
+			{
+				std::unique_lock<std::mutex> lock(mMutex);
+				mFreeCondition.wait(lock, [this] { return (mQueuedJobs.empty() && mBusyJobs == 0) || mStopping; });
+				mManifest = manifest;
+			}
+
+			// Most boots never see a manifest, the threads wait until one does
+			StartThreads();
+		}
+
+		void ChunkVerifier::StartThreads()
+		{
+			if (!mThreads.empty())
+			{
+				return;
+			}
+
+			for (size_t i = 0; i < mThreadCount; i++)
+			{
+				mThreads.emplace_back(&ChunkVerifier::VerifierThread, this);
+			}
+		}
+
+		int ChunkVerifier::Submit(const int clientFD, const uint64_t offset, const uint8_t* data, const size_t size)
+		{
+			size_t index = 0;
+			uint32_t chunkSize = 0;
+			{
+				std::unique_lock<std::mutex> lock(mMutex);
+				if (!mManifest.IsActive() || size > MERKLE_MAX_CHUNK_SIZE)
+				{
+					return -1;
+				}
+
+				// Back pressure - wait for a thread to hand a job back
+				mFreeCondition.wait(lock, [this] { return !mFreeJobs.empty() || mStopping; });
+				if (mStopping)
+				{
+					return -1;
+				}
+
+				index = mFreeJobs.front();
+				mFreeJobs.pop_front();
+				chunkSize = mManifest.GetChunkSize();
+			}
+
+			// The job belongs to the caller until it is queued, copy outside the lock
+			Job& job = mJobs[index];
+			if (job.data.size() < MERKLE_MAX_CHUNK_SIZE)
+			{
+				job.data.resize(MERKLE_MAX_CHUNK_SIZE);
+			}
+			memcpy(job.data.data(), data, size);
+			job.size = size;
+			job.offset = offset;
+			job.clientFD = clientFD;
+
+			{
+				std::lock_guard<std::mutex> lock(mMutex);
+				mPendingLeaves += (size + chunkSize - 1) / chunkSize;
+				mQueuedJobs.push_back(index);
+			}
+			mJobCondition.notify_one();
+
+			return 0;
+		}
+
+		std::vector<ChunkVerifier::Result> ChunkVerifier::TakeResults()
+		{
+			std::vector<Result> results;
+
+			std::lock_guard<std::mutex> lock(mMutex);
+#ifndef WIN32
+			uint64_t count = 0;
+			ssize_t rtn = read(mEventFD, &count, sizeof(count));
+			(void)rtn;
+#endif
+			results.swap(mResults);
+			mPendingLeaves -= std::min(mPendingLeaves, results.size());
+
+			return results;
+		}
+
+		void ChunkVerifier::WaitIdle()
+		{
+			std::unique_lock<std::mutex> lock(mMutex);
+			mFreeCondition.wait(lock, [this] { return (mQueuedJobs.empty() && mBusyJobs == 0) || mStopping; });
+		}
+
+		size_t ChunkVerifier::GetPendingCount()
+		{
+			std::lock_guard<std::mutex> lock(mMutex);
+			return mPendingLeaves;
+		}
+
+		int ChunkVerifier::GetFD() const
+		{
+			return mEventFD;
+		}
+
+		void ChunkVerifier::VerifierThread()
+		{
+			std::unique_lock<std::mutex> lock(mMutex);
+
+			while (true)
+			{
+				mJobCondition.wait(lock, [this] { return !mQueuedJobs.empty() || mStopping; });
+				if (mStopping)
+				{
+					return;
+				}
+
+				size_t index = mQueuedJobs.front();
+				mQueuedJobs.pop_front();
+				mBusyJobs++;
+				lock.unlock();
+
+				// Each leaf in the chunk is hashed and compared on its own, so one bad leaf costs one leaf
+				const Job& job = mJobs[index];
+				const uint32_t chunkSize = mManifest.GetChunkSize();
+				std::vector<Result> results;
+
+				for (size_t position = 0; position < job.size; position += chunkSize)
+				{
+					Result result = { job.clientFD, mManifest.GetTransferId(), job.offset + position, 0, false };
+					result.length = std::min<uint64_t>(chunkSize, job.size - position);
+
+					uint64_t leaf = result.offset / chunkSize;
+					if (leaf < mManifest.GetLeafCount() && result.length == std::min<uint64_t>(chunkSize, mManifest.GetImageSize() - result.offset))
+					{
+						Sha256Digest digest = MerkleManifest::HashLeaf(job.data.data() + position, static_cast<size_t>(result.length));
+						result.ok = digest == mManifest.GetLeaf(static_cast<uint32_t>(leaf));
+					}
+					results.push_back(result);
+				}
+
+				lock.lock();
+				mResults.insert(mResults.end(), results.begin(), results.end());
+				mBusyJobs--;
+				mFreeJobs.push_back(index);
+				mFreeCondition.notify_all();
+				Notify();
+			}
+		}
+
+		void ChunkVerifier::Notify()
+		{
+#ifndef WIN32
+			uint64_t one = 1;
+			ssize_t rtn = write(mEventFD, &one, sizeof(one));
+			(void)rtn;
+#endif
+		}
+	}
+}
@@ -0,0 +1,232 @@
+///////////////////////////////////////////////////////////////////////////////
+//! @file		merkle_manifest.h
+//! @brief		Merkle tree manifest of an OFS image and the chunk verifier that checks against it
+//! @author		Chip Brommer
+///////////////////////////////////////////////////////////////////////////////
+#pragma once
+///////////////////////////////////////////////////////////////////////////////
+//
+//  Includes:
+//          name                        reason included
+//          --------------------        ---------------------------------------
+#ifndef WIN32
+#include <unistd.h>						// read, write, close
+#include <sys/eventfd.h>				// Results ready notification
+#endif
+#include <cstdint>						// Standard integer types
+#include <cstring>						// memcpy, memcmp
+#include <map>							// Error enum to strings.
+#include <string>						// Strings
+#include <vector>						// Leaves, job buffers
+#include <deque>						// Job queue
+#include <thread>						// Verifier threads
+#include <mutex>						// Queue protection
+#include <condition_variable>			// Queue signalling
+#include <algorithm>					// std::min
+#include "sha256.h"						// Leaf and node hashes
+#include "project_messages.h"			// Manifest structures
+//
+//	Defines:
+//          name                        reason defined
+//          --------------------        ---------------------------------------
+#ifndef     CPP_MERKLE_MANIFEST			// Define the cpp merkle manifest classes.
+#define     CPP_MERKLE_MANIFEST
+//
+///////////////////////////////////////////////////////////////////////////////
+
+namespace Essentials
+{
+	namespace Utilities
+	{
+		constexpr static size_t		CHUNK_VERIFIER_DEFAULT_JOBS	= 8;	// Chunks that can wait to be verified before Submit blocks
+		constexpr static size_t		CHUNK_VERIFIER_MAX_THREADS	= 4;	// Most verifier threads started when the count is left to the core count
+
+		/// @brief enum for error codes
+		enum class MerkleError : uint8_t
+		{
+			NONE,
+			BAD_SIZE,
+			BAD_CHUNK_SIZE,
+			LEAF_COUNT_MISMATCH,
+			ROOT_MISMATCH,
+		};
+
+		/// @brief Error enum to string map
+		static std::map<MerkleError, std::string> MerkleErrorMap
+		{
+			{MerkleError::NONE,
+			std::string("Error Code " + std::to_string((uint8_t)MerkleError::NONE) + ": No error.")},
+			{MerkleError::BAD_SIZE,
+			std::string("Error Code " + std::to_string((uint8_t)MerkleError::BAD_SIZE) + ": Manifest size doesn't match its leaf count.")},
+			{MerkleError::BAD_CHUNK_SIZE,
+			std::string("Error Code " + std::to_string((uint8_t)MerkleError::BAD_CHUNK_SIZE) + ": Chunk size out of range.")},
+			{MerkleError::LEAF_COUNT_MISMATCH,
+			std::string("Error Code " + std::to_string((uint8_t)MerkleError::LEAF_COUNT_MISMATCH) + ": Leaf count doesn't cover the image.")},
+			{MerkleError::ROOT_MISMATCH,
+			std::string("Error Code " + std::to_string((uint8_t)MerkleError::ROOT_MISMATCH) + ": Leaves don't hash to the root.")},
+		};
+
+		/// @brief The leaf hashes of an image and the root they were checked against. Each leaf covers
+		/// a fixed size piece of the image, so a bad piece can be found and fetched again on its own.
+		/// The root arrives in the same message as the leaves, so it only proves the leaves are the set
+		/// the sender hashed. It catches damage in transit, not an image from the wrong source.
+		class MerkleManifest
+		{
+		public:
+			/// @brief Constructor
+			MerkleManifest();
+
+			/// @brief Takes a manifest from an UPDATE_OFS_MANIFEST message and checks the leaves hash to its root
+			/// @param data -[in]- MERKLE_MANIFEST_HEADER followed by the leaves
+			/// @param size -[in]- Number of bytes
+			/// @return 0 if successful, -1 if fails. Call MerkleManifest::GetLastError to find out more.
+			int Parse(const uint8_t* data, const size_t size);
+
+			/// @brief Forgets the manifest
+			void Clear();
+
+			/// @brief Check if a manifest is loaded
+			/// @return true if loaded
+			bool IsActive() const;
+
+			/// @brief Get the id of the upload the manifest describes
+			uint64_t GetTransferId() const;
+
+			/// @brief Get the size of the image
+			uint64_t GetImageSize() const;
+
+			/// @brief Get the bytes of image under each leaf
+			uint32_t GetChunkSize() const;
+
+			/// @brief Get the number of leaves
+			uint32_t GetLeafCount() const;
+
+			/// @brief Get a leaf hash
+			/// @param index -[in]- Leaf number
+			/// @return leaf hash
+			const Sha256Digest& GetLeaf(const uint32_t index) const;
+
+			/// @brief Check a range starts and ends on leaf boundaries
+			/// @param offset -[in]- Offset of the range
+			/// @param length -[in]- Length of the range
+			/// @return true if the range holds whole leaves only
+			bool IsAligned(const uint64_t offset, const uint64_t length) const;
+
+			/// @brief Hashes a piece of the image into a leaf
+			static Sha256Digest HashLeaf(const uint8_t* data, const size_t size);
+
+			/// @brief Hashes two children into their parent
+			static Sha256Digest HashNode(const Sha256Digest& left, const Sha256Digest& right);
+
+			/// @brief Builds the root over a set of leaves
+			static Sha256Digest ComputeRoot(std::vector<Sha256Digest> level);
+
+			/// @brief Get the last error in string format
+			/// @return The last error in a formatted string
+			std::string GetLastError();
+
+		protected:
+		private:
+			MerkleError					mLastError;			// Last error for this utility
+			bool						mActive;			// A manifest is loaded
+			uint64_t					mTransferId;		// Upload the manifest describes
+			uint64_t					mImageSize;			// Size of the image
+			uint32_t					mChunkSize;			// Bytes of image under each leaf
+			std::vector<Sha256Digest>	mLeaves;			// Leaf hashes
+		};
+
+		/// @brief Checks received chunks against a manifest on a pool of threads, off the thread that
+		/// receives them. Submit copies the chunk so the caller can hand its buffer straight on to the
+		/// file writer. Results come back per leaf through TakeResults, GetFD becomes readable when
+		/// there are some waiting. The threads are only started by the first SetManifest, so a
+		/// verifier that never sees a manifest costs nothing.
+		class ChunkVerifier
+		{
+		public:
+			/// @brief Outcome of checking one leaf
+			struct Result
+			{
+				int			clientFD;		// Connection the chunk arrived on
+				uint64_t	transferId;		// Upload the chunk belongs to
+				uint64_t	offset;			// Offset of the leaf in the image
+				uint64_t	length;			// Length of the leaf
+				bool		ok;				// Leaf matched the manifest
+			};
+
+			/// @brief Constructor
+			/// @param threadCount -[in]- Verifier threads, 0 for one per core up to CHUNK_VERIFIER_MAX_THREADS
+			/// @param maxJobs -[in]- Chunks that can wait to be verified before Submit blocks
+			ChunkVerifier(const size_t threadCount = 0, const size_t maxJobs = CHUNK_VERIFIER_DEFAULT_JOBS);
+
+			/// @brief Deconstructor, stops the threads
+			~ChunkVerifier();
+
+			/// @brief Prevent copying
+			ChunkVerifier(const ChunkVerifier&) = delete;
+			ChunkVerifier& operator=(const ChunkVerifier&) = delete;
+
+			/// @brief Waits for the chunks in hand and then checks against a new manifest, starting the threads the first time
+			/// @param manifest -[in]- Manifest to check against
+			void SetManifest(const MerkleManifest& manifest);
+
+			/// @brief Queues a chunk of whole leaves to be checked, blocks while every job is busy
+			/// @param clientFD -[in]- Connection the chunk arrived on
+			/// @param offset -[in]- Offset of the chunk in the image
+			/// @param data -[in]- Chunk data, copied
+			/// @param size -[in]- Number of bytes, no more than MERKLE_MAX_CHUNK_SIZE
+			/// @return 0 if queued, -1 if too big or the verifier is stopped
+			int Submit(const int clientFD, const uint64_t offset, const uint8_t* data, const size_t size);
+
+			/// @brief Takes every result ready so far
+			/// @return results, one per leaf
+			std::vector<Result> TakeResults();
+
+			/// @brief Waits until every queued chunk has been checked
+			void WaitIdle();
+
+			/// @brief Get the number of leaves submitted whose results haven't been taken
+			size_t GetPendingCount();
+
+			/// @brief Get the descriptor that becomes readable when results are waiting
+			/// @return eventfd, -1 where not supported
+			int GetFD() const;
+
+		protected:
+		private:
+			/// @brief A chunk waiting to be checked
+			struct Job
+			{
+				std::vector<uint8_t>	data;		// Copy of the chunk
+				size_t					size;		// Bytes in the chunk
+				uint64_t				offset;		// Offset of the chunk in the image
+				int						clientFD;	// Connection it arrived on
+			};
+
+			/// @brief Starts the verifier threads if they aren't running
+			void StartThreads();
+
+			/// @brief Verifier thread main loop
+			void VerifierThread();
+
+			/// @brief Signals the results descriptor
+			void Notify();
+
+			MerkleManifest				mManifest;			// Manifest being checked against
+			std::vector<Job>			mJobs;				// Job pool
+			std::deque<size_t>			mFreeJobs;			// Jobs ready to be filled
+			std::deque<size_t>			mQueuedJobs;		// Jobs waiting for a thread
+			size_t						mBusyJobs;			// Jobs being checked
+			std::vector<Result>			mResults;			// Results not yet taken
+			size_t						mPendingLeaves;		// Leaves submitted and not yet taken
+			std::mutex					mMutex;				// Queue protection
+			std::condition_variable		mJobCondition;		// Signalled when a job is queued
+			std::condition_variable		mFreeCondition;		// Signalled when a job is returned
+			std::vector<std::thread>	mThreads;			// Verifier threads
+			size_t						mThreadCount;		// Verifier threads to start
+			bool						mStopping;			// Verifier threads stop request
+			int							mEventFD;			// Readable while results are waiting
+		};
+	}
+}
+
+#endif		// CPP_MERKLE_MANIFEST
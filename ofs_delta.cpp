@@ -0,0 +1,345 @@
+///////////////////////////////////////////////////////////////////////////////
+//! @file		ofs_delta.cpp
+//! @brief		Implementation of the OFS delta classes
+//! @author		Chip Brommer
+///////////////////////////////////////////////////////////////////////////////
+
+///////////////////////////////////////////////////////////////////////////////
+//
+//  Includes:
+//          name                        reason included
+//          --------------------        ---------------------------------------
+#include	"ofs_delta.h"				// OFS delta classes
+//
+///////////////////////////////////////////////////////////////////////////////
+
+namespace Essentials
+{
+	namespace Utilities
+	{
+		RollingChecksum::RollingChecksum()
+		{
+			mA		= 0;
+			mB		= 0;
+			mLength	= 0;
+		}
+
+		void RollingChecksum::Reset(const uint8_t* data, const size_t size)
+		{
+			mA = 0;
+			mB = 0;
+			mLength = static_cast<uint32_t>(size);
+
+			for (size_t i = 0; i < size; i++)
+			{
+				mA += data[i];
+				mB += static_cast<uint32_t>(size - i) * data[i];
+			}
+		}
+
+		void RollingChecksum::Roll(const uint8_t out, const uint8_t in)
+		{
+			mA = mA - out + in;
+			mB = mB - mLength * out + mA;
+		}
+
+		uint32_t RollingChecksum::Get() const
+		{
+			return (mA & 0xFFFF) | (mB << 16);
+		}
+
+		void DeltaStrongHash(const uint8_t* data, const size_t size, uint8_t* hash)
+		{
+			// A collision here copies the wrong block into the image, so it has to be cryptographic
+			Sha256 sha;
+			sha.Update(data, size);
+			Sha256Digest digest = sha.Final();
+			memcpy(hash, digest.data(), DELTA_STRONG_HASH_SIZE);
+		}
+
+		DeltaPatcher::DeltaPatcher()
+		{
+			mLastError		= DeltaError::NONE;
+			mSourceFd		= -1;
+			mSourceSize		= 0;
+			mWriter			= nullptr;
+			mOutputOffset	= 0;
+			mTargetSize		= 0;
+		}
+
+		DeltaPatcher::~DeltaPatcher()
+		{
+			Abort();
+		}
+
+		int DeltaPatcher::GenerateSignature(const std::string& imagePath, const uint32_t blockSize, std::string& signature)
+		{
+			if (blockSize < DELTA_MIN_BLOCK_SIZE || blockSize > DELTA_MAX_BLOCK_SIZE)
+			{
+				mLastError = DeltaError::BAD_BLOCK_SIZE;
+				return -1;
+			}
+
+			std::ifstream image(imagePath, std::ios::binary | std::ios::ate);
+			if (!image.is_open())
+			{
+				mLastError = DeltaError::SOURCE_OPEN_FAILED;
+				return -1;
+			}
+
+			DELTA_SIGNATURE_HEADER header = { 0 };
+			header.imageSize = static_cast<uint64_t>(image.tellg());
+			header.blockSize = blockSize;
+			header.blockCount = static_cast<uint32_t>((header.imageSize + blockSize - 1) / blockSize);
+			image.seekg(0);
+
+			signature.clear();
+			signature.reserve(sizeof(header) + static_cast<size_t>(header.blockCount) * sizeof(DELTA_BLOCK_SIGNATURE));
+			signature.append(reinterpret_cast<const char*>(&header), sizeof(header));
+
+			std::vector<uint8_t> block(blockSize);
+			RollingChecksum checksum;
+
+			for (uint32_t i = 0; i < header.blockCount; i++)
+			{
+				size_t count = static_cast<size_t>(std::min<uint64_t>(blockSize, header.imageSize - static_cast<uint64_t>(i) * blockSize));
+				if (!image.read(reinterpret_cast<char*>(block.data()), count))
+				{
+					mLastError = DeltaError::SOURCE_READ_FAILED;
+					return -1;
+				}
+
+				checksum.Reset(block.data(), count);
+
+				DELTA_BLOCK_SIGNATURE entry = { 0 };
+				entry.weak = checksum.Get();
+				DeltaStrongHash(block.data(), count, entry.strong);
+				signature.append(reinterpret_cast<const char*>(&entry), sizeof(entry));
+			}
+
+			return 0;
+		}
+
+		int DeltaPatcher::Begin(const std::string& sourcePath, AsyncFileWriter* writer, const uint64_t targetSize)
+		{
+			Abort();
+
+			if (writer == nullptr || !writer->IsOpen())
+			{
+				mLastError = DeltaError::WRITE_FAILED;
+				return -1;
+			}
+
+#ifdef WIN32
+			mSourceFd = _open(sourcePath.c_str(), _O_RDONLY | _O_BINARY);
+			if (mSourceFd < 0)
+			{
+				mSourceFd = -1;
+				mLastError = DeltaError::SOURCE_OPEN_FAILED;
+				return -1;
+			}
+			mSourceSize = static_cast<uint64_t>(_lseeki64(mSourceFd, 0, SEEK_END));
+#else
+			mSourceFd = open(sourcePath.c_str(), O_RDONLY | O_CLOEXEC);
+			struct stat info {};
+			if (mSourceFd < 0 || fstat(mSourceFd, &info) != 0)
+			{
+				Abort();
+				mLastError = DeltaError::SOURCE_OPEN_FAILED;
+				return -1;
+			}
+			mSourceSize = static_cast<uint64_t>(info.st_size);
+#endif
+
+			mWriter = writer;
+			mOutputOffset = 0;
+			mTargetSize = targetSize;
+
+			if (mCopyBuffer.empty())
+			{
+				mCopyBuffer.resize(DELTA_COPY_BUFFER_SIZE);
+			}
+
+			return 0;
+		}
+
+		int DeltaPatcher::Apply(const uint64_t outputOffset, const uint8_t* instructions, const size_t size)
+		{
+			if (!IsActive())
+			{
+				mLastError = DeltaError::NOT_STARTED;
+				return -1;
+			}
+
+			// The new image is written strictly in order, a gap or replay means the stream is broken
+			if (outputOffset != mOutputOffset)
+			{
+				mLastError = DeltaError::OUT_OF_ORDER;
+				return -1;
+			}
+
+			size_t position = 0;
+			while (position < size)
+			{
+				DELTA_INSTRUCTION instruction = { 0 };
+				if (size - position < sizeof(instruction))
+				{
+					mLastError = DeltaError::BAD_INSTRUCTION;
+					return -1;
+				}
+				memcpy(&instruction, instructions + position, sizeof(instruction));
+				position += sizeof(instruction);
+
+				if (instruction.length > mTargetSize - mOutputOffset)
+				{
+					mLastError = DeltaError::SIZE_MISMATCH;
+					return -1;
+				}
+
+				if (instruction.type == DELTA_COPY)
+				{
+					if (instruction.sourceOffset > mSourceSize || instruction.length > mSourceSize - instruction.sourceOffset)
+					{
+						mLastError = DeltaError::BAD_INSTRUCTION;
+						return -1;
+					}
+
+					if (CopyFromSource(instruction.sourceOffset, instruction.length) < 0)
+					{
+						return -1;
+					}
+				}
+				else if (instruction.type == DELTA_LITERAL)
+				{
+					if (size - position < instruction.length)
+					{
+						mLastError = DeltaError::BAD_INSTRUCTION;
+						return -1;
+					}
+
+					// Literal data goes straight from the received message to the writer
+					if (mWriter->Write(mOutputOffset, instructions + position, instruction.length) < 0)
+					{
+						mLastError = DeltaError::WRITE_FAILED;
+						return -1;
+					}
+					position += instruction.length;
+					mOutputOffset += instruction.length;
+				}
+				else
+				{
+					mLastError = DeltaError::BAD_INSTRUCTION;
+					return -1;
+				}
+			}
+
+			return 0;
+		}
+
+		int DeltaPatcher::Finish()
+		{
+			if (!IsActive())
+			{
+				mLastError = DeltaError::NOT_STARTED;
+				return -1;
+			}
+
+			bool complete = mOutputOffset == mTargetSize;
+			Abort();
+
+			if (!complete)
+			{
+				mLastError = DeltaError::SIZE_MISMATCH;
+				return -1;
+			}
+
+			return 0;
+		}
+
+		void DeltaPatcher::Abort()
+		{
+			if (mSourceFd != -1)
+			{
+#ifdef WIN32
+				_close(mSourceFd);
+#else
+				close(mSourceFd);
+#endif
+				mSourceFd = -1;
+			}
+
+			mWriter = nullptr;
+		}
+
+		bool DeltaPatcher::IsActive() const
+		{
+			return mSourceFd != -1;
+		}
+
+		uint64_t DeltaPatcher::GetOutputOffset() const
+		{
+			return mOutputOffset;
+		}
+
+		std::string DeltaPatcher::GetLastError()
+		{
+			return DeltaErrorMap[mLastError];
+		}
+
+		int DeltaPatcher::CopyFromSource(uint64_t offset, uint64_t length)
+		{
+			while (length > 0)
+			{
+				size_t count = static_cast<size_t>(std::min<uint64_t>(length, mCopyBuffer.size()));
+
+				if (ReadAt(mCopyBuffer.data(), count, offset) < 0)
+				{
+					mLastError = DeltaError::SOURCE_READ_FAILED;
+					return -1;
+				}
+
+				if (mWriter->Write(mOutputOffset, mCopyBuffer.data(), count) < 0)
+				{
+					mLastError = DeltaError::WRITE_FAILED;
+					return -1;
+				}
+
+				offset += count;
+				length -= count;
+				mOutputOffset += count;
+			}
+
+			return 0;
+		}
+
+		int DeltaPatcher::ReadAt(uint8_t* data, size_t size, uint64_t offset)
+		{
+			while (size > 0)
+			{
+#ifdef WIN32
+				if (_lseeki64(mSourceFd, static_cast<__int64>(offset), SEEK_SET) < 0)
+				{
+					return -1;
+				}
+				int count = _read(mSourceFd, data, static_cast<unsigned int>(size));
+#else
+				ssize_t count = pread(mSourceFd, data, size, static_cast<off_t>(offset));
+				if (count < 0 && errno == EINTR)
+				{
+					continue;
+				}
+#endif
+				if (count <= 0)
+				{
+					return -1;
+				}
+
+				data += count;
+				size -= static_cast<size_t>(count);
+				offset += static_cast<uint64_t>(count);
+			}
+
+			return 0;
+		}
+	}
+}
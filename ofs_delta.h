@@ -0,0 +1,197 @@
+///////////////////////////////////////////////////////////////////////////////
+//! @file		ofs_delta.h
+//! @brief		Block signatures and delta reconstruction for OFS images
+//! @author		Chip Brommer
+///////////////////////////////////////////////////////////////////////////////
+#pragma once
+///////////////////////////////////////////////////////////////////////////////
+//
+//  Includes:
+//          name                        reason included
+//          --------------------        ---------------------------------------
+#ifdef WIN32
+#include <io.h>							// _open, _read
+#include <fcntl.h>						// File open flags
+#else
+#include <fcntl.h>						// open
+#include <unistd.h>						// pread, close
+#include <sys/stat.h>					// fstat
+#include <cerrno>						// errno
+#endif
+#include <cstdint>						// Standard integer types
+#include <cstring>						// memcpy
+#include <map>							// Error enum to strings.
+#include <string>						// Strings
+#include <fstream>						// Reading the image to sign
+#include <algorithm>					// std::min
+#include <vector>						// Copy buffer
+#include "file_writer.h"				// Reconstructed image output
+#include "sha256.h"						// Strong block hash
+#include "project_messages.h"			// Delta message structures
+//
+//	Defines:
+//          name                        reason defined
+//          --------------------        ---------------------------------------
+#ifndef     CPP_OFS_DELTA				// Define the cpp ofs delta classes.
+#define     CPP_OFS_DELTA
+//
+///////////////////////////////////////////////////////////////////////////////
+
+namespace Essentials
+{
+	namespace Utilities
+	{
+		constexpr static size_t		DELTA_COPY_BUFFER_SIZE	= 64 * 1024;	// Size of the buffer copies from the current image go through
+
+		/// @brief enum for error codes
+		enum class DeltaError : uint8_t
+		{
+			NONE,
+			NOT_STARTED,
+			BAD_BLOCK_SIZE,
+			SOURCE_OPEN_FAILED,
+			SOURCE_READ_FAILED,
+			OUT_OF_ORDER,
+			BAD_INSTRUCTION,
+			WRITE_FAILED,
+			SIZE_MISMATCH,
+		};
+
+		/// @brief Error enum to string map
+		static std::map<DeltaError, std::string> DeltaErrorMap
+		{
+			{DeltaError::NONE,
+			std::string("Error Code " + std::to_string((uint8_t)DeltaError::NONE) + ": No error.")},
+			{DeltaError::NOT_STARTED,
+			std::string("Error Code " + std::to_string((uint8_t)DeltaError::NOT_STARTED) + ": No delta update in progress.")},
+			{DeltaError::BAD_BLOCK_SIZE,
+			std::string("Error Code " + std::to_string((uint8_t)DeltaError::BAD_BLOCK_SIZE) + ": Block size out of range.")},
+			{DeltaError::SOURCE_OPEN_FAILED,
+			std::string("Error Code " + std::to_string((uint8_t)DeltaError::SOURCE_OPEN_FAILED) + ": Failed to open current image.")},
+			{DeltaError::SOURCE_READ_FAILED,
+			std::string("Error Code " + std::to_string((uint8_t)DeltaError::SOURCE_READ_FAILED) + ": Failed to read current image.")},
+			{DeltaError::OUT_OF_ORDER,
+			std::string("Error Code " + std::to_string((uint8_t)DeltaError::OUT_OF_ORDER) + ": Delta data out of order.")},
+			{DeltaError::BAD_INSTRUCTION,
+			std::string("Error Code " + std::to_string((uint8_t)DeltaError::BAD_INSTRUCTION) + ": Malformed delta instruction.")},
+			{DeltaError::WRITE_FAILED,
+			std::string("Error Code " + std::to_string((uint8_t)DeltaError::WRITE_FAILED) + ": Failed to write new image.")},
+			{DeltaError::SIZE_MISMATCH,
+			std::string("Error Code " + std::to_string((uint8_t)DeltaError::SIZE_MISMATCH) + ": New image size mismatch.")},
+		};
+
+		/// @brief The rsync style weak checksum. It can be slid along a buffer one byte at a time,
+		/// so a sender can test every offset of the new image against the unit's block signatures
+		/// for the cost of a couple of additions per byte.
+		class RollingChecksum
+		{
+		public:
+			/// @brief Constructor
+			RollingChecksum();
+
+			/// @brief Starts a checksum over a window of data
+			/// @param data -[in]- Start of the window
+			/// @param size -[in]- Size of the window
+			void Reset(const uint8_t* data, const size_t size);
+
+			/// @brief Slides the window forward one byte
+			/// @param out -[in]- Byte leaving the front of the window
+			/// @param in -[in]- Byte entering the back of the window
+			void Roll(const uint8_t out, const uint8_t in);
+
+			/// @brief Get the checksum of the current window
+			/// @return weak checksum
+			uint32_t Get() const;
+
+		protected:
+		private:
+			uint32_t	mA;				// Sum of the bytes in the window
+			uint32_t	mB;				// Sum of the bytes weighted by distance from the end of the window
+			uint32_t	mLength;		// Size of the window
+		};
+
+		/// @brief Strong hash confirming a weak checksum match, SHA-256 truncated to DELTA_STRONG_HASH_SIZE bytes
+		/// @param data -[in]- Block to hash
+		/// @param size -[in]- Size of the block
+		/// @param hash -[out]- DELTA_STRONG_HASH_SIZE bytes of hash
+		void DeltaStrongHash(const uint8_t* data, const size_t size, uint8_t* hash);
+
+		/// @brief Rebuilds a new OFS image from the current one and a stream of COPY and LITERAL
+		/// instructions. Copies are read from the current image and literals taken straight from
+		/// the received message, both written through the write-behind writer in output order, so
+		/// the new image is never held in memory.
+		class DeltaPatcher
+		{
+		public:
+			/// @brief Constructor
+			DeltaPatcher();
+
+			/// @brief Deconstructor, closes the current image
+			~DeltaPatcher();
+
+			/// @brief Prevent copying
+			DeltaPatcher(const DeltaPatcher&) = delete;
+			DeltaPatcher& operator=(const DeltaPatcher&) = delete;
+
+			/// @brief Builds the block signatures of an image
+			/// @param imagePath -[in]- Image to sign
+			/// @param blockSize -[in]- Size of each block, DELTA_MIN_BLOCK_SIZE to DELTA_MAX_BLOCK_SIZE
+			/// @param signature -[out]- DELTA_SIGNATURE_HEADER followed by a DELTA_BLOCK_SIGNATURE per block
+			/// @return 0 if successful, -1 if fails. Call DeltaPatcher::GetLastError to find out more.
+			int GenerateSignature(const std::string& imagePath, const uint32_t blockSize, std::string& signature);
+
+			/// @brief Starts rebuilding an image
+			/// @param sourcePath -[in]- Current image copies are taken from
+			/// @param writer -[in]- Open writer the new image is written to
+			/// @param targetSize -[in]- Size of the new image
+			/// @return 0 if successful, -1 if fails. Call DeltaPatcher::GetLastError to find out more.
+			int Begin(const std::string& sourcePath, AsyncFileWriter* writer, const uint64_t targetSize);
+
+			/// @brief Applies a run of whole instructions
+			/// @param outputOffset -[in]- Offset in the new image the instructions start at
+			/// @param instructions -[in]- DELTA_INSTRUCTIONs, each LITERAL followed by its data
+			/// @param size -[in]- Number of instruction bytes
+			/// @return 0 if successful, -1 if fails. Call DeltaPatcher::GetLastError to find out more.
+			int Apply(const uint64_t outputOffset, const uint8_t* instructions, const size_t size);
+
+			/// @brief Checks the whole image was rebuilt and releases the current image
+			/// @return 0 if successful, -1 if fails. Call DeltaPatcher::GetLastError to find out more.
+			int Finish();
+
+			/// @brief Stops rebuilding and releases the current image
+			void Abort();
+
+			/// @brief Check if an image is being rebuilt
+			/// @return true if active
+			bool IsActive() const;
+
+			/// @brief Get the number of bytes of the new image produced so far
+			/// @return bytes produced
+			uint64_t GetOutputOffset() const;
+
+			/// @brief Get the last error in string format
+			/// @return The last error in a formatted string
+			std::string GetLastError();
+
+		protected:
+		private:
+			/// @brief Copies a range of the current image to the end of the new image
+			/// @return 0 if successful, -1 if fails
+			int CopyFromSource(uint64_t offset, uint64_t length);
+
+			/// @brief Reads a range of the current image, retrying short reads
+			/// @return 0 if successful, -1 if fails
+			int ReadAt(uint8_t* data, size_t size, uint64_t offset);
+
+			DeltaError				mLastError;			// Last error for this utility
+			int						mSourceFd;			// Current image descriptor
+			uint64_t				mSourceSize;		// Size of the current image
+			AsyncFileWriter*		mWriter;			// Writer for the new image
+			uint64_t				mOutputOffset;		// Bytes of the new image produced
+			uint64_t				mTargetSize;		// Size of the new image
+			std::vector<uint8_t>	mCopyBuffer;		// Buffer copies go through
+		};
+	}
+}
+
+#endif		// CPP_OFS_DELTA
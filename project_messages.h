@@ -23,6 +23,44 @@ constexpr uint8_t   SYNC4       = 0xD5;
 constexpr uint16_t  ACKNOWLEDGE = 0xBA21;
 constexpr uint16_t  EOB         = 0xA5E1;
 
+constexpr uint32_t  MAX_CHUNK_SIZE      = 1024 * 1024;              // Largest image chunk carried by one message
+constexpr uint32_t  MAX_MESSAGE_SIZE    = MAX_CHUNK_SIZE + 256;     // Largest message accepted, chunk plus framing
+
+constexpr uint8_t   CHUNK_FLAG_FIRST    = 0x01;     // First chunk of a stream, opens a new file or joins the transfer with the same id
+constexpr uint8_t   CHUNK_FLAG_LAST     = 0x02;     // Last chunk of a stream, the file is committed once every byte is in
+constexpr uint8_t   CHUNK_FLAG_CRC32C   = 0x04;     // crc32c is set and must match before the chunk is used
+constexpr uint8_t   CHUNK_FLAG_POLL     = 0x08;     // Multicast only, every unit answers the sender with what it is missing
+constexpr uint8_t   CHUNK_FLAG_FEC      = 0x10;     // Multicast only, a MULTICAST_FEC_HEADER leads the chunk data
+constexpr uint8_t   CHUNK_FLAG_REPAIR   = 0x20;     // Multicast only, with CHUNK_FLAG_FEC the data is a repair symbol rather than image
+
+constexpr uint64_t  TRANSFER_CHECKPOINT_INTERVAL = 16 * 1024 * 1024;    // Bytes received between durable upload checkpoints
+
+constexpr uint32_t  DELTA_DEFAULT_BLOCK_SIZE    = 8 * 1024;         // Signature block size when the request doesn't give one
+constexpr uint32_t  DELTA_MIN_BLOCK_SIZE        = 512;              // Smallest signature block size allowed
+constexpr uint32_t  DELTA_MAX_BLOCK_SIZE        = MAX_CHUNK_SIZE;   // Largest signature block size allowed
+constexpr uint32_t  DELTA_STRONG_HASH_SIZE      = 16;               // Leading bytes of a block's SHA-256 kept in its signature
+
+constexpr uint32_t  MERKLE_MIN_CHUNK_SIZE       = 4 * 1024;         // Smallest manifest chunk allowed
+constexpr uint32_t  MERKLE_MAX_CHUNK_SIZE       = MAX_CHUNK_SIZE;   // Largest manifest chunk, so one always fits in a message
+constexpr uint8_t   MERKLE_LEAF_PREFIX          = 0x00;             // Hashed ahead of a chunk to make a leaf
+constexpr uint8_t   MERKLE_NODE_PREFIX          = 0x01;             // Hashed ahead of two children to make a node
+
+// An UPDATE_OFS_MULTICAST datagram is framed like UPDATE_OFS and sent to the multicast group in the
+// settings. Units join the transfer on whichever datagram they first see, so a chunk may arrive in any
+// order, more than once or not at all. The sender sets CHUNK_FLAG_POLL at the end of each pass, length
+// may be 0, and every unit answers it by unicast to the datagram's source: FAIL with a TRANSFER_STATUS
+// followed by up to MULTICAST_MAX_NACK_RANGES missing TRANSFER_RANGEs, or SUCCESS with the SHA-256 of
+// the installed image once it has all of it. The sender's next pass is the union of the missing ranges.
+//
+// A sender may also cut the image into blocks of sourceCount symbols of symbolSize bytes and send repair
+// symbols after each block's data, see MULTICAST_FEC_HEADER. A unit rebuilds up to as many lost chunks
+// of a block as it received repair symbols, without waiting for the next pass.
+constexpr uint32_t  MULTICAST_MAX_DATAGRAM_SIZE = 65507;            // Largest UDP payload over IPv4
+constexpr uint32_t  MULTICAST_MAX_NACK_RANGES   = 64;               // Missing ranges listed in one answer to a poll
+
+constexpr uint8_t   DELTA_COPY          = 0x01;     // Copy 'length' bytes of the current image from 'sourceOffset'
+constexpr uint8_t   DELTA_LITERAL       = 0x02;     // 'length' bytes of new data follow the instruction
+
 enum class MSG_TYPE
 {
     BOOT_INTERRUPT,
@@ -32,6 +70,12 @@ enum class MSG_TYPE
     GET_LOG_NAMES,
     GET_SPECIFIC_LOG,
     GET_LAST_FLIGHT_LOG,
+    GET_OFS_SIGNATURE,
+    UPDATE_OFS_DELTA,
+    RESUME_OFS,
+    RESUME_SPECIFIC_LOG,
+    UPDATE_OFS_MANIFEST,
+    UPDATE_OFS_MULTICAST,
 };
 
 enum ACTION_COMMAND : std::uint32_t
@@ -44,6 +88,12 @@ enum ACTION_COMMAND : std::uint32_t
     GET_SPECIFIC_LOG    = 0xC2C3B4A6,
     GET_LAST_FLIGHT_LOG = 0xC3C3B4A7,
     CLOSE               = 0xA4C3B4A8,
+    GET_OFS_SIGNATURE   = 0xC4C3B4A9,
+    UPDATE_OFS_DELTA    = 0xD4C3B4AA,
+    RESUME_OFS          = 0xD5C3B4AB,
+    RESUME_SPECIFIC_LOG = 0xC5C3B4AC,
+    UPDATE_OFS_MANIFEST = 0xD6C3B4AD,
+    UPDATE_OFS_MULTICAST = 0xD7C3B4AE,
 };
 
 enum ACTION_STATUS : std::uint32_t
@@ -73,6 +123,103 @@ struct UPDATER_ACTION_MESSAGE
     UPDATER_FOOTER  footer;
 };
 
+/// @brief Follows the action of an UPDATE_OFS message, 'length' bytes of image data follow it 
+/// and then the footer. The header msgSize covers the whole message. With CHUNK_FLAG_CRC32C the 
+/// crc32c covers this header up to the crc32c field and then the data. A chunk failing it is 
+/// answered FAIL with the TRANSFER_RANGE of the chunk so the client can send it again. The SUCCESS 
+/// answer to a completed upload carries the SHA-256 of the installed image.
+struct UPDATER_CHUNK_HEADER
+{
+    uint64_t        offset;         // offset of this chunk within the image
+    uint64_t        totalSize;      // total size of the image
+    uint32_t        length;         // number of image bytes in this chunk
+    uint8_t         flags;          // CHUNK_FLAG_*
+    uint64_t        transferId;     // chosen by the client, names the upload when resuming it
+    uint32_t        crc32c;         // CRC32C of the chunk, checked when CHUNK_FLAG_CRC32C is set
+};
+
+/// @brief With CHUNK_FLAG_FEC this leads the data of an UPDATE_OFS_MULTICAST chunk and the chunk length
+/// counts it, so the crc32c covers it too. Source symbol i of a block is the chunk at offset 
+/// blockOffset + i * symbolSize, a whole symbol except the last of the image which is zero padded for 
+/// coding. Repair symbols are indexed from sourceCount up, set CHUNK_FLAG_REPAIR, carry blockOffset as 
+/// the chunk offset and are always symbolSize bytes, see Essentials::Utilities::ReedSolomon::Encode. 
+/// The last block of the image may have fewer source symbols than the rest.
+struct MULTICAST_FEC_HEADER
+{
+    uint64_t        blockOffset;    // Image offset of the block's first source symbol
+    uint32_t        symbolSize;     // Bytes per symbol
+    uint16_t        sourceCount;    // Source symbols in the block, below RS_MAX_SYMBOLS
+    uint16_t        symbolIndex;    // This symbol, repair symbols from sourceCount up
+};
+
+/// @brief A RESUME_OFS message carries the transfer id of an interrupted upload between the action 
+/// and the footer. On success the unit reopens the upload and answers with a TRANSFER_STATUS and its 
+/// TRANSFER_RANGEs, the client then sends only what is missing as ordinary UPDATE_OFS chunks. Ranges 
+/// count as received once they are handed to the file writer, a RESUME_OFS answer flushes them to disk 
+/// first but a multicast poll answer does not.
+struct TRANSFER_STATUS
+{
+    uint64_t        transferId;     // id of the upload
+    uint64_t        totalSize;      // total size of the image
+    uint64_t        receivedBytes;  // bytes received and queued to be written
+    uint32_t        rangeCount;     // number of received ranges that follow
+};
+
+struct TRANSFER_RANGE
+{
+    uint64_t        offset;         // start of a received range
+    uint64_t        length;         // length of a received range
+};
+
+/// @brief A RESUME_SPECIFIC_LOG message carries this and then the log name between the action and the 
+/// footer. The response holds the log from the offset onward.
+struct RESUME_LOG_REQUEST
+{
+    uint64_t        offset;         // bytes of the log the client already has
+};
+
+/// @brief An UPDATE_OFS_MANIFEST message carries this and then leafCount SHA-256 leaf hashes between 
+/// the action and the footer, sent before the first chunk of the upload it describes. A leaf is the 
+/// SHA-256 of MERKLE_LEAF_PREFIX and one chunkSize piece of the image, the last may be short. Nodes 
+/// hash MERKLE_NODE_PREFIX and their two children, an odd node out is carried up as is. The unit 
+/// rebuilds the root from the leaves and refuses the manifest if it differs. Chunks of an upload with 
+/// a manifest must hold whole leaves. Each leaf is checked as it arrives and one that fails is 
+/// answered FAIL with its TRANSFER_RANGE, only that range needs sending again. The root travels with
+/// the leaves, so it guards against damage in transit but says nothing about who built the image.
+struct MERKLE_MANIFEST_HEADER
+{
+    uint64_t        transferId;     // upload the manifest describes
+    uint64_t        imageSize;      // size of the complete image
+    uint32_t        chunkSize;      // bytes of image under each leaf
+    uint32_t        leafCount;      // number of leaf hashes that follow
+    uint8_t         root[32];       // root of the tree
+};
+
+/// @brief Starts the GET_OFS_SIGNATURE response data, followed by a DELTA_BLOCK_SIGNATURE for each
+/// block of the current image. The last block may be short, its signature covers only what there is.
+struct DELTA_SIGNATURE_HEADER
+{
+    uint64_t        imageSize;      // size of the current image
+    uint32_t        blockSize;      // size of each signed block
+    uint32_t        blockCount;     // number of block signatures that follow
+};
+
+struct DELTA_BLOCK_SIGNATURE
+{
+    uint32_t        weak;           // rolling checksum of the block
+    uint8_t         strong[DELTA_STRONG_HASH_SIZE]; // first DELTA_STRONG_HASH_SIZE bytes of the block's SHA-256
+};
+
+/// @brief An UPDATE_OFS_DELTA message is framed like UPDATE_OFS, except the chunk carries whole delta 
+/// instructions rather than image data. The chunk offset is where in the new image the first instruction's
+/// output goes, totalSize is the size of the new image and length is the number of instruction bytes.
+struct DELTA_INSTRUCTION
+{
+    uint8_t         type;           // DELTA_COPY or DELTA_LITERAL
+    uint32_t        length;         // bytes of output produced
+    uint64_t        sourceOffset;   // offset in the current image for a copy, unused for a literal
+};
+
 struct UPDATER_ACTION_ACK
 {
     UPDATER_HEADER  header;
@@ -90,4 +237,13 @@ struct RESPONSE_MSG
     UPDATER_FOOTER	footer = { EOB };
 };
 
+/// @brief Fixed leading part of a serialized RESPONSE_MSG, 'dataSize' bytes of data and the footer follow it
+struct RESPONSE_PREFIX
+{
+    UPDATER_HEADER  header;
+    std::uint32_t   action;
+    std::uint32_t   status;
+    size_t          dataSize;
+};
+
 #pragma pack(pop)
\ No newline at end of file
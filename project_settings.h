@@ -12,6 +12,16 @@
 #include <string>                       // strings
 #include <iostream>                     // iostream
 #include <fstream>                      // file stream
+#include <cstdint>                      // standard types
+#include <cstring>                      // memcpy
+#include <vector>                       // snapshot buffer
+#include <filesystem>                   // json file time and size
+#ifndef WIN32
+#include <fcntl.h>                      // open
+#include <unistd.h>                     // close
+#include <sys/mman.h>                   // mmap
+#include <sys/stat.h>                   // fstat
+#endif
 #include "nlohmann/json.hpp"            // json
 //
 ///////////////////////////////////////////////////////////////////////////////
@@ -24,6 +34,25 @@ constexpr int MINIMUM_TIMEOUT           = 1000;
 constexpr int MINIMUM_PORT              = 1024;
 constexpr int MAXIMUM_PORT              = 65535;
 constexpr int MINIMUM_CONNECTIONS       = 1;   
+constexpr int DEFAULT_MULTICAST_PORT    = 5802;
+
+constexpr uint32_t    SETTINGS_SNAPSHOT_MAGIC     = 0x53535555;     // "UUSS"
+constexpr uint16_t    SETTINGS_SNAPSHOT_VERSION   = 2;              // Bump when the snapshot layout changes
+constexpr const char* SETTINGS_SNAPSHOT_EXTENSION = ".snapshot";    // Snapshot lives next to the json as <json>.snapshot
+
+/// @brief Header of the binary settings snapshot, followed by payloadSize bytes of payload.
+/// The payload is the five ints followed by each string as a uint32_t length and its characters.
+struct SETTINGS_SNAPSHOT_HEADER
+{
+    uint32_t magic;                         // SETTINGS_SNAPSHOT_MAGIC
+    uint16_t version;                       // SETTINGS_SNAPSHOT_VERSION
+    uint16_t reserved;                      // Padding, zero
+    int64_t  jsonWriteTime;                 // Write time of the json the snapshot was made from
+    uint64_t jsonSize;                      // Size of the json the snapshot was made from
+    uint64_t payloadHash;                   // FNV-1a of the payload
+    uint32_t payloadSize;                   // Bytes of payload after the header
+    uint32_t reserved2;                     // Padding, zero
+};
 
 /// @brief A structure to represent a settings file
 struct Settings 
@@ -36,10 +65,13 @@ struct Settings
     int broadcastPort;                      // Port for broadcast listening
     int communicationPort;                  // Port for direct communication
     int maximumConnections;                 // Maximum number of connections for TCP server 
+    std::string multicastGroup;             // Group to receive fleet OFS updates on, empty to not join one
+    int multicastPort;                      // Port of the multicast group
 
     // @brief Default Constructor
     Settings() : ofsLocation(""), ofsNonWebConfigLocation(""), asBuiltLocation(""), sdcardLocation(""), broadcastTimeoutMSec(DEFAULT_BROADCAST_TIMEOUT),
-        broadcastPort(DEFAULT_BROADCAST_PORT), communicationPort(DEFAULT_COMMS_PORT), maximumConnections(DEFAULT_CONNECTIONS_LIMIT) {}
+        broadcastPort(DEFAULT_BROADCAST_PORT), communicationPort(DEFAULT_COMMS_PORT), maximumConnections(DEFAULT_CONNECTIONS_LIMIT),
+        multicastGroup(""), multicastPort(DEFAULT_MULTICAST_PORT) {}
 
     /// @brief Constructor
     /// @param ofsLocation - location of the OFS 
@@ -50,7 +82,8 @@ struct Settings
     Settings(const std::string& ofsLocation, const std::string& configLocation, const std::string& asBuiltLocation, const std::string& sdcardLocation, 
         const int broadcastTimeoutMSec, const int broadcastPort, const int communicationPort, const int maximumConnections)
         : ofsLocation(ofsLocation), ofsNonWebConfigLocation(configLocation), asBuiltLocation(asBuiltLocation), sdcardLocation(sdcardLocation),
-        broadcastTimeoutMSec(broadcastTimeoutMSec), broadcastPort(broadcastPort), communicationPort(communicationPort), maximumConnections(maximumConnections)
+        broadcastTimeoutMSec(broadcastTimeoutMSec), broadcastPort(broadcastPort), communicationPort(communicationPort), maximumConnections(maximumConnections),
+        multicastGroup(""), multicastPort(DEFAULT_MULTICAST_PORT)
     {
         // Ensure broadcastTimeoutMSec is at least 1000
         this->broadcastTimeoutMSec = (broadcastTimeoutMSec >= MINIMUM_TIMEOUT) ? broadcastTimeoutMSec : DEFAULT_BROADCAST_TIMEOUT;
@@ -75,7 +108,9 @@ struct Settings
                 broadcastTimeoutMSec    == rhs.broadcastTimeoutMSec     &&
                 broadcastPort           == rhs.broadcastPort            &&
                 communicationPort       == rhs.communicationPort        &&
-                maximumConnections      == rhs.maximumConnections);
+                maximumConnections      == rhs.maximumConnections       &&
+                multicastGroup          == rhs.multicastGroup           &&
+                multicastPort           == rhs.multicastPort);
     }
 
     /// @brief Converts settings to json structure
@@ -91,12 +126,15 @@ struct Settings
         settingsJson["broadcastPort"] = broadcastPort;
         settingsJson["communicationPort"] = communicationPort;
         settingsJson["maximumConnections"] = maximumConnections;
+        settingsJson["multicastGroup"] = multicastGroup;
+        settingsJson["multicastPort"] = multicastPort;
         return settingsJson;
     }
 
     /// @brief Load the settings from json
     /// @param j - pointer to the json data
-    void LoadFromJson(const nlohmann::json& j) 
+    /// @return - true if every required field was present
+    bool LoadFromJson(const nlohmann::json& j) 
     {
         try 
         {
@@ -136,11 +174,135 @@ struct Settings
                 std::cout << "[SETTINGS] Loaded invalid maximum connections, setting default: " << DEFAULT_CONNECTIONS_LIMIT << std::endl;
                 maximumConnections = DEFAULT_CONNECTIONS_LIMIT;
             }
+
+            // Multicast updates are optional, older settings files leave them off
+            multicastGroup = j.value("multicastGroup", std::string(""));
+            multicastPort = j.value("multicastPort", DEFAULT_MULTICAST_PORT);
+            if (multicastPort < MINIMUM_PORT || multicastPort > MAXIMUM_PORT)
+            {
+                std::cout << "[SETTINGS] Loaded invalid multicast port, setting default: " << DEFAULT_MULTICAST_PORT << std::endl;
+                multicastPort = DEFAULT_MULTICAST_PORT;
+            }
         }
         catch (const std::exception& e) 
         {
             std::cerr << "[SETTINGS] Error loading from JSON: " << std::string(e.what()) << std::endl;
+            return false;
         }
+
+        return true;
+    }
+
+    /// @brief Save a binary snapshot of the settings that can be loaded without parsing the json
+    /// @param snapshotPath - in - filepath to save the snapshot to
+    /// @param jsonPath - in - json file the settings were loaded from, used to detect a stale snapshot
+    /// @return - true if successful
+    bool SaveToSnapshot(const std::string& snapshotPath, const std::string& jsonPath) const
+    {
+        SETTINGS_SNAPSHOT_HEADER header = { 0 };
+        if (!GetJsonStamp(jsonPath, header.jsonWriteTime, header.jsonSize))
+        {
+            return false;
+        }
+
+        const int32_t fields[] = { broadcastTimeoutMSec, broadcastPort, communicationPort, maximumConnections, multicastPort };
+        const std::string* strings[] = { &ofsLocation, &ofsNonWebConfigLocation, &asBuiltLocation, &sdcardLocation, &multicastGroup };
+
+        // Sized up front and filled at a running offset, every length is a uint32_t ahead of its string
+        size_t payloadSize = sizeof(fields);
+        for (const std::string* value : strings)
+        {
+            payloadSize += sizeof(uint32_t) + value->size();
+        }
+
+        std::vector<uint8_t> payload(payloadSize);
+        size_t offset = 0;
+        memcpy(payload.data(), fields, sizeof(fields));
+        offset += sizeof(fields);
+        for (const std::string* value : strings)
+        {
+            uint32_t length = static_cast<uint32_t>(value->size());
+            memcpy(payload.data() + offset, &length, sizeof(length));
+            offset += sizeof(length);
+            memcpy(payload.data() + offset, value->data(), value->size());
+            offset += value->size();
+        }
+
+        header.magic        = SETTINGS_SNAPSHOT_MAGIC;
+        header.version      = SETTINGS_SNAPSHOT_VERSION;
+        header.payloadSize  = static_cast<uint32_t>(payload.size());
+        header.payloadHash  = HashSnapshot(payload.data(), payload.size());
+
+        // Write to the side and rename so a power cut never leaves a half written snapshot in place
+        std::string tempPath = snapshotPath + ".part";
+        {
+            std::ofstream file(tempPath, std::ios::binary | std::ios::trunc);
+            if (!file.is_open())
+            {
+                return false;
+            }
+
+            file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+            file.write(reinterpret_cast<const char*>(payload.data()), payload.size());
+            if (!file.good())
+            {
+                return false;
+            }
+        }
+
+        std::error_code ec;
+        std::filesystem::rename(tempPath, snapshotPath, ec);
+        if (ec)
+        {
+            std::filesystem::remove(tempPath, ec);
+            return false;
+        }
+
+        return true;
+    }
+
+    /// @brief Load the settings from a binary snapshot if it is still current for the json file
+    /// @param snapshotPath - in - filepath of the snapshot
+    /// @param jsonPath - in - json file the snapshot must match
+    /// @return - true if loaded, false if missing, stale or corrupt and the json should be used
+    bool LoadFromSnapshot(const std::string& snapshotPath, const std::string& jsonPath)
+    {
+        SETTINGS_SNAPSHOT_HEADER header = { 0 };
+        if (!GetJsonStamp(jsonPath, header.jsonWriteTime, header.jsonSize))
+        {
+            return false;
+        }
+
+#ifdef WIN32
+        std::ifstream file(snapshotPath, std::ios::binary);
+        std::vector<uint8_t> contents((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+        return ParseSnapshot(contents.data(), contents.size(), header);
+#else
+        int fd = open(snapshotPath.c_str(), O_RDONLY | O_CLOEXEC);
+        if (fd < 0)
+        {
+            return false;
+        }
+
+        struct stat info {};
+        if (fstat(fd, &info) != 0 || info.st_size < static_cast<off_t>(sizeof(SETTINGS_SNAPSHOT_HEADER)))
+        {
+            close(fd);
+            return false;
+        }
+
+        // Map it rather than read it, the page cache hands us the bytes without a copy
+        void* mapped = mmap(nullptr, static_cast<size_t>(info.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+        close(fd);
+        if (mapped == MAP_FAILED)
+        {
+            return false;
+        }
+
+        bool loaded = ParseSnapshot(static_cast<const uint8_t*>(mapped), static_cast<size_t>(info.st_size), header);
+        munmap(mapped, static_cast<size_t>(info.st_size));
+        return loaded;
+#endif
     }
 
     /// @brief Save the settings as json file
@@ -170,6 +332,40 @@ struct Settings
         }
     }
 
+    /// @brief Load the settings from the snapshot next to a json file, falling back to parsing the json
+    /// when the snapshot is missing or stale. The snapshot is rewritten after a json load.
+    /// @param jsonPath - in - filepath of the json settings
+    /// @return - true if successful
+    bool LoadFromFile(const std::string& jsonPath)
+    {
+        std::string snapshotPath = jsonPath + SETTINGS_SNAPSHOT_EXTENSION;
+        if (LoadFromSnapshot(snapshotPath, jsonPath))
+        {
+            return true;
+        }
+
+        std::ifstream settingsFile(jsonPath);
+        if (!settingsFile.is_open())
+        {
+            return false;
+        }
+
+        nlohmann::json settingsJson = nlohmann::json::parse(settingsFile, nullptr, false);
+        if (settingsJson.is_discarded() || !LoadFromJson(settingsJson))
+        {
+            std::cerr << "[SETTINGS] Error parsing: " << jsonPath << std::endl;
+            return false;
+        }
+
+        // Best effort, a read only file system just means we parse the json again next boot
+        if (!SaveToSnapshot(snapshotPath, jsonPath))
+        {
+            std::cout << "[SETTINGS] Unable to write settings snapshot: " << snapshotPath << std::endl;
+        }
+
+        return true;
+    }
+
     /// @brief Print the structure contents to console
     void Print() const 
     {
@@ -182,5 +378,111 @@ struct Settings
         std::cout << "\tbroadcastPort:           " << this->broadcastPort           << std::endl;
         std::cout << "\tcommunicationPort:       " << this->communicationPort       << std::endl;
         std::cout << "\tmaximumConnections:      " << this->maximumConnections      << std::endl;
+        std::cout << "\tmulticastGroup:          " << this->multicastGroup          << std::endl;
+        std::cout << "\tmulticastPort:           " << this->multicastPort           << std::endl;
+    }
+
+private:
+    /// @brief Get the write time and size of the json file a snapshot belongs to
+    /// @param jsonPath - in - filepath of the json settings
+    /// @param writeTime - out - write time of the file
+    /// @param size - out - size of the file
+    /// @return - true if the file exists
+    static bool GetJsonStamp(const std::string& jsonPath, int64_t& writeTime, uint64_t& size)
+    {
+        std::error_code ec;
+        auto time = std::filesystem::last_write_time(jsonPath, ec);
+        if (ec)
+        {
+            return false;
+        }
+
+        size = static_cast<uint64_t>(std::filesystem::file_size(jsonPath, ec));
+        writeTime = static_cast<int64_t>(time.time_since_epoch().count());
+        return !ec;
+    }
+
+    /// @brief FNV-1a hash used to detect a corrupt snapshot
+    /// @param data - in - bytes to hash
+    /// @param size - in - number of bytes
+    /// @return - 64 bit hash
+    static uint64_t HashSnapshot(const uint8_t* data, const size_t size)
+    {
+        uint64_t hash = 0xcbf29ce484222325ULL;
+        for (size_t i = 0; i < size; i++)
+        {
+            hash ^= data[i];
+            hash *= 0x100000001b3ULL;
+        }
+        return hash;
+    }
+
+    /// @brief Validate a snapshot against the json stamp and load it
+    /// @param data - in - snapshot contents
+    /// @param size - in - size of the snapshot
+    /// @param expected - in - header holding the current json write time and size
+    /// @return - true if the snapshot was valid and loaded
+    bool ParseSnapshot(const uint8_t* data, const size_t size, const SETTINGS_SNAPSHOT_HEADER& expected)
+    {
+        SETTINGS_SNAPSHOT_HEADER header = { 0 };
+        if (data == nullptr || size < sizeof(header))
+        {
+            return false;
+        }
+        memcpy(&header, data, sizeof(header));
+
+        if (header.magic != SETTINGS_SNAPSHOT_MAGIC || header.version != SETTINGS_SNAPSHOT_VERSION ||
+            header.jsonWriteTime != expected.jsonWriteTime || header.jsonSize != expected.jsonSize ||
+            header.payloadSize != size - sizeof(header))
+        {
+            return false;
+        }
+
+        const uint8_t* payload = data + sizeof(header);
+        if (HashSnapshot(payload, header.payloadSize) != header.payloadHash)
+        {
+            return false;
+        }
+
+        size_t position = 0;
+        int32_t fields[5] = { 0 };
+        if (header.payloadSize < sizeof(fields))
+        {
+            return false;
+        }
+        memcpy(fields, payload, sizeof(fields));
+        position += sizeof(fields);
+
+        std::string strings[5];
+        for (std::string& value : strings)
+        {
+            uint32_t length = 0;
+            if (header.payloadSize - position < sizeof(length))
+            {
+                return false;
+            }
+            memcpy(&length, payload + position, sizeof(length));
+            position += sizeof(length);
+
+            if (header.payloadSize - position < length)
+            {
+                return false;
+            }
+            value.assign(reinterpret_cast<const char*>(payload + position), length);
+            position += length;
+        }
+
+        // Values were validated when the snapshot was written from the json
+        broadcastTimeoutMSec    = fields[0];
+        broadcastPort           = fields[1];
+        communicationPort       = fields[2];
+        maximumConnections      = fields[3];
+        multicastPort           = fields[4];
+        ofsLocation             = std::move(strings[0]);
+        ofsNonWebConfigLocation = std::move(strings[1]);
+        asBuiltLocation         = std::move(strings[2]);
+        sdcardLocation          = std::move(strings[3]);
+        multicastGroup          = std::move(strings[4]);
+        return true;
     }
 };
\ No newline at end of file
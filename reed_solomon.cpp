@@ -0,0 +1,462 @@
+///////////////////////////////////////////////////////////////////////////////
+//! @file		reed_solomon.cpp
+//! @brief		Implementation of the reed solomon classes
+//! @author		Chip Brommer
+///////////////////////////////////////////////////////////////////////////////
+
+///////////////////////////////////////////////////////////////////////////////
+//
+//  Includes:
+//          name                        reason included
+//          --------------------        ---------------------------------------
+#include	"reed_solomon.h"			// Reed solomon classes
+//
+///////////////////////////////////////////////////////////////////////////////
+
+namespace Essentials
+{
+	namespace Utilities
+	{
+		namespace
+		{
+			constexpr uint32_t GF_POLYNOMIAL = 0x11D;	// x^8 + x^4 + x^3 + x^2 + 1, 2 generates the field
+
+			/// @brief Exponent and log tables, the exponents are doubled up so a sum of two logs needs no modulo
+			struct GfTables
+			{
+				std::array<uint8_t, 512>	exp;
+				std::array<uint8_t, 256>	log;
+			};
+
+			constexpr GfTables MakeTables()
+			{
+				GfTables tables = {};
+				uint32_t x = 1;
+				for (uint32_t i = 0; i < 255; i++)
+				{
+					tables.exp[i] = static_cast<uint8_t>(x);
+					tables.exp[i + 255] = static_cast<uint8_t>(x);
+					tables.log[x] = static_cast<uint8_t>(i);
+					x <<= 1;
+					if (x & 0x100)
+					{
+						x ^= GF_POLYNOMIAL;
+					}
+				}
+				tables.exp[510] = tables.exp[0];
+				tables.exp[511] = tables.exp[1];
+				return tables;
+			}
+
+			constexpr GfTables GF_TABLES = MakeTables();
+
+			/// @brief Products of c with every low nibble and every high nibble, c * x is lo[x & 15] ^ hi[x >> 4]
+			void MakeNibbleTables(const uint8_t c, uint8_t* lo, uint8_t* hi)
+			{
+				for (uint8_t i = 0; i < 16; i++)
+				{
+					lo[i] = ReedSolomon::Multiply(c, i);
+					hi[i] = ReedSolomon::Multiply(c, static_cast<uint8_t>(i << 4));
+				}
+			}
+
+			void MultiplyAddTable(uint8_t* dst, const uint8_t* src, const uint8_t* lo, const uint8_t* hi, size_t size)
+			{
+				for (size_t i = 0; i < size; i++)
+				{
+					dst[i] ^= lo[src[i] & 0x0F] ^ hi[src[i] >> 4];
+				}
+			}
+
+#if defined(RS_HAVE_X86)
+#ifndef _MSC_VER
+			__attribute__((target("ssse3")))
+#endif
+			void MultiplyAddSsse3(uint8_t* dst, const uint8_t* src, const uint8_t* lo, const uint8_t* hi, size_t size)
+			{
+				const __m128i tableLo = _mm_loadu_si128(reinterpret_cast<const __m128i*>(lo));
+				const __m128i tableHi = _mm_loadu_si128(reinterpret_cast<const __m128i*>(hi));
+				const __m128i mask = _mm_set1_epi8(0x0F);
+
+				size_t i = 0;
+				for (; i + 16 <= size; i += 16)
+				{
+					__m128i s = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i));
+					__m128i product = _mm_xor_si128(_mm_shuffle_epi8(tableLo, _mm_and_si128(s, mask)),
+						_mm_shuffle_epi8(tableHi, _mm_and_si128(_mm_srli_epi64(s, 4), mask)));
+					__m128i d = _mm_loadu_si128(reinterpret_cast<const __m128i*>(dst + i));
+					_mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i), _mm_xor_si128(d, product));
+				}
+				MultiplyAddTable(dst + i, src + i, lo, hi, size - i);
+			}
+
+#ifndef _MSC_VER
+			__attribute__((target("avx2")))
+#endif
+			void MultiplyAddAvx2(uint8_t* dst, const uint8_t* src, const uint8_t* lo, const uint8_t* hi, size_t size)
+			{
+				const __m256i tableLo = _mm256_broadcastsi128_si256(_mm_loadu_si128(reinterpret_cast<const __m128i*>(lo)));
+				const __m256i tableHi = _mm256_broadcastsi128_si256(_mm_loadu_si128(reinterpret_cast<const __m128i*>(hi)));
+				const __m256i mask = _mm256_set1_epi8(0x0F);
+
+				size_t i = 0;
+				for (; i + 32 <= size; i += 32)
+				{
+					__m256i s = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(src + i));
+					__m256i product = _mm256_xor_si256(_mm256_shuffle_epi8(tableLo, _mm256_and_si256(s, mask)),
+						_mm256_shuffle_epi8(tableHi, _mm256_and_si256(_mm256_srli_epi64(s, 4), mask)));
+					__m256i d = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(dst + i));
+					_mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + i), _mm256_xor_si256(d, product));
+				}
+				MultiplyAddTable(dst + i, src + i, lo, hi, size - i);
+			}
+
+			bool HasAvx2()
+			{
+#ifdef _MSC_VER
+				int info[4] = { 0 };
+				__cpuidex(info, 7, 0);
+				return (info[1] & (1 << 5)) != 0;
+#else
+				return __builtin_cpu_supports("avx2");
+#endif
+			}
+
+			bool HasSsse3()
+			{
+#ifdef _MSC_VER
+				int info[4] = { 0 };
+				__cpuid(info, 1);
+				return (info[2] & (1 << 9)) != 0;
+#else
+				return __builtin_cpu_supports("ssse3");
+#endif
+			}
+#elif defined(RS_HAVE_NEON)
+			void MultiplyAddNeon(uint8_t* dst, const uint8_t* src, const uint8_t* lo, const uint8_t* hi, size_t size)
+			{
+				const uint8x16_t tableLo = vld1q_u8(lo);
+				const uint8x16_t tableHi = vld1q_u8(hi);
+				const uint8x16_t mask = vdupq_n_u8(0x0F);
+
+				size_t i = 0;
+				for (; i + 16 <= size; i += 16)
+				{
+					uint8x16_t s = vld1q_u8(src + i);
+					uint8x16_t product = veorq_u8(vqtbl1q_u8(tableLo, vandq_u8(s, mask)), vqtbl1q_u8(tableHi, vshrq_n_u8(s, 4)));
+					vst1q_u8(dst + i, veorq_u8(vld1q_u8(dst + i), product));
+				}
+				MultiplyAddTable(dst + i, src + i, lo, hi, size - i);
+			}
+#endif
+
+			using MultiplyAddFunction = void(*)(uint8_t*, const uint8_t*, const uint8_t*, const uint8_t*, size_t);
+
+			/// @brief Picks the implementation once, on first use
+			MultiplyAddFunction GetImplementation()
+			{
+#if defined(RS_HAVE_X86)
+				static const MultiplyAddFunction implementation = HasAvx2() ? MultiplyAddAvx2 : HasSsse3() ? MultiplyAddSsse3 : MultiplyAddTable;
+#elif defined(RS_HAVE_NEON)
+				static const MultiplyAddFunction implementation = MultiplyAddNeon;
+#else
+				static const MultiplyAddFunction implementation = MultiplyAddTable;
+#endif
+				return implementation;
+			}
+		}
+
+		uint8_t ReedSolomon::Multiply(const uint8_t a, const uint8_t b)
+		{
+			if (a == 0 || b == 0)
+			{
+				return 0;
+			}
+			return GF_TABLES.exp[GF_TABLES.log[a] + GF_TABLES.log[b]];
+		}
+
+		uint8_t ReedSolomon::Inverse(const uint8_t a)
+		{
+			return GF_TABLES.exp[255 - GF_TABLES.log[a]];
+		}
+
+		uint8_t ReedSolomon::Coefficient(const uint32_t symbolIndex, const uint32_t source)
+		{
+			// Cauchy matrix 1 / (x + y), x the repair index and y the source index never meet, so every
+			// square piece of it can be inverted
+			return Inverse(static_cast<uint8_t>(symbolIndex ^ source));
+		}
+
+		void ReedSolomon::MultiplyAdd(uint8_t* dst, const uint8_t* src, const uint8_t c, const size_t size)
+		{
+			if (c == 0)
+			{
+				return;
+			}
+
+			uint8_t lo[16];
+			uint8_t hi[16];
+			MakeNibbleTables(c, lo, hi);
+			GetImplementation()(dst, src, lo, hi, size);
+		}
+
+		bool ReedSolomon::IsAccelerated()
+		{
+			return GetImplementation() != MultiplyAddTable;
+		}
+
+		int ReedSolomon::Encode(const uint8_t* const* sources, const uint32_t sourceCount, const uint32_t symbolIndex, uint8_t* repair, const size_t symbolSize)
+		{
+			if (sourceCount == 0 || symbolIndex < sourceCount || symbolIndex >= RS_MAX_SYMBOLS)
+			{
+				return -1;
+			}
+
+			memset(repair, 0, symbolSize);
+			for (uint32_t j = 0; j < sourceCount; j++)
+			{
+				MultiplyAdd(repair, sources[j], Coefficient(symbolIndex, j), symbolSize);
+			}
+			return 0;
+		}
+
+		int ReedSolomon::Decode(uint8_t* const* sources, const uint8_t* present, const uint32_t sourceCount,
+			uint8_t* const* repairs, const uint32_t* repairIndexes, const uint32_t repairCount, const size_t symbolSize)
+		{
+			std::vector<uint32_t> missing;
+			for (uint32_t j = 0; j < sourceCount; j++)
+			{
+				if (!present[j])
+				{
+					missing.push_back(j);
+				}
+			}
+
+			const size_t count = missing.size();
+			if (count == 0)
+			{
+				return 0;
+			}
+			if (count > repairCount)
+			{
+				return -1;
+			}
+
+			for (uint32_t r = 0; r < count; r++)
+			{
+				if (repairIndexes[r] < sourceCount || repairIndexes[r] >= RS_MAX_SYMBOLS)
+				{
+					return -1;
+				}
+			}
+
+			// Take what is known out of the repair symbols, leaving the missing sources times their coefficients
+			for (uint32_t r = 0; r < count; r++)
+			{
+				for (uint32_t j = 0; j < sourceCount; j++)
+				{
+					if (present[j])
+					{
+						MultiplyAdd(repairs[r], sources[j], Coefficient(repairIndexes[r], j), symbolSize);
+					}
+				}
+			}
+
+			// Invert the coefficients of the missing sources, Gauss-Jordan on [A | I]
+			std::vector<uint8_t> a(count * count);
+			std::vector<uint8_t> inverse(count * count, 0);
+			for (size_t r = 0; r < count; r++)
+			{
+				for (size_t c = 0; c < count; c++)
+				{
+					a[r * count + c] = Coefficient(repairIndexes[r], missing[c]);
+				}
+				inverse[r * count + r] = 1;
+			}
+
+			for (size_t col = 0; col < count; col++)
+			{
+				size_t pivot = col;
+				while (pivot < count && a[pivot * count + col] == 0)
+				{
+					pivot++;
+				}
+				if (pivot == count)
+				{
+					return -1;
+				}
+
+				if (pivot != col)
+				{
+					for (size_t c = 0; c < count; c++)
+					{
+						std::swap(a[pivot * count + c], a[col * count + c]);
+						std::swap(inverse[pivot * count + c], inverse[col * count + c]);
+					}
+				}
+
+				uint8_t scale = Inverse(a[col * count + col]);
+				for (size_t c = 0; c < count; c++)
+				{
+					a[col * count + c] = Multiply(a[col * count + c], scale);
+					inverse[col * count + c] = Multiply(inverse[col * count + c], scale);
+				}
+
+				for (size_t r = 0; r < count; r++)
+				{
+					uint8_t factor = a[r * count + col];
+					if (r == col || factor == 0)
+					{
+						continue;
+					}
+					for (size_t c = 0; c < count; c++)
+					{
+						a[r * count + c] ^= Multiply(factor, a[col * count + c]);
+						inverse[r * count + c] ^= Multiply(factor, inverse[col * count + c]);
+					}
+				}
+			}
+
+			for (size_t m = 0; m < count; m++)
+			{
+				uint8_t* target = sources[missing[m]];
+				memset(target, 0, symbolSize);
+				for (size_t r = 0; r < count; r++)
+				{
+					MultiplyAdd(target, repairs[r], inverse[m * count + r], symbolSize);
+				}
+			}
+
+			return static_cast<int>(count);
+		}
+
+		FecDecoder::FecDecoder(const size_t maxBlocks, const size_t maxBlockBytes)
+		{
+			mMaxBlocks		= maxBlocks > 0 ? maxBlocks : 1;
+			mMaxBlockBytes	= maxBlockBytes;
+			mTransferId		= 0;
+			mClock			= 0;
+		}
+
+		int FecDecoder::AddSymbol(const uint64_t transferId, const uint64_t blockOffset, const uint32_t symbolSize, const uint32_t sourceCount,
+			const uint32_t symbolIndex, const uint8_t* data, const size_t size, std::vector<FecRecovered>& recovered)
+		{
+			recovered.clear();
+
+			if (symbolSize == 0 || sourceCount == 0 || symbolIndex >= RS_MAX_SYMBOLS || sourceCount >= RS_MAX_SYMBOLS ||
+				size > symbolSize || static_cast<uint64_t>(symbolSize) * sourceCount > mMaxBlockBytes ||
+				(symbolIndex >= sourceCount && size != symbolSize))
+			{
+				return -1;
+			}
+
+			if (transferId != mTransferId)
+			{
+				Reset();
+				mTransferId = transferId;
+			}
+
+			auto found = mBlocks.find(blockOffset);
+			if (found == mBlocks.end())
+			{
+				if (mBlocks.size() >= mMaxBlocks)
+				{
+					auto oldest = mBlocks.begin();
+					for (auto it = mBlocks.begin(); it != mBlocks.end(); ++it)
+					{
+						if (it->second.lastUse < oldest->second.lastUse)
+						{
+							oldest = it;
+						}
+					}
+					mBlocks.erase(oldest);
+				}
+
+				Block& block = mBlocks[blockOffset];
+				block.symbolSize = symbolSize;
+				block.sourceCount = sourceCount;
+				block.sources.assign(static_cast<size_t>(symbolSize) * sourceCount, 0);
+				block.present.assign(sourceCount, 0);
+				block.presentCount = 0;
+				found = mBlocks.find(blockOffset);
+			}
+
+			Block& block = found->second;
+			if (block.symbolSize != symbolSize || block.sourceCount != sourceCount)
+			{
+				return -1;
+			}
+			block.lastUse = ++mClock;
+
+			if (symbolIndex < sourceCount)
+			{
+				if (!block.present[symbolIndex])
+				{
+					memcpy(block.sources.data() + static_cast<size_t>(symbolIndex) * symbolSize, data, size);
+					block.present[symbolIndex] = 1;
+					block.presentCount++;
+				}
+			}
+			else if (block.presentCount + block.repairIndexes.size() < sourceCount &&
+				std::find(block.repairIndexes.begin(), block.repairIndexes.end(), symbolIndex) == block.repairIndexes.end())
+			{
+				block.repairs.insert(block.repairs.end(), data, data + size);
+				block.repairIndexes.push_back(symbolIndex);
+			}
+
+			// Every source arrived by itself, nothing to rebuild
+			if (block.presentCount == sourceCount)
+			{
+				mBlocks.erase(found);
+				return 0;
+			}
+
+			if (block.presentCount + block.repairIndexes.size() < sourceCount)
+			{
+				return 0;
+			}
+
+			std::vector<uint8_t*> sources(sourceCount);
+			for (uint32_t j = 0; j < sourceCount; j++)
+			{
+				sources[j] = block.sources.data() + static_cast<size_t>(j) * symbolSize;
+			}
+			std::vector<uint8_t*> repairs(block.repairIndexes.size());
+			for (size_t r = 0; r < repairs.size(); r++)
+			{
+				repairs[r] = block.repairs.data() + r * symbolSize;
+			}
+
+			int rebuilt = ReedSolomon::Decode(sources.data(), block.present.data(), sourceCount, repairs.data(),
+				block.repairIndexes.data(), static_cast<uint32_t>(block.repairIndexes.size()), symbolSize);
+
+			// The block is finished either way, keep it only as long as the caller needs the data
+			mDecoded = std::move(block);
+			mBlocks.erase(found);
+			if (rebuilt <= 0)
+			{
+				return rebuilt;
+			}
+
+			for (uint32_t j = 0; j < sourceCount; j++)
+			{
+				if (!mDecoded.present[j])
+				{
+					recovered.push_back({ blockOffset, j, mDecoded.sources.data() + static_cast<size_t>(j) * symbolSize });
+				}
+			}
+			return rebuilt;
+		}
+
+		void FecDecoder::Forget(const uint64_t blockOffset)
+		{
+			mBlocks.erase(blockOffset);
+		}
+
+		void FecDecoder::Reset()
+		{
+			mBlocks.clear();
+			mTransferId = 0;
+		}
+	}
+}
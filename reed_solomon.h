@@ -0,0 +1,163 @@
+///////////////////////////////////////////////////////////////////////////////
+//! @file		reed_solomon.h
+//! @brief		Systematic Reed-Solomon erasure code over GF(256) and a block decoder for it
+//! @author		Chip Brommer
+///////////////////////////////////////////////////////////////////////////////
+#pragma once
+///////////////////////////////////////////////////////////////////////////////
+//
+//  Includes:
+//          name                        reason included
+//          --------------------        ---------------------------------------
+#if !defined(RS_PORTABLE_ONLY) && (defined(__x86_64__) || defined(_M_X64))
+#ifdef _MSC_VER
+#include <intrin.h>						// __cpuidex, SSSE3 and AVX2 intrinsics
+#else
+#include <immintrin.h>					// SSSE3 and AVX2 intrinsics
+#endif
+#define RS_HAVE_X86
+#elif !defined(RS_PORTABLE_ONLY) && defined(__aarch64__)
+#include <arm_neon.h>					// vqtbl1q_u8
+#define RS_HAVE_NEON
+#endif
+#include <cstdint>						// Standard integer types
+#include <cstddef>						// size_t
+#include <cstring>						// memcpy, memset
+#include <array>						// Field tables
+#include <vector>						// Block buffers
+#include <map>							// Blocks being collected
+#include <algorithm>					// std::min
+//
+//	Defines:
+//          name                        reason defined
+//          --------------------        ---------------------------------------
+#ifndef     CPP_REED_SOLOMON			// Define the cpp reed solomon classes.
+#define     CPP_REED_SOLOMON
+//
+///////////////////////////////////////////////////////////////////////////////
+
+namespace Essentials
+{
+	namespace Utilities
+	{
+		constexpr static uint32_t	RS_MAX_SYMBOLS				= 256;				// Source and repair symbols in one block
+		constexpr static size_t		FEC_DECODER_DEFAULT_BLOCKS	= 4;				// Blocks collected at once before the oldest is dropped
+		constexpr static size_t		FEC_DECODER_MAX_BLOCK_BYTES	= 4 * 1024 * 1024;	// Largest block the decoder will hold
+
+		/// @brief Erasure code over GF(256). Symbols 0 to sourceCount-1 of a block are the data itself,
+		/// symbol i from sourceCount up is a repair symbol whose coefficients are a row of a Cauchy
+		/// matrix, so any sourceCount of the symbols rebuild the rest. The inner loop multiplies a whole
+		/// symbol by a constant with 16 entry nibble tables, run through PSHUFB (SSSE3 or AVX2) or TBL
+		/// (NEON) when the CPU has them. Define RS_PORTABLE_ONLY to always use the plain tables.
+		class ReedSolomon
+		{
+		public:
+			/// @brief Builds a repair symbol
+			/// @param sources -[in]- sourceCount source symbols, each symbolSize bytes
+			/// @param sourceCount -[in]- Number of source symbols in the block
+			/// @param symbolIndex -[in]- Which repair symbol, from sourceCount to RS_MAX_SYMBOLS-1
+			/// @param repair -[out]- symbolSize bytes of repair symbol
+			/// @param symbolSize -[in]- Bytes per symbol
+			/// @return 0 if successful, -1 if the indexes are out of range
+			static int Encode(const uint8_t* const* sources, const uint32_t sourceCount, const uint32_t symbolIndex, uint8_t* repair, const size_t symbolSize);
+
+			/// @brief Rebuilds missing source symbols
+			/// @param sources -[in/out]- sourceCount buffers of symbolSize bytes, the missing ones are filled in
+			/// @param present -[in]- Per source symbol, non zero if its buffer holds it
+			/// @param sourceCount -[in]- Number of source symbols in the block
+			/// @param repairs -[in]- Repair symbols, used as scratch and left changed
+			/// @param repairIndexes -[in]- Symbol index of each repair symbol
+			/// @param repairCount -[in]- Number of repair symbols, at least as many as are missing
+			/// @param symbolSize -[in]- Bytes per symbol
+			/// @return number of symbols rebuilt, -1 if too few repair symbols or a bad index
+			static int Decode(uint8_t* const* sources, const uint8_t* present, const uint32_t sourceCount,
+				uint8_t* const* repairs, const uint32_t* repairIndexes, const uint32_t repairCount, const size_t symbolSize);
+
+			/// @brief Adds a multiple of one region into another, dst += c * src in GF(256)
+			/// @param dst -[in/out]- Region added into
+			/// @param src -[in]- Region multiplied
+			/// @param c -[in]- Constant
+			/// @param size -[in]- Number of bytes
+			static void MultiplyAdd(uint8_t* dst, const uint8_t* src, const uint8_t c, const size_t size);
+
+			/// @brief Multiplies two field elements
+			static uint8_t Multiply(const uint8_t a, const uint8_t b);
+
+			/// @brief Get the multiplicative inverse of a non zero field element
+			static uint8_t Inverse(const uint8_t a);
+
+			/// @brief Check if the region multiply is using SIMD table lookups
+			/// @return true if accelerated
+			static bool IsAccelerated();
+
+		protected:
+		private:
+			/// @brief Coefficient of source symbol 'source' in repair symbol 'symbolIndex'
+			static uint8_t Coefficient(const uint32_t symbolIndex, const uint32_t source);
+		};
+
+		/// @brief A source symbol FecDecoder rebuilt
+		struct FecRecovered
+		{
+			uint64_t		blockOffset;	// Block it belongs to
+			uint32_t		index;			// Source symbol index within the block
+			const uint8_t*	data;			// symbolSize bytes, valid until the next call to the decoder
+		};
+
+		/// @brief Collects the symbols of erasure coded blocks as they arrive in any order and rebuilds
+		/// the missing source symbols of a block once it has as many symbols as it has sources. A few
+		/// blocks are held at once, the one touched longest ago is dropped to make room.
+		class FecDecoder
+		{
+		public:
+			/// @brief Constructor
+			/// @param maxBlocks -[in]- Blocks held at once
+			/// @param maxBlockBytes -[in]- Largest block accepted, sourceCount times symbolSize
+			FecDecoder(const size_t maxBlocks = FEC_DECODER_DEFAULT_BLOCKS, const size_t maxBlockBytes = FEC_DECODER_MAX_BLOCK_BYTES);
+
+			/// @brief Takes in one symbol
+			/// @param transferId -[in]- Transfer the symbol belongs to, a new one drops every block held
+			/// @param blockOffset -[in]- Names the block
+			/// @param symbolSize -[in]- Bytes per symbol in the block
+			/// @param sourceCount -[in]- Source symbols in the block
+			/// @param symbolIndex -[in]- Index of this symbol, repair symbols from sourceCount up
+			/// @param data -[in]- Symbol, a short source symbol is zero padded
+			/// @param size -[in]- Number of bytes, no more than symbolSize
+			/// @param recovered -[out]- Source symbols rebuilt by this one
+			/// @return number rebuilt, 0 if none yet, -1 if the symbol doesn't fit the block
+			int AddSymbol(const uint64_t transferId, const uint64_t blockOffset, const uint32_t symbolSize, const uint32_t sourceCount,
+				const uint32_t symbolIndex, const uint8_t* data, const size_t size, std::vector<FecRecovered>& recovered);
+
+			/// @brief Drops a block, e.g. once everything in it is known to have arrived
+			/// @param blockOffset -[in]- Names the block
+			void Forget(const uint64_t blockOffset);
+
+			/// @brief Drops every block
+			void Reset();
+
+		protected:
+		private:
+			/// @brief Symbols of one block collected so far
+			struct Block
+			{
+				uint32_t				symbolSize;		// Bytes per symbol
+				uint32_t				sourceCount;	// Source symbols in the block
+				std::vector<uint8_t>	sources;		// Source symbols, sourceCount * symbolSize
+				std::vector<uint8_t>	present;		// Per source symbol, it has arrived
+				uint32_t				presentCount;	// Source symbols that have arrived
+				std::vector<uint8_t>	repairs;		// Repair symbols, packed
+				std::vector<uint32_t>	repairIndexes;	// Symbol index of each repair symbol
+				uint64_t				lastUse;		// mClock when last touched
+			};
+
+			size_t						mMaxBlocks;		// Blocks held at once
+			size_t						mMaxBlockBytes;	// Largest block accepted
+			uint64_t					mTransferId;	// Transfer the blocks belong to
+			uint64_t					mClock;			// Counts calls, orders blocks by use
+			std::map<uint64_t, Block>	mBlocks;		// Blocks being collected, by offset
+			Block						mDecoded;		// Last block rebuilt, backs FecRecovered::data
+		};
+	}
+}
+
+#endif		// CPP_REED_SOLOMON
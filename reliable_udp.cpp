@@ -0,0 +1,744 @@
+///////////////////////////////////////////////////////////////////////////////
+//! @file		reliable_udp.cpp
+//! @brief		Implementation of the reliable udp classes
+//! @author		Chip Brommer
+///////////////////////////////////////////////////////////////////////////////
+
+///////////////////////////////////////////////////////////////////////////////
+//
+//  Includes:
+//          name                        reason included
+//          --------------------        ---------------------------------------
+#include	"reliable_udp.h"			// Reliable udp classes
+#include	<thread>					// Short pacing sleeps
+//
+///////////////////////////////////////////////////////////////////////////////
+
+namespace Essentials
+{
+	namespace Communications
+	{
+		/// @brief Get a monotonic clock for pacing and round trip times
+		/// @return microseconds
+		static uint64_t NowUSec()
+		{
+			return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now().time_since_epoch()).count());
+		}
+
+		ReliableSender::ReliableSender(UDP_Client& udp, const std::string& ipAddress, const int16_t port, const uint32_t chunkSize) : mUdp(udp)
+		{
+			mLastError			= ReliableUdpError::NONE;
+			mIpAddress			= ipAddress;
+			mPort				= port;
+			mChunkSize			= chunkSize;
+			mData				= nullptr;
+			mSize				= 0;
+			mTransferId			= 0;
+			mChunkCount			= 0;
+			mCumulative			= 0;
+			mAckedCount			= 0;
+			mNextNew			= 0;
+			mSequence			= 0;
+			mRate				= RUDP_INITIAL_RATE;
+			mTokens				= 0;
+			mLastRefillUSec		= 0;
+			mLastProbeUSec		= 0;
+			mRttUSec			= 0;
+			mRttVarUSec			= 0;
+			mMinRttUSec			= 0;
+			mLossRate			= 0;
+			mLastAdjustUSec		= 0;
+			mIntervalSent		= 0;
+			mIntervalReceived	= 0;
+			mStartup			= true;
+			mLastHighest		= 0;
+			mLastReceived		= 0;
+			mLastFeedbackUSec	= 0;
+			mRetransmitCount	= 0;
+			mAccepted			= false;
+			mBatchBytes			= 0;
+			mFeedback.resize(sizeof(RudpFeedbackHeader) + RUDP_NACK_WINDOW_WORDS * sizeof(uint64_t) + RUDP_MAX_RESULT_SIZE + 1);
+		}
+
+		int ReliableSender::Send(const uint64_t transferId, const uint8_t* data, const uint64_t size)
+		{
+			if (data == nullptr || size == 0 || mChunkSize == 0 || mChunkSize > RUDP_MAX_CHUNK_SIZE ||
+				sizeof(RudpDataHeader) + mChunkSize > RUDP_MAX_PACKET_SIZE || (size + mChunkSize - 1) / mChunkSize > UINT32_MAX)
+			{
+				mLastError = ReliableUdpError::BAD_ARGUMENT;
+				return -1;
+			}
+
+			mData				= data;
+			mSize				= size;
+			mTransferId			= transferId;
+			mChunkCount			= static_cast<uint32_t>((size + mChunkSize - 1) / mChunkSize);
+			mAcked.assign(mChunkCount, 0);
+			mSentUSec.assign(mChunkCount, 0);
+			mQueued.assign(mChunkCount, 0);
+			mRetransmits.clear();
+			mPacket.resize((sizeof(RudpDataHeader) + mChunkSize) * RUDP_SEND_BATCH);
+			mBatch.clear();
+			mBatchBytes			= 0;
+			mCumulative			= 0;
+			mAckedCount			= 0;
+			mNextNew			= 0;
+			mLastHighest		= mSequence - 1;
+			mLastReceived		= 0;
+			mIntervalSent		= 0;
+			mIntervalReceived	= 0;
+			mRetransmitCount	= 0;
+			mResult.clear();
+			mAccepted			= false;
+
+			const uint64_t start = NowUSec();
+			const double packetCost = static_cast<double>(sizeof(RudpDataHeader) + mChunkSize);
+			mTokens				= packetCost;
+			mLastRefillUSec		= start;
+			mLastProbeUSec		= start;
+			mLastFeedbackUSec	= start;
+			mLastAdjustUSec		= start;
+
+			while (true)
+			{
+				uint64_t now = NowUSec();
+				if (now - mLastFeedbackUSec > RUDP_IDLE_TIMEOUT_USEC)
+				{
+					mLastError = ReliableUdpError::TIMED_OUT;
+					return -1;
+				}
+
+				// Short bursts are allowed so the pacer doesn't depend on sleeping accurately
+				double burst = std::max(packetCost * RUDP_MAX_BURST, mRate * RUDP_QUEUE_MARGIN_USEC / 1e6);
+				mTokens = std::min(burst, mTokens + mRate * static_cast<double>(now - mLastRefillUSec) / 1e6);
+				mLastRefillUSec = now;
+
+				bool idle = false;
+				bool blocked = false;
+				while (mTokens >= packetCost)
+				{
+					uint8_t flags = 0;
+					int64_t index = NextChunk(now, flags);
+					if (index < 0)
+					{
+						idle = true;
+						break;
+					}
+
+					BuildChunk(static_cast<uint32_t>(index), flags, now);
+					mTokens -= packetCost;
+
+					// Only the last chunk of the transfer is short, a segmented send has to end with it
+					if ((mBatch.size() == RUDP_SEND_BATCH || index == mChunkCount - 1) && SendBatch(now) < 0)
+					{
+						blocked = true;
+						break;
+					}
+				}
+
+				if (!blocked && !mBatch.empty() && SendBatch(now) < 0)
+				{
+					blocked = true;
+				}
+
+				// With nothing to send, sleep until the receiver answers or the retransmit timeout sweeps
+				int32_t waitMSec = blocked ? 1 : 0;
+				if (idle)
+				{
+					waitMSec = static_cast<int32_t>(std::max<uint64_t>(1, GetTimeoutUSec() / 1000));
+				}
+				else if (mTokens < packetCost)
+				{
+					uint64_t waitUSec = static_cast<uint64_t>((packetCost - mTokens) * 1e6 / mRate);
+					if (waitUSec < 1000)
+					{
+						std::this_thread::sleep_for(std::chrono::microseconds(waitUSec));
+					}
+					else
+					{
+						waitMSec = static_cast<int32_t>(waitUSec / 1000);
+					}
+				}
+
+				int rtn = ReadFeedback(waitMSec);
+				if (rtn != 0)
+				{
+					return rtn > 0 ? 0 : -1;
+				}
+			}
+		}
+
+		int64_t ReliableSender::NextChunk(const uint64_t now, uint8_t& flags)
+		{
+			int64_t index = -1;
+			while (index < 0 && !mRetransmits.empty())
+			{
+				uint32_t candidate = mRetransmits.front();
+				mRetransmits.pop_front();
+				mQueued[candidate] = 0;
+				if (!mAcked[candidate])
+				{
+					index = candidate;
+				}
+			}
+
+			if (index < 0 && mNextNew < mChunkCount)
+			{
+				index = mNextNew++;
+			}
+
+			// Sweep for chunks whose feedback never came, which also covers a lost tail or a lost DONE
+			if (index < 0 && now - mLastProbeUSec >= GetTimeoutUSec())
+			{
+				mLastProbeUSec = now;
+				uint64_t timeout = GetTimeoutUSec();
+
+				if (mAckedCount == mChunkCount)
+				{
+					index = mChunkCount - 1;
+				}
+				else
+				{
+					for (uint32_t i = mCumulative; i < mChunkCount; i++)
+					{
+						if (!mAcked[i] && !mQueued[i] && now - mSentUSec[i] >= timeout)
+						{
+							mQueued[i] = 1;
+							mRetransmits.push_back(i);
+						}
+					}
+
+					if (!mRetransmits.empty())
+					{
+						index = mRetransmits.front();
+						mRetransmits.pop_front();
+						mQueued[index] = 0;
+					}
+				}
+			}
+
+			// The last thing in hand asks for feedback rather than waiting for the receiver's timer
+			if (index >= 0 && mRetransmits.empty() && mNextNew >= mChunkCount)
+			{
+				flags |= RUDP_FLAG_POLL;
+			}
+
+			return index;
+		}
+
+		void ReliableSender::BuildChunk(const uint32_t index, const uint8_t flags, const uint64_t now)
+		{
+			uint64_t offset = static_cast<uint64_t>(index) * mChunkSize;
+			uint32_t length = static_cast<uint32_t>(std::min<uint64_t>(mChunkSize, mSize - offset));
+
+			RudpDataHeader header = { 0 };
+			header.magic		= RUDP_MAGIC;
+			header.type			= static_cast<uint8_t>(RudpPacketType::DATA);
+			header.flags		= flags;
+			header.length		= length;
+			header.chunkSize	= mChunkSize;
+			header.chunkIndex	= index;
+			header.sequence		= mSequence + static_cast<uint32_t>(mBatch.size());
+			header.transferId	= mTransferId;
+			header.totalSize	= mSize;
+			header.sendTimeUSec	= now;
+
+			uint8_t* packet = mPacket.data() + mBatch.size() * (sizeof(header) + mChunkSize);
+			memcpy(packet, &header, sizeof(header));
+			memcpy(packet + sizeof(header), mData + offset, length);
+
+			// Held like a queued chunk until it goes, so the timeout sweep doesn't pick it up a second time
+			mQueued[index] = 1;
+			mBatch.push_back(index);
+			mBatchBytes = static_cast<uint32_t>(packet - mPacket.data() + sizeof(header) + length);
+		}
+
+		int ReliableSender::SendBatch(const uint64_t now)
+		{
+			const uint32_t count = static_cast<uint32_t>(mBatch.size());
+			int32_t sent = mUdp.SendUnicastSegments(mPacket.data(), mBatchBytes, static_cast<uint32_t>(sizeof(RudpDataHeader) + mChunkSize), mIpAddress, mPort);
+			if (sent < 0)
+			{
+				mLastError = ReliableUdpError::SEND_FAILED;
+				sent = 0;
+			}
+
+			for (uint32_t i = 0; i < static_cast<uint32_t>(sent); i++)
+			{
+				mQueued[mBatch[i]] = 0;
+				if (mSentUSec[mBatch[i]] != 0)
+				{
+					mRetransmitCount++;
+				}
+				mSentUSec[mBatch[i]] = now;
+			}
+			mSequence += static_cast<uint32_t>(sent);
+
+			// A full socket buffer is the same as a lost packet, what didn't go goes to the front of the queue in
+			// order and is numbered again when it does
+			for (uint32_t i = count; i > static_cast<uint32_t>(sent); i--)
+			{
+				mRetransmits.push_front(mBatch[i - 1]);
+			}
+			mTokens += static_cast<double>(count - sent) * (sizeof(RudpDataHeader) + mChunkSize);
+
+			mBatch.clear();
+			mBatchBytes = 0;
+			return static_cast<uint32_t>(sent) == count ? 0 : -1;
+		}
+
+		int ReliableSender::ReadFeedback(const int32_t waitMSec)
+		{
+			ReadySocket ready[1];
+			int32_t numReady = mUdp.WaitForReadable(ready, 1, waitMSec);
+			if (numReady < 0)
+			{
+				mLastError = ReliableUdpError::RECEIVE_FAILED;
+				return -1;
+			}
+
+			while (numReady > 0)
+			{
+				int32_t size = mUdp.ReceiveUnicast(mFeedback.data(), static_cast<uint32_t>(mFeedback.size()));
+				if (size < 0)
+				{
+					mLastError = ReliableUdpError::RECEIVE_FAILED;
+					return -1;
+				}
+				if (size == 0)
+				{
+					break;
+				}
+
+				int rtn = HandleFeedback(mFeedback.data(), static_cast<size_t>(size), NowUSec());
+				if (rtn != 0)
+				{
+					return rtn;
+				}
+			}
+
+			return 0;
+		}
+
+		int ReliableSender::HandleFeedback(const uint8_t* packet, const size_t size, const uint64_t now)
+		{
+			RudpFeedbackHeader feedback = { 0 };
+			if (size < sizeof(feedback))
+			{
+				return 0;
+			}
+			memcpy(&feedback, packet, sizeof(feedback));
+
+			if (feedback.magic != RUDP_MAGIC || feedback.transferId != mTransferId)
+			{
+				return 0;
+			}
+			mLastFeedbackUSec = now;
+
+			switch (static_cast<RudpPacketType>(feedback.type))
+			{
+			case RudpPacketType::DONE:
+				if (size != sizeof(feedback) + feedback.resultSize)
+				{
+					return 0;
+				}
+				mResult.assign(reinterpret_cast<const char*>(packet + sizeof(feedback)), feedback.resultSize);
+				mAccepted = (feedback.flags & RUDP_FLAG_OK) != 0;
+				if (!mAccepted)
+				{
+					mLastError = ReliableUdpError::REJECTED;
+					return -1;
+				}
+				return 1;
+			case RudpPacketType::ABORT:
+				mLastError = ReliableUdpError::REJECTED;
+				return -1;
+			case RudpPacketType::FEEDBACK:
+				break;
+			default:
+				return 0;
+			}
+
+			if (feedback.bitmapWords > RUDP_NACK_WINDOW_WORDS || size != sizeof(feedback) + feedback.bitmapWords * sizeof(uint64_t) ||
+				feedback.cumulative > mChunkCount || feedback.highestChunk > mChunkCount)
+			{
+				return 0;
+			}
+
+			// Loss is what the packet numbers skipped over that never arrived, repeats of a chunk count too
+			uint32_t sent = feedback.highestSequence - mLastHighest;
+			if (sent > 0 && sent < UINT32_MAX / 2)
+			{
+				mIntervalSent += sent;
+				mIntervalReceived += feedback.packetsReceived - mLastReceived;
+				mLastHighest = feedback.highestSequence;
+				mLastReceived = feedback.packetsReceived;
+			}
+
+			if (feedback.echoTimeUSec != 0 && feedback.echoTimeUSec <= now)
+			{
+				uint64_t rtt = now - feedback.echoTimeUSec;
+				AdjustRate(rtt > feedback.holdUSec ? rtt - feedback.holdUSec : 1, now);
+			}
+
+			while (mCumulative < feedback.cumulative)
+			{
+				Acknowledge(mCumulative++);
+			}
+
+			// A chunk is only resent if it went out before the packet being echoed, otherwise the receiver
+			// may simply not have seen the copy already on its way
+			uint64_t words[RUDP_NACK_WINDOW_WORDS] = { 0 };
+			memcpy(words, packet + sizeof(feedback), feedback.bitmapWords * sizeof(uint64_t));
+
+			uint32_t end = std::min<uint64_t>(feedback.highestChunk, static_cast<uint64_t>(feedback.cumulative) + feedback.bitmapWords * 64);
+			for (uint32_t i = feedback.cumulative; i < end; i++)
+			{
+				uint32_t bit = i - feedback.cumulative;
+				if ((words[bit / 64] >> (bit % 64)) & 1)
+				{
+					if (!mAcked[i] && !mQueued[i] && mSentUSec[i] != 0 && mSentUSec[i] < feedback.echoTimeUSec)
+					{
+						mQueued[i] = 1;
+						mRetransmits.push_back(i);
+					}
+				}
+				else
+				{
+					Acknowledge(i);
+				}
+			}
+
+			return 0;
+		}
+
+		void ReliableSender::Acknowledge(const uint32_t index)
+		{
+			if (!mAcked[index])
+			{
+				mAcked[index] = 1;
+				mAckedCount++;
+			}
+
+			while (mCumulative < mChunkCount && mAcked[mCumulative])
+			{
+				mCumulative++;
+			}
+		}
+
+		void ReliableSender::AdjustRate(const uint64_t rttSample, const uint64_t now)
+		{
+			if (mRttUSec == 0)
+			{
+				mRttUSec = rttSample;
+				mRttVarUSec = rttSample / 2;
+				mMinRttUSec = rttSample;
+			}
+			else
+			{
+				uint64_t deviation = rttSample > mRttUSec ? rttSample - mRttUSec : mRttUSec - rttSample;
+				mRttVarUSec = (mRttVarUSec * 3 + deviation) / 4;
+				mRttUSec = (mRttUSec * 7 + rttSample) / 8;
+				mMinRttUSec = std::min(mMinRttUSec, rttSample);
+			}
+
+			// Judged over at least a round trip, so one burst of loss is weighed against everything around it
+			if (now - mLastAdjustUSec < std::max(mRttUSec, RUDP_MIN_ADJUST_USEC))
+			{
+				return;
+			}
+			mLastAdjustUSec = now;
+
+			// A handful of packets at a low rate says little, the count carries over until there are enough
+			if (mIntervalSent >= RUDP_LOSS_SAMPLE_PACKETS)
+			{
+				double sample = 1.0 - std::min(1.0, static_cast<double>(mIntervalReceived) / mIntervalSent);
+				mLossRate = (mLossRate + sample) / 2;
+				mIntervalSent = 0;
+				mIntervalReceived = 0;
+			}
+
+			// A growing queue or heavy loss means the path is full, light loss alone is the link
+			bool queueing = static_cast<double>(mRttUSec) > mMinRttUSec * RUDP_QUEUE_FACTOR + RUDP_QUEUE_MARGIN_USEC;
+			if (queueing || mLossRate > RUDP_LOSS_THRESHOLD)
+			{
+				mRate = std::max(RUDP_MIN_RATE, mRate * RUDP_RATE_DECREASE);
+				mStartup = false;
+			}
+			else
+			{
+				mRate = std::min(RUDP_MAX_RATE, mRate * (mStartup ? RUDP_STARTUP_INCREASE : RUDP_RATE_INCREASE));
+			}
+		}
+
+		uint64_t ReliableSender::GetTimeoutUSec() const
+		{
+			// Before the first sample, assume a slow link
+			if (mRttUSec == 0)
+			{
+				return 200000;
+			}
+			return std::max(mRttUSec + mRttVarUSec * 4, RUDP_MIN_TIMEOUT_USEC);
+		}
+
+		const std::string& ReliableSender::GetResult() const
+		{
+			return mResult;
+		}
+
+		double ReliableSender::GetRate() const
+		{
+			return mRate;
+		}
+
+		uint64_t ReliableSender::GetRttUSec() const
+		{
+			return mRttUSec;
+		}
+
+		double ReliableSender::GetLossRate() const
+		{
+			return mLossRate;
+		}
+
+		uint64_t ReliableSender::GetRetransmitCount() const
+		{
+			return mRetransmitCount;
+		}
+
+		std::string ReliableSender::GetLastError()
+		{
+			return ReliableUdpErrorMap[mLastError];
+		}
+
+		ReliableReceiver::ReliableReceiver(const ChunkHandler& onChunk, const CompleteHandler& onComplete, const uint64_t maxTotalSize)
+		{
+			mOnChunk				= onChunk;
+			mOnComplete				= onComplete;
+			mMaxTotalSize			= maxTotalSize;
+			mLastDataUSec			= 0;
+			mActive					= false;
+			mComplete				= false;
+			mAccepted				= false;
+			mAborted				= false;
+			mTransferId				= 0;
+			mTotalSize				= 0;
+			mChunkSize				= 0;
+			mChunkCount				= 0;
+			mReceivedCount			= 0;
+			mCumulative				= 0;
+			mHighestChunk			= 0;
+			mHighestSequence		= 0;
+			mPacketsReceived		= 0;
+			mPacketsSinceFeedback	= 0;
+			mLastFeedbackUSec		= 0;
+		}
+
+		bool ReliableReceiver::IsDataPacket(const uint8_t* data, const size_t size)
+		{
+			RudpDataHeader header = { 0 };
+			if (data == nullptr || size < sizeof(header))
+			{
+				return false;
+			}
+			memcpy(&header, data, sizeof(header));
+
+			return header.magic == RUDP_MAGIC && header.type == static_cast<uint8_t>(RudpPacketType::DATA);
+		}
+
+		int ReliableReceiver::HandleDatagram(const Endpoint& sender, const uint8_t* data, const size_t size, std::string& reply)
+		{
+			const uint64_t arrival = NowUSec();
+
+			if (!IsDataPacket(data, size))
+			{
+				return -1;
+			}
+
+			RudpDataHeader header = { 0 };
+			memcpy(&header, data, sizeof(header));
+
+			if (size != sizeof(header) + header.length)
+			{
+				return -1;
+			}
+
+			bool ours = mActive && header.transferId == mTransferId && sender.ipAddress == mSender.ipAddress && sender.port == mSender.port;
+			if (!ours)
+			{
+				// A transfer still running keeps the receiver until it finishes or its sender goes quiet
+				bool busy = mActive && !mComplete && !mAborted && arrival - mLastDataUSec < RUDP_RECEIVER_IDLE_USEC;
+				if (busy || !IsAcceptable(header))
+				{
+					return -1;
+				}
+				Reset(sender, header);
+			}
+			else if (header.totalSize != mTotalSize || header.chunkSize != mChunkSize)
+			{
+				return -1;
+			}
+
+			// Only the last chunk may be short
+			uint64_t offset = static_cast<uint64_t>(header.chunkIndex) * mChunkSize;
+			if (header.chunkIndex >= mChunkCount || header.length != std::min<uint64_t>(mChunkSize, mTotalSize - offset))
+			{
+				return -1;
+			}
+
+			mLastDataUSec = arrival;
+
+			if (mAborted)
+			{
+				BuildFinal(reply, RudpPacketType::ABORT);
+				return 1;
+			}
+
+			if (mComplete)
+			{
+				BuildFinal(reply, RudpPacketType::DONE);
+				return 1;
+			}
+
+			mPacketsReceived++;
+			mPacketsSinceFeedback++;
+			if (header.sequence - mHighestSequence < UINT32_MAX / 2)
+			{
+				mHighestSequence = header.sequence;
+			}
+
+			// A chunk past a hole means the hole is probably a loss, say so now rather than at the next timer
+			bool newGap = header.chunkIndex > mHighestChunk;
+			mHighestChunk = std::max(mHighestChunk, header.chunkIndex + 1);
+
+			if (!HasChunk(header.chunkIndex))
+			{
+				if (mOnChunk && mOnChunk(mTransferId, mTotalSize, offset, data + sizeof(header), header.length) < 0)
+				{
+					mAborted = true;
+					BuildFinal(reply, RudpPacketType::ABORT);
+					return 1;
+				}
+
+				mReceived[header.chunkIndex / 64] |= 1ull << (header.chunkIndex % 64);
+				mReceivedCount++;
+				while (mCumulative < mChunkCount && HasChunk(mCumulative))
+				{
+					mCumulative++;
+				}
+			}
+
+			if (mReceivedCount == mChunkCount)
+			{
+				mComplete = true;
+				mResult.clear();
+				mAccepted = !mOnComplete || mOnComplete(mTransferId, mResult) == 0;
+				if (mResult.size() > RUDP_MAX_RESULT_SIZE)
+				{
+					mResult.resize(RUDP_MAX_RESULT_SIZE);
+				}
+				BuildFinal(reply, RudpPacketType::DONE);
+				return 1;
+			}
+
+			uint64_t now = NowUSec();
+			if ((header.flags & RUDP_FLAG_POLL) || newGap || mPacketsSinceFeedback >= RUDP_FEEDBACK_PACKETS ||
+				now - mLastFeedbackUSec >= RUDP_FEEDBACK_INTERVAL_USEC)
+			{
+				BuildFeedback(reply, header.sendTimeUSec, arrival);
+				return 1;
+			}
+
+			return 0;
+		}
+
+		bool ReliableReceiver::IsAcceptable(const RudpDataHeader& header) const
+		{
+			// Tiny chunks would make the chunk bitmap huge, they are only allowed when the whole transfer fits in one
+			if (header.totalSize == 0 || header.totalSize > mMaxTotalSize || header.chunkSize > RUDP_MAX_CHUNK_SIZE ||
+				header.chunkSize == 0 || (header.chunkSize < RUDP_MIN_CHUNK_SIZE && header.totalSize > header.chunkSize))
+			{
+				return false;
+			}
+
+			return (header.totalSize + header.chunkSize - 1) / header.chunkSize <= UINT32_MAX;
+		}
+
+		void ReliableReceiver::Reset(const Endpoint& sender, const RudpDataHeader& header)
+		{
+			mActive					= true;
+			mSender					= sender;
+			mLastDataUSec			= NowUSec();
+			mComplete				= false;
+			mAccepted				= false;
+			mAborted				= false;
+			mTransferId				= header.transferId;
+			mTotalSize				= header.totalSize;
+			mChunkSize				= header.chunkSize;
+			mChunkCount				= static_cast<uint32_t>((header.totalSize + header.chunkSize - 1) / header.chunkSize);
+			mReceived.assign((static_cast<size_t>(mChunkCount) + 63) / 64, 0);
+			mReceivedCount			= 0;
+			mCumulative				= 0;
+			mHighestChunk			= 0;
+			mHighestSequence		= header.sequence;
+			mPacketsReceived		= 0;
+			mPacketsSinceFeedback	= 0;
+			mLastFeedbackUSec		= NowUSec();
+			mResult.clear();
+		}
+
+		void ReliableReceiver::BuildFeedback(std::string& reply, const uint64_t echoTimeUSec, const uint64_t arrivalUSec)
+		{
+			uint64_t words[RUDP_NACK_WINDOW_WORDS] = { 0 };
+			uint32_t span = std::min<uint32_t>(mHighestChunk - mCumulative, RUDP_NACK_WINDOW_WORDS * 64);
+			for (uint32_t i = 0; i < span; i++)
+			{
+				if (!HasChunk(mCumulative + i))
+				{
+					words[i / 64] |= 1ull << (i % 64);
+				}
+			}
+
+			uint64_t now = NowUSec();
+			RudpFeedbackHeader feedback = { 0 };
+			feedback.magic				= RUDP_MAGIC;
+			feedback.type				= static_cast<uint8_t>(RudpPacketType::FEEDBACK);
+			feedback.bitmapWords		= static_cast<uint8_t>((span + 63) / 64);
+			feedback.cumulative			= mCumulative;
+			feedback.highestChunk		= mHighestChunk;
+			feedback.highestSequence	= mHighestSequence;
+			feedback.packetsReceived	= mPacketsReceived;
+			feedback.holdUSec			= static_cast<uint32_t>(std::min<uint64_t>(now - arrivalUSec, UINT32_MAX));
+			feedback.transferId			= mTransferId;
+			feedback.echoTimeUSec		= echoTimeUSec;
+
+			reply.assign(reinterpret_cast<const char*>(&feedback), sizeof(feedback));
+			reply.append(reinterpret_cast<const char*>(words), feedback.bitmapWords * sizeof(uint64_t));
+
+			mPacketsSinceFeedback = 0;
+			mLastFeedbackUSec = now;
+		}
+
+		void ReliableReceiver::BuildFinal(std::string& reply, const RudpPacketType type)
+		{
+			RudpFeedbackHeader header = { 0 };
+			header.magic			= RUDP_MAGIC;
+			header.type				= static_cast<uint8_t>(type);
+			header.flags			= (type == RudpPacketType::DONE && mAccepted) ? RUDP_FLAG_OK : 0;
+			header.resultSize		= type == RudpPacketType::DONE ? static_cast<uint8_t>(mResult.size()) : 0;
+			header.cumulative		= mCumulative;
+			header.highestChunk		= mHighestChunk;
+			header.highestSequence	= mHighestSequence;
+			header.packetsReceived	= mPacketsReceived;
+			header.transferId		= mTransferId;
+
+			reply.assign(reinterpret_cast<const char*>(&header), sizeof(header));
+			reply.append(mResult.data(), header.resultSize);
+		}
+
+		bool ReliableReceiver::HasChunk(const uint32_t index) const
+		{
+			return (mReceived[index / 64] >> (index % 64)) & 1;
+		}
+	}
+}
@@ -0,0 +1,343 @@
+///////////////////////////////////////////////////////////////////////////////
+//! @file		reliable_udp.h
+//! @brief		Reliable bulk transfer over UDP with selective NACKs and a paced sender
+//! @author		Chip Brommer
+///////////////////////////////////////////////////////////////////////////////
+#pragma once
+///////////////////////////////////////////////////////////////////////////////
+//
+//  Includes:
+//          name                        reason included
+//          --------------------        ---------------------------------------
+#include <cstdint>						// Standard integer types
+#include <cstring>						// memcpy
+#include <map>							// Error enum to strings.
+#include <string>						// Strings, packets
+#include <vector>						// Chunk state, bitmaps
+#include <deque>						// Retransmit queue
+#include <chrono>						// Pacing and RTT clock
+#include <functional>					// Receiver callbacks
+#include <algorithm>					// std::min, std::max
+#include "udp_client.h"					// Datagram transport
+//
+//	Defines:
+//          name                        reason defined
+//          --------------------        ---------------------------------------
+#ifndef     CPP_RELIABLE_UDP			// Define the cpp reliable udp classes.
+#define     CPP_RELIABLE_UDP
+//
+///////////////////////////////////////////////////////////////////////////////
+
+namespace Essentials
+{
+	namespace Communications
+	{
+		constexpr static uint32_t	RUDP_MAGIC					= 0x50445552;			// "RUDP"
+		constexpr static uint32_t	RUDP_DEFAULT_CHUNK_SIZE		= 1400;					// Payload per datagram, keeps a packet inside an ethernet frame
+		constexpr static uint32_t	RUDP_MIN_CHUNK_SIZE			= 512;					// Smallest chunk size accepted unless the transfer is one chunk
+		constexpr static uint32_t	RUDP_MAX_CHUNK_SIZE			= 60000;				// Largest payload per datagram
+		constexpr static uint64_t	RUDP_DEFAULT_MAX_TOTAL_SIZE	= 4ull * 1024 * 1024 * 1024;	// Largest transfer a receiver takes unless told otherwise
+		constexpr static uint32_t	RUDP_MAX_PACKET_SIZE		= 65507;				// Largest UDP payload over IPv4
+		constexpr static uint32_t	RUDP_NACK_WINDOW_WORDS		= 64;					// 64 bit words of missing chunk bitmap per feedback
+		constexpr static uint32_t	RUDP_FEEDBACK_PACKETS		= 32;					// Data packets between feedback
+		constexpr static uint64_t	RUDP_FEEDBACK_INTERVAL_USEC	= 10000;				// Longest gap between feedback while data arrives
+		constexpr static uint32_t	RUDP_MAX_RESULT_SIZE		= 64;					// Bytes of result the receiver can return with DONE
+		constexpr static double		RUDP_INITIAL_RATE			= 1024.0 * 1024;		// Bytes per second to start at
+		constexpr static double		RUDP_MIN_RATE				= 64.0 * 1024;			// Bytes per second never paced below
+		constexpr static double		RUDP_MAX_RATE				= 1024.0 * 1024 * 1024;	// Bytes per second never paced above
+		constexpr static double		RUDP_LOSS_THRESHOLD			= 0.10;					// Loss above this is taken as congestion rather than a noisy link
+		constexpr static uint32_t	RUDP_LOSS_SAMPLE_PACKETS	= 128;					// Packets needed before the loss rate is trusted
+		constexpr static double		RUDP_QUEUE_FACTOR			= 1.25;					// RTT grown this far over the minimum means a queue is building
+		constexpr static uint64_t	RUDP_QUEUE_MARGIN_USEC		= 2000;					// Jitter allowed on top of the minimum RTT before backing off
+		constexpr static double		RUDP_STARTUP_INCREASE		= 1.25;					// Rate growth per interval until the path first fills
+		constexpr static double		RUDP_RATE_INCREASE			= 1.05;					// Rate growth per interval after that
+		constexpr static double		RUDP_RATE_DECREASE			= 0.8;					// Rate cut per interval while the path is full
+		constexpr static uint64_t	RUDP_MIN_ADJUST_USEC		= 10000;				// Shortest interval between rate changes
+		constexpr static uint64_t	RUDP_MIN_TIMEOUT_USEC		= 10000;				// Shortest retransmit timeout
+		constexpr static uint32_t	RUDP_MAX_BURST				= 32;					// Packets the pacer may send back to back
+		constexpr static uint32_t	RUDP_SEND_BATCH				= 32;					// Packets handed to the socket in one send
+		constexpr static uint64_t	RUDP_IDLE_TIMEOUT_USEC		= 5000000;				// Sender gives up after this long without feedback
+		constexpr static uint64_t	RUDP_RECEIVER_IDLE_USEC		= 2 * RUDP_IDLE_TIMEOUT_USEC;	// Receiver lets another sender in after this long without data
+
+		constexpr static uint8_t	RUDP_FLAG_POLL				= 0x01;					// Data packet asks for feedback straight away
+		constexpr static uint8_t	RUDP_FLAG_OK				= 0x02;					// DONE, the receiver accepted the transfer
+
+		/// @brief enum for error codes
+		enum class ReliableUdpError : uint8_t
+		{
+			NONE,
+			BAD_ARGUMENT,
+			SEND_FAILED,
+			RECEIVE_FAILED,
+			TIMED_OUT,
+			REJECTED,
+		};
+
+		/// @brief Error enum to string map
+		static std::map<ReliableUdpError, std::string> ReliableUdpErrorMap
+		{
+			{ReliableUdpError::NONE,
+			std::string("Error Code " + std::to_string((uint8_t)ReliableUdpError::NONE) + ": No error.")},
+			{ReliableUdpError::BAD_ARGUMENT,
+			std::string("Error Code " + std::to_string((uint8_t)ReliableUdpError::BAD_ARGUMENT) + ": Bad argument.")},
+			{ReliableUdpError::SEND_FAILED,
+			std::string("Error Code " + std::to_string((uint8_t)ReliableUdpError::SEND_FAILED) + ": Send failed.")},
+			{ReliableUdpError::RECEIVE_FAILED,
+			std::string("Error Code " + std::to_string((uint8_t)ReliableUdpError::RECEIVE_FAILED) + ": Receive failed.")},
+			{ReliableUdpError::TIMED_OUT,
+			std::string("Error Code " + std::to_string((uint8_t)ReliableUdpError::TIMED_OUT) + ": Receiver stopped answering.")},
+			{ReliableUdpError::REJECTED,
+			std::string("Error Code " + std::to_string((uint8_t)ReliableUdpError::REJECTED) + ": Receiver refused the transfer.")},
+		};
+
+		/// @brief Packet types
+		enum class RudpPacketType : uint8_t
+		{
+			DATA		= 1,		// Sender to receiver, one chunk
+			FEEDBACK	= 2,		// Receiver to sender, what has arrived and what is missing
+			DONE		= 3,		// Receiver to sender, every chunk arrived, result follows
+			ABORT		= 4,		// Receiver to sender, the transfer was refused
+		};
+
+#pragma pack(push, 1)
+		/// @brief Starts every data packet, 'length' bytes of the chunk follow it. Chunks are fixed size
+		/// apart from the last, so the index places the data. The sequence counts every packet sent,
+		/// retransmissions included, which lets the sender tell loss apart from a chunk sent twice.
+		struct RudpDataHeader
+		{
+			uint32_t	magic;				// RUDP_MAGIC
+			uint8_t		type;				// RudpPacketType::DATA
+			uint8_t		flags;				// RUDP_FLAG_*
+			uint16_t	reserved;			// Zero
+			uint32_t	length;				// Bytes of chunk that follow
+			uint32_t	chunkSize;			// Size of every chunk but the last
+			uint32_t	chunkIndex;			// Which chunk this is
+			uint32_t	sequence;			// Packet number
+			uint64_t	transferId;			// Chosen by the sender, names the transfer
+			uint64_t	totalSize;			// Size of the whole transfer
+			uint64_t	sendTimeUSec;		// Sender's clock, echoed back for the RTT
+		};
+
+		/// @brief Starts every feedback, DONE and ABORT packet. Feedback is followed by bitmapWords words
+		/// where bit i is set if chunk cumulative + i is missing, DONE by resultSize bytes of result.
+		struct RudpFeedbackHeader
+		{
+			uint32_t	magic;				// RUDP_MAGIC
+			uint8_t		type;				// RudpPacketType::FEEDBACK, DONE or ABORT
+			uint8_t		flags;				// RUDP_FLAG_OK on DONE when the transfer was accepted
+			uint8_t		resultSize;			// DONE, bytes of result that follow
+			uint8_t		bitmapWords;		// FEEDBACK, 64 bit words of missing bitmap that follow
+			uint32_t	cumulative;			// Every chunk before this has arrived
+			uint32_t	highestChunk;		// One past the highest chunk seen, the bitmap says nothing past it
+			uint32_t	highestSequence;	// Highest packet number seen
+			uint32_t	packetsReceived;	// Data packets seen since the transfer started
+			uint32_t	holdUSec;			// Time between the echoed packet arriving and this being sent
+			uint64_t	transferId;			// Transfer this is about
+			uint64_t	echoTimeUSec;		// sendTimeUSec of the latest data packet
+		};
+#pragma pack(pop)
+
+		/// @brief Sends a block of memory to a ReliableReceiver. Chunks go out paced at a rate that grows
+		/// while the round trip time stays near its minimum and shrinks when it climbs or loss goes past
+		/// RUDP_LOSS_THRESHOLD, so a few percent of random loss on the link doesn't slow it down. Missing
+		/// chunks reported by the receiver are sent again ahead of new ones.
+		class ReliableSender
+		{
+		public:
+			/// @brief Constructor
+			/// @param udp -[in]- Client with an open unicast socket, used for the whole transfer
+			/// @param ipAddress -[in]- Address of the receiver
+			/// @param port -[in]- Port of the receiver
+			/// @param chunkSize -[in]- Payload per datagram, no more than RUDP_MAX_CHUNK_SIZE
+			ReliableSender(UDP_Client& udp, const std::string& ipAddress, const int16_t port, const uint32_t chunkSize = RUDP_DEFAULT_CHUNK_SIZE);
+
+			/// @brief Sends a transfer and waits until the receiver has every byte of it
+			/// @param transferId -[in]- Id for the transfer, a receiver treats a new id as a new transfer
+			/// @param data -[in]- Data to send
+			/// @param size -[in]- Number of bytes
+			/// @return 0 if the receiver accepted it, -1 if fails. Call ReliableSender::GetLastError to find out more.
+			int Send(const uint64_t transferId, const uint8_t* data, const uint64_t size);
+
+			/// @brief Get the result the receiver returned with DONE
+			/// @return result bytes, empty if none
+			const std::string& GetResult() const;
+
+			/// @brief Get the pacing rate reached
+			/// @return bytes per second
+			double GetRate() const;
+
+			/// @brief Get the smoothed round trip time
+			/// @return microseconds
+			uint64_t GetRttUSec() const;
+
+			/// @brief Get the smoothed loss rate the receiver's feedback showed
+			/// @return fraction of packets lost, 0 to 1
+			double GetLossRate() const;
+
+			/// @brief Get the number of chunks sent more than once
+			uint64_t GetRetransmitCount() const;
+
+			/// @brief Get the last error in string format
+			/// @return The last error in a formatted string
+			std::string GetLastError();
+
+		protected:
+		private:
+			/// @brief Picks the chunk to send next, reported losses first, then new data, then anything
+			/// unacknowledged for longer than the retransmit timeout
+			/// @param now -[in]- Current time
+			/// @param flags -[out]- Flags to send it with
+			/// @return chunk index, -1 if there is nothing to send yet
+			int64_t NextChunk(const uint64_t now, uint8_t& flags);
+
+			/// @brief Builds the packet for one chunk at the end of the batch
+			void BuildChunk(const uint32_t index, const uint8_t flags, const uint64_t now);
+
+			/// @brief Sends the batch as one segmented send, the packets are laid end to end in mPacket
+			/// @param now -[in]- Current time
+			/// @return 0 if all were sent, -1 if the socket took only some, the rest are queued to go again
+			int SendBatch(const uint64_t now);
+
+			/// @brief Reads every packet the receiver has sent back
+			/// @param waitMSec -[in]- Milliseconds to wait for the first
+			/// @return 1 when the transfer is done, 0 to carry on, -1 if fails
+			int ReadFeedback(const int32_t waitMSec);
+
+			/// @brief Takes in one packet from the receiver
+			/// @return 1 when the transfer is done, 0 to carry on, -1 if refused
+			int HandleFeedback(const uint8_t* packet, const size_t size, const uint64_t now);
+
+			/// @brief Marks a chunk as having arrived
+			void Acknowledge(const uint32_t index);
+
+			/// @brief Adjusts the pacing rate from the RTT and the loss seen since the last change
+			void AdjustRate(const uint64_t rttSample, const uint64_t now);
+
+			/// @brief Get the retransmit timeout
+			/// @return microseconds
+			uint64_t GetTimeoutUSec() const;
+
+			ReliableUdpError			mLastError;			// Last error for this utility
+			UDP_Client&					mUdp;				// Transport
+			std::string					mIpAddress;			// Receiver address
+			int16_t						mPort;				// Receiver port
+			uint32_t					mChunkSize;			// Payload per datagram
+			std::vector<uint8_t>		mPacket;			// Packets being built, RUDP_SEND_BATCH full sized slots
+			std::vector<uint32_t>		mBatch;				// Chunk in each slot of mPacket
+			uint32_t					mBatchBytes;		// Bytes of mPacket in use
+			std::vector<uint8_t>		mFeedback;			// Packet being read
+
+			const uint8_t*				mData;				// Transfer being sent
+			uint64_t					mSize;				// Bytes in the transfer
+			uint64_t					mTransferId;		// Id of the transfer
+			uint32_t					mChunkCount;		// Chunks in the transfer
+			std::vector<uint8_t>		mAcked;				// Per chunk, the receiver has it
+			std::vector<uint64_t>		mSentUSec;			// Per chunk, when it was last sent
+			std::vector<uint8_t>		mQueued;			// Per chunk, waiting in mRetransmits
+			std::deque<uint32_t>		mRetransmits;		// Chunks reported missing
+			uint32_t					mCumulative;		// Every chunk before this has been acknowledged
+			uint32_t					mAckedCount;		// Chunks acknowledged
+			uint32_t					mNextNew;			// Next chunk not yet sent at all
+			uint32_t					mSequence;			// Next packet number
+
+			double						mRate;				// Pacing rate, bytes per second
+			double						mTokens;			// Bytes the pacer may send now
+			uint64_t					mLastRefillUSec;	// When mTokens was last topped up
+			uint64_t					mLastProbeUSec;		// When unacknowledged chunks were last swept for resending
+			uint64_t					mRttUSec;			// Smoothed round trip time
+			uint64_t					mRttVarUSec;		// Round trip time variation
+			uint64_t					mMinRttUSec;		// Lowest round trip time seen
+			double						mLossRate;			// Smoothed loss rate
+			uint64_t					mLastAdjustUSec;	// When the rate was last changed
+			uint32_t					mIntervalSent;		// Packets the receiver should have seen since the rate was last changed
+			uint32_t					mIntervalReceived;	// Packets the receiver did see since the rate was last changed
+			bool						mStartup;			// The path hasn't filled yet, the rate grows quickly
+			uint32_t					mLastHighest;		// highestSequence of the previous feedback
+			uint32_t					mLastReceived;		// packetsReceived of the previous feedback
+			uint64_t					mLastFeedbackUSec;	// When feedback last arrived
+			uint64_t					mRetransmitCount;	// Chunks sent more than once
+			std::string					mResult;			// Result returned with DONE
+			bool						mAccepted;			// DONE carried RUDP_FLAG_OK
+		};
+
+		/// @brief Receives transfers from a ReliableSender. Datagrams are handed in by the caller, each
+		/// new chunk is passed to the chunk handler once and the complete handler is called when the last
+		/// one arrives. Any packet that needs answering comes back as a reply for the caller to send to
+		/// where the datagram came from, so the receiver never touches a socket itself. A transfer belongs
+		/// to the endpoint that started it, data for any other transfer is ignored until it completes,
+		/// is refused or that sender goes quiet for RUDP_RECEIVER_IDLE_USEC.
+		class ReliableReceiver
+		{
+		public:
+			/// @brief Called with each chunk the first time it arrives
+			/// @return 0 to carry on, -1 to refuse the transfer
+			using ChunkHandler = std::function<int(const uint64_t transferId, const uint64_t totalSize, const uint64_t offset, const uint8_t* data, const size_t size)>;
+
+			/// @brief Called once every chunk has arrived, may fill in up to RUDP_MAX_RESULT_SIZE bytes of result
+			/// @return 0 if the transfer is accepted, -1 if not
+			using CompleteHandler = std::function<int(const uint64_t transferId, std::string& result)>;
+
+			/// @brief Constructor
+			/// @param onChunk -[in]- Chunk handler
+			/// @param onComplete -[in]- Complete handler
+			/// @param maxTotalSize -[in]- Largest transfer that will be started
+			ReliableReceiver(const ChunkHandler& onChunk, const CompleteHandler& onComplete, const uint64_t maxTotalSize = RUDP_DEFAULT_MAX_TOTAL_SIZE);
+
+			/// @brief Takes in one datagram
+			/// @param sender -[in]- Where the datagram came from
+			/// @param data -[in]- Datagram
+			/// @param size -[in]- Number of bytes
+			/// @param reply -[out]- Packet to send back to the sender
+			/// @return 1 if reply should be sent, 0 if nothing to send, -1 if the datagram was not taken
+			int HandleDatagram(const Endpoint& sender, const uint8_t* data, const size_t size, std::string& reply);
+
+			/// @brief Check if a datagram is a data packet for a receiver
+			/// @param data -[in]- Datagram
+			/// @param size -[in]- Number of bytes
+			/// @return true if it is
+			static bool IsDataPacket(const uint8_t* data, const size_t size);
+
+		protected:
+		private:
+			/// @brief Check if a data header describes a transfer this receiver will start
+			bool IsAcceptable(const RudpDataHeader& header) const;
+
+			/// @brief Starts tracking a new transfer
+			void Reset(const Endpoint& sender, const RudpDataHeader& header);
+
+			/// @brief Builds a feedback packet
+			void BuildFeedback(std::string& reply, const uint64_t echoTimeUSec, const uint64_t arrivalUSec);
+
+			/// @brief Builds a DONE or ABORT packet
+			void BuildFinal(std::string& reply, const RudpPacketType type);
+
+			/// @brief Check if a chunk has arrived
+			bool HasChunk(const uint32_t index) const;
+
+			ChunkHandler				mOnChunk;			// Chunk handler
+			CompleteHandler				mOnComplete;		// Complete handler
+			uint64_t					mMaxTotalSize;		// Largest transfer that will be started
+			Endpoint					mSender;			// Where the transfer is coming from
+			uint64_t					mLastDataUSec;		// When data last arrived from mSender
+			bool						mActive;			// A transfer is being received
+			bool						mComplete;			// Every chunk arrived and the complete handler ran
+			bool						mAccepted;			// Complete handler accepted it
+			bool						mAborted;			// Chunk handler refused it
+			uint64_t					mTransferId;		// Id of the transfer
+			uint64_t					mTotalSize;			// Size of the transfer
+			uint32_t					mChunkSize;			// Size of every chunk but the last
+			uint32_t					mChunkCount;		// Chunks in the transfer
+			std::vector<uint64_t>		mReceived;			// Bitmap of chunks that have arrived
+			uint32_t					mReceivedCount;		// Chunks that have arrived
+			uint32_t					mCumulative;		// Every chunk before this has arrived
+			uint32_t					mHighestChunk;		// One past the highest chunk seen
+			uint32_t					mHighestSequence;	// Highest packet number seen
+			uint32_t					mPacketsReceived;	// Data packets seen
+			uint32_t					mPacketsSinceFeedback;	// Data packets since feedback was last sent
+			uint64_t					mLastFeedbackUSec;	// When feedback was last sent
+			std::string					mResult;			// Result from the complete handler
+		};
+	}
+}
+
+#endif		// CPP_RELIABLE_UDP
@@ -0,0 +1,344 @@
+///////////////////////////////////////////////////////////////////////////////
+//! @file		sha256.cpp
+//! @brief		Implementation of the SHA-256 class
+//! @author		Chip Brommer
+///////////////////////////////////////////////////////////////////////////////
+
+///////////////////////////////////////////////////////////////////////////////
+//
+//  Includes:
+//          name                        reason included
+//          --------------------        ---------------------------------------
+#include	"sha256.h"					// SHA-256 class
+//
+///////////////////////////////////////////////////////////////////////////////
+
+namespace Essentials
+{
+	namespace Utilities
+	{
+		namespace
+		{
+			alignas(16) constexpr uint32_t SHA256_K[64] =
+			{
+				0x428A2F98, 0x71374491, 0xB5C0FBCF, 0xE9B5DBA5, 0x3956C25B, 0x59F111F1, 0x923F82A4, 0xAB1C5ED5,
+				0xD807AA98, 0x12835B01, 0x243185BE, 0x550C7DC3, 0x72BE5D74, 0x80DEB1FE, 0x9BDC06A7, 0xC19BF174,
+				0xE49B69C1, 0xEFBE4786, 0x0FC19DC6, 0x240CA1CC, 0x2DE92C6F, 0x4A7484AA, 0x5CB0A9DC, 0x76F988DA,
+				0x983E5152, 0xA831C66D, 0xB00327C8, 0xBF597FC7, 0xC6E00BF3, 0xD5A79147, 0x06CA6351, 0x14292967,
+				0x27B70A85, 0x2E1B2138, 0x4D2C6DFC, 0x53380D13, 0x650A7354, 0x766A0ABB, 0x81C2C92E, 0x92722C85,
+				0xA2BFE8A1, 0xA81A664B, 0xC24B8B70, 0xC76C51A3, 0xD192E819, 0xD6990624, 0xF40E3585, 0x106AA070,
+				0x19A4C116, 0x1E376C08, 0x2748774C, 0x34B0BCB5, 0x391C0CB3, 0x4ED8AA4A, 0x5B9CCA4F, 0x682E6FF3,
+				0x748F82EE, 0x78A5636F, 0x84C87814, 0x8CC70208, 0x90BEFFFA, 0xA4506CEB, 0xBEF9A3F7, 0xC67178F2,
+			};
+
+			constexpr uint32_t SHA256_INITIAL[8] =
+			{
+				0x6A09E667, 0xBB67AE85, 0x3C6EF372, 0xA54FF53A, 0x510E527F, 0x9B05688C, 0x1F83D9AB, 0x5BE0CD19,
+			};
+
+			inline uint32_t RotateRight(const uint32_t value, const int count)
+			{
+				return (value >> count) | (value << (32 - count));
+			}
+
+			void CompressPortable(uint32_t state[8], const uint8_t* data, size_t blocks)
+			{
+				while (blocks-- > 0)
+				{
+					uint32_t w[64];
+					for (int i = 0; i < 16; i++)
+					{
+						w[i] = (static_cast<uint32_t>(data[i * 4]) << 24) | (static_cast<uint32_t>(data[i * 4 + 1]) << 16) |
+							(static_cast<uint32_t>(data[i * 4 + 2]) << 8) | static_cast<uint32_t>(data[i * 4 + 3]);
+					}
+					for (int i = 16; i < 64; i++)
+					{
+						uint32_t s0 = RotateRight(w[i - 15], 7) ^ RotateRight(w[i - 15], 18) ^ (w[i - 15] >> 3);
+						uint32_t s1 = RotateRight(w[i - 2], 17) ^ RotateRight(w[i - 2], 19) ^ (w[i - 2] >> 10);
+						w[i] = w[i - 16] + s0 + w[i - 7] + s1;
+					}
+
+					uint32_t a = state[0], b = state[1], c = state[2], d = state[3];
+					uint32_t e = state[4], f = state[5], g = state[6], h = state[7];
+
+					for (int i = 0; i < 64; i++)
+					{
+						uint32_t s1 = RotateRight(e, 6) ^ RotateRight(e, 11) ^ RotateRight(e, 25);
+						uint32_t t1 = h + s1 + ((e & f) ^ (~e & g)) + SHA256_K[i] + w[i];
+						uint32_t s0 = RotateRight(a, 2) ^ RotateRight(a, 13) ^ RotateRight(a, 22);
+						uint32_t t2 = s0 + ((a & b) ^ (a & c) ^ (b & c));
+						h = g;
+						g = f;
+						f = e;
+						e = d + t1;
+						d = c;
+						c = b;
+						b = a;
+						a = t1 + t2;
+					}
+
+					state[0] += a; state[1] += b; state[2] += c; state[3] += d;
+					state[4] += e; state[5] += f; state[6] += g; state[7] += h;
+					data += SHA256_BLOCK_SIZE;
+				}
+			}
+
+#if defined(SHA256_HAVE_SHANI)
+#ifndef _MSC_VER
+			__attribute__((target("sha,sse4.1,ssse3")))
+#endif
+			void CompressHardware(uint32_t state[8], const uint8_t* data, size_t blocks)
+			{
+				const __m128i byteSwap = _mm_set_epi64x(0x0C0D0E0F08090A0BULL, 0x0405060700010203ULL);
+
+				// The instructions want the state as ABEF and CDGH
+				__m128i tmp = _mm_shuffle_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i*>(&state[0])), 0xB1);
+				__m128i state1 = _mm_shuffle_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i*>(&state[4])), 0x1B);
+				__m128i state0 = _mm_alignr_epi8(tmp, state1, 8);
+				state1 = _mm_blend_epi16(state1, tmp, 0xF0);
+
+				while (blocks-- > 0)
+				{
+					__m128i abefSave = state0;
+					__m128i cdghSave = state1;
+					__m128i msg[4];
+
+					for (int i = 0; i < 4; i++)
+					{
+						msg[i] = _mm_shuffle_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i*>(data + i * 16)), byteSwap);
+					}
+
+					// Four rounds per pass, extending the message schedule four words ahead as we go
+					for (int i = 0; i < 16; i++)
+					{
+						__m128i current = msg[i & 3];
+						__m128i rounds = _mm_add_epi32(current, _mm_load_si128(reinterpret_cast<const __m128i*>(&SHA256_K[i * 4])));
+						state1 = _mm_sha256rnds2_epu32(state1, state0, rounds);
+
+						if (i >= 3 && i < 15)
+						{
+							__m128i next = _mm_add_epi32(msg[(i + 1) & 3], _mm_alignr_epi8(current, msg[(i - 1) & 3], 4));
+							msg[(i + 1) & 3] = _mm_sha256msg2_epu32(next, current);
+						}
+
+						rounds = _mm_shuffle_epi32(rounds, 0x0E);
+						state0 = _mm_sha256rnds2_epu32(state0, state1, rounds);
+
+						if (i >= 1 && i < 13)
+						{
+							msg[(i - 1) & 3] = _mm_sha256msg1_epu32(msg[(i - 1) & 3], current);
+						}
+					}
+
+					state0 = _mm_add_epi32(state0, abefSave);
+					state1 = _mm_add_epi32(state1, cdghSave);
+					data += SHA256_BLOCK_SIZE;
+				}
+
+				// Back to ABCD and EFGH
+				tmp = _mm_shuffle_epi32(state0, 0x1B);
+				state1 = _mm_shuffle_epi32(state1, 0xB1);
+				state0 = _mm_blend_epi16(tmp, state1, 0xF0);
+				state1 = _mm_alignr_epi8(state1, tmp, 8);
+
+				_mm_storeu_si128(reinterpret_cast<__m128i*>(&state[0]), state0);
+				_mm_storeu_si128(reinterpret_cast<__m128i*>(&state[4]), state1);
+			}
+
+			bool HasShaInstructions()
+			{
+#ifdef _MSC_VER
+				int info[4] = { 0 };
+				__cpuid(info, 1);
+				bool sse41 = (info[2] & (1 << 19)) != 0;
+				__cpuidex(info, 7, 0);
+				return sse41 && (info[1] & (1 << 29)) != 0;
+#else
+				unsigned int eax = 0, ebx = 0, ecx = 0, edx = 0;
+				if (!__get_cpuid(1, &eax, &ebx, &ecx, &edx) || (ecx & bit_SSE4_1) == 0)
+				{
+					return false;
+				}
+				return __get_cpuid_count(7, 0, &eax, &ebx, &ecx, &edx) && (ebx & bit_SHA) != 0;
+#endif
+			}
+#elif defined(SHA256_HAVE_ARMV8)
+#if defined(__clang__)
+			__attribute__((target("sha2")))
+#else
+			__attribute__((target("+crypto")))
+#endif
+			void CompressHardware(uint32_t state[8], const uint8_t* data, size_t blocks)
+			{
+				uint32x4_t state0 = vld1q_u32(&state[0]);
+				uint32x4_t state1 = vld1q_u32(&state[4]);
+
+				while (blocks-- > 0)
+				{
+					uint32x4_t abcdSave = state0;
+					uint32x4_t efghSave = state1;
+					uint32x4_t msg[4];
+
+					for (int i = 0; i < 4; i++)
+					{
+						msg[i] = vreinterpretq_u32_u8(vrev32q_u8(vld1q_u8(data + i * 16)));
+					}
+
+					// Four rounds per pass, extending the message schedule four words ahead as we go
+					uint32x4_t rounds = vaddq_u32(msg[0], vld1q_u32(&SHA256_K[0]));
+					for (int i = 0; i < 16; i++)
+					{
+						if (i < 12)
+						{
+							msg[i & 3] = vsha256su0q_u32(msg[i & 3], msg[(i + 1) & 3]);
+						}
+
+						uint32x4_t abcd = state0;
+						uint32x4_t nextRounds = rounds;
+						if (i < 15)
+						{
+							nextRounds = vaddq_u32(msg[(i + 1) & 3], vld1q_u32(&SHA256_K[(i + 1) * 4]));
+						}
+
+						state0 = vsha256hq_u32(state0, state1, rounds);
+						state1 = vsha256h2q_u32(state1, abcd, rounds);
+
+						if (i < 12)
+						{
+							msg[i & 3] = vsha256su1q_u32(msg[i & 3], msg[(i + 2) & 3], msg[(i + 3) & 3]);
+						}
+						rounds = nextRounds;
+					}
+
+					state0 = vaddq_u32(state0, abcdSave);
+					state1 = vaddq_u32(state1, efghSave);
+					data += SHA256_BLOCK_SIZE;
+				}
+
+				vst1q_u32(&state[0], state0);
+				vst1q_u32(&state[4], state1);
+			}
+
+			bool HasShaInstructions()
+			{
+				return (getauxval(AT_HWCAP) & HWCAP_SHA2) != 0;
+			}
+#endif
+
+			using CompressFunction = void(*)(uint32_t*, const uint8_t*, size_t);
+
+			/// @brief Picks the implementation once, on first use
+			CompressFunction GetCompress()
+			{
+#if defined(SHA256_HAVE_SHANI) || defined(SHA256_HAVE_ARMV8)
+				static const CompressFunction compress = HasShaInstructions() ? CompressHardware : CompressPortable;
+#else
+				static const CompressFunction compress = CompressPortable;
+#endif
+				return compress;
+			}
+		}
+
+		Sha256::Sha256()
+		{
+			Reset();
+		}
+
+		void Sha256::Reset()
+		{
+			memcpy(mState, SHA256_INITIAL, sizeof(mState));
+			mBuffered	= 0;
+			mLength		= 0;
+		}
+
+		void Sha256::Update(const uint8_t* data, size_t size)
+		{
+			CompressFunction compress = GetCompress();
+			mLength += size;
+
+			// Top up a partial block first
+			if (mBuffered > 0)
+			{
+				size_t count = std::min(size, SHA256_BLOCK_SIZE - mBuffered);
+				memcpy(mBuffer + mBuffered, data, count);
+				mBuffered += count;
+				data += count;
+				size -= count;
+
+				if (mBuffered < SHA256_BLOCK_SIZE)
+				{
+					return;
+				}
+				compress(mState, mBuffer, 1);
+				mBuffered = 0;
+			}
+
+			// Whole blocks straight from the caller's data
+			size_t blocks = size / SHA256_BLOCK_SIZE;
+			if (blocks > 0)
+			{
+				compress(mState, data, blocks);
+				data += blocks * SHA256_BLOCK_SIZE;
+				size -= blocks * SHA256_BLOCK_SIZE;
+			}
+
+			memcpy(mBuffer, data, size);
+			mBuffered = size;
+		}
+
+		Sha256Digest Sha256::Final()
+		{
+			CompressFunction compress = GetCompress();
+			uint64_t bits = mLength * 8;
+
+			// Pad with 0x80, zeros and the length in bits so the data ends on a block boundary
+			mBuffer[mBuffered++] = 0x80;
+			if (mBuffered > SHA256_BLOCK_SIZE - sizeof(bits))
+			{
+				memset(mBuffer + mBuffered, 0, SHA256_BLOCK_SIZE - mBuffered);
+				compress(mState, mBuffer, 1);
+				mBuffered = 0;
+			}
+			memset(mBuffer + mBuffered, 0, SHA256_BLOCK_SIZE - sizeof(bits) - mBuffered);
+			for (size_t i = 0; i < sizeof(bits); i++)
+			{
+				mBuffer[SHA256_BLOCK_SIZE - 1 - i] = static_cast<uint8_t>(bits >> (i * 8));
+			}
+			compress(mState, mBuffer, 1);
+			mBuffered = 0;
+
+			Sha256Digest digest = { 0 };
+			for (size_t i = 0; i < 8; i++)
+			{
+				digest[i * 4]		= static_cast<uint8_t>(mState[i] >> 24);
+				digest[i * 4 + 1]	= static_cast<uint8_t>(mState[i] >> 16);
+				digest[i * 4 + 2]	= static_cast<uint8_t>(mState[i] >> 8);
+				digest[i * 4 + 3]	= static_cast<uint8_t>(mState[i]);
+			}
+			return digest;
+		}
+
+		uint64_t Sha256::GetLength() const
+		{
+			return mLength;
+		}
+
+		std::string Sha256::ToHex(const Sha256Digest& digest)
+		{
+			static constexpr char hex[] = "0123456789abcdef";
+			std::string out;
+			out.reserve(digest.size() * 2);
+			for (uint8_t byte : digest)
+			{
+				out.push_back(hex[byte >> 4]);
+				out.push_back(hex[byte & 0x0F]);
+			}
+			return out;
+		}
+
+		bool Sha256::IsAccelerated()
+		{
+			return GetCompress() != CompressPortable;
+		}
+	}
+}
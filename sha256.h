@@ -0,0 +1,95 @@
+///////////////////////////////////////////////////////////////////////////////
+//! @file		sha256.h
+//! @brief		Incremental SHA-256 using the CPU's SHA instructions when present
+//! @author		Chip Brommer
+///////////////////////////////////////////////////////////////////////////////
+#pragma once
+///////////////////////////////////////////////////////////////////////////////
+//
+//  Includes:
+//          name                        reason included
+//          --------------------        ---------------------------------------
+#if !defined(SHA256_PORTABLE_ONLY) && (defined(__x86_64__) || defined(_M_X64))
+#ifdef _MSC_VER
+#include <intrin.h>						// __cpuidex, SHA intrinsics
+#else
+#include <immintrin.h>					// SHA intrinsics
+#include <cpuid.h>						// __get_cpuid_count
+#endif
+#define SHA256_HAVE_SHANI
+#elif !defined(SHA256_PORTABLE_ONLY) && defined(__aarch64__) && defined(__linux__)
+#include <arm_neon.h>					// vsha256hq_u32
+#include <sys/auxv.h>					// getauxval
+#include <asm/hwcap.h>					// HWCAP_SHA2
+#define SHA256_HAVE_ARMV8
+#endif
+#include <cstdint>						// Standard integer types
+#include <cstddef>						// size_t
+#include <cstring>						// memcpy, memset
+#include <algorithm>					// std::min
+#include <array>						// Digest
+#include <string>						// Hex digest
+//
+//	Defines:
+//          name                        reason defined
+//          --------------------        ---------------------------------------
+#ifndef     CPP_SHA256					// Define the cpp sha256 class.
+#define     CPP_SHA256
+//
+///////////////////////////////////////////////////////////////////////////////
+
+namespace Essentials
+{
+	namespace Utilities
+	{
+		constexpr static size_t		SHA256_DIGEST_SIZE	= 32;		// Bytes in a SHA-256 digest
+		constexpr static size_t		SHA256_BLOCK_SIZE	= 64;		// Bytes the compression function takes at a time
+
+		using Sha256Digest = std::array<uint8_t, SHA256_DIGEST_SIZE>;
+
+		/// @brief Computes a SHA-256 digest over data given in any number of pieces. Whole blocks are
+		/// compressed with SHA-NI on x86-64 or the ARMv8 SHA2 extension when the CPU has them, with a
+		/// portable version otherwise. Only a partial block is ever copied. Define SHA256_PORTABLE_ONLY
+		/// to always use the portable version.
+		class Sha256
+		{
+		public:
+			/// @brief Constructor, ready for data
+			Sha256();
+
+			/// @brief Starts a new digest
+			void Reset();
+
+			/// @brief Adds data to the digest
+			/// @param data -[in]- Data to add
+			/// @param size -[in]- Number of bytes
+			void Update(const uint8_t* data, size_t size);
+
+			/// @brief Finishes the digest. Reset before using again.
+			/// @return digest of everything added
+			Sha256Digest Final();
+
+			/// @brief Get the number of bytes added so far
+			/// @return bytes added
+			uint64_t GetLength() const;
+
+			/// @brief Formats a digest as lower case hex
+			/// @param digest -[in]- Digest to format
+			/// @return 64 character hex string
+			static std::string ToHex(const Sha256Digest& digest);
+
+			/// @brief Check if the CPU's SHA instructions are being used
+			/// @return true if accelerated
+			static bool IsAccelerated();
+
+		protected:
+		private:
+			uint32_t	mState[8];							// Working hash
+			uint8_t		mBuffer[SHA256_BLOCK_SIZE];			// Partial block
+			size_t		mBuffered;							// Bytes in the partial block
+			uint64_t	mLength;							// Bytes added
+		};
+	}
+}
+
+#endif		// CPP_SHA256
@@ -40,22 +40,27 @@ namespace Essentials
 			{ TcpServerError::CONNECTION_FAILED, std::string("Error Code " + std::to_string(static_cast<uint8_t>(TcpServerError::CONNECTION_FAILED)) + ": Connection failed.") },
 			{ TcpServerError::ACCEPT_FAILED, std::string("Error Code " + std::to_string(static_cast<uint8_t>(TcpServerError::ACCEPT_FAILED)) + ": Accepting new client failed.") },
 			{ TcpServerError::ECHO_FAILED, std::string("Error Code " + std::to_string(static_cast<uint8_t>(TcpServerError::ECHO_FAILED)) + ": Echo to client failed.") },
-			{ TcpServerError::RECEIVE_FAILED, std::string("Error Code " + std::to_string(static_cast<uint8_t>(TcpServerError::RECEIVE_FAILED)) + ": Receive from client failed.") }
+			{ TcpServerError::RECEIVE_FAILED, std::string("Error Code " + std::to_string(static_cast<uint8_t>(TcpServerError::RECEIVE_FAILED)) + ": Receive from client failed.") },
+			{ TcpServerError::SEND_FAILED, std::string("Error Code " + std::to_string(static_cast<uint8_t>(TcpServerError::SEND_FAILED)) + ": Send to client failed.") },
+			{ TcpServerError::SERVER_NOT_STARTED, std::string("Error Code " + std::to_string(static_cast<uint8_t>(TcpServerError::SERVER_NOT_STARTED)) + ": Server not started.") },
+			{ TcpServerError::EVENT_LOOP_FAILURE, std::string("Error Code " + std::to_string(static_cast<uint8_t>(TcpServerError::EVENT_LOOP_FAILURE)) + ": Event loop failure.") },
+			{ TcpServerError::FILE_OPEN_FAILED, std::string("Error Code " + std::to_string(static_cast<uint8_t>(TcpServerError::FILE_OPEN_FAILED)) + ": Failed to open file.") },
+			{ TcpServerError::FILE_SEND_FAILED, std::string("Error Code " + std::to_string(static_cast<uint8_t>(TcpServerError::FILE_SEND_FAILED)) + ": Failed to send file.") }
 	};
 
-		TCP_Server::TCP_Server() : mMaxClients(FD_SETSIZE), mAddress("\n"), mPort(-1), mLastError(TcpServerError::NONE)
+		TCP_Server::TCP_Server() : mMaxClients(FD_SETSIZE), mAddress("\n"), mPort(-1), mLastError(TcpServerError::NONE), mStopFlag(true), mRunning(false)
 #ifdef WIN32
 			, mWsaData(), mSocket(INVALID_SOCKET)
 #else
-			, mSocket(-1)
+			, mSocket(-1), mEpollFD(-1), mWakeFD(-1)
 #endif
 		{}
 
-		TCP_Server::TCP_Server(int maxClients) : mMaxClients(maxClients), mAddress("\n"), mPort(-1), mLastError(TcpServerError::NONE)
+		TCP_Server::TCP_Server(int maxClients) : mMaxClients(maxClients), mAddress("\n"), mPort(-1), mLastError(TcpServerError::NONE), mStopFlag(true), mRunning(false)
 #ifdef WIN32
 			, mWsaData(), mSocket(INVALID_SOCKET)
 #else
-			, mSocket(-1)
+			, mSocket(-1), mEpollFD(-1), mWakeFD(-1)
 #endif
 		{}
 
@@ -94,8 +99,6 @@ namespace Essentials
 			Stop();
 #ifdef WIN32
 			FD_ZERO(&mFDs);
-#else
-			delete[] mFDs;
 #endif
 		}
 
@@ -176,7 +179,52 @@ namespace Essentials
 			FD_ZERO(&mFDs);
 			FD_SET(mSocket, &mFDs);
 #else
-			memset(mFDs, 0, sizeof(mFDs));
+			// The event loop is edge triggered, so every socket it watches must be non-blocking
+			if (SetNonBlocking(mSocket) < 0)
+			{
+				mLastError = TcpServerError::LINUX_SOCKET_OPEN_FAILURE;
+				return -1;
+			}
+
+			mEpollFD = epoll_create1(EPOLL_CLOEXEC);
+			mWakeFD = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+
+			if (mEpollFD == -1 || mWakeFD == -1)
+			{
+				mLastError = TcpServerError::EVENT_LOOP_FAILURE;
+				return -1;
+			}
+
+			epoll_event event{};
+			event.events = EPOLLIN | EPOLLET;
+			event.data.fd = mSocket;
+			if (epoll_ctl(mEpollFD, EPOLL_CTL_ADD, mSocket, &event) == -1)
+			{
+				mLastError = TcpServerError::EVENT_LOOP_FAILURE;
+				return -1;
+			}
+
+			event.data.fd = mWakeFD;
+			if (epoll_ctl(mEpollFD, EPOLL_CTL_ADD, mWakeFD, &event) == -1)
+			{
+				mLastError = TcpServerError::EVENT_LOOP_FAILURE;
+				return -1;
+			}
+
+			for (const auto& source : mEventSources)
+			{
+				event.data.fd = source.first;
+				if (epoll_ctl(mEpollFD, EPOLL_CTL_ADD, source.first, &event) == -1)
+				{
+					mLastError = TcpServerError::EVENT_LOOP_FAILURE;
+					return -1;
+				}
+			}
+
+			mReceiveBuffer.resize(TCP_SERVER_RECEIVE_BUFFER_SIZE);
+
+			// sendfile has no MSG_NOSIGNAL, a client going away part way through a file would kill the process
+			signal(SIGPIPE, SIG_IGN);
 #endif
 			mStopFlag = false;
 			return 0;
@@ -187,12 +235,87 @@ namespace Essentials
 #ifdef WIN32
 			fd_set reads;
 			reads = mFDs;
-#else
-
-#endif
 
 			// default return 
 			return -1;
+#else
+			if (mSocket == -1 || mEpollFD == -1)
+			{
+				mLastError = TcpServerError::SERVER_NOT_STARTED;
+				return -1;
+			}
+
+			int rtn = 0;
+			epoll_event events[TCP_SERVER_MAX_EVENTS];
+			mRunning = true;
+
+			while (!mStopFlag)
+			{
+				// Block until a socket is ready, no polling interval needed as Stop wakes us.
+				int numEvents = epoll_wait(mEpollFD, events, TCP_SERVER_MAX_EVENTS, -1);
+
+				if (numEvents == -1)
+				{
+					if (errno == EINTR)
+					{
+						continue;
+					}
+
+					mLastError = TcpServerError::EVENT_LOOP_FAILURE;
+					rtn = -1;
+					break;
+				}
+
+				for (int i = 0; i < numEvents && !mStopFlag; i++)
+				{
+					int fd = events[i].data.fd;
+
+					if (fd == mWakeFD)
+					{
+						uint64_t count = 0;
+						while (read(mWakeFD, &count, sizeof(count)) > 0) {}
+					}
+					else if (fd == mSocket)
+					{
+						AcceptClients();
+					}
+					else if (mEventSources.count(fd) > 0)
+					{
+						// Copy, the handler is allowed to remove itself
+						auto handler = mEventSources[fd];
+						handler();
+					}
+					else
+					{
+						// Carry on queued sends first, a failed one has already removed the client
+						if ((events[i].events & EPOLLOUT) && !FlushClient(fd))
+						{
+							continue;
+						}
+
+						if (events[i].events & EPOLLIN)
+						{
+							// A hang up with pending data still reports EPOLLIN, the read drains it and sees the close.
+							ReadFromClient(fd);
+						}
+						else if (events[i].events & (EPOLLERR | EPOLLHUP))
+						{
+							RemoveClient(fd);
+						}
+					}
+				}
+			}
+
+			mRunning = false;
+
+			// A stop requested from within a callback leaves the clean up to us. 
+			if (mStopFlag)
+			{
+				CloseServer();
+			}
+
+			return rtn;
+#endif
 		}
 
 		void TCP_Server::Stop()
@@ -200,6 +323,24 @@ namespace Essentials
 			// Set the stop flag
 			mStopFlag = true;
 
+#ifndef WIN32
+			// Let the event loop close everything down once it is out of its callbacks
+			if (mRunning)
+			{
+				WakeEventLoop();
+				return;
+			}
+#endif
+			CloseServer();
+		}
+
+		void TCP_Server::CloseServer()
+		{
+			if (mSocket == INVALID_SOCKET)
+			{
+				return;
+			}
+
 			CloseAllClientSockets();
 
 #ifdef WIN32
@@ -209,6 +350,18 @@ namespace Essentials
 #else
 			close(mSocket);
 			mSocket = -1;
+
+			if (mEpollFD != -1)
+			{
+				close(mEpollFD);
+				mEpollFD = -1;
+			}
+
+			if (mWakeFD != -1)
+			{
+				close(mWakeFD);
+				mWakeFD = -1;
+			}
 #endif
 			std::cout << "[SERVER] Stopped." << std::endl;
 		}
@@ -220,14 +373,269 @@ namespace Essentials
 				return -1; 
 			}
 
-			int bytesSent = send(clientFD, reinterpret_cast<const char*>(msg), msgSize, 0);
-			if (bytesSent < 0) 
+			return SendAll(clientFD, msg, msgSize, TCP_SEND_FLAGS);
+		}
+
+		int TCP_Server::SendBuffersToClient(const int clientFD, const iovec* buffers, const int count)
+		{
+			if (clientFD <= 0 || clientFD == mSocket || buffers == nullptr || count <= 0 || count > TCP_SERVER_MAX_IOVECS)
 			{
-				mLastError = TcpServerError::SEND_FAILED;
 				return -1;
 			}
 
-			return bytesSent;
+#ifdef WIN32
+			int totalSent = 0;
+			for (int i = 0; i < count; i++)
+			{
+				if (buffers[i].iov_len == 0)
+				{
+					continue;
+				}
+
+				if (SendAll(clientFD, static_cast<const uint8_t*>(buffers[i].iov_base), static_cast<int>(buffers[i].iov_len), TCP_SEND_FLAGS) < 0)
+				{
+					return -1;
+				}
+				totalSent += static_cast<int>(buffers[i].iov_len);
+			}
+
+			return totalSent;
+#else
+			int totalSize = 0;
+			for (int i = 0; i < count; i++)
+			{
+				totalSize += static_cast<int>(buffers[i].iov_len);
+			}
+
+			// Anything already waiting on the client goes first
+			if (mSendQueues.count(clientFD) > 0)
+			{
+				return QueueBuffers(clientFD, buffers, count) == 0 ? totalSize : -1;
+			}
+
+			// Work on a copy so a short write can be resumed part way through a buffer
+			iovec pending[TCP_SERVER_MAX_IOVECS];
+			memcpy(pending, buffers, sizeof(iovec) * count);
+
+			msghdr message{};
+			message.msg_iov = pending;
+			message.msg_iovlen = count;
+
+			int totalSent = 0;
+			while (message.msg_iovlen > 0)
+			{
+				ssize_t bytesSent = sendmsg(clientFD, &message, TCP_SEND_FLAGS);
+
+				if (bytesSent < 0)
+				{
+					if (errno == EINTR)
+					{
+						continue;
+					}
+
+					// The event loop sends the rest once the client has room
+					if (errno == EAGAIN || errno == EWOULDBLOCK)
+					{
+						return QueueBuffers(clientFD, message.msg_iov, static_cast<int>(message.msg_iovlen)) == 0 ? totalSize : -1;
+					}
+
+					mLastError = TcpServerError::SEND_FAILED;
+					return -1;
+				}
+
+				totalSent += static_cast<int>(bytesSent);
+
+				// Step over everything that went out
+				size_t sent = static_cast<size_t>(bytesSent);
+				while (message.msg_iovlen > 0 && sent >= message.msg_iov->iov_len)
+				{
+					sent -= message.msg_iov->iov_len;
+					message.msg_iov++;
+					message.msg_iovlen--;
+				}
+
+				if (message.msg_iovlen > 0)
+				{
+					message.msg_iov->iov_base = static_cast<uint8_t*>(message.msg_iov->iov_base) + sent;
+					message.msg_iov->iov_len -= sent;
+				}
+			}
+
+			return totalSent;
+#endif
+		}
+
+		int64_t TCP_Server::SendFileToClient(const int clientFD, const std::string& filePath, const uint64_t offset, const uint64_t length,
+			const uint8_t* header, const int headerSize, const uint8_t* footer, const int footerSize)
+		{
+			if (clientFD <= 0 || clientFD == mSocket)
+			{
+				return -1;
+			}
+
+			int64_t totalSent = 0;
+
+#ifdef WIN32
+			std::ifstream file(filePath, std::ios::binary);
+			if (!file.is_open())
+			{
+				mLastError = TcpServerError::FILE_OPEN_FAILED;
+				return -1;
+			}
+
+			if (header != nullptr && headerSize > 0)
+			{
+				if (SendAll(clientFD, header, headerSize, TCP_SEND_FLAGS) < 0)
+				{
+					return -1;
+				}
+				totalSent += headerSize;
+			}
+
+			// No sendfile here, stream through a fixed buffer so memory use doesn't grow with the file
+			std::vector<char> buffer(TCP_SERVER_RECEIVE_BUFFER_SIZE);
+			file.seekg(static_cast<std::streamoff>(offset));
+			uint64_t remaining = length;
+			while (remaining > 0)
+			{
+				std::streamsize count = static_cast<std::streamsize>(std::min<uint64_t>(remaining, buffer.size()));
+				if (!file.read(buffer.data(), count))
+				{
+					mLastError = TcpServerError::FILE_SEND_FAILED;
+					return -1;
+				}
+
+				if (SendAll(clientFD, reinterpret_cast<const uint8_t*>(buffer.data()), static_cast<int>(count), TCP_SEND_FLAGS) < 0)
+				{
+					return -1;
+				}
+				remaining -= static_cast<uint64_t>(count);
+				totalSent += count;
+			}
+#else
+			int fileFD = open(filePath.c_str(), O_RDONLY | O_CLOEXEC);
+			if (fileFD < 0)
+			{
+				mLastError = TcpServerError::FILE_OPEN_FAILED;
+				return -1;
+			}
+
+			// MSG_MORE holds the header back so it leaves in the same segment as the start of the file
+			if (header != nullptr && headerSize > 0)
+			{
+				if (SendAll(clientFD, header, headerSize, TCP_SEND_FLAGS | MSG_MORE) < 0)
+				{
+					close(fileFD);
+					return -1;
+				}
+				totalSent += headerSize;
+			}
+
+			// The kernel copies straight from the page cache to the socket, unless the header had to be queued
+			uint64_t position = offset;
+			uint64_t remaining = length;
+			while (remaining > 0 && mSendQueues.count(clientFD) == 0)
+			{
+				off_t filePosition = static_cast<off_t>(position);
+				ssize_t bytesSent = sendfile(clientFD, fileFD, &filePosition, static_cast<size_t>(std::min<uint64_t>(remaining, 0x40000000)));
+
+				if (bytesSent < 0)
+				{
+					if (errno == EINTR)
+					{
+						continue;
+					}
+
+					if (errno == EAGAIN || errno == EWOULDBLOCK)
+					{
+						break;
+					}
+				}
+
+				if (bytesSent <= 0)
+				{
+					// An error, or the file is shorter than the caller said
+					mLastError = TcpServerError::FILE_SEND_FAILED;
+					close(fileFD);
+					return -1;
+				}
+
+				position += static_cast<uint64_t>(bytesSent);
+				remaining -= static_cast<uint64_t>(bytesSent);
+			}
+
+			// The event loop carries on from where the socket filled up, the footer queues behind it
+			if (remaining > 0)
+			{
+				QueueFile(clientFD, fileFD, position, remaining);
+			}
+			else
+			{
+				close(fileFD);
+			}
+			totalSent += static_cast<int64_t>(length);
+#endif
+			if (footer != nullptr && footerSize > 0)
+			{
+				if (SendAll(clientFD, footer, footerSize, TCP_SEND_FLAGS) < 0)
+				{
+					return -1;
+				}
+				totalSent += footerSize;
+			}
+
+			return totalSent;
+		}
+
+		void TCP_Server::DisconnectClient(const int clientFD)
+		{
+			if (clientFD <= 0 || clientFD == mSocket)
+			{
+				return;
+			}
+
+			// Shutting down makes the socket readable with end of stream, the event loop then removes it
+			shutdown(clientFD, SD_BOTH);
+		}
+
+		int TCP_Server::SendAll(const int clientFD, const uint8_t* msg, const int msgSize, const int flags)
+		{
+#ifndef WIN32
+			// Anything already waiting on the client goes first
+			if (mSendQueues.count(clientFD) > 0)
+			{
+				iovec buffer = { const_cast<uint8_t*>(msg), static_cast<size_t>(msgSize) };
+				return QueueBuffers(clientFD, &buffer, 1) == 0 ? msgSize : -1;
+			}
+#endif
+			// Client sockets are non-blocking, hand the kernel as much as it will take
+			int totalSent = 0;
+			while (totalSent < msgSize)
+			{
+				int bytesSent = send(clientFD, reinterpret_cast<const char*>(msg) + totalSent, msgSize - totalSent, flags);
+				if (bytesSent < 0) 
+				{
+#ifndef WIN32
+					if (errno == EINTR)
+					{
+						continue;
+					}
+
+					// The event loop sends the rest once the client has room
+					if (errno == EAGAIN || errno == EWOULDBLOCK)
+					{
+						iovec rest = { const_cast<uint8_t*>(msg) + totalSent, static_cast<size_t>(msgSize - totalSent) };
+						return QueueBuffers(clientFD, &rest, 1) == 0 ? msgSize : -1;
+					}
+#endif
+					mLastError = TcpServerError::SEND_FAILED;
+					return -1;
+				}
+
+				totalSent += bytesSent;
+			}
+
+			return totalSent;
 		}
 
 		int TCP_Server::SendMessageToClient(const int clientFD, const std::string& message) 
@@ -263,6 +671,52 @@ namespace Essentials
 			mDisconnectHandler = handler;
 		}
 
+		void TCP_Server::SetMaxClients(const int maxClients)
+		{
+			mMaxClients = maxClients;
+		}
+
+		int TCP_Server::AddEventSource(const int fd, const std::function<void()>& handler)
+		{
+			if (fd < 0 || !handler)
+			{
+				mLastError = TcpServerError::EVENT_LOOP_FAILURE;
+				return -1;
+			}
+
+#ifndef WIN32
+			// Already started, add it to the live set. Otherwise Start adds it.
+			if (mEpollFD != -1 && mEventSources.count(fd) == 0)
+			{
+				epoll_event event{};
+				event.events = EPOLLIN | EPOLLET;
+				event.data.fd = fd;
+				if (epoll_ctl(mEpollFD, EPOLL_CTL_ADD, fd, &event) == -1)
+				{
+					mLastError = TcpServerError::EVENT_LOOP_FAILURE;
+					return -1;
+				}
+			}
+#endif
+			mEventSources[fd] = handler;
+			return 0;
+		}
+
+		void TCP_Server::RemoveEventSource(const int fd)
+		{
+			if (mEventSources.erase(fd) == 0)
+			{
+				return;
+			}
+
+#ifndef WIN32
+			if (mEpollFD != -1)
+			{
+				epoll_ctl(mEpollFD, EPOLL_CTL_DEL, fd, nullptr);
+			}
+#endif
+		}
+
 		int TCP_Server::ValidateIP(const std::string& ip)
 		{
 			// Regex expression for validating IPv4
@@ -296,15 +750,20 @@ namespace Essentials
 			for (auto& client : mClients)
 			{
 				std::lock_guard<std::mutex> clientLock(client.mutex);
+#ifndef WIN32
+				DropSendQueue(client.socket);
+#endif
 				SendShutdownMessage(client.socket);
 				CloseClientSocket(client.socket);
 			}
+
+			mClients.clear();
 		}
 
 		int TCP_Server::SendShutdownMessage(SOCKET clientSocket)
 		{
 			const char* shutdownMessage = "SERVER_SHUTDOWN";
-			return send(clientSocket, shutdownMessage, strlen(shutdownMessage), 0);
+			return send(clientSocket, shutdownMessage, strlen(shutdownMessage), TCP_SEND_FLAGS);
 		}
 
 		void TCP_Server::CloseClientSocket(SOCKET clientSocket) 
@@ -317,6 +776,298 @@ namespace Essentials
 			close(clientSocket);
 #endif
 		}
-	
+
+#ifndef WIN32
+		int TCP_Server::SetNonBlocking(SOCKET socket)
+		{
+			int flags = fcntl(socket, F_GETFL, 0);
+			if (flags == -1)
+			{
+				return -1;
+			}
+
+			return fcntl(socket, F_SETFL, flags | O_NONBLOCK);
+		}
+
+		void TCP_Server::AcceptClients()
+		{
+			// Edge triggered - drain the whole accept queue before going back to wait.
+			while (!mStopFlag)
+			{
+				sockaddr_in clientAddress{};
+				socklen_t addressLength = sizeof(clientAddress);
+				SOCKET clientSocket = accept4(mSocket, reinterpret_cast<sockaddr*>(&clientAddress), &addressLength, SOCK_NONBLOCK | SOCK_CLOEXEC);
+
+				if (clientSocket == -1)
+				{
+					if (errno == EINTR)
+					{
+						continue;
+					}
+
+					if (errno != EAGAIN && errno != EWOULDBLOCK)
+					{
+						mLastError = TcpServerError::ACCEPT_FAILED;
+					}
+					return;
+				}
+
+				if (static_cast<int>(mClients.size()) >= mMaxClients)
+				{
+					std::cout << "[SERVER] Client limit reached, refusing connection." << std::endl;
+					CloseClientSocket(clientSocket);
+					continue;
+				}
+
+				epoll_event event{};
+				event.events = EPOLLIN | EPOLLRDHUP | EPOLLET;
+				event.data.fd = clientSocket;
+				if (epoll_ctl(mEpollFD, EPOLL_CTL_ADD, clientSocket, &event) == -1)
+				{
+					mLastError = TcpServerError::EVENT_LOOP_FAILURE;
+					CloseClientSocket(clientSocket);
+					continue;
+				}
+
+				char ip[INET_ADDRSTRLEN] = { 0 };
+				inet_ntop(AF_INET, &clientAddress.sin_addr, ip, INET_ADDRSTRLEN);
+				mClients.emplace_back(std::string(ip), ntohs(clientAddress.sin_port), clientSocket, 0, 0, static_cast<std::int32_t>(time(nullptr)));
+
+				std::cout << "[SERVER] Client connected: " << ip << ":" << ntohs(clientAddress.sin_port) << std::endl;
+
+				if (mNewConnectionHandler)
+				{
+					mNewConnectionHandler(clientSocket);
+				}
+			}
+		}
+
+		void TCP_Server::ReadFromClient(SOCKET clientSocket)
+		{
+			// Edge triggered - read until the socket reports it would block.
+			while (!mStopFlag)
+			{
+				ssize_t bytesRead = recv(clientSocket, mReceiveBuffer.data(), mReceiveBuffer.size(), 0);
+
+				if (bytesRead > 0)
+				{
+					for (auto& client : mClients)
+					{
+						if (client.socket == clientSocket)
+						{
+							client.bytesReceived += static_cast<std::int32_t>(bytesRead);
+							break;
+						}
+					}
+
+					if (mMessageHandler)
+					{
+						mMessageHandler(clientSocket, std::string(mReceiveBuffer.data(), static_cast<size_t>(bytesRead)));
+					}
+					continue;
+				}
+
+				if (bytesRead == -1)
+				{
+					if (errno == EINTR)
+					{
+						continue;
+					}
+
+					if (errno == EAGAIN || errno == EWOULDBLOCK)
+					{
+						return;
+					}
+
+					mLastError = TcpServerError::RECEIVE_FAILED;
+				}
+
+				// Orderly shutdown from the client or a hard error
+				RemoveClient(clientSocket);
+				return;
+			}
+		}
+
+		void TCP_Server::RemoveClient(SOCKET clientSocket)
+		{
+			for (auto it = mClients.begin(); it != mClients.end(); ++it)
+			{
+				if (it->socket == clientSocket)
+				{
+					std::cout << "[SERVER] Client disconnected: " << it->ip << ":" << it->port << std::endl;
+					mClients.erase(it);
+					break;
+				}
+			}
+
+			epoll_ctl(mEpollFD, EPOLL_CTL_DEL, clientSocket, nullptr);
+			DropSendQueue(clientSocket);
+
+			if (mDisconnectHandler)
+			{
+				mDisconnectHandler(clientSocket);
+			}
+
+			CloseClientSocket(clientSocket);
+		}
+
+		void TCP_Server::WakeEventLoop()
+		{
+			if (mWakeFD != -1)
+			{
+				uint64_t one = 1;
+				ssize_t rtn = write(mWakeFD, &one, sizeof(one));
+				(void)rtn;
+			}
+		}
+
+		int TCP_Server::QueueBuffers(SOCKET clientSocket, const iovec* buffers, const int count)
+		{
+			auto queue = mSendQueues.find(clientSocket);
+			if (queue != mSendQueues.end() && queue->second.bufferedBytes > TCP_SERVER_MAX_QUEUED_BYTES)
+			{
+				// The client has stopped reading and part of a message may be out, it can't be kept
+				std::cout << "[SERVER] Client not reading its responses, disconnecting." << std::endl;
+				mLastError = TcpServerError::SEND_FAILED;
+				DisconnectClient(clientSocket);
+				return -1;
+			}
+
+			PendingSend pending = { {}, 0, -1, 0, 0 };
+			for (int i = 0; i < count; i++)
+			{
+				const uint8_t* data = static_cast<const uint8_t*>(buffers[i].iov_base);
+				pending.data.insert(pending.data.end(), data, data + buffers[i].iov_len);
+			}
+
+			if (!pending.data.empty())
+			{
+				Enqueue(clientSocket, std::move(pending));
+			}
+
+			return 0;
+		}
+
+		void TCP_Server::QueueFile(SOCKET clientSocket, const int fileFD, const uint64_t position, const uint64_t remaining)
+		{
+			Enqueue(clientSocket, { {}, 0, fileFD, position, remaining });
+		}
+
+		void TCP_Server::Enqueue(SOCKET clientSocket, PendingSend&& send)
+		{
+			auto inserted = mSendQueues.try_emplace(clientSocket);
+			SendQueue& queue = inserted.first->second;
+
+			if (inserted.second)
+			{
+				queue.bufferedBytes = 0;
+				WatchWritable(clientSocket, true);
+			}
+
+			queue.bufferedBytes += send.data.size();
+			queue.sends.push_back(std::move(send));
+		}
+
+		bool TCP_Server::FlushClient(SOCKET clientSocket)
+		{
+			auto queue = mSendQueues.find(clientSocket);
+			if (queue == mSendQueues.end())
+			{
+				return true;
+			}
+
+			auto& sends = queue->second.sends;
+			while (!sends.empty())
+			{
+				PendingSend& pending = sends.front();
+				ssize_t bytesSent = 0;
+
+				if (pending.fileFD == -1)
+				{
+					// Hold back a partial segment while more is queued behind it
+					int flags = TCP_SEND_FLAGS | (sends.size() > 1 ? MSG_MORE : 0);
+					bytesSent = send(clientSocket, pending.data.data() + pending.sent, pending.data.size() - pending.sent, flags);
+				}
+				else
+				{
+					off_t position = static_cast<off_t>(pending.position);
+					bytesSent = sendfile(clientSocket, pending.fileFD, &position, static_cast<size_t>(std::min<uint64_t>(pending.remaining, 0x40000000)));
+				}
+
+				if (bytesSent < 0 && errno == EINTR)
+				{
+					continue;
+				}
+
+				if (bytesSent < 0 && (errno == EAGAIN || errno == EWOULDBLOCK))
+				{
+					// Full again, wait for the next EPOLLOUT
+					return true;
+				}
+
+				if (bytesSent <= 0)
+				{
+					// An error, or a file shorter than the caller said, the client would be out of step
+					mLastError = pending.fileFD == -1 ? TcpServerError::SEND_FAILED : TcpServerError::FILE_SEND_FAILED;
+					RemoveClient(clientSocket);
+					return false;
+				}
+
+				if (pending.fileFD == -1)
+				{
+					pending.sent += static_cast<size_t>(bytesSent);
+					if (pending.sent < pending.data.size())
+					{
+						continue;
+					}
+					queue->second.bufferedBytes -= pending.data.size();
+				}
+				else
+				{
+					pending.position += static_cast<uint64_t>(bytesSent);
+					pending.remaining -= static_cast<uint64_t>(bytesSent);
+					if (pending.remaining > 0)
+					{
+						continue;
+					}
+					close(pending.fileFD);
+				}
+
+				sends.pop_front();
+			}
+
+			// Everything is out, sends go straight to the socket again
+			mSendQueues.erase(queue);
+			WatchWritable(clientSocket, false);
+			return true;
+		}
+
+		void TCP_Server::DropSendQueue(SOCKET clientSocket)
+		{
+			auto queue = mSendQueues.find(clientSocket);
+			if (queue == mSendQueues.end())
+			{
+				return;
+			}
+
+			for (const PendingSend& pending : queue->second.sends)
+			{
+				if (pending.fileFD != -1)
+				{
+					close(pending.fileFD);
+				}
+			}
+
+			mSendQueues.erase(queue);
+		}
+
+		void TCP_Server::WatchWritable(SOCKET clientSocket, const bool writable)
+		{
+			epoll_event event{};
+			event.events = EPOLLIN | EPOLLRDHUP | EPOLLET | (writable ? static_cast<uint32_t>(EPOLLOUT) : 0u);
+			event.data.fd = clientSocket;
+			epoll_ctl(mEpollFD, EPOLL_CTL_MOD, clientSocket, &event);
+		}
+#endif
 	}
 }
\ No newline at end of file
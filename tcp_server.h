@@ -12,11 +12,25 @@
 #ifdef WIN32
 #include <ws2tcpip.h>
 #pragma comment(lib, "ws2_32.lib")
+struct iovec
+{
+	void*	iov_base;					// Start of the buffer
+	size_t	iov_len;					// Size of the buffer
+};
 #else
 #include <sys/socket.h>
+#include <sys/uio.h>					// Scatter-gather sends
+#include <sys/epoll.h>					// Event loop readiness notification
+#include <sys/eventfd.h>				// Event loop wake up
+#include <sys/sendfile.h>				// Zero copy file transfers
 #include <netinet/in.h>
 #include <arpa/inet.h>
 #include <unistd.h>
+#include <fcntl.h>						// Non-blocking sockets
+#include <cerrno>						// errno
+#include <csignal>						// Ignoring SIGPIPE
+#ifndef ESSENTIALS_SOCKET_TYPES
+#define ESSENTIALS_SOCKET_TYPES
 typedef int SOCKET;
 typedef struct sockaddr_in SOCKADDR_IN;
 typedef struct sockaddr SOCKADDR;
@@ -25,6 +39,8 @@ const int SOCKET_ERROR = -1;
 const int SD_BOTH = SHUT_RDWR;
 #define closesocket(s) close(s)
 #endif
+#endif
+#include <cstring>						// memset, strlen
 #include <cstdint>						// Standard integer types
 #include <map>							// Error enum to strings.
 #include <string>						// Strings
@@ -32,9 +48,11 @@ const int SD_BOTH = SHUT_RDWR;
 #include <thread>						// Multiple threads for monitor and clients. 
 #include <atomic>						// Thread instance stop flag
 #include <vector>						// Client thread list 
+#include <deque>						// Sends queued behind a full send buffer
 #include <iostream>						// Prints 
 #include <mutex>
 #include <functional>
+#include <fstream>						// File transfer fallback
 //
 //	Defines:
 //          name                        reason defined
@@ -42,6 +60,12 @@ const int SD_BOTH = SHUT_RDWR;
 #ifndef     TCP_SERVER					// Define the cpp tcp server class. 
 #define     TCP_SERVER
 //
+#ifdef WIN32
+#define		TCP_SEND_FLAGS	0			// Flags passed to send()
+#else
+#define		TCP_SEND_FLAGS	MSG_NOSIGNAL	// Don't raise SIGPIPE on a dropped client
+#endif
+//
 ///////////////////////////////////////////////////////////////////////////////
 
 namespace Essentials
@@ -136,6 +160,11 @@ namespace Essentials
 
 			static const std::string TcpServerVersion;
 
+			static constexpr int TCP_SERVER_MAX_EVENTS = 64;				// Maximum events handled per event loop wake up
+			static constexpr int TCP_SERVER_RECEIVE_BUFFER_SIZE = 65536;	// Size of the shared client receive buffer
+			static constexpr size_t TCP_SERVER_MAX_QUEUED_BYTES = 4 * 1024 * 1024;	// Buffered bytes a client may have queued before further sends fail
+			static constexpr int TCP_SERVER_MAX_IOVECS = 16;				// Maximum buffers passed to SendBuffersToClient
+
 			/// @brief enum for error codes
 			enum class TcpServerError : uint8_t
 			{
@@ -157,6 +186,10 @@ namespace Essentials
 				ECHO_FAILED,
 				RECEIVE_FAILED,
 				SEND_FAILED,
+				SERVER_NOT_STARTED,
+				EVENT_LOOP_FAILURE,
+				FILE_OPEN_FAILED,
+				FILE_SEND_FAILED,
 			};
 
 			/// @brief Error enum to string map
@@ -188,29 +221,63 @@ namespace Essentials
 			/// @return 0 if successful, -1 if fails. Call Serial::GetLastError to find out more.
 			int Start();
 
-			/// @brief a blocking function that runs the server interface and listens for clients communication
+			/// @brief a blocking function that runs the server interface and listens for clients communication.
+			/// Accepts new clients and dispatches received data to the message callback until Stop is called.
+			/// @return 0 if stopped cleanly, -1 if fails. Call TCP_Server::GetLastError to find out more.
 			int Run();
 
-			/// @brief Stops the server if it is running
+			/// @brief Stops the server if it is running. Safe to call from within a callback, in which case
+			/// Run will return once the current callback completes.
 			void Stop();
 
 			/// @brief Sends a buffer to a client 
 			/// @param clientFD - in - the file descriptor for the client to send to
 			/// @param msg - in - the buffer to be sent to the client
 			/// @param msgSize - in - the size of the data to be sent. 
-			/// @return -1 on error, else number of bytes sent
+			/// @return -1 on error, else number of bytes sent or queued
 			int SendBufferToClient(const int clientFD, const uint8_t* msg, const int msgSize);
 
+			/// @brief Sends several buffers to a client as one message with a single gather write
+			/// @param clientFD - in - the file descriptor for the client to send to
+			/// @param buffers - in - the buffers to be sent, in order
+			/// @param count - in - the number of buffers, up to TCP_SERVER_MAX_IOVECS
+			/// @return -1 on error, else number of bytes sent or queued
+			int SendBuffersToClient(const int clientFD, const iovec* buffers, const int count);
+
+			/// @brief Sends a range of a file to a client, straight from the page cache where the platform allows.
+			/// An optional header and footer are sent around the file contents as one message. What the client
+			/// can't take yet is queued and carried on by the event loop, later sends to the client go behind it.
+			/// @param clientFD - in - the file descriptor for the client to send to
+			/// @param filePath - in - path of the file to be sent
+			/// @param offset - in - offset in the file to start sending from
+			/// @param length - in - number of file bytes to be sent
+			/// @param header - in - optional buffer sent ahead of the file contents
+			/// @param headerSize - in - size of the header
+			/// @param footer - in - optional buffer sent after the file contents
+			/// @param footerSize - in - size of the footer
+			/// @return -1 on error, else number of bytes sent or queued
+			int64_t SendFileToClient(const int clientFD, const std::string& filePath, const uint64_t offset, const uint64_t length,
+				const uint8_t* header = nullptr, const int headerSize = 0, const uint8_t* footer = nullptr, const int footerSize = 0);
+
+			/// @brief Disconnects a client. The client is removed and the disconnect callback called by the event loop.
+			/// @param clientFD - in - the file descriptor for the client to disconnect
+			void DisconnectClient(const int clientFD);
+
 			/// @brief Sends a message to a client 
 			/// @param clientFD - in - the file descriptor for the client to send to
 			/// @param msg - in - the buffer to be sent to the client
-			/// @return -1 on error, else number of bytes sent
+			/// @return -1 on error, else number of bytes sent or queued
 			int SendMessageToClient(const int clientFD, const std::string& msg);
 
 			/// @brief Get the last error in string format
 			/// @return The last error in a formatted string
 			std::string GetLastError();
 
+			/// @brief Changes the maximum number of clients. Clients already connected are kept, the limit 
+			/// applies to new connections. Safe to call from any thread.
+			/// @param maxClients - in - Maximum number of clients the server should handle concurrently
+			void SetMaxClients(const int maxClients);
+
 			/// @brief Set a function to be called when a new connection is established
 			/// @param handler - in - Function to be used as a callback for a new connection 
 			void SetConnectionCallback(const std::function<int(const int)>& handler);
@@ -223,8 +290,36 @@ namespace Essentials
 			/// @param handler - in - Function to be used as a callback for a client disconnect
 			void SetDisconnectCallback(const std::function<int(const int)>& handler);
 
+			/// @brief Adds a descriptor, such as a timerfd, to the event loop. The handler is called from Run 
+			/// whenever it becomes readable and must drain it. Can be called before or after Start.
+			/// @param fd - in - the file descriptor to watch
+			/// @param handler - in - Function to be called when the descriptor is readable
+			/// @return 0 if successful, -1 if fails. Call TCP_Server::GetLastError to find out more.
+			int AddEventSource(const int fd, const std::function<void()>& handler);
+
+			/// @brief Removes a descriptor added with AddEventSource
+			/// @param fd - in - the file descriptor to stop watching
+			void RemoveEventSource(const int fd);
+
 		protected:
 		private:
+			/// @brief Part of a send waiting on a client's full send buffer, a buffer or a range of a file
+			struct PendingSend
+			{
+				std::vector<uint8_t> data;		// Buffer to send, empty for a file range
+				size_t sent;					// Bytes of the buffer already sent
+				int fileFD;						// File to send from, -1 for a buffer
+				uint64_t position;				// Next offset in the file to send
+				uint64_t remaining;				// File bytes still to send
+			};
+
+			/// @brief Sends waiting on a client, in the order they were made
+			struct SendQueue
+			{
+				std::deque<PendingSend> sends;	// Queued sends, the front one is in progress
+				size_t bufferedBytes;			// Bytes held in queued buffers
+			};
+
 			/// @brief Validates an IP address is IPv4 or IPv6
 			/// @param ip - in - IP Address to be validated
 			/// @return -1 = bad IP, 1 = valid IPv4, 2 = valid IPv6
@@ -238,17 +333,83 @@ namespace Essentials
 			/// @brief Sends server shutdown message to a client
 			int SendShutdownMessage(SOCKET clientSocket);
 
+			/// @brief Sends a whole buffer to a client, queueing what its full send buffer won't take
+			/// @param clientFD - in - the file descriptor for the client to send to
+			/// @param msg - in - the buffer to be sent to the client
+			/// @param msgSize - in - the size of the data to be sent. 
+			/// @param flags - in - flags passed to send
+			/// @return -1 on error, else number of bytes sent or queued
+			int SendAll(const int clientFD, const uint8_t* msg, const int msgSize, const int flags);
+
 			/// @brief Close a single client connection
 			void CloseClientSocket(SOCKET clientSocket);
 			
 			/// @brief Close all client sockets in mClient vector
 			void CloseAllClientSockets();
 
+			/// @brief Closes the clients, the server socket and the event loop descriptors
+			void CloseServer();
+
+#ifndef WIN32
+			/// @brief Sets a socket to non-blocking mode
+			/// @param socket - in - socket to be modified
+			/// @return 0 if successful, -1 if fails.
+			int SetNonBlocking(SOCKET socket);
+
+			/// @brief Accepts all pending connections on the server socket
+			void AcceptClients();
+
+			/// @brief Reads all available data from a client and passes it to the message callback
+			/// @param clientSocket - in - socket of the client to read from
+			void ReadFromClient(SOCKET clientSocket);
+
+			/// @brief Removes a client from the event loop, closes it and notifies the disconnect callback
+			/// @param clientSocket - in - socket of the client to remove
+			void RemoveClient(SOCKET clientSocket);
+
+			/// @brief Wakes the event loop so it can observe the stop flag
+			void WakeEventLoop();
+
+			/// @brief Queues buffers behind a client's other sends as one, watching for the client becoming writable
+			/// @param clientSocket - in - socket of the client to queue for
+			/// @param buffers - in - the buffers to be queued, in order
+			/// @param count - in - the number of buffers
+			/// @return 0 if successful, -1 if the client already has more than TCP_SERVER_MAX_QUEUED_BYTES queued
+			int QueueBuffers(SOCKET clientSocket, const iovec* buffers, const int count);
+
+			/// @brief Queues a range of a file behind a client's other sends, the queue closes the file
+			/// @param clientSocket - in - socket of the client to queue for
+			/// @param fileFD - in - open file to send from
+			/// @param position - in - offset in the file to start sending from
+			/// @param remaining - in - number of file bytes to be sent
+			void QueueFile(SOCKET clientSocket, const int fileFD, const uint64_t position, const uint64_t remaining);
+
+			/// @brief Adds a send to a client's queue
+			/// @param clientSocket - in - socket of the client to queue for
+			/// @param send - in - the send to be queued
+			void Enqueue(SOCKET clientSocket, PendingSend&& send);
+
+			/// @brief Carries on a client's queued sends until they finish or its send buffer fills again
+			/// @param clientSocket - in - socket of the client that became writable
+			/// @return false if a send failed and the client was removed
+			bool FlushClient(SOCKET clientSocket);
+
+			/// @brief Drops a client's queued sends, closing any files
+			/// @param clientSocket - in - socket of the client
+			void DropSendQueue(SOCKET clientSocket);
+
+			/// @brief Turns watching a client for becoming writable on or off
+			/// @param clientSocket - in - socket of the client
+			/// @param writable - in - true to be told when the client can take more data
+			void WatchWritable(SOCKET clientSocket, const bool writable);
+#endif
+
 			std::string mAddress;				// Address of the TCP server
 			int mPort;							// Port of the TCP server
-			int mMaxClients;					// Holds maximum number of allowed client connections
+			std::atomic<int> mMaxClients;		// Holds maximum number of allowed client connections
 			TcpServerError mLastError;			// Holds last error of the TCP server
 			std::atomic<bool> mStopFlag;		// Stop flag for the server. 
+			std::atomic<bool> mRunning;			// True while Run is processing the event loop
 			std::vector<Client> mClients;		// Vector of clients
 			SOCKET mSocket;						// Server socket
 
@@ -261,11 +422,17 @@ namespace Essentials
 			// callback function to be called when client disconnects
 			std::function<int(const int fd)> mDisconnectHandler;						
 
+			// extra descriptors serviced by the event loop
+			std::map<int, std::function<void()>> mEventSources;
+
 #ifdef WIN32
 			WSADATA mWsaData;					// Win socket data
 			fd_set	mFDs;						// Windows FD list
 #else
-			pollfd* mFDs;						// Pointer for an array of file descriptors
+			int mEpollFD;						// Event loop epoll instance
+			int mWakeFD;						// eventfd used to wake the event loop on stop
+			std::vector<char> mReceiveBuffer;	// Buffer client data is read into
+			std::map<int, SendQueue> mSendQueues;	// Sends waiting on clients with a full send buffer
 #endif
 		};
 
@@ -0,0 +1,37 @@
+///////////////////////////////////////////////////////////////////////////////
+//! @file		test_check.h
+//! @brief		Minimal check macros shared by the unit tests
+//! @author		Chip Brommer
+///////////////////////////////////////////////////////////////////////////////
+#pragma once
+///////////////////////////////////////////////////////////////////////////////
+//
+//  Includes:
+//          name                        reason included
+//          --------------------        ---------------------------------------
+#include <iostream>						// Failure output
+//
+///////////////////////////////////////////////////////////////////////////////
+
+/// @brief Failed checks in this test, main returns it
+static int gTestFailures = 0;
+
+/// @brief Records a failure with where it happened when cond is false, carries on either way
+#define CHECK(cond)																	\
+	do																				\
+	{																				\
+		if (!(cond))																\
+		{																			\
+			std::cerr << __FILE__ << ":" << __LINE__ << ": CHECK(" #cond ") failed\n";	\
+			gTestFailures++;														\
+		}																			\
+	} while (0)
+
+/// @brief Reports the result of the test
+/// @param name -[in]- Name of the test
+/// @return 0 if every check passed, 1 if not
+static int TestResult(const char* name)
+{
+	std::cout << name << ": " << (gTestFailures == 0 ? "passed" : "FAILED") << " (" << gTestFailures << " failures)\n";
+	return gTestFailures == 0 ? 0 : 1;
+}
@@ -0,0 +1,99 @@
+///////////////////////////////////////////////////////////////////////////////
+//! @file		test_crc32c.cpp
+//! @brief		CRC32C tests, built once as is and once with CRC32C_PORTABLE_ONLY
+//! @author		Chip Brommer
+///////////////////////////////////////////////////////////////////////////////
+//
+//  Includes:
+//          name                        reason included
+//          --------------------        ---------------------------------------
+#include "test_check.h"					// CHECK
+#include "crc32c.h"						// Crc32c
+#include <vector>						// Test data
+//
+///////////////////////////////////////////////////////////////////////////////
+
+using namespace Essentials::Utilities;
+
+/// @brief Bit at a time CRC32C to check the fast paths against
+static uint32_t ReferenceCrc32c(const uint8_t* data, const size_t size)
+{
+	uint32_t crc = 0xFFFFFFFF;
+	for (size_t i = 0; i < size; i++)
+	{
+		crc ^= data[i];
+		for (int bit = 0; bit < 8; bit++)
+		{
+			crc = (crc >> 1) ^ ((crc & 1) ? 0x82F63B78 : 0);
+		}
+	}
+	return ~crc;
+}
+
+/// @brief The standard check value and the RFC 3720 iSCSI vectors
+static void TestKnownAnswers()
+{
+	const uint8_t check[] = { '1', '2', '3', '4', '5', '6', '7', '8', '9' };
+	CHECK(Crc32c(check, sizeof(check)) == 0xE3069283);
+	CHECK(Crc32c(nullptr, 0) == 0);
+
+	uint8_t data[32] = { 0 };
+	CHECK(Crc32c(data, sizeof(data)) == 0x8A9136AA);
+
+	memset(data, 0xFF, sizeof(data));
+	CHECK(Crc32c(data, sizeof(data)) == 0x62A8AB43);
+
+	for (uint8_t i = 0; i < sizeof(data); i++)
+	{
+		data[i] = i;
+	}
+	CHECK(Crc32c(data, sizeof(data)) == 0x46DD794E);
+
+	for (uint8_t i = 0; i < sizeof(data); i++)
+	{
+		data[i] = static_cast<uint8_t>(31 - i);
+	}
+	CHECK(Crc32c(data, sizeof(data)) == 0x113FDB5C);
+}
+
+/// @brief Every length and alignment agrees with the reference, in one piece or split anywhere
+static void TestAgainstReference()
+{
+	std::vector<uint8_t> data(4096 + 16);
+	uint32_t seed = 12345;
+	for (auto& byte : data)
+	{
+		seed = seed * 1103515245 + 12345;
+		byte = static_cast<uint8_t>(seed >> 16);
+	}
+
+	for (size_t offset = 0; offset < 8; offset++)
+	{
+		for (size_t size = 0; size <= 100; size++)
+		{
+			CHECK(Crc32c(data.data() + offset, size) == ReferenceCrc32c(data.data() + offset, size));
+		}
+	}
+
+	uint32_t whole = ReferenceCrc32c(data.data(), 4096);
+	CHECK(Crc32c(data.data(), 4096) == whole);
+	for (size_t split = 0; split <= 4096; split += 37)
+	{
+		CHECK(Crc32c(data.data() + split, 4096 - split, Crc32c(data.data(), split)) == whole);
+	}
+}
+
+int main()
+{
+#ifdef CRC32C_PORTABLE_ONLY
+	CHECK(!Crc32cIsAccelerated());
+	const char* name = "test_crc32c_portable";
+#else
+	const char* name = "test_crc32c";
+#endif
+	std::cout << name << ": " << (Crc32cIsAccelerated() ? "CPU instructions" : "table") << "\n";
+
+	TestKnownAnswers();
+	TestAgainstReference();
+	return TestResult(name);
+}
@@ -0,0 +1,202 @@
+///////////////////////////////////////////////////////////////////////////////
+//! @file		test_frame_assembler.cpp
+//! @brief		Frame assembler tests, splitting, batching and resynchronizing
+//! @author		Chip Brommer
+///////////////////////////////////////////////////////////////////////////////
+//
+//  Includes:
+//          name                        reason included
+//          --------------------        ---------------------------------------
+#include "test_check.h"					// CHECK
+#include "frame_assembler.h"			// FrameAssembler
+#include <vector>						// Test data
+//
+///////////////////////////////////////////////////////////////////////////////
+
+/// @brief Builds a frame of header, payload and footer, the payload never contains SYNC1
+static std::vector<uint8_t> MakeFrame(const size_t payloadSize, const uint8_t seed)
+{
+	std::vector<uint8_t> frame(sizeof(UPDATER_HEADER) + payloadSize + sizeof(UPDATER_FOOTER));
+
+	UPDATER_HEADER header = { SYNC1, SYNC2, SYNC3, SYNC4, static_cast<uint32_t>(frame.size()) };
+	memcpy(frame.data(), &header, sizeof(header));
+
+	for (size_t i = 0; i < payloadSize; i++)
+	{
+		frame[sizeof(header) + i] = static_cast<uint8_t>(0x20 + (seed + i) % 0x60);
+	}
+
+	UPDATER_FOOTER footer = { EOB };
+	memcpy(frame.data() + frame.size() - sizeof(footer), &footer, sizeof(footer));
+	return frame;
+}
+
+/// @brief Collects a copy of every frame handed out
+struct Collector
+{
+	std::vector<std::vector<uint8_t>> frames;
+
+	FrameHandler Handler()
+	{
+		return [this](const uint8_t* frame, const uint32_t size) { frames.emplace_back(frame, frame + size); };
+	}
+};
+
+/// @brief A frame trickling in a byte at a time and in odd sized pieces comes out once and intact
+static void TestSplitFrame()
+{
+	std::vector<uint8_t> frame = MakeFrame(300, 1);
+
+	FrameAssembler assembler;
+	Collector collector;
+	int frames = 0;
+	for (size_t i = 0; i < frame.size(); i++)
+	{
+		frames += assembler.Push(frame.data() + i, 1, collector.Handler());
+		if (i + 1 < frame.size())
+		{
+			CHECK(collector.frames.empty());
+		}
+	}
+	CHECK(frames == 1);
+	CHECK(collector.frames.size() == 1);
+	CHECK(collector.frames.size() == 1 && collector.frames[0] == frame);
+
+	// Pieces that don't line up with the header, including a split in the middle of the sync bytes
+	std::vector<uint8_t> stream = MakeFrame(100, 2);
+	std::vector<uint8_t> second = MakeFrame(50, 3);
+	stream.insert(stream.end(), second.begin(), second.end());
+
+	collector.frames.clear();
+	for (size_t i = 0; i < stream.size(); i += 7)
+	{
+		assembler.Push(stream.data() + i, std::min<size_t>(7, stream.size() - i), collector.Handler());
+	}
+	CHECK(collector.frames.size() == 2);
+	CHECK(collector.frames.size() == 2 && collector.frames[1] == second);
+	CHECK(assembler.GetDroppedBytes() == 0);
+}
+
+/// @brief Several frames in one receive all come out of the one Push, in order
+static void TestBatchedFrames()
+{
+	std::vector<std::vector<uint8_t>> sent = { MakeFrame(0, 0), MakeFrame(10, 1), MakeFrame(1000, 2), MakeFrame(3, 3) };
+	std::vector<uint8_t> stream;
+	for (const std::vector<uint8_t>& frame : sent)
+	{
+		stream.insert(stream.end(), frame.begin(), frame.end());
+	}
+
+	// Plus the start of one more, which should wait for the rest
+	std::vector<uint8_t> last = MakeFrame(20, 4);
+	stream.insert(stream.end(), last.begin(), last.begin() + 10);
+
+	FrameAssembler assembler;
+	Collector collector;
+	CHECK(assembler.Push(stream.data(), stream.size(), collector.Handler()) == 4);
+	CHECK(collector.frames == sent);
+
+	CHECK(assembler.Push(last.data() + 10, last.size() - 10, collector.Handler()) == 1);
+	CHECK(collector.frames.size() == 5 && collector.frames[4] == last);
+	CHECK(assembler.GetDroppedBytes() == 0);
+}
+
+/// @brief Bytes ahead of the sync pattern are skipped and counted
+static void TestGarbageBeforeSync()
+{
+	std::vector<uint8_t> stream = { 0x00, 0xFF, SYNC2, SYNC3, SYNC4, 0x42, SYNC1, SYNC2, 0x00 };
+	const size_t garbage = stream.size();
+	std::vector<uint8_t> frame = MakeFrame(40, 5);
+	stream.insert(stream.end(), frame.begin(), frame.end());
+
+	FrameAssembler assembler;
+	Collector collector;
+	CHECK(assembler.Push(stream.data(), stream.size(), collector.Handler()) == 1);
+	CHECK(collector.frames.size() == 1 && collector.frames[0] == frame);
+	CHECK(assembler.GetDroppedBytes() == garbage);
+}
+
+/// @brief A full sync pattern that isn't a frame doesn't swallow the real frame behind it
+static void TestFalseSync()
+{
+	std::vector<uint8_t> frame = MakeFrame(60, 6);
+
+	// A plausible length that runs into the real frame, its footer won't match
+	std::vector<uint8_t> stream = { SYNC1, SYNC2, SYNC3, SYNC4 };
+	uint32_t falseSize = 24;
+	stream.insert(stream.end(), reinterpret_cast<uint8_t*>(&falseSize), reinterpret_cast<uint8_t*>(&falseSize) + sizeof(falseSize));
+	stream.insert(stream.end(), frame.begin(), frame.end());
+
+	FrameAssembler assembler;
+	Collector collector;
+	CHECK(assembler.Push(stream.data(), stream.size(), collector.Handler()) == 1);
+	CHECK(collector.frames.size() == 1 && collector.frames[0] == frame);
+	CHECK(assembler.GetDroppedBytes() == sizeof(UPDATER_HEADER));
+
+	// The same again fed a byte at a time, so the false frame has to be buffered first
+	FrameAssembler trickled;
+	collector.frames.clear();
+	for (size_t i = 0; i < stream.size(); i++)
+	{
+		trickled.Push(stream.data() + i, 1, collector.Handler());
+	}
+	CHECK(collector.frames.size() == 1 && collector.frames[0] == frame);
+	CHECK(trickled.GetDroppedBytes() == sizeof(UPDATER_HEADER));
+
+	// A length too small to hold the header and footer is rejected straight away
+	std::vector<uint8_t> shortStream = { SYNC1, SYNC2, SYNC3, SYNC4, 2, 0, 0, 0 };
+	shortStream.insert(shortStream.end(), frame.begin(), frame.end());
+
+	FrameAssembler rejecting;
+	collector.frames.clear();
+	CHECK(rejecting.Push(shortStream.data(), shortStream.size(), collector.Handler()) == 1);
+	CHECK(collector.frames.size() == 1 && collector.frames[0] == frame);
+}
+
+/// @brief A frame claiming more than the maximum is dropped without waiting for it
+static void TestOversizedFrame()
+{
+	FrameAssembler assembler(128);
+	Collector collector;
+
+	std::vector<uint8_t> tooBig = MakeFrame(128, 7);
+	std::vector<uint8_t> fits = MakeFrame(128 - sizeof(UPDATER_HEADER) - sizeof(UPDATER_FOOTER), 8);
+	std::vector<uint8_t> stream = tooBig;
+	stream.insert(stream.end(), fits.begin(), fits.end());
+
+	CHECK(assembler.Push(stream.data(), stream.size(), collector.Handler()) == 1);
+	CHECK(collector.frames.size() == 1 && collector.frames[0] == fits);
+	CHECK(assembler.GetDroppedBytes() == tooBig.size());
+
+	// A huge length on its own mustn't leave the assembler waiting for bytes that never come
+	std::vector<uint8_t> huge = { SYNC1, SYNC2, SYNC3, SYNC4, 0xFF, 0xFF, 0xFF, 0xFF };
+	std::vector<uint8_t> after = MakeFrame(16, 9);
+	collector.frames.clear();
+	CHECK(assembler.Push(huge.data(), huge.size(), collector.Handler()) == 0);
+	CHECK(assembler.Push(after.data(), after.size(), collector.Handler()) == 1);
+	CHECK(collector.frames.size() == 1 && collector.frames[0] == after);
+}
+
+/// @brief Reset throws away a partial frame
+static void TestReset()
+{
+	std::vector<uint8_t> frame = MakeFrame(30, 10);
+
+	FrameAssembler assembler;
+	Collector collector;
+	CHECK(assembler.Push(frame.data(), 20, collector.Handler()) == 0);
+	assembler.Reset();
+	CHECK(assembler.Push(frame.data(), frame.size(), collector.Handler()) == 1);
+	CHECK(collector.frames.size() == 1 && collector.frames[0] == frame);
+}
+
+int main()
+{
+	TestSplitFrame();
+	TestBatchedFrames();
+	TestGarbageBeforeSync();
+	TestFalseSync();
+	TestOversizedFrame();
+	TestReset();
+	return TestResult("test_frame_assembler");
+}
@@ -0,0 +1,139 @@
+///////////////////////////////////////////////////////////////////////////////
+//! @file		test_merkle_manifest.cpp
+//! @brief		MerkleManifest and ChunkVerifier tests, root known answer and leaf checks
+//! @author		Chip Brommer
+///////////////////////////////////////////////////////////////////////////////
+//
+//  Includes:
+//          name                        reason included
+//          --------------------        ---------------------------------------
+#include "test_check.h"					// CHECK
+#include "merkle_manifest.h"			// MerkleManifest, ChunkVerifier
+//
+///////////////////////////////////////////////////////////////////////////////
+
+using namespace Essentials::Utilities;
+
+constexpr uint32_t	TEST_CHUNK_SIZE	= MERKLE_MIN_CHUNK_SIZE;
+constexpr size_t	TEST_IMAGE_SIZE	= 4 * TEST_CHUNK_SIZE + 100;	// Five leaves, the last short
+
+// Root of the test image, worked out independently of this code
+static const char*	TEST_ROOT		= "c6e16400705894525cb34e88d3f884bfa192d1651e7aee8d92c6a43e274276b1";
+
+/// @brief Builds the test image
+static std::vector<uint8_t> MakeImage()
+{
+	std::vector<uint8_t> image(TEST_IMAGE_SIZE);
+	for (size_t i = 0; i < image.size(); i++)
+	{
+		image[i] = static_cast<uint8_t>(i % 251);
+	}
+	return image;
+}
+
+/// @brief Hashes the image into its leaves
+static std::vector<Sha256Digest> MakeLeaves(const std::vector<uint8_t>& image)
+{
+	std::vector<Sha256Digest> leaves;
+	for (size_t offset = 0; offset < image.size(); offset += TEST_CHUNK_SIZE)
+	{
+		leaves.push_back(MerkleManifest::HashLeaf(image.data() + offset, std::min<size_t>(TEST_CHUNK_SIZE, image.size() - offset)));
+	}
+	return leaves;
+}
+
+/// @brief Builds an UPDATE_OFS_MANIFEST payload
+static std::string MakeManifest(const std::vector<Sha256Digest>& leaves, const Sha256Digest& root)
+{
+	MERKLE_MANIFEST_HEADER header = { 0 };
+	header.transferId	= 7;
+	header.imageSize	= TEST_IMAGE_SIZE;
+	header.chunkSize	= TEST_CHUNK_SIZE;
+	header.leafCount	= static_cast<uint32_t>(leaves.size());
+	memcpy(header.root, root.data(), sizeof(header.root));
+
+	std::string manifest(reinterpret_cast<const char*>(&header), sizeof(header));
+	for (const auto& leaf : leaves)
+	{
+		manifest.append(reinterpret_cast<const char*>(leaf.data()), leaf.size());
+	}
+	return manifest;
+}
+
+/// @brief The root matches a known answer and the manifest only parses with it
+static void TestRoot()
+{
+	std::vector<uint8_t> image = MakeImage();
+	std::vector<Sha256Digest> leaves = MakeLeaves(image);
+	CHECK(leaves.size() == 5);
+
+	Sha256Digest root = MerkleManifest::ComputeRoot(leaves);
+	CHECK(Sha256::ToHex(root) == TEST_ROOT);
+
+	MerkleManifest manifest;
+	std::string payload = MakeManifest(leaves, root);
+	CHECK(manifest.Parse(reinterpret_cast<const uint8_t*>(payload.data()), payload.size()) == 0);
+	CHECK(manifest.GetLeafCount() == 5);
+	CHECK(manifest.IsAligned(0, TEST_CHUNK_SIZE));
+	CHECK(manifest.IsAligned(4 * TEST_CHUNK_SIZE, 100));
+	CHECK(!manifest.IsAligned(1, TEST_CHUNK_SIZE));
+	CHECK(!manifest.IsAligned(0, TEST_CHUNK_SIZE + 1));
+
+	// A leaf that doesn't add up to the root is refused
+	std::vector<Sha256Digest> bad = leaves;
+	bad[3][0] ^= 1;
+	payload = MakeManifest(bad, root);
+	CHECK(manifest.Parse(reinterpret_cast<const uint8_t*>(payload.data()), payload.size()) == -1);
+	CHECK(!manifest.IsActive());
+
+	// As is one cut short
+	payload = MakeManifest(leaves, root);
+	payload.pop_back();
+	CHECK(manifest.Parse(reinterpret_cast<const uint8_t*>(payload.data()), payload.size()) == -1);
+}
+
+/// @brief Chunks are checked leaf by leaf
+static void TestVerifier()
+{
+	std::vector<uint8_t> image = MakeImage();
+	std::vector<Sha256Digest> leaves = MakeLeaves(image);
+	std::string payload = MakeManifest(leaves, MerkleManifest::ComputeRoot(leaves));
+
+	MerkleManifest manifest;
+	CHECK(manifest.Parse(reinterpret_cast<const uint8_t*>(payload.data()), payload.size()) == 0);
+
+	ChunkVerifier verifier(2);
+
+	// Nothing can be checked before there is a manifest
+	CHECK(verifier.Submit(1, 0, image.data(), TEST_CHUNK_SIZE) == -1);
+
+	verifier.SetManifest(manifest);
+
+	// Two leaves in one chunk, then one with a damaged byte, then the short last leaf
+	CHECK(verifier.Submit(1, 0, image.data(), 2 * TEST_CHUNK_SIZE) == 0);
+	std::vector<uint8_t> damaged(image.begin() + 2 * TEST_CHUNK_SIZE, image.begin() + 3 * TEST_CHUNK_SIZE);
+	damaged[10] ^= 0xFF;
+	CHECK(verifier.Submit(1, 2 * TEST_CHUNK_SIZE, damaged.data(), damaged.size()) == 0);
+	CHECK(verifier.Submit(1, 4 * TEST_CHUNK_SIZE, image.data() + 4 * TEST_CHUNK_SIZE, 100) == 0);
+	verifier.WaitIdle();
+
+	std::vector<ChunkVerifier::Result> results = verifier.TakeResults();
+	CHECK(results.size() == 4);
+
+	size_t good = 0;
+	for (const auto& result : results)
+	{
+		CHECK(result.transferId == 7);
+		CHECK(result.ok == (result.offset != 2 * TEST_CHUNK_SIZE));
+		good += result.ok ? 1 : 0;
+	}
+	CHECK(good == 3);
+	CHECK(verifier.GetPendingCount() == 0);
+}
+
+int main()
+{
+	TestRoot();
+	TestVerifier();
+	return TestResult("test_merkle_manifest");
+}
@@ -0,0 +1,236 @@
+///////////////////////////////////////////////////////////////////////////////
+//! @file		test_ofs_delta.cpp
+//! @brief		RollingChecksum and DeltaPatcher tests, rolling, rebuilding and bounds checks
+//! @author		Chip Brommer
+///////////////////////////////////////////////////////////////////////////////
+//
+//  Includes:
+//          name                        reason included
+//          --------------------        ---------------------------------------
+#include "test_check.h"					// CHECK
+#include "ofs_delta.h"					// RollingChecksum, DeltaPatcher
+#include <filesystem>					// Scratch files
+#include <fstream>						// Reading the rebuilt image
+#include <limits>						// Overflowing offsets
+//
+///////////////////////////////////////////////////////////////////////////////
+
+using namespace Essentials::Utilities;
+
+constexpr size_t	TEST_SOURCE_SIZE	= 10000;	// Size of the current image
+
+/// @brief Fills a buffer with bytes that don't repeat over short distances
+static std::vector<uint8_t> MakeData(const size_t size, uint32_t seed)
+{
+	std::vector<uint8_t> data(size);
+	for (uint8_t& byte : data)
+	{
+		seed = seed * 1103515245 + 12345;
+		byte = static_cast<uint8_t>(seed >> 16);
+	}
+	return data;
+}
+
+/// @brief Appends an instruction, and for a literal its data, to an instruction stream
+static void AddInstruction(std::vector<uint8_t>& stream, const uint8_t type, const uint32_t length, const uint64_t sourceOffset,
+	const uint8_t* literal = nullptr)
+{
+	DELTA_INSTRUCTION instruction = { type, length, sourceOffset };
+	const uint8_t* bytes = reinterpret_cast<const uint8_t*>(&instruction);
+	stream.insert(stream.end(), bytes, bytes + sizeof(instruction));
+	if (literal != nullptr)
+	{
+		stream.insert(stream.end(), literal, literal + length);
+	}
+}
+
+/// @brief Reads a whole file
+static std::vector<uint8_t> ReadFile(const std::filesystem::path& path)
+{
+	std::ifstream file(path, std::ios::binary);
+	return std::vector<uint8_t>(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+}
+
+/// @brief Sliding the window must give the same checksum as starting afresh at every offset
+static void TestRollingChecksum()
+{
+	std::vector<uint8_t> data = MakeData(4096, 1);
+
+	for (size_t window : { size_t(1), size_t(16), size_t(700), size_t(DELTA_MIN_BLOCK_SIZE) })
+	{
+		RollingChecksum rolling;
+		rolling.Reset(data.data(), window);
+
+		for (size_t offset = 1; offset + window <= data.size(); offset++)
+		{
+			rolling.Roll(data[offset - 1], data[offset + window - 1]);
+
+			RollingChecksum fresh;
+			fresh.Reset(data.data() + offset, window);
+			CHECK(rolling.Get() == fresh.Get());
+		}
+	}
+
+	// All 0xFF is the worst case for the sums wrapping
+	std::vector<uint8_t> ones(DELTA_MAX_BLOCK_SIZE + 64, 0xFF);
+	ones[DELTA_MAX_BLOCK_SIZE + 10] = 0x00;
+	RollingChecksum rolling;
+	rolling.Reset(ones.data(), DELTA_MAX_BLOCK_SIZE);
+	for (size_t offset = 1; offset <= 64; offset++)
+	{
+		rolling.Roll(ones[offset - 1], ones[offset + DELTA_MAX_BLOCK_SIZE - 1]);
+	}
+	RollingChecksum fresh;
+	fresh.Reset(ones.data() + 64, DELTA_MAX_BLOCK_SIZE);
+	CHECK(rolling.Get() == fresh.Get());
+}
+
+/// @brief Copies and literals rebuild the image in order
+static void TestRebuild(const std::filesystem::path& directory, const std::vector<uint8_t>& source)
+{
+	std::filesystem::path sourcePath = directory / "current.ofs";
+	std::filesystem::path targetPath = directory / "new.ofs";
+	std::vector<uint8_t> literal = MakeData(500, 2);
+
+	std::vector<uint8_t> expected(source.begin(), source.begin() + 1000);
+	expected.insert(expected.end(), literal.begin(), literal.end());
+	expected.insert(expected.end(), source.end() - 1000, source.end());
+	expected.insert(expected.end(), source.begin() + 5000, source.begin() + 5001);
+
+	// Split across two Applies, the second carrying on where the first stopped
+	std::vector<uint8_t> first;
+	AddInstruction(first, DELTA_COPY, 1000, 0);
+	AddInstruction(first, DELTA_LITERAL, static_cast<uint32_t>(literal.size()), 0, literal.data());
+	std::vector<uint8_t> second;
+	AddInstruction(second, DELTA_COPY, 1000, TEST_SOURCE_SIZE - 1000);
+	AddInstruction(second, DELTA_COPY, 1, 5000);
+
+	AsyncFileWriter writer;
+	DeltaPatcher patcher;
+	CHECK(writer.Open(targetPath.string()) == 0);
+	CHECK(patcher.Begin(sourcePath.string(), &writer, expected.size()) == 0);
+	CHECK(patcher.IsActive());
+	CHECK(patcher.Apply(0, first.data(), first.size()) == 0);
+	CHECK(patcher.GetOutputOffset() == 1500);
+	CHECK(patcher.Apply(1500, second.data(), second.size()) == 0);
+	CHECK(patcher.GetOutputOffset() == expected.size());
+	CHECK(patcher.Finish() == 0);
+	CHECK(!patcher.IsActive());
+	CHECK(writer.Commit() == 0);
+
+	CHECK(ReadFile(targetPath) == expected);
+}
+
+/// @brief Malformed instructions and out of order output are refused without writing anything
+static void TestRejects(const std::filesystem::path& directory)
+{
+	std::filesystem::path sourcePath = directory / "current.ofs";
+	std::filesystem::path targetPath = directory / "rejected.ofs";
+	const uint64_t targetSize = 4000;
+	std::vector<uint8_t> literal = MakeData(100, 3);
+
+	DeltaPatcher patcher;
+	std::vector<uint8_t> stream;
+	AddInstruction(stream, DELTA_COPY, 10, 0);
+	CHECK(patcher.Apply(0, stream.data(), stream.size()) == -1);
+	CHECK(patcher.GetLastError() == DeltaErrorMap[DeltaError::NOT_STARTED]);
+
+	AsyncFileWriter writer;
+	CHECK(writer.Open(targetPath.string()) == 0);
+	CHECK(patcher.Begin(sourcePath.string(), &writer, targetSize) == 0);
+
+	struct Reject
+	{
+		std::vector<uint8_t>	stream;
+		DeltaError				error;
+	};
+	std::vector<Reject> rejects;
+
+	// Copies running off the end of the current image, including an offset that wraps
+	stream.clear();
+	AddInstruction(stream, DELTA_COPY, 1, TEST_SOURCE_SIZE);
+	rejects.push_back({ stream, DeltaError::BAD_INSTRUCTION });
+	stream.clear();
+	AddInstruction(stream, DELTA_COPY, 100, TEST_SOURCE_SIZE - 99);
+	rejects.push_back({ stream, DeltaError::BAD_INSTRUCTION });
+	stream.clear();
+	AddInstruction(stream, DELTA_COPY, 100, TEST_SOURCE_SIZE + 1);
+	rejects.push_back({ stream, DeltaError::BAD_INSTRUCTION });
+	stream.clear();
+	AddInstruction(stream, DELTA_COPY, 100, std::numeric_limits<uint64_t>::max() - 10);
+	rejects.push_back({ stream, DeltaError::BAD_INSTRUCTION });
+
+	// A literal claiming more data than the stream holds
+	stream.clear();
+	AddInstruction(stream, DELTA_LITERAL, static_cast<uint32_t>(literal.size()), 0, literal.data());
+	stream.resize(stream.size() - 1);
+	rejects.push_back({ stream, DeltaError::BAD_INSTRUCTION });
+
+	// Output past the end of the new image, from either kind of instruction
+	stream.clear();
+	AddInstruction(stream, DELTA_COPY, static_cast<uint32_t>(targetSize + 1), 0);
+	rejects.push_back({ stream, DeltaError::SIZE_MISMATCH });
+	stream.clear();
+	AddInstruction(stream, DELTA_LITERAL, 0xFFFFFFFF, 0);
+	rejects.push_back({ stream, DeltaError::SIZE_MISMATCH });
+
+	// A cut off instruction and an unknown type
+	stream.clear();
+	AddInstruction(stream, DELTA_COPY, 10, 0);
+	stream.resize(sizeof(DELTA_INSTRUCTION) - 1);
+	rejects.push_back({ stream, DeltaError::BAD_INSTRUCTION });
+	stream.clear();
+	AddInstruction(stream, 0x7F, 10, 0);
+	rejects.push_back({ stream, DeltaError::BAD_INSTRUCTION });
+
+	for (const Reject& reject : rejects)
+	{
+		CHECK(patcher.Apply(0, reject.stream.data(), reject.stream.size()) == -1);
+		CHECK(patcher.GetLastError() == DeltaErrorMap[reject.error]);
+		CHECK(patcher.GetOutputOffset() == 0);
+	}
+
+	// The patcher is still usable at the same offset after each refusal
+	stream.clear();
+	AddInstruction(stream, DELTA_LITERAL, static_cast<uint32_t>(literal.size()), 0, literal.data());
+	CHECK(patcher.Apply(0, stream.data(), stream.size()) == 0);
+	CHECK(patcher.GetOutputOffset() == literal.size());
+
+	// A gap in the output or a replay of data already written
+	stream.clear();
+	AddInstruction(stream, DELTA_COPY, 10, 0);
+	CHECK(patcher.Apply(literal.size() + 1, stream.data(), stream.size()) == -1);
+	CHECK(patcher.GetLastError() == DeltaErrorMap[DeltaError::OUT_OF_ORDER]);
+	CHECK(patcher.Apply(0, stream.data(), stream.size()) == -1);
+	CHECK(patcher.GetLastError() == DeltaErrorMap[DeltaError::OUT_OF_ORDER]);
+	CHECK(patcher.GetOutputOffset() == literal.size());
+
+	// Finishing short of the new image size fails
+	CHECK(patcher.Finish() == -1);
+	CHECK(patcher.GetLastError() == DeltaErrorMap[DeltaError::SIZE_MISMATCH]);
+	CHECK(!patcher.IsActive());
+	writer.Abort();
+
+	// A missing current image can't be patched from
+	CHECK(writer.Open(targetPath.string()) == 0);
+	CHECK(patcher.Begin((directory / "missing.ofs").string(), &writer, targetSize) == -1);
+	CHECK(patcher.GetLastError() == DeltaErrorMap[DeltaError::SOURCE_OPEN_FAILED]);
+	writer.Abort();
+}
+
+int main()
+{
+	std::filesystem::path directory = std::filesystem::temp_directory_path() / ("test_ofs_delta_" + std::to_string(getpid()));
+	std::filesystem::create_directories(directory);
+
+	std::vector<uint8_t> source = MakeData(TEST_SOURCE_SIZE, 4);
+	std::ofstream(directory / "current.ofs", std::ios::binary).write(reinterpret_cast<const char*>(source.data()), source.size());
+
+	TestRollingChecksum();
+	TestRebuild(directory, source);
+	TestRejects(directory);
+
+	std::error_code ec;
+	std::filesystem::remove_all(directory, ec);
+	return TestResult("test_ofs_delta");
+}
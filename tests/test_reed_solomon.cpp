@@ -0,0 +1,209 @@
+///////////////////////////////////////////////////////////////////////////////
+//! @file		test_reed_solomon.cpp
+//! @brief		Reed-Solomon tests, built once as is and once with RS_PORTABLE_ONLY
+//! @author		Chip Brommer
+///////////////////////////////////////////////////////////////////////////////
+//
+//  Includes:
+//          name                        reason included
+//          --------------------        ---------------------------------------
+#include "test_check.h"					// CHECK
+#include "reed_solomon.h"				// ReedSolomon, FecDecoder
+//
+///////////////////////////////////////////////////////////////////////////////
+
+using namespace Essentials::Utilities;
+
+/// @brief Small deterministic generator for test data
+static uint32_t gSeed = 1;
+static uint8_t NextByte()
+{
+	gSeed = gSeed * 1103515245 + 12345;
+	return static_cast<uint8_t>(gSeed >> 16);
+}
+
+/// @brief The field behaves like a field
+static void TestField()
+{
+	for (uint32_t a = 1; a < 256; a++)
+	{
+		CHECK(ReedSolomon::Multiply(static_cast<uint8_t>(a), ReedSolomon::Inverse(static_cast<uint8_t>(a))) == 1);
+		CHECK(ReedSolomon::Multiply(static_cast<uint8_t>(a), 1) == a);
+		CHECK(ReedSolomon::Multiply(static_cast<uint8_t>(a), 0) == 0);
+	}
+}
+
+/// @brief The region multiply agrees with the scalar one at every length, covering the SIMD tails
+static void TestMultiplyAdd()
+{
+	std::vector<uint8_t> src(300), dst(300), expected(300);
+	for (size_t size = 0; size <= 300; size += (size < 70 ? 1 : 23))
+	{
+		for (uint8_t c : { 0, 1, 2, 0x53, 0xFF })
+		{
+			for (size_t i = 0; i < size; i++)
+			{
+				src[i] = NextByte();
+				dst[i] = NextByte();
+				expected[i] = dst[i] ^ ReedSolomon::Multiply(c, src[i]);
+			}
+
+			ReedSolomon::MultiplyAdd(dst.data(), src.data(), c, size);
+			CHECK(memcmp(dst.data(), expected.data(), size) == 0);
+		}
+	}
+}
+
+/// @brief Encodes a block, erases sources and checks they come back
+/// @param sourceCount -[in]- Source symbols in the block
+/// @param symbolSize -[in]- Bytes per symbol
+/// @param repairCount -[in]- Repair symbols made, and sources erased
+static void RoundTrip(const uint32_t sourceCount, const size_t symbolSize, const uint32_t repairCount)
+{
+	std::vector<std::vector<uint8_t>> original(sourceCount, std::vector<uint8_t>(symbolSize));
+	for (auto& symbol : original)
+	{
+		for (auto& byte : symbol)
+		{
+			byte = NextByte();
+		}
+	}
+
+	std::vector<const uint8_t*> sources;
+	for (auto& symbol : original)
+	{
+		sources.push_back(symbol.data());
+	}
+
+	// Repairs taken from the top of the index range as well as straight after the sources
+	std::vector<std::vector<uint8_t>> repairs(repairCount, std::vector<uint8_t>(symbolSize));
+	std::vector<uint32_t> repairIndexes;
+	std::vector<uint8_t*> repairPtrs;
+	for (uint32_t i = 0; i < repairCount; i++)
+	{
+		uint32_t index = (i % 2 == 0) ? sourceCount + i / 2 : RS_MAX_SYMBOLS - 1 - i / 2;
+		CHECK(ReedSolomon::Encode(sources.data(), sourceCount, index, repairs[i].data(), symbolSize) == 0);
+		repairIndexes.push_back(index);
+		repairPtrs.push_back(repairs[i].data());
+	}
+
+	// Erase as many sources as there are repairs, spread over the block
+	std::vector<std::vector<uint8_t>> received = original;
+	std::vector<uint8_t> present(sourceCount, 1);
+	uint32_t erased = 0;
+	for (uint32_t i = 0; erased < repairCount && i < sourceCount; i += std::max<uint32_t>(1, sourceCount / repairCount))
+	{
+		if (present[i])
+		{
+			present[i] = 0;
+			memset(received[i].data(), 0xEE, symbolSize);
+			erased++;
+		}
+	}
+
+	std::vector<uint8_t*> buffers;
+	for (auto& symbol : received)
+	{
+		buffers.push_back(symbol.data());
+	}
+
+	CHECK(ReedSolomon::Decode(buffers.data(), present.data(), sourceCount, repairPtrs.data(), repairIndexes.data(), repairCount, symbolSize) == static_cast<int>(erased));
+	CHECK(received == original);
+}
+
+/// @brief Round trips across block shapes, and too few repairs is refused
+static void TestRoundTrips()
+{
+	for (uint32_t sourceCount : { 1u, 2u, 3u, 10u, 64u, 200u })
+	{
+		for (size_t symbolSize : { 1, 15, 16, 33, 64, 1000 })
+		{
+			uint32_t repairCount = std::min<uint32_t>(std::max<uint32_t>(sourceCount / 4, 1), RS_MAX_SYMBOLS - sourceCount);
+			RoundTrip(sourceCount, symbolSize, repairCount);
+		}
+	}
+
+	// Every source lost
+	RoundTrip(8, 100, 8);
+
+	// More missing than repairs
+	std::vector<uint8_t> a(16, 1), b(16, 2), repair(16);
+	const uint8_t* sources[] = { a.data(), b.data() };
+	CHECK(ReedSolomon::Encode(sources, 2, 2, repair.data(), repair.size()) == 0);
+	uint8_t* buffers[] = { a.data(), b.data() };
+	uint8_t* repairs[] = { repair.data() };
+	uint32_t indexes[] = { 2 };
+	uint8_t present[] = { 0, 0 };
+	CHECK(ReedSolomon::Decode(buffers, present, 2, repairs, indexes, 1, repair.size()) == -1);
+
+	// Indexes outside the code
+	CHECK(ReedSolomon::Encode(sources, 2, 1, repair.data(), repair.size()) == -1);
+	CHECK(ReedSolomon::Encode(sources, 2, RS_MAX_SYMBOLS, repair.data(), repair.size()) == -1);
+}
+
+/// @brief The decoder rebuilds a block from symbols arriving in any order
+static void TestDecoder()
+{
+	constexpr uint32_t sourceCount = 6;
+	constexpr uint32_t symbolSize = 50;
+	constexpr size_t lastSize = 20;		// The last source is short and zero padded
+
+	std::vector<std::vector<uint8_t>> original(sourceCount, std::vector<uint8_t>(symbolSize, 0));
+	for (uint32_t i = 0; i < sourceCount; i++)
+	{
+		for (size_t j = 0; j < (i + 1 == sourceCount ? lastSize : symbolSize); j++)
+		{
+			original[i][j] = NextByte();
+		}
+	}
+
+	std::vector<const uint8_t*> sources;
+	for (auto& symbol : original)
+	{
+		sources.push_back(symbol.data());
+	}
+
+	std::vector<uint8_t> repair1(symbolSize), repair2(symbolSize);
+	CHECK(ReedSolomon::Encode(sources.data(), sourceCount, sourceCount, repair1.data(), symbolSize) == 0);
+	CHECK(ReedSolomon::Encode(sources.data(), sourceCount, sourceCount + 1, repair2.data(), symbolSize) == 0);
+
+	FecDecoder decoder;
+	std::vector<FecRecovered> recovered;
+
+	// Sources 1 and 5 are lost, a repair arrives before the sources it stands in for
+	CHECK(decoder.AddSymbol(9, 4096, symbolSize, sourceCount, sourceCount + 1, repair2.data(), symbolSize, recovered) == 0);
+	for (uint32_t i : { 0u, 2u, 3u })
+	{
+		CHECK(decoder.AddSymbol(9, 4096, symbolSize, sourceCount, i, original[i].data(), symbolSize, recovered) == 0);
+	}
+	CHECK(decoder.AddSymbol(9, 4096, symbolSize, sourceCount, 4, original[4].data(), symbolSize, recovered) == 0);
+	CHECK(decoder.AddSymbol(9, 4096, symbolSize, sourceCount, sourceCount, repair1.data(), symbolSize, recovered) == 2);
+
+	CHECK(recovered.size() == 2);
+	for (const auto& symbol : recovered)
+	{
+		CHECK(symbol.blockOffset == 4096);
+		CHECK(symbol.index == 1 || symbol.index == 5);
+		CHECK(memcmp(symbol.data, original[symbol.index].data(), symbolSize) == 0);
+	}
+
+	// A symbol that disagrees with the block's shape is refused
+	CHECK(decoder.AddSymbol(9, 8192, symbolSize, sourceCount, 0, original[0].data(), symbolSize + 1, recovered) == -1);
+}
+
+int main()
+{
+#ifdef RS_PORTABLE_ONLY
+	CHECK(!ReedSolomon::IsAccelerated());
+	const char* name = "test_reed_solomon_portable";
+#else
+	const char* name = "test_reed_solomon";
+#endif
+	std::cout << name << ": " << (ReedSolomon::IsAccelerated() ? "SIMD" : "table") << "\n";
+
+	TestField();
+	TestMultiplyAdd();
+	TestRoundTrips();
+	TestDecoder();
+	return TestResult(name);
+}
@@ -0,0 +1,177 @@
+///////////////////////////////////////////////////////////////////////////////
+//! @file		test_reliable_udp.cpp
+//! @brief		ReliableReceiver tests, hostile data headers and sender binding
+//! @author		Chip Brommer
+///////////////////////////////////////////////////////////////////////////////
+//
+//  Includes:
+//          name                        reason included
+//          --------------------        ---------------------------------------
+#include "test_check.h"					// CHECK
+#include "reliable_udp.h"				// ReliableReceiver
+//
+///////////////////////////////////////////////////////////////////////////////
+
+using namespace Essentials::Communications;
+
+/// @brief Builds a data packet, the payload is filled with the chunk index
+static std::string MakeData(const uint64_t transferId, const uint32_t chunkSize, const uint64_t totalSize, const uint32_t index, const uint32_t length)
+{
+	RudpDataHeader header = { 0 };
+	header.magic		= RUDP_MAGIC;
+	header.type			= static_cast<uint8_t>(RudpPacketType::DATA);
+	header.length		= length;
+	header.chunkSize	= chunkSize;
+	header.chunkIndex	= index;
+	header.sequence		= index;
+	header.transferId	= transferId;
+	header.totalSize	= totalSize;
+
+	std::string packet(reinterpret_cast<const char*>(&header), sizeof(header));
+	packet.append(length, static_cast<char>(index));
+	return packet;
+}
+
+/// @brief Packet type of a reply
+static uint8_t ReplyType(const std::string& reply)
+{
+	return reply.size() >= sizeof(RudpFeedbackHeader) ? static_cast<uint8_t>(reply[4]) : 0;
+}
+
+struct Receiver
+{
+	uint64_t		chunks = 0;
+	uint64_t		bytes = 0;
+	uint64_t		completed = 0;
+	std::string		reply;
+	ReliableReceiver receiver;
+
+	explicit Receiver(const uint64_t maxTotalSize = RUDP_DEFAULT_MAX_TOTAL_SIZE) : receiver(
+		[this](const uint64_t, const uint64_t, const uint64_t, const uint8_t*, const size_t size) { chunks++; bytes += size; return 0; },
+		[this](const uint64_t, std::string&) { completed++; return 0; },
+		maxTotalSize)
+	{
+	}
+
+	int Feed(const Endpoint& sender, const std::string& packet)
+	{
+		return receiver.HandleDatagram(sender, reinterpret_cast<const uint8_t*>(packet.data()), packet.size(), reply);
+	}
+};
+
+static const Endpoint gSender	= { "192.168.1.10", 5000 };
+static const Endpoint gStranger	= { "192.168.1.66", 5000 };
+
+/// @brief Headers that would size the transfer badly never start one
+static void TestHostileHeaders()
+{
+	Receiver r(1024 * 1024);
+
+	// Too big for the receiver
+	CHECK(r.Feed(gSender, MakeData(1, 1400, 1024 * 1024 + 1, 0, 1400)) == -1);
+	CHECK(r.Feed(gSender, MakeData(1, 1400, UINT64_MAX, 0, 1400)) == -1);
+
+	// One byte chunks of a big image, which would blow up the chunk bitmap
+	CHECK(r.Feed(gSender, MakeData(2, 1, 1024 * 1024, 0, 1)) == -1);
+	CHECK(r.Feed(gSender, MakeData(2, RUDP_MIN_CHUNK_SIZE - 1, 1024 * 1024, 0, RUDP_MIN_CHUNK_SIZE - 1)) == -1);
+
+	// Chunk sizes outside the protocol
+	CHECK(r.Feed(gSender, MakeData(3, 0, 1024, 0, 0)) == -1);
+	CHECK(r.Feed(gSender, MakeData(3, RUDP_MAX_CHUNK_SIZE + 1, 1024 * 1024, 0, 100)) == -1);
+	CHECK(r.Feed(gSender, MakeData(3, 1400, 0, 0, 0)) == -1);
+
+	// Length field that doesn't match the datagram
+	std::string packet = MakeData(4, 1400, 4096, 0, 1400);
+	packet.pop_back();
+	CHECK(r.Feed(gSender, packet) == -1);
+
+	// Not a data packet at all
+	CHECK(r.Feed(gSender, std::string(8, '\0')) == -1);
+
+	CHECK(r.chunks == 0);
+	CHECK(r.completed == 0);
+
+	// A single short chunk is a whole transfer, small chunk size or not
+	CHECK(r.Feed(gSender, MakeData(5, 16, 16, 0, 16)) == 1);
+	CHECK(ReplyType(r.reply) == static_cast<uint8_t>(RudpPacketType::DONE));
+	CHECK(r.completed == 1);
+}
+
+/// @brief Chunks have to sit inside the transfer and be the right length
+static void TestBadChunks()
+{
+	Receiver r;
+
+	CHECK(r.Feed(gSender, MakeData(10, 512, 1200, 0, 512)) >= 0);
+	CHECK(r.Feed(gSender, MakeData(10, 512, 1200, 3, 512)) == -1);			// Past the end
+	CHECK(r.Feed(gSender, MakeData(10, 512, 1200, 2, 512)) == -1);			// Last chunk is 176 bytes
+	CHECK(r.Feed(gSender, MakeData(10, 512, 1200, 1, 100)) == -1);			// Short middle chunk
+	CHECK(r.Feed(gSender, MakeData(10, 1024, 1200, 1, 176)) == -1);		// Chunk size changed part way
+	CHECK(r.Feed(gSender, MakeData(10, 512, 2400, 1, 512)) == -1);			// Total size changed part way
+	CHECK(r.chunks == 1);
+
+	CHECK(r.Feed(gSender, MakeData(10, 512, 1200, 1, 512)) >= 0);
+	CHECK(r.Feed(gSender, MakeData(10, 512, 1200, 2, 176)) == 1);
+	CHECK(r.completed == 1);
+	CHECK(r.bytes == 1200);
+}
+
+/// @brief A transfer in progress belongs to its sender
+static void TestSenderBinding()
+{
+	Receiver r;
+
+	CHECK(r.Feed(gSender, MakeData(20, 512, 1536, 0, 512)) >= 0);
+
+	// Another transfer id, from anyone, can't take over
+	CHECK(r.Feed(gStranger, MakeData(21, 512, 1024, 0, 512)) == -1);
+	CHECK(r.Feed(gSender, MakeData(21, 512, 1024, 0, 512)) == -1);
+
+	// Nor can the right transfer id from somewhere else
+	CHECK(r.Feed(gStranger, MakeData(20, 512, 1536, 1, 512)) == -1);
+	CHECK(r.Feed(Endpoint{ "192.168.1.10", 5001 }, MakeData(20, 512, 1536, 1, 512)) == -1);
+	CHECK(r.chunks == 1);
+
+	// Repeats from the sender are taken but only counted once
+	CHECK(r.Feed(gSender, MakeData(20, 512, 1536, 0, 512)) >= 0);
+	CHECK(r.Feed(gSender, MakeData(20, 512, 1536, 1, 512)) >= 0);
+	CHECK(r.Feed(gSender, MakeData(20, 512, 1536, 2, 512)) == 1);
+	CHECK(r.chunks == 3);
+	CHECK(r.completed == 1);
+
+	// Once it has finished the next transfer can come from anywhere
+	CHECK(r.Feed(gStranger, MakeData(22, 512, 512, 0, 512)) == 1);
+	CHECK(ReplyType(r.reply) == static_cast<uint8_t>(RudpPacketType::DONE));
+	CHECK(r.completed == 2);
+}
+
+/// @brief A refused transfer frees the receiver
+static void TestAbortReleases()
+{
+	bool refuse = true;
+	int taken = 0;
+	std::string reply;
+	ReliableReceiver receiver(
+		[&refuse, &taken](const uint64_t, const uint64_t, const uint64_t, const uint8_t*, const size_t) { taken++; return refuse ? -1 : 0; },
+		nullptr);
+
+	std::string packet = MakeData(30, 512, 1024, 0, 512);
+	CHECK(receiver.HandleDatagram(gSender, reinterpret_cast<const uint8_t*>(packet.data()), packet.size(), reply) == 1);
+	CHECK(ReplyType(reply) == static_cast<uint8_t>(RudpPacketType::ABORT));
+
+	refuse = false;
+	packet = MakeData(31, 512, 1024, 0, 512);
+	reply.clear();
+	CHECK(receiver.HandleDatagram(gStranger, reinterpret_cast<const uint8_t*>(packet.data()), packet.size(), reply) >= 0);
+	CHECK(ReplyType(reply) != static_cast<uint8_t>(RudpPacketType::ABORT));
+	CHECK(taken == 2);
+}
+
+int main()
+{
+	TestHostileHeaders();
+	TestBadChunks();
+	TestSenderBinding();
+	TestAbortReleases();
+	return TestResult("test_reliable_udp");
+}
@@ -0,0 +1,95 @@
+///////////////////////////////////////////////////////////////////////////////
+//! @file		test_sha256.cpp
+//! @brief		SHA-256 tests, built once as is and once with SHA256_PORTABLE_ONLY
+//! @author		Chip Brommer
+///////////////////////////////////////////////////////////////////////////////
+//
+//  Includes:
+//          name                        reason included
+//          --------------------        ---------------------------------------
+#include "test_check.h"					// CHECK
+#include "sha256.h"						// Sha256
+#include <vector>						// Test data
+//
+///////////////////////////////////////////////////////////////////////////////
+
+using namespace Essentials::Utilities;
+
+/// @brief Digest of a string in one Update
+static std::string Digest(const std::string& message)
+{
+	Sha256 sha;
+	sha.Update(reinterpret_cast<const uint8_t*>(message.data()), message.size());
+	return Sha256::ToHex(sha.Final());
+}
+
+/// @brief The FIPS 180-2 example messages
+static void TestNistVectors()
+{
+	CHECK(Digest("") == "e3b0c44298fc1c149afbf4c8996fb92427ae41e4649b934ca495991b7852b855");
+	CHECK(Digest("abc") == "ba7816bf8f01cfea414140de5dae2223b00361a396177a9cb410ff61f20015ad");
+	CHECK(Digest("abcdbcdecdefdefgefghfghighijhijkijkljklmklmnlmnomnopnopq") ==
+		"248d6a61d20638b8e5c026930c3e6039a33ce45964ff2167f6ecedd419db06c1");
+	CHECK(Digest("abcdefghbcdefghicdefghijdefghijkefghijklfghijklmghijklmnhijklmnoijklmnopjklmnopqklmnopqrlmnopqrsmnopqrstnopqrstu") ==
+		"cf5b16a778af8380036ce59e7b0492370b249b11e8f07a51afac45037afee9d1");
+
+	// A million 'a's, fed in uneven pieces so partial blocks get carried over
+	std::vector<uint8_t> a(1000000, 'a');
+	Sha256 sha;
+	size_t offset = 0;
+	for (size_t piece = 1; offset < a.size(); piece = piece * 3 % 1021 + 1)
+	{
+		size_t size = std::min(piece, a.size() - offset);
+		sha.Update(a.data() + offset, size);
+		offset += size;
+	}
+	CHECK(sha.GetLength() == a.size());
+	CHECK(Sha256::ToHex(sha.Final()) == "cdc76e5c9914fb9281a1c7e284d73e67f1809a48a497200e046d39ccc7112cd0");
+}
+
+/// @brief Lengths either side of the padding boundary give the same digest however they are split
+static void TestSplits()
+{
+	std::vector<uint8_t> data(200);
+	for (size_t i = 0; i < data.size(); i++)
+	{
+		data[i] = static_cast<uint8_t>(i * 7);
+	}
+
+	for (size_t size = 50; size <= 130; size++)
+	{
+		Sha256 whole;
+		whole.Update(data.data(), size);
+		Sha256Digest expected = whole.Final();
+
+		for (size_t split = 0; split <= size; split += 9)
+		{
+			Sha256 pieces;
+			pieces.Update(data.data(), split);
+			pieces.Update(data.data() + split, size - split);
+			CHECK(pieces.Final() == expected);
+		}
+	}
+
+	// Reset starts over
+	Sha256 sha;
+	sha.Update(data.data(), 100);
+	sha.Reset();
+	sha.Update(reinterpret_cast<const uint8_t*>("abc"), 3);
+	CHECK(Sha256::ToHex(sha.Final()) == "ba7816bf8f01cfea414140de5dae2223b00361a396177a9cb410ff61f20015ad");
+}
+
+int main()
+{
+#ifdef SHA256_PORTABLE_ONLY
+	CHECK(!Sha256::IsAccelerated());
+	const char* name = "test_sha256_portable";
+#else
+	const char* name = "test_sha256";
+#endif
+	std::cout << name << ": " << (Sha256::IsAccelerated() ? "CPU instructions" : "portable") << "\n";
+
+	TestNistVectors();
+	TestSplits();
+	return TestResult(name);
+}
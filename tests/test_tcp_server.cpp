@@ -0,0 +1,187 @@
+///////////////////////////////////////////////////////////////////////////////
+//! @file		test_tcp_server.cpp
+//! @brief		TCP_Server tests over loopback, sends to a full client queue instead of blocking the loop
+//! @author		Chip Brommer
+///////////////////////////////////////////////////////////////////////////////
+//
+//  Includes:
+//          name                        reason included
+//          --------------------        ---------------------------------------
+#include "test_check.h"					// CHECK
+#include "tcp_server.h"					// TCP_Server
+#include <poll.h>						// Waiting on replies
+#include <chrono>						// Reply deadlines
+#include <filesystem>					// Scratch file
+//
+///////////////////////////////////////////////////////////////////////////////
+
+using namespace Essentials::Communications;
+
+constexpr int		TEST_PORT		= 28736;			// Loopback port the server listens on, one per test
+constexpr size_t	TEST_FILE_SIZE	= 8 * 1024 * 1024;	// Far more than the loopback socket buffers hold
+
+/// @brief Connects a client socket to the test server
+/// @param port - in - port the server is listening on
+/// @param receiveBuffer - in - SO_RCVBUF to ask for, 0 to leave the default
+static int Connect(const int port, const int receiveBuffer = 0)
+{
+	int socketFD = socket(AF_INET, SOCK_STREAM, 0);
+	if (receiveBuffer > 0)
+	{
+		setsockopt(socketFD, SOL_SOCKET, SO_RCVBUF, &receiveBuffer, sizeof(receiveBuffer));
+	}
+
+	sockaddr_in address{};
+	address.sin_family = AF_INET;
+	address.sin_port = htons(port);
+	inet_pton(AF_INET, "127.0.0.1", &address.sin_addr);
+	if (connect(socketFD, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0)
+	{
+		close(socketFD);
+		return -1;
+	}
+
+	return socketFD;
+}
+
+/// @brief Reads until size bytes have arrived or the deadline passes
+static std::string ReadExactly(const int socketFD, const size_t size, const std::chrono::milliseconds deadline)
+{
+	std::string data;
+	std::vector<char> buffer(65536);
+	auto start = std::chrono::steady_clock::now();
+
+	while (data.size() < size && std::chrono::steady_clock::now() - start < deadline)
+	{
+		pollfd pfd = { socketFD, POLLIN, 0 };
+		if (poll(&pfd, 1, 50) <= 0)
+		{
+			continue;
+		}
+
+		ssize_t count = recv(socketFD, buffer.data(), std::min(buffer.size(), size - data.size()), 0);
+		if (count <= 0)
+		{
+			break;
+		}
+		data.append(buffer.data(), static_cast<size_t>(count));
+	}
+
+	return data;
+}
+
+/// @brief A client that stops reading mid file doesn't hold up anyone else, and gets the file, its
+/// footer and the response sent after it whole and in order once it reads again
+static void TestSlowReader(const std::string& filePath, const std::string& contents)
+{
+	const int port = TEST_PORT;
+	TCP_Server server(4, "127.0.0.1", port);
+	CHECK(server.Start() == 0);
+
+	server.SetMessageCallback([&server, &filePath](const int clientFD, const std::string& message) {
+		if (message == "file")
+		{
+			const uint8_t header[] = { 'H', 'E', 'A', 'D' };
+			const uint8_t footer[] = { 'F', 'O', 'O', 'T' };
+			CHECK(server.SendFileToClient(clientFD, filePath, 0, TEST_FILE_SIZE, header, sizeof(header), footer, sizeof(footer)) ==
+				static_cast<int64_t>(TEST_FILE_SIZE + sizeof(header) + sizeof(footer)));
+			CHECK(server.SendMessageToClient(clientFD, "AFTER") == 5);
+		}
+		else if (message == "ping")
+		{
+			CHECK(server.SendMessageToClient(clientFD, "pong") == 4);
+		}
+		return 0;
+	});
+
+	std::thread loop([&server]() { server.Run(); });
+
+	// A small receive buffer so the file can't all be handed to the kernel
+	int slow = Connect(port, 4096);
+	CHECK(slow != -1);
+	CHECK(send(slow, "file", 4, 0) == 4);
+	std::this_thread::sleep_for(std::chrono::milliseconds(100));
+
+	// The loop is free while the slow client's send waits for room
+	int other = Connect(port);
+	CHECK(other != -1);
+	auto start = std::chrono::steady_clock::now();
+	CHECK(send(other, "ping", 4, 0) == 4);
+	CHECK(ReadExactly(other, 4, std::chrono::milliseconds(1000)) == "pong");
+	CHECK(std::chrono::steady_clock::now() - start < std::chrono::milliseconds(1000));
+
+	std::string expected = "HEAD" + contents + "FOOT" + "AFTER";
+	std::string received = ReadExactly(slow, expected.size(), std::chrono::milliseconds(10000));
+	CHECK(received.size() == expected.size());
+	CHECK(received == expected);
+
+	close(slow);
+	close(other);
+	server.Stop();
+	loop.join();
+}
+
+/// @brief A client that goes away with a send queued is dropped cleanly, the loop carries on
+static void TestDropWhileQueued(const std::string& filePath)
+{
+	const int port = TEST_PORT + 1;
+	TCP_Server server(4, "127.0.0.1", port);
+	CHECK(server.Start() == 0);
+
+	std::atomic<int> disconnects = 0;
+	server.SetDisconnectCallback([&disconnects](const int) { disconnects++; return 0; });
+	server.SetMessageCallback([&server, &filePath](const int clientFD, const std::string& message) {
+		if (message == "file")
+		{
+			server.SendFileToClient(clientFD, filePath, 0, TEST_FILE_SIZE);
+		}
+		else if (message == "ping")
+		{
+			server.SendMessageToClient(clientFD, "pong");
+		}
+		return 0;
+	});
+
+	std::thread loop([&server]() { server.Run(); });
+
+	int slow = Connect(port, 4096);
+	CHECK(send(slow, "file", 4, 0) == 4);
+	std::this_thread::sleep_for(std::chrono::milliseconds(100));
+	close(slow);
+
+	int other = Connect(port);
+	CHECK(send(other, "ping", 4, 0) == 4);
+	CHECK(ReadExactly(other, 4, std::chrono::milliseconds(1000)) == "pong");
+
+	auto start = std::chrono::steady_clock::now();
+	while (disconnects == 0 && std::chrono::steady_clock::now() - start < std::chrono::seconds(2))
+	{
+		std::this_thread::sleep_for(std::chrono::milliseconds(10));
+	}
+	CHECK(disconnects == 1);
+
+	close(other);
+	server.Stop();
+	loop.join();
+}
+
+int main()
+{
+	std::filesystem::path filePath = std::filesystem::temp_directory_path() / ("test_tcp_server_" + std::to_string(getpid()));
+
+	std::string contents(TEST_FILE_SIZE, '\0');
+	uint32_t seed = 1;
+	for (char& byte : contents)
+	{
+		seed = seed * 1103515245 + 12345;
+		byte = static_cast<char>(seed >> 16);
+	}
+	std::ofstream(filePath, std::ios::binary).write(contents.data(), contents.size());
+
+	TestSlowReader(filePath.string(), contents);
+	TestDropWhileQueued(filePath.string());
+
+	std::error_code ec;
+	std::filesystem::remove(filePath, ec);
+	return TestResult("test_tcp_server");
+}
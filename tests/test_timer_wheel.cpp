@@ -0,0 +1,184 @@
+///////////////////////////////////////////////////////////////////////////////
+//! @file		test_timer_wheel.cpp
+//! @brief		TimerWheel tests, one-shot arming, moving down levels and jumping over empty ticks
+//! @author		Chip Brommer
+///////////////////////////////////////////////////////////////////////////////
+//
+//  Includes:
+//          name                        reason included
+//          --------------------        ---------------------------------------
+#include "test_check.h"					// CHECK
+#include "timer.h"						// TimerWheel
+#include <random>						// Random deadlines
+//
+///////////////////////////////////////////////////////////////////////////////
+
+using namespace Essentials::Utilities;
+
+#ifndef _WIN32
+/// @brief Get what the timerfd is set to
+static itimerspec GetArmed(const TimerWheel& wheel)
+{
+	itimerspec spec = {};
+	timerfd_gettime(wheel.GetFD(), &spec);
+	return spec;
+}
+
+/// @brief The timerfd is armed one-shot for the next occupied slot, a coarse slot wakes at its start
+static void TestOneShot()
+{
+	// Levels of 64 ticks, 64 * 64 ticks and 64 * 64 * 64 ticks
+	TimerWheel wheel(10, 64);
+	CHECK(wheel.GetFD() != -1);
+
+	itimerspec spec = GetArmed(wheel);
+	CHECK(spec.it_value.tv_sec == 0 && spec.it_value.tv_nsec == 0);
+
+	// 6000 ticks is in the top level slot starting at tick 4096
+	uint64_t late = wheel.Schedule(60000, []() {});
+	spec = GetArmed(wheel);
+	CHECK(spec.it_interval.tv_sec == 0 && spec.it_interval.tv_nsec == 0);
+	CHECK(spec.it_value.tv_sec >= 40 && spec.it_value.tv_sec < 41);
+
+	// An earlier deadline pulls the timer in
+	uint64_t soon = wheel.Schedule(50, []() {});
+	spec = GetArmed(wheel);
+	CHECK(spec.it_interval.tv_sec == 0 && spec.it_interval.tv_nsec == 0);
+	CHECK(spec.it_value.tv_sec == 0 && spec.it_value.tv_nsec > 0);
+
+	// Cancelling leaves the timer alone, the wake finds nothing due and arms for what is left
+	CHECK(wheel.Cancel(soon));
+	CHECK(GetArmed(wheel).it_value.tv_sec == 0);
+	std::this_thread::sleep_for(std::chrono::milliseconds(70));
+	CHECK(wheel.HandleEvent() == 0);
+	spec = GetArmed(wheel);
+	CHECK(spec.it_value.tv_sec >= 39 && spec.it_value.tv_sec < 41);
+
+	// Nothing left pending disarms it on the next wake
+	CHECK(wheel.Cancel(late));
+	CHECK(!wheel.Cancel(late));
+	CHECK(wheel.Advance() == 0);
+	spec = GetArmed(wheel);
+	CHECK(spec.it_value.tv_sec == 0 && spec.it_value.tv_nsec == 0);
+}
+#endif
+
+/// @brief Deadlines fire in order once due, whatever lies between them
+static void TestAdvance()
+{
+	TimerWheel wheel(1, 8);
+	std::vector<int> fired;
+
+	wheel.Schedule(5, [&fired]() { fired.push_back(1); });
+	wheel.Schedule(20, [&fired]() { fired.push_back(2); });		// On the second level
+	uint64_t cancelled = wheel.Schedule(10, [&fired]() { fired.push_back(3); });
+	wheel.Schedule(60000, [&fired]() { fired.push_back(4); });	// Past the top level
+	CHECK(wheel.Cancel(cancelled));
+	CHECK(wheel.GetPendingCount() == 3);
+
+	CHECK(wheel.Advance() == 0);
+
+	std::this_thread::sleep_for(std::chrono::milliseconds(30));
+#ifndef _WIN32
+	CHECK(wheel.HandleEvent() == 2);
+
+	// The deadline past the top level wakes the wheel when the top level comes round, 512 ticks
+	itimerspec spec = GetArmed(wheel);
+	CHECK(spec.it_value.tv_sec != 0 || spec.it_value.tv_nsec != 0);
+#else
+	CHECK(wheel.Advance() == 2);
+#endif
+	CHECK(fired.size() == 2 && fired[0] == 1 && fired[1] == 2);
+	CHECK(wheel.GetPendingCount() == 1);
+
+	// Callbacks may schedule more
+	wheel.Schedule(1, [&wheel, &fired]() { fired.push_back(5); wheel.Schedule(1, [&fired]() { fired.push_back(6); }); });
+	std::this_thread::sleep_for(std::chrono::milliseconds(5));
+	CHECK(wheel.Advance() == 1);
+	std::this_thread::sleep_for(std::chrono::milliseconds(5));
+	CHECK(wheel.Advance() == 1);
+	CHECK(fired.size() == 4 && fired[3] == 6);
+}
+
+/// @brief Deadlines spread over every level and past the top fire in order and never early, however
+/// many times they are moved down, and can still be cancelled after they have been
+static void TestLevels()
+{
+	// Levels of 4, 16 and 64 ticks, anything later waits past the top level
+	TimerWheel wheel(1, 4);
+	std::mt19937 random(7);
+
+	struct Deadline
+	{
+		uint64_t	delay;
+		uint64_t	id;
+		bool		cancel;
+		bool		fired;
+		std::chrono::steady_clock::time_point scheduled;
+		std::chrono::steady_clock::time_point at;
+	};
+	std::vector<Deadline> deadlines(200);
+	std::vector<size_t> order;
+
+	for (size_t i = 0; i < deadlines.size(); i++)
+	{
+		Deadline& deadline = deadlines[i];
+		deadline.delay = random() % 250;
+		deadline.cancel = i % 5 == 0;
+		deadline.fired = false;
+		deadline.scheduled = std::chrono::steady_clock::now();
+		deadline.id = wheel.Schedule(deadline.delay, [&deadlines, &order, i]() {
+			deadlines[i].fired = true;
+			deadlines[i].at = std::chrono::steady_clock::now();
+			order.push_back(i);
+		});
+	}
+	CHECK(wheel.GetPendingCount() == deadlines.size());
+
+	auto start = std::chrono::steady_clock::now();
+	bool cancelled = false;
+	while (wheel.GetPendingCount() > 0 && std::chrono::steady_clock::now() - start < std::chrono::seconds(5))
+	{
+		// Cancel part way through, by now the later ones have been moved down at least once
+		if (!cancelled && std::chrono::steady_clock::now() - start > std::chrono::milliseconds(70))
+		{
+			for (Deadline& deadline : deadlines)
+			{
+				CHECK(!deadline.cancel || deadline.fired || wheel.Cancel(deadline.id));
+			}
+			cancelled = true;
+		}
+
+		std::this_thread::sleep_for(std::chrono::milliseconds(1));
+		wheel.Advance();
+	}
+	CHECK(wheel.GetPendingCount() == 0);
+
+	uint64_t lastDelay = 0;
+	for (size_t i : order)
+	{
+		const Deadline& deadline = deadlines[i];
+		auto waited = std::chrono::duration_cast<std::chrono::milliseconds>(deadline.at - deadline.scheduled).count();
+
+		// Ticks are counted from the wheel's start, so a deadline can land up to a tick short
+		CHECK(waited + 1 >= static_cast<int64_t>(deadline.delay));
+		CHECK(deadline.delay + 2 >= lastDelay);
+		lastDelay = std::max(lastDelay, deadline.delay);
+	}
+
+	for (const Deadline& deadline : deadlines)
+	{
+		CHECK(deadline.fired || (deadline.cancel && deadline.delay >= 60));
+		CHECK(!deadline.fired || !deadline.cancel || deadline.delay <= 80);
+	}
+}
+
+int main()
+{
+#ifndef _WIN32
+	TestOneShot();
+#endif
+	TestAdvance();
+	TestLevels();
+	return TestResult("test_timer_wheel");
+}
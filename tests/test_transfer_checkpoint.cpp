@@ -0,0 +1,197 @@
+///////////////////////////////////////////////////////////////////////////////
+//! @file		test_transfer_checkpoint.cpp
+//! @brief		TransferCheckpoint tests, range merging, missing ranges and loading
+//! @author		Chip Brommer
+///////////////////////////////////////////////////////////////////////////////
+//
+//  Includes:
+//          name                        reason included
+//          --------------------        ---------------------------------------
+#include "test_check.h"					// CHECK
+#include "transfer_checkpoint.h"		// TransferCheckpoint
+#include <cstring>						// memcpy
+#include <fstream>						// Corrupting checkpoint files
+//
+///////////////////////////////////////////////////////////////////////////////
+
+using namespace Essentials::Utilities;
+
+using RangeList = std::vector<std::pair<uint64_t, uint64_t>>;
+
+/// @brief Gets the received ranges as start, end pairs
+static RangeList Ranges(const TransferCheckpoint& checkpoint)
+{
+	return RangeList(checkpoint.GetRanges().begin(), checkpoint.GetRanges().end());
+}
+
+/// @brief Splits a GetMissing answer into its status and ranges
+static TRANSFER_STATUS ParseMissing(const std::string& missing, std::vector<TRANSFER_RANGE>& ranges)
+{
+	TRANSFER_STATUS status = { 0 };
+	memcpy(&status, missing.data(), sizeof(status));
+
+	ranges.resize(status.rangeCount);
+	CHECK(missing.size() == sizeof(status) + ranges.size() * sizeof(TRANSFER_RANGE));
+	if (!ranges.empty())
+	{
+		memcpy(ranges.data(), missing.data() + sizeof(status), ranges.size() * sizeof(TRANSFER_RANGE));
+	}
+	return status;
+}
+
+/// @brief Overlapping, touching and contained ranges merge and the byte count stays exact
+static void TestAddRange()
+{
+	TransferCheckpoint checkpoint;
+	checkpoint.Reset(7, 1000);
+
+	checkpoint.AddRange(100, 100);
+	checkpoint.AddRange(300, 100);
+	CHECK(Ranges(checkpoint) == RangeList({ { 100, 200 }, { 300, 400 } }));
+	CHECK(checkpoint.GetReceivedBytes() == 200);
+
+	// Touching on either side
+	checkpoint.AddRange(200, 50);
+	checkpoint.AddRange(250, 50);
+	CHECK(Ranges(checkpoint) == RangeList({ { 100, 400 } }));
+	CHECK(checkpoint.GetReceivedBytes() == 300);
+
+	// Inside an existing range, a repeat and an empty range change nothing
+	checkpoint.AddRange(150, 10);
+	checkpoint.AddRange(100, 300);
+	checkpoint.AddRange(600, 0);
+	CHECK(Ranges(checkpoint) == RangeList({ { 100, 400 } }));
+	CHECK(checkpoint.GetReceivedBytes() == 300);
+
+	// Overlapping the front of one range and spanning several
+	checkpoint.AddRange(500, 50);
+	checkpoint.AddRange(700, 50);
+	checkpoint.AddRange(50, 100);
+	checkpoint.AddRange(390, 400);
+	CHECK(Ranges(checkpoint) == RangeList({ { 50, 790 } }));
+	CHECK(checkpoint.GetReceivedBytes() == 740);
+
+	CHECK(checkpoint.Contains(50, 740));
+	CHECK(checkpoint.Contains(400, 10));
+	CHECK(!checkpoint.Contains(40, 20));
+	CHECK(!checkpoint.Contains(780, 20));
+	CHECK(!checkpoint.Contains(0, 1));
+	CHECK(!checkpoint.IsComplete());
+
+	checkpoint.AddRange(0, 50);
+	checkpoint.AddRange(790, 210);
+	CHECK(checkpoint.GetReceivedBytes() == 1000);
+	CHECK(checkpoint.IsComplete());
+}
+
+/// @brief GetMissing lists the gaps between and after the received ranges, lowest first
+static void TestGetMissing()
+{
+	TransferCheckpoint checkpoint;
+	checkpoint.Reset(9, 1000);
+
+	std::vector<TRANSFER_RANGE> ranges;
+	TRANSFER_STATUS status = ParseMissing(checkpoint.GetMissing(10), ranges);
+	CHECK(status.transferId == 9 && status.totalSize == 1000 && status.receivedBytes == 0);
+	CHECK(ranges.size() == 1 && ranges[0].offset == 0 && ranges[0].length == 1000);
+
+	checkpoint.AddRange(0, 100);
+	checkpoint.AddRange(200, 100);
+	checkpoint.AddRange(500, 100);
+	status = ParseMissing(checkpoint.GetMissing(10), ranges);
+	CHECK(status.receivedBytes == 300);
+	CHECK(ranges.size() == 3);
+	CHECK(ranges.size() == 3 && ranges[0].offset == 100 && ranges[0].length == 100);
+	CHECK(ranges.size() == 3 && ranges[1].offset == 300 && ranges[1].length == 200);
+	CHECK(ranges.size() == 3 && ranges[2].offset == 600 && ranges[2].length == 400);
+
+	// Capped at the lowest maxRanges gaps
+	ParseMissing(checkpoint.GetMissing(2), ranges);
+	CHECK(ranges.size() == 2 && ranges[1].offset == 300);
+
+	// Nothing after a range that reaches the end
+	checkpoint.AddRange(600, 400);
+	ParseMissing(checkpoint.GetMissing(10), ranges);
+	CHECK(ranges.size() == 2 && ranges[1].offset == 300 && ranges[1].length == 200);
+
+	checkpoint.AddRange(100, 100);
+	checkpoint.AddRange(300, 200);
+	status = ParseMissing(checkpoint.GetMissing(10), ranges);
+	CHECK(ranges.empty());
+	CHECK(status.receivedBytes == 1000);
+}
+
+/// @brief A saved checkpoint loads back the same, a damaged one is refused
+static void TestSaveLoad(const std::filesystem::path& directory)
+{
+	std::string path = (directory / ("image.ofs" + std::string(TRANSFER_CHECKPOINT_EXTENSION))).string();
+
+	TransferCheckpoint saved;
+	saved.Reset(42, 1 << 20);
+	saved.AddRange(0, 4096);
+	saved.AddRange(65536, 1000);
+	CHECK(saved.Save(path) == 0);
+
+	TransferCheckpoint loaded;
+	CHECK(loaded.Load(path) == 0);
+	CHECK(loaded.IsActive());
+	CHECK(loaded.GetTransferId() == 42);
+	CHECK(loaded.GetTotalSize() == 1 << 20);
+	CHECK(loaded.GetRanges() == saved.GetRanges());
+	CHECK(loaded.GetReceivedBytes() == saved.GetReceivedBytes());
+
+	std::string good;
+	{
+		std::ifstream file(path, std::ios::binary);
+		good.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+	}
+
+	// Header is magic, version, transfer id, total size, range count, then the ranges
+	const size_t headerSize = 2 * sizeof(uint32_t) + 3 * sizeof(uint64_t);
+	CHECK(good.size() == headerSize + 2 * sizeof(TRANSFER_RANGE));
+
+	std::vector<std::string> corrupt;
+	corrupt.push_back(good.substr(0, good.size() - 1));		// Cut off in the last range
+	corrupt.push_back(good.substr(0, headerSize - 1));		// Cut off in the header
+	corrupt.push_back("");
+	corrupt.push_back(good);
+	corrupt.back()[0] ^= 0xFF;								// Magic
+	corrupt.push_back(good);
+	corrupt.back()[sizeof(uint32_t)] ^= 0xFF;				// Version
+	corrupt.push_back(good);
+	corrupt.back()[headerSize - sizeof(uint64_t)] = 3;		// More ranges than the file holds
+
+	// A range running past the end of the file
+	TRANSFER_RANGE outside = { (1 << 20) - 10, 11 };
+	corrupt.push_back(good);
+	memcpy(corrupt.back().data() + headerSize, &outside, sizeof(outside));
+
+	for (const std::string& contents : corrupt)
+	{
+		std::ofstream(path, std::ios::binary | std::ios::trunc).write(contents.data(), contents.size());
+
+		// A refused load leaves nothing behind from before or from the partial read
+		CHECK(loaded.Load(path) == -1);
+		CHECK(!loaded.IsActive());
+		CHECK(loaded.GetRanges().empty());
+		CHECK(loaded.GetReceivedBytes() == 0);
+	}
+
+	TransferCheckpoint::Remove(path);
+	CHECK(!std::filesystem::exists(path));
+	CHECK(loaded.Load(path) == -1);
+}
+
+int main()
+{
+	std::filesystem::path directory = std::filesystem::temp_directory_path() / ("test_transfer_checkpoint_" + std::to_string(getpid()));
+	std::filesystem::create_directories(directory);
+
+	TestAddRange();
+	TestGetMissing();
+	TestSaveLoad(directory);
+
+	std::error_code ec;
+	std::filesystem::remove_all(directory, ec);
+	return TestResult("test_transfer_checkpoint");
+}
@@ -0,0 +1,89 @@
+///////////////////////////////////////////////////////////////////////////////
+//! @file		test_udp_client.cpp
+//! @brief		UDP_Client tests over loopback, batch receive of datagrams too big for their slot
+//! @author		Chip Brommer
+///////////////////////////////////////////////////////////////////////////////
+//
+//  Includes:
+//          name                        reason included
+//          --------------------        ---------------------------------------
+#include "test_check.h"					// CHECK
+#include "udp_client.h"					// UDP_Client
+//
+///////////////////////////////////////////////////////////////////////////////
+
+using namespace Essentials::Communications;
+
+constexpr int16_t	TEST_PORT		= 28734;	// Loopback port the receiver binds
+constexpr int16_t	TEST_BROADCAST_PORT	= 28735;	// Broadcast listener port, nothing is ever sent to it
+constexpr uint32_t	TEST_SLOT_SIZE	= 64;		// Arena slot per datagram
+constexpr uint32_t	TEST_SLOTS		= 8;		// Datagrams one read can hold
+constexpr int		TEST_ATTEMPTS	= 5;		// Reads tried before giving up
+
+/// @brief A datagram bigger than its slot is dropped rather than handed back cut short
+static void TestTruncatedDropped()
+{
+	UDP_Client receiver;
+	UDP_Client sender;
+	CHECK(receiver.ConfigureThisClient("127.0.0.1", TEST_PORT) == 0);
+	CHECK(receiver.OpenUnicast() == 0);
+	CHECK(sender.ConfigureThisClient("127.0.0.1", 0) == 0);
+	CHECK(sender.OpenUnicast() == 0);
+
+	std::string small(10, 'a');
+	std::string large(TEST_SLOT_SIZE * 3, 'b');
+	std::string exact(TEST_SLOT_SIZE, 'c');
+	CHECK(sender.SendUnicast(small.data(), static_cast<uint32_t>(small.size()), "127.0.0.1", TEST_PORT) == static_cast<int32_t>(small.size()));
+	CHECK(sender.SendUnicast(large.data(), static_cast<uint32_t>(large.size()), "127.0.0.1", TEST_PORT) == static_cast<int32_t>(large.size()));
+	CHECK(sender.SendUnicast(exact.data(), static_cast<uint32_t>(exact.size()), "127.0.0.1", TEST_PORT) == static_cast<int32_t>(exact.size()));
+
+	std::vector<uint8_t> arena(TEST_SLOT_SIZE * TEST_SLOTS * TEST_ATTEMPTS);
+	Datagram datagrams[TEST_SLOTS];
+	uint32_t total = 0;
+
+	// Loopback delivers at once, but give it a few reads in case the three land across them, each into its own part of the arena
+	for (int attempt = 0; attempt < TEST_ATTEMPTS && total < 2; attempt++)
+	{
+		ReadySocket ready[1];
+		if (receiver.WaitForReadable(ready, 1, 200) <= 0)
+		{
+			continue;
+		}
+
+		int32_t count = receiver.ReceiveReadyBatch(ready[0], arena.data() + static_cast<size_t>(attempt) * TEST_SLOT_SIZE * TEST_SLOTS, TEST_SLOT_SIZE, datagrams + total, TEST_SLOTS - total);
+		CHECK(count >= 0);
+		total += count > 0 ? static_cast<uint32_t>(count) : 0;
+	}
+
+	CHECK(total == 2);
+	if (total == 2)
+	{
+		CHECK(std::string(reinterpret_cast<const char*>(datagrams[0].data), datagrams[0].size) == small);
+		CHECK(std::string(reinterpret_cast<const char*>(datagrams[1].data), datagrams[1].size) == exact);
+	}
+}
+
+/// @brief A receive without its own deadline waits for the configured timeout and no longer
+static void TestDefaultTimeout()
+{
+	UDP_Client listener;
+	CHECK(listener.SetTimeout(1200) == 0);
+	CHECK(listener.AddBroadcastListener(TEST_BROADCAST_PORT) == 0);
+
+	std::vector<uint8_t> arena(TEST_SLOT_SIZE * TEST_SLOTS);
+	Datagram datagrams[TEST_SLOTS];
+
+	auto start = std::chrono::steady_clock::now();
+	CHECK(listener.ReceiveBroadcastBatch(arena.data(), TEST_SLOT_SIZE, datagrams, TEST_SLOTS, TEST_BROADCAST_PORT) == 0);
+	auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start).count();
+
+	CHECK(elapsed >= 1150);
+	CHECK(elapsed < 1700);
+}
+
+int main()
+{
+	TestTruncatedDropped();
+	TestDefaultTimeout();
+	return TestResult("test_udp_client");
+}
@@ -3,13 +3,13 @@
 //! @brief		Implementation of the Timer class
 //! @author		Chip Brommer
 ///////////////////////////////////////////////////////////////////////////////
-#pragma once
+
 ///////////////////////////////////////////////////////////////////////////////
 //
 //  Includes:
 //          name                        reason included
 //          --------------------        ---------------------------------------
-#include	"Timer.h"					// Timer class header
+#include	"timer.h"					// Timer class header
 //
 ///////////////////////////////////////////////////////////////////////////////
 
@@ -41,73 +41,43 @@ namespace Essentials
 
 		void Timer::Reset()
 		{
-			uint32_t now = GetMSecTicks();
-			mTickOffset += now;
+			mTickOffset += GetMSecTicks64();
 		}
 
 		uint32_t Timer::GetMSecTicks()
 		{
-			uint32_t now;
-			bool firstTime;
-
-			if (firstTime = !mInitialized)
-			{
-				Initialize();
-			}
-
-#ifdef _WIN32
-			now = mTickCount;
-#else
-			{
-				static uint32_t prevNow;
-				struct timeval tv;
-				gettimeofday(&tv, NULL);
-				now = tv.tv_sec * 1000 + tv.tv_usec / 1000;
-				if (!firstTime)
-				{
-					int32_t elapsed = (int32_t)(now - prevNow);
-
-					if (elapsed < 0)
-					{
-						tickOffset += elapsed;
-#ifdef USE_STDIO
-						printf("System time went backwards %d msec\n", -elapsed);
-#else
-						Log* log = Log::GetInstance();
-						log->AddEntry(LOG_WARN, mUser, "System time went backwards %d msec", -elapsed);
-#endif // USE_STDIO
-					}
-				}
-				prevNow = now;
-			}
-#endif
+			return static_cast<uint32_t>(GetMSecTicks64());
+		}
 
-			if (firstTime)
-			{
-				mTickOffset = now;
-			}
+		uint32_t Timer::GetUSecTicks()
+		{
+			return static_cast<uint32_t>(GetUSecTicks64() & 0xffffffff);
+		}
 
-			return now - mTickOffset;
+		uint64_t Timer::GetMSecTicks64()
+		{
+			return GetUSecTicks64() / 1000 - mTickOffset;
 		}
 
-		uint32_t Timer::GetUSecTicks()
+		uint64_t Timer::GetUSecTicks64()
 		{
 			// Catch not initialized
 			if (!mInitialized)
 			{
-				int time = GetMSecTicks();
+				Initialize();
 			}
 
 #if defined _WIN32
 			LARGE_INTEGER currentCount;
 			QueryPerformanceCounter(&currentCount);
-			return (uint32_t)((uint64_t)((((uint64_t)currentCount.QuadPart - mUSecStartTime) * mTimerFactor + 0.5)) & 0xffffffff);
+			return (uint64_t)((((uint64_t)currentCount.QuadPart - mUSecStartTime) * mTimerFactor + 0.5));
 #else
-			struct timeval tv;
-			gettimeofday(&tv, NULL);
+			// CLOCK_MONOTONIC never jumps with NTP and is read through the vDSO, no system call
+			timespec now{};
+			clock_gettime(CLOCK_MONOTONIC, &now);
 
-			unit64_t uSecs = tv.tv_sec * 1000000 + tv.tv_usec;
-			return (uSecs & 0xffffffff);
+			uint64_t uSecs = static_cast<uint64_t>(now.tv_sec) * 1000000 + static_cast<uint64_t>(now.tv_nsec) / 1000;
+			return uSecs - mUSecStartTime;
 #endif
 		}
 
@@ -116,7 +86,7 @@ namespace Essentials
 #ifdef _WIN32
 			Sleep(mSecs);
 #else
-			usleep(mSecs * 1000);
+			USecSleep(mSecs * 1000);
 #endif
 		}
 
@@ -125,7 +95,11 @@ namespace Essentials
 #ifdef _WIN32
 			Sleep(uSecs / 1000);
 #else
-			usleep(uSecs);
+			// Sleep the remainder again if a signal wakes us early
+			timespec request{};
+			request.tv_sec = uSecs / 1000000;
+			request.tv_nsec = static_cast<long>(uSecs % 1000000) * 1000;
+			while (nanosleep(&request, &request) == -1 && errno == EINTR) {}
 #endif
 		}
 
@@ -135,7 +109,7 @@ namespace Essentials
 		{
 			// Notify close and wait for thread
 #ifdef USE_STDIO
-			printf_s("Timer Closing.\n");
+			printf("Timer Closing.\n");
 #else
 			AddEntry(LOG_INFO, mUser, "Closing.");
 #endif // USE_STDIO
@@ -144,12 +118,16 @@ namespace Essentials
 				mInitialized = false;
 				mClosing = true;
 
-				if (mThread->joinable())
+				if (mThread != nullptr)
 				{
-					mThread->join();
-				}
+					if (mThread->joinable())
+					{
+						mThread->join();
+					}
 
-				delete mThread;
+					delete mThread;
+					mThread = nullptr;
+				}
 			}
 		}
 
@@ -176,10 +154,6 @@ namespace Essentials
 			mTimerFactor = 1000000.0 / hrInfo.QuadPart;
 			mUSecStartTime = (uint64_t)curCount.QuadPart;
 
-#else
-
-#endif
-
 			mThread = new std::thread(&Timer::HandleTrueMSec, this);
 
 			// Wait for timer thread to become ready
@@ -187,6 +161,18 @@ namespace Essentials
 			{
 				MSecSleep(1);
 			}
+#else
+			// No timer thread needed, ticks are read straight from the monotonic clock
+			timespec start{};
+			if (clock_gettime(CLOCK_MONOTONIC, &start) != 0)
+			{
+				Fatal("monotonic clock not available");
+			}
+
+			mUSecStartTime = static_cast<uint64_t>(start.tv_sec) * 1000000 + static_cast<uint64_t>(start.tv_nsec) / 1000;
+			mTimerFactor = 1.0;
+			mTimerThreadReady = true;
+#endif
 
 			mInitialized = true;
 
@@ -247,12 +233,302 @@ namespace Essentials
 		void Timer::Fatal(std::string msg)
 		{
 #ifdef USE_STDIO
-			fprintf_s(stderr, "%s\n", msg.c_str());
+			fprintf(stderr, "%s\n", msg.c_str());
 #else
 			Log* log = Log::GetInstance();
 			log->AddEntry(LOG_ERROR, mUser, "Fatal Error: %s", msg.c_str());
 #endif
 			exit(1);
 		}
+
+		TimerWheel::TimerWheel(const uint32_t tickMSec, const uint32_t slots)
+		{
+			mSlotCount		= slots > 0 ? slots : TIMER_WHEEL_DEFAULT_SLOTS;
+			mOccupiedWords	= (mSlotCount + 63) / 64;
+			mOverflow		= TIMER_WHEEL_LEVELS * mSlotCount;
+			mSlots.resize(mOverflow + 1);
+			mOccupied.resize(TIMER_WHEEL_LEVELS * mOccupiedWords, 0);
+			mTickMSec		= tickMSec > 0 ? tickMSec : TIMER_WHEEL_DEFAULT_TICK_MSEC;
+			mStart			= std::chrono::steady_clock::now();
+			mCurrentTick	= 0;
+			mNextId			= 1;
+			mArmedTick		= 0;
+
+			// Saturates rather than wraps for huge slot counts, the top levels just never fill
+			mLevelTicks[0] = 1;
+			for (int level = 1; level <= TIMER_WHEEL_LEVELS; level++)
+			{
+				uint64_t below = mLevelTicks[level - 1];
+				mLevelTicks[level] = below > UINT64_MAX / mSlotCount ? UINT64_MAX : below * mSlotCount;
+			}
+#ifdef _WIN32
+			mTimerFD		= -1;
+#else
+			mTimerFD		= timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+#endif
+		}
+
+		TimerWheel::~TimerWheel()
+		{
+#ifndef _WIN32
+			if (mTimerFD != -1)
+			{
+				close(mTimerFD);
+			}
+#endif
+		}
+
+		uint64_t TimerWheel::Schedule(const uint64_t delayMSec, const std::function<void()>& callback)
+		{
+			// Round up so a deadline never fires early, and always at least one tick away
+			uint64_t ticks = (delayMSec + mTickMSec - 1) / mTickMSec;
+			uint64_t target = GetNowTick() + (ticks > 0 ? ticks : 1);
+			if (target < mCurrentTick)
+			{
+				target = mCurrentTick;
+			}
+
+			uint64_t id = mNextId++;
+			size_t slot = Locate(target);
+			auto& list = mSlots[slot];
+			list.push_back({ id, target, slot, callback });
+			mIndex[id] = std::prev(list.end());
+			SetOccupied(slot, true);
+
+			// Only an earlier wake needs the timerfd touched
+			uint64_t tick = GetSlotTick(slot);
+			if (mArmedTick == 0 || tick < mArmedTick)
+			{
+				Arm(tick);
+			}
+
+			return id;
+		}
+
+		bool TimerWheel::Cancel(const uint64_t id)
+		{
+			auto it = mIndex.find(id);
+			if (it == mIndex.end())
+			{
+				return false;
+			}
+
+			size_t slot = it->second->slot;
+			mSlots[slot].erase(it->second);
+			mIndex.erase(it);
+
+			if (mSlots[slot].empty())
+			{
+				SetOccupied(slot, false);
+			}
+
+			return true;
+		}
+
+		int TimerWheel::Advance()
+		{
+			uint64_t now = GetNowTick();
+			std::vector<std::function<void()>> expired;
+
+			// Jump from one occupied slot to the next, the ticks between have nothing in them
+			for (uint64_t tick = GetNextTick(); tick != 0 && tick <= now; tick = GetNextTick())
+			{
+				// Entering a coarser slot moves its deadlines down first, some may be due on this tick
+				MoveTo(tick);
+
+				size_t slot = static_cast<size_t>(tick % mSlotCount);
+				for (Entry& entry : mSlots[slot])
+				{
+					expired.push_back(std::move(entry.callback));
+					mIndex.erase(entry.id);
+				}
+				mSlots[slot].clear();
+				SetOccupied(slot, false);
+
+				MoveTo(tick + 1);
+			}
+
+			if (now + 1 > mCurrentTick)
+			{
+				MoveTo(now + 1);
+			}
+
+			uint64_t next = GetNextTick();
+			if (next != mArmedTick)
+			{
+				Arm(next);
+			}
+
+			// Callbacks run after the wheel is updated so they are free to schedule and cancel
+			for (auto& callback : expired)
+			{
+				callback();
+			}
+
+			return static_cast<int>(expired.size());
+		}
+
+		int TimerWheel::HandleEvent()
+		{
+#ifndef _WIN32
+			uint64_t expirations = 0;
+			while (read(mTimerFD, &expirations, sizeof(expirations)) > 0)
+			{
+				// Drain, the wheel works out elapsed ticks from the clock
+			}
+
+			// One-shot, it has fired and has to be armed again whatever Advance finds
+			mArmedTick = 0;
+#endif
+			return Advance();
+		}
+
+		int TimerWheel::GetFD() const
+		{
+			return mTimerFD;
+		}
+
+		size_t TimerWheel::GetPendingCount() const
+		{
+			return mIndex.size();
+		}
+
+		uint64_t TimerWheel::GetNowTick()
+		{
+			auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - mStart);
+			return static_cast<uint64_t>(elapsed.count()) / mTickMSec;
+		}
+
+		size_t TimerWheel::Locate(const uint64_t dueTick) const
+		{
+			// The lowest level whose current revolution the deadline falls in, so no slot ever holds two
+			// revolutions and everything on level 0 is due on its slot's tick
+			for (size_t level = 0; level < TIMER_WHEEL_LEVELS; level++)
+			{
+				if (dueTick / mLevelTicks[level + 1] == mCurrentTick / mLevelTicks[level + 1])
+				{
+					return level * mSlotCount + static_cast<size_t>((dueTick / mLevelTicks[level]) % mSlotCount);
+				}
+			}
+
+			return mOverflow;
+		}
+
+		void TimerWheel::Place(std::list<Entry>& from, std::list<Entry>::iterator entry)
+		{
+			// Splicing keeps the iterator in mIndex valid
+			size_t slot = Locate(entry->dueTick);
+			entry->slot = slot;
+			mSlots[slot].splice(mSlots[slot].end(), from, entry);
+			SetOccupied(slot, true);
+		}
+
+		void TimerWheel::SetOccupied(const size_t slot, const bool occupied)
+		{
+			if (slot == mOverflow)
+			{
+				return;
+			}
+
+			uint64_t& word = mOccupied[(slot / mSlotCount) * mOccupiedWords + (slot % mSlotCount) / 64];
+			uint64_t bit = 1ull << ((slot % mSlotCount) % 64);
+			word = occupied ? (word | bit) : (word & ~bit);
+		}
+
+		uint64_t TimerWheel::GetSlotTick(const size_t slot) const
+		{
+			if (slot == mOverflow)
+			{
+				return (mCurrentTick / mLevelTicks[TIMER_WHEEL_LEVELS] + 1) * mLevelTicks[TIMER_WHEEL_LEVELS];
+			}
+
+			size_t level = slot / mSlotCount;
+			uint64_t revolution = (mCurrentTick / mLevelTicks[level + 1]) * mLevelTicks[level + 1];
+			return revolution + (slot % mSlotCount) * mLevelTicks[level];
+		}
+
+		uint64_t TimerWheel::GetNextTick() const
+		{
+			// Everything on a level is due before anything on the level above, so the first occupied
+			// slot of the lowest level with one is next. Slots behind the current tick are always empty.
+			for (size_t level = 0; level < TIMER_WHEEL_LEVELS; level++)
+			{
+				size_t from = static_cast<size_t>((mCurrentTick / mLevelTicks[level]) % mSlotCount) + (level > 0 ? 1 : 0);
+				const uint64_t* words = mOccupied.data() + level * mOccupiedWords;
+
+				for (size_t word = from / 64; word < mOccupiedWords; word++)
+				{
+					uint64_t bits = words[word];
+					if (word == from / 64)
+					{
+						bits &= ~0ull << (from % 64);
+					}
+
+					if (bits != 0)
+					{
+						return GetSlotTick(level * mSlotCount + word * 64 + static_cast<size_t>(std::countr_zero(bits)));
+					}
+				}
+			}
+
+			return mSlots[mOverflow].empty() ? 0 : GetSlotTick(mOverflow);
+		}
+
+		void TimerWheel::MoveTo(const uint64_t tick)
+		{
+			uint64_t previous = mCurrentTick;
+			mCurrentTick = tick;
+
+			// Top down, so deadlines moved from one level can be moved again from the level below
+			for (size_t level = TIMER_WHEEL_LEVELS; level > 0; level--)
+			{
+				if (tick / mLevelTicks[level] == previous / mLevelTicks[level])
+				{
+					continue;
+				}
+
+				size_t from = level == TIMER_WHEEL_LEVELS ? mOverflow :
+					level * mSlotCount + static_cast<size_t>((tick / mLevelTicks[level]) % mSlotCount);
+
+				// Taken out first as overflow deadlines still past the top level go straight back in
+				std::list<Entry> moving;
+				moving.splice(moving.end(), mSlots[from]);
+				SetOccupied(from, false);
+
+				while (!moving.empty())
+				{
+					Place(moving, moving.begin());
+				}
+			}
+		}
+
+		void TimerWheel::Arm(const uint64_t tick)
+		{
+#ifndef _WIN32
+			if (mTimerFD == -1)
+			{
+				return;
+			}
+
+			// One-shot at the tick, on the same monotonic clock the wheel counts ticks from
+			itimerspec spec = {};
+			int flags = 0;
+			if (tick != 0)
+			{
+				auto due = mStart.time_since_epoch() + std::chrono::milliseconds(tick * mTickMSec);
+				auto dueNSec = std::chrono::duration_cast<std::chrono::nanoseconds>(due).count();
+				spec.it_value.tv_sec = static_cast<time_t>(dueNSec / 1000000000LL);
+				spec.it_value.tv_nsec = static_cast<long>(dueNSec % 1000000000LL);
+				flags = TFD_TIMER_ABSTIME;
+			}
+
+			if (timerfd_settime(mTimerFD, flags, &spec, nullptr) == 0)
+			{
+				mArmedTick = tick;
+			}
+#else
+			mArmedTick = tick;
+#endif
+		}
 	}
-}
\ No newline at end of file
+}
@@ -9,19 +9,29 @@
 //  Includes:
 //          name                        reason included
 //          --------------------        ---------------------------------------
-#pragma comment(lib, "Winmm.lib")		
 #ifdef _WIN32
+#pragma comment(lib, "Winmm.lib")		
 #include <iostream>						// IO stream
 #include <windows.h>					// Windows 
 #else
 #include <sys/time.h>
-#include <time.h>
+#include <time.h>						// clock_gettime, nanosleep
 #include <unistd.h>
+#include <cerrno>						// errno
+#include <sys/timerfd.h>				// Timer wheel event loop integration
 #endif
 //
 #include <cstdint>						// Standard integer types
+#include <cstdio>						// printf
+#include <cstdlib>						// exit
 #include <string>						// Strings
 #include <thread>						// Threading
+#include <functional>					// Timer wheel callbacks
+#include <list>							// Timer wheel slots
+#include <vector>						// Timer wheel
+#include <unordered_map>				// Timer wheel cancel index
+#include <bit>							// Timer wheel occupancy scan
+#include <chrono>						// Timer wheel clock
 //
 // 
 //	Defines:
@@ -34,6 +44,10 @@
 #ifndef     CPP_TIMER					// Define the cpp timer class. 
 #define     CPP_TIMER
 //
+#define		TIMER_WHEEL_DEFAULT_TICK_MSEC	10		// Timer wheel resolution
+#define		TIMER_WHEEL_DEFAULT_SLOTS		512		// Timer wheel slots per level, one revolution is slots * tick
+#define		TIMER_WHEEL_LEVELS				3		// Timer wheel levels, each slot of a level spans a revolution of the one below
+//
 ///////////////////////////////////////////////////////////////////////////////
 
 namespace Essentials
@@ -64,6 +78,12 @@ namespace Essentials
 			//! @brief Get the current timer ticks in Microseconds
 			uint32_t		GetUSecTicks();
 
+			//! @brief Get the current timer ticks in Milliseconds, never wraps
+			uint64_t		GetMSecTicks64();
+
+			//! @brief Get the current timer ticks in Microseconds, never wraps
+			uint64_t		GetUSecTicks64();
+
 			//! @brief Milliseconds sleep command
 			void			MSecSleep(const uint32_t mSecs);
 
@@ -76,7 +96,7 @@ namespace Essentials
 			Timer();		//!< Hidden Constructor
 			~Timer();		//!< Hidden Deconstructor
 
-			//! @brief Hidden Initializer - starts the thread. 
+			//! @brief Hidden Initializer - starts the thread on Windows, Linux reads the monotonic clock directly.
 			void			Initialize();
 
 			//! @brief Handle True Milliseconds as an event
@@ -88,16 +108,124 @@ namespace Essentials
 			//!< VARIABLES
 			bool			mInitialized = false;		//!< Track if initialized
 			bool			mClosing = false;			//!< Track if closing.
-			uint32_t		mTickOffset;				//!< Timer offset from start up timer
-			bool			mTimerThreadReady;			//!< Thread flag
-			uint64_t		mUSecStartTime;				//!< System start time in usec
-			volatile uint32_t	mTickCount;				//!< Tick count
+			uint64_t		mTickOffset = 0;			//!< Millisecond offset applied by Reset
+			bool			mTimerThreadReady = false;	//!< Thread flag
+			uint64_t		mUSecStartTime = 0;			//!< System start time in usec, counter ticks on Windows
+			volatile uint32_t	mTickCount = 0;			//!< Tick count
 			double			mTimerFactor;				//!< Timer factor
 			static Timer* mInstance;					//!< Instance of Logger
-			std::thread* mThread;					//!< Pointer to a thread object
+			std::thread* mThread = nullptr;			//!< Pointer to a thread object
 			std::string		mUser;						//!< System User for Log information location
 		};
 
+		//! @brief A hierarchical timer wheel for large numbers of deadlines, such as idle connection timeouts
+		//! and retransmits. Near deadlines sit in the slot for their tick, later ones in a coarser level and
+		//! are moved down as their slot comes round. Schedule and Cancel are O(1), and an occupancy bitmap per
+		//! level lets the wheel jump straight to the next occupied slot, so empty ticks cost nothing however
+		//! long the loop slept. On Linux the wheel owns a one-shot timerfd armed for that slot; add GetFD to an
+		//! event loop and call HandleEvent when it is readable. Elsewhere call Advance periodically.
+		class TimerWheel
+		{
+		public:
+			//! @brief Constructor
+			//! @param tickMSec - in - Resolution of the wheel in milliseconds
+			//! @param slots - in - Number of slots in each level of the wheel
+			TimerWheel(const uint32_t tickMSec = TIMER_WHEEL_DEFAULT_TICK_MSEC, const uint32_t slots = TIMER_WHEEL_DEFAULT_SLOTS);
+
+			//! @brief Deconstructor
+			~TimerWheel();
+
+			//! @brief Prevent copying
+			TimerWheel(const TimerWheel&) = delete;
+			TimerWheel& operator=(const TimerWheel&) = delete;
+
+			//! @brief Schedule a callback to run once after a delay
+			//! @param delayMSec - in - Milliseconds until the callback runs, rounded up to the wheel resolution
+			//! @param callback - in - Function to be called
+			//! @return id of the deadline, used to cancel it
+			uint64_t		Schedule(const uint64_t delayMSec, const std::function<void()>& callback);
+
+			//! @brief Cancel a pending deadline. The timerfd is left armed, a wake with nothing due just arms the next.
+			//! @param id - in - id returned by Schedule
+			//! @return true if the deadline was pending
+			bool			Cancel(const uint64_t id);
+
+			//! @brief Runs every callback whose deadline has passed
+			//! @return number of callbacks run
+			int				Advance();
+
+			//! @brief Clears the timerfd and advances the wheel, call when GetFD is readable
+			//! @return number of callbacks run
+			int				HandleEvent();
+
+			//! @brief Get the descriptor that becomes readable when the earliest pending deadline is due
+			//! @return timerfd, -1 where not supported
+			int				GetFD() const;
+
+			//! @brief Get the number of pending deadlines
+			size_t			GetPendingCount() const;
+
+		protected:
+		private:
+			//!< A pending deadline
+			struct Entry
+			{
+				uint64_t				id;			//!< Deadline id
+				uint64_t				dueTick;	//!< Wheel tick it is due on
+				size_t					slot;		//!< Slot it is in, level * slots + slot, mOverflow past the top level
+				std::function<void()>	callback;	//!< Function to call when due
+			};
+
+			//! @brief Get the current wheel tick
+			uint64_t		GetNowTick();
+
+			//! @brief Find the slot a deadline belongs in from the current tick
+			//! @param dueTick - in - Tick the deadline is due on
+			//! @return slot index, mOverflow if it is past the top level
+			size_t			Locate(const uint64_t dueTick) const;
+
+			//! @brief Moves a deadline into the slot it belongs in from the current tick
+			//! @param from - in - List the deadline is in now
+			//! @param entry - in - Deadline to move
+			void			Place(std::list<Entry>& from, std::list<Entry>::iterator entry);
+
+			//! @brief Marks a slot as holding deadlines or not, the overflow isn't tracked
+			//! @param slot - in - Slot index
+			//! @param occupied - in - true if it holds deadlines
+			void			SetOccupied(const size_t slot, const bool occupied);
+
+			//! @brief Get the tick a slot next needs attention, its deadline on level 0, when it moves down above that
+			//! @param slot - in - Slot index
+			uint64_t		GetSlotTick(const size_t slot) const;
+
+			//! @brief Get the tick the wheel next has something to do
+			//! @return tick, 0 if nothing is pending
+			uint64_t		GetNextTick() const;
+
+			//! @brief Moves the current tick on, moving down the deadlines of every coarser slot it enters
+			//! @param tick - in - New current tick
+			void			MoveTo(const uint64_t tick);
+
+			//! @brief Points the timerfd at a tick, or disarms it for 0
+			//! @param tick - in - Tick to fire at
+			void			Arm(const uint64_t tick);
+
+			//!< VARIABLES
+			std::vector<std::list<Entry>>	mSlots;			//!< Wheel slots, level by level, then the overflow
+			std::vector<uint64_t>	mOccupied;			//!< Bit per slot with deadlines in it, level by level
+			std::unordered_map<uint64_t, std::list<Entry>::iterator> mIndex;	//!< Deadline id to entry
+			uint64_t		mLevelTicks[TIMER_WHEEL_LEVELS + 1];	//!< Ticks a slot of each level spans, then the whole wheel
+			size_t			mSlotCount;					//!< Slots per level
+			size_t			mOccupiedWords;				//!< Bitmap words per level
+			size_t			mOverflow;					//!< Slot holding deadlines past the top level
+			uint64_t		mCurrentTick;				//!< Next tick to process, every earlier one has run
+			std::chrono::steady_clock::time_point mStart;	//!< When the wheel was created
+			uint32_t		mTickMSec;					//!< Wheel resolution
+			uint64_t		mNextId;					//!< Next deadline id
+			int				mTimerFD;					//!< timerfd driving the wheel
+			uint64_t		mArmedTick;					//!< Tick the timerfd fires at, 0 when disarmed
+		};
+
 	}
 }
 
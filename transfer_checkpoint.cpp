@@ -0,0 +1,270 @@
+///////////////////////////////////////////////////////////////////////////////
+//! @file		transfer_checkpoint.cpp
+//! @brief		Implementation of the transfer checkpoint class
+//! @author		Chip Brommer
+///////////////////////////////////////////////////////////////////////////////
+
+///////////////////////////////////////////////////////////////////////////////
+//
+//  Includes:
+//          name                        reason included
+//          --------------------        ---------------------------------------
+#include	"transfer_checkpoint.h"		// Transfer checkpoint class
+//
+///////////////////////////////////////////////////////////////////////////////
+
+namespace Essentials
+{
+	namespace Utilities
+	{
+		TransferCheckpoint::TransferCheckpoint()
+		{
+			Clear();
+		}
+
+		void TransferCheckpoint::Reset(const uint64_t transferId, const uint64_t totalSize)
+		{
+			mActive			= true;
+			mTransferId		= transferId;
+			mTotalSize		= totalSize;
+			mReceivedBytes	= 0;
+			mRanges.clear();
+		}
+
+		void TransferCheckpoint::Clear()
+		{
+			mActive			= false;
+			mTransferId		= 0;
+			mTotalSize		= 0;
+			mReceivedBytes	= 0;
+			mRanges.clear();
+		}
+
+		void TransferCheckpoint::AddRange(const uint64_t offset, const uint64_t length)
+		{
+			if (length == 0)
+			{
+				return;
+			}
+
+			uint64_t start = offset;
+			uint64_t end = offset + length;
+
+			// Step back to a range that starts before us in case it reaches into us
+			auto it = mRanges.upper_bound(start);
+			if (it != mRanges.begin())
+			{
+				--it;
+				if (it->second < start)
+				{
+					++it;
+				}
+			}
+
+			// Swallow every range we overlap or touch
+			while (it != mRanges.end() && it->first <= end)
+			{
+				start = std::min(start, it->first);
+				end = std::max(end, it->second);
+				mReceivedBytes -= it->second - it->first;
+				it = mRanges.erase(it);
+			}
+
+			mRanges[start] = end;
+			mReceivedBytes += end - start;
+		}
+
+		bool TransferCheckpoint::IsActive() const
+		{
+			return mActive;
+		}
+
+		bool TransferCheckpoint::IsComplete() const
+		{
+			return mActive && mReceivedBytes == mTotalSize &&
+				(mTotalSize == 0 || (mRanges.size() == 1 && mRanges.begin()->first == 0));
+		}
+
+		bool TransferCheckpoint::Contains(const uint64_t offset, const uint64_t length) const
+		{
+			// Ranges never touch, so the one starting at or before us must hold all of it
+			auto it = mRanges.upper_bound(offset);
+			if (it == mRanges.begin())
+			{
+				return length == 0;
+			}
+			--it;
+
+			return it->second >= offset + length;
+		}
+
+		uint64_t TransferCheckpoint::GetTransferId() const
+		{
+			return mTransferId;
+		}
+
+		uint64_t TransferCheckpoint::GetTotalSize() const
+		{
+			return mTotalSize;
+		}
+
+		uint64_t TransferCheckpoint::GetReceivedBytes() const
+		{
+			return mReceivedBytes;
+		}
+
+		const std::map<uint64_t, uint64_t>& TransferCheckpoint::GetRanges() const
+		{
+			return mRanges;
+		}
+
+		std::string TransferCheckpoint::GetStatus() const
+		{
+			TRANSFER_STATUS status = { 0 };
+			status.transferId = mTransferId;
+			status.totalSize = mTotalSize;
+			status.receivedBytes = mReceivedBytes;
+			status.rangeCount = static_cast<uint32_t>(mRanges.size());
+
+			std::string out(reinterpret_cast<const char*>(&status), sizeof(status));
+			for (const auto& range : mRanges)
+			{
+				TRANSFER_RANGE entry = { range.first, range.second - range.first };
+				out.append(reinterpret_cast<const char*>(&entry), sizeof(entry));
+			}
+
+			return out;
+		}
+
+		std::string TransferCheckpoint::GetMissing(const size_t maxRanges) const
+		{
+			std::string ranges;
+			uint32_t count = 0;
+			uint64_t position = 0;
+
+			// The gaps are whatever lies between the received ranges and after the last of them
+			auto it = mRanges.begin();
+			while (position < mTotalSize && count < maxRanges)
+			{
+				uint64_t end = (it != mRanges.end()) ? it->first : mTotalSize;
+				if (end > position)
+				{
+					TRANSFER_RANGE entry = { position, end - position };
+					ranges.append(reinterpret_cast<const char*>(&entry), sizeof(entry));
+					count++;
+				}
+
+				if (it == mRanges.end())
+				{
+					break;
+				}
+				position = it->second;
+				++it;
+			}
+
+			TRANSFER_STATUS status = { 0 };
+			status.transferId = mTransferId;
+			status.totalSize = mTotalSize;
+			status.receivedBytes = mReceivedBytes;
+			status.rangeCount = count;
+
+			return std::string(reinterpret_cast<const char*>(&status), sizeof(status)) + ranges;
+		}
+
+		int TransferCheckpoint::Save(const std::string& path) const
+		{
+			FileHeader header = { TRANSFER_CHECKPOINT_MAGIC, TRANSFER_CHECKPOINT_VERSION, mTransferId, mTotalSize, mRanges.size() };
+			std::string tempPath = path + ".part";
+
+			FILE* file = fopen(tempPath.c_str(), "wb");
+			if (file == nullptr)
+			{
+				return -1;
+			}
+
+			bool ok = fwrite(&header, sizeof(header), 1, file) == 1;
+			for (const auto& range : mRanges)
+			{
+				TRANSFER_RANGE entry = { range.first, range.second - range.first };
+				ok = ok && fwrite(&entry, sizeof(entry), 1, file) == 1;
+			}
+
+			// The rename must not reach the disk before the contents do
+			ok = ok && fflush(file) == 0;
+#ifdef WIN32
+			ok = ok && _commit(_fileno(file)) == 0;
+#else
+			ok = ok && fsync(fileno(file)) == 0;
+#endif
+			ok = (fclose(file) == 0) && ok;
+
+			std::error_code ec;
+			if (ok)
+			{
+				std::filesystem::rename(tempPath, path, ec);
+			}
+
+			if (!ok || ec)
+			{
+				std::filesystem::remove(tempPath, ec);
+				return -1;
+			}
+
+#ifndef WIN32
+			std::string directory = std::filesystem::path(path).parent_path().string();
+			int dirFd = open(directory.empty() ? "." : directory.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+			if (dirFd >= 0)
+			{
+				fsync(dirFd);
+				close(dirFd);
+			}
+#endif
+			return 0;
+		}
+
+		int TransferCheckpoint::Load(const std::string& path)
+		{
+			Clear();
+
+			FILE* file = fopen(path.c_str(), "rb");
+			if (file == nullptr)
+			{
+				return -1;
+			}
+
+			FileHeader header = { 0 };
+			bool ok = fread(&header, sizeof(header), 1, file) == 1 &&
+				header.magic == TRANSFER_CHECKPOINT_MAGIC && header.version == TRANSFER_CHECKPOINT_VERSION;
+
+			if (ok)
+			{
+				Reset(header.transferId, header.totalSize);
+				for (uint64_t i = 0; ok && i < header.rangeCount; i++)
+				{
+					TRANSFER_RANGE entry = { 0 };
+					ok = fread(&entry, sizeof(entry), 1, file) == 1 && entry.offset <= mTotalSize && entry.length <= mTotalSize - entry.offset;
+					if (ok)
+					{
+						AddRange(entry.offset, entry.length);
+					}
+				}
+			}
+
+			fclose(file);
+
+			if (!ok)
+			{
+				Clear();
+				return -1;
+			}
+
+			return 0;
+		}
+
+		void TransferCheckpoint::Remove(const std::string& path)
+		{
+			std::error_code ec;
+			std::filesystem::remove(path, ec);
+		}
+	}
+}
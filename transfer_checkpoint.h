@@ -0,0 +1,136 @@
+///////////////////////////////////////////////////////////////////////////////
+//! @file		transfer_checkpoint.h
+//! @brief		Tracks and persists the byte ranges received for a resumable upload
+//! @author		Chip Brommer
+///////////////////////////////////////////////////////////////////////////////
+#pragma once
+///////////////////////////////////////////////////////////////////////////////
+//
+//  Includes:
+//          name                        reason included
+//          --------------------        ---------------------------------------
+#ifdef WIN32
+#include <io.h>							// _commit
+#else
+#include <fcntl.h>						// open
+#include <unistd.h>						// fsync, close
+#endif
+#include <cstdint>						// Standard integer types
+#include <cstdio>						// fopen, fwrite
+#include <algorithm>					// std::min, std::max
+#include <map>							// Received ranges
+#include <string>						// Strings
+#include <vector>						// Range lists
+#include <filesystem>					// Atomic rename
+#include "project_messages.h"			// Transfer structures
+//
+//	Defines:
+//          name                        reason defined
+//          --------------------        ---------------------------------------
+#ifndef     CPP_TRANSFER_CHECKPOINT		// Define the cpp transfer checkpoint class.
+#define     CPP_TRANSFER_CHECKPOINT
+//
+///////////////////////////////////////////////////////////////////////////////
+
+namespace Essentials
+{
+	namespace Utilities
+	{
+		constexpr static uint32_t	TRANSFER_CHECKPOINT_MAGIC		= 0x4B435555;	// "UUCK"
+		constexpr static uint32_t	TRANSFER_CHECKPOINT_VERSION		= 1;			// Bump when the checkpoint layout changes
+		constexpr static const char* TRANSFER_CHECKPOINT_EXTENSION	= ".ckpt";		// Checkpoint sits next to the file being received
+
+		/// @brief Keeps the set of byte ranges received for an upload, merged as they arrive, and saves
+		/// it to disk. A checkpoint must only be saved once the data it describes has been flushed, it
+		/// is then safe to resume from after a dropped connection or a power cut.
+		class TransferCheckpoint
+		{
+		public:
+			/// @brief Constructor
+			TransferCheckpoint();
+
+			/// @brief Starts tracking a new transfer
+			/// @param transferId -[in]- Id the client gave the transfer
+			/// @param totalSize -[in]- Size of the complete file
+			void Reset(const uint64_t transferId, const uint64_t totalSize);
+
+			/// @brief Stops tracking any transfer
+			void Clear();
+
+			/// @brief Records a range as received, overlapping and touching ranges are merged
+			/// @param offset -[in]- Offset of the range
+			/// @param length -[in]- Length of the range
+			void AddRange(const uint64_t offset, const uint64_t length);
+
+			/// @brief Check if a range has already been received in full
+			/// @param offset -[in]- Offset of the range
+			/// @param length -[in]- Length of the range
+			/// @return true if every byte of the range has been received
+			bool Contains(const uint64_t offset, const uint64_t length) const;
+
+			/// @brief Check if a transfer is being tracked
+			/// @return true if tracking a transfer
+			bool IsActive() const;
+
+			/// @brief Check if every byte of the file has been received
+			/// @return true if complete
+			bool IsComplete() const;
+
+			/// @brief Get the id of the transfer being tracked
+			uint64_t GetTransferId() const;
+
+			/// @brief Get the size of the complete file
+			uint64_t GetTotalSize() const;
+
+			/// @brief Get the number of distinct bytes received
+			uint64_t GetReceivedBytes() const;
+
+			/// @brief Get the received ranges
+			/// @return ranges, start to end
+			const std::map<uint64_t, uint64_t>& GetRanges() const;
+
+			/// @brief Builds the TRANSFER_STATUS and TRANSFER_RANGE list sent in answer to a resume
+			/// @return status followed by the received ranges
+			std::string GetStatus() const;
+
+			/// @brief Builds a TRANSFER_STATUS followed by the ranges still missing, lowest first
+			/// @param maxRanges -[in]- Most missing ranges to list
+			/// @return status followed by up to maxRanges missing ranges
+			std::string GetMissing(const size_t maxRanges) const;
+
+			/// @brief Saves the ranges durably, replacing any earlier checkpoint
+			/// @param path -[in]- Checkpoint file path
+			/// @return 0 if successful, -1 if fails
+			int Save(const std::string& path) const;
+
+			/// @brief Loads a checkpoint saved by Save
+			/// @param path -[in]- Checkpoint file path
+			/// @return 0 if successful, -1 if missing or corrupt
+			int Load(const std::string& path);
+
+			/// @brief Removes a checkpoint file
+			/// @param path -[in]- Checkpoint file path
+			static void Remove(const std::string& path);
+
+		protected:
+		private:
+			/// @brief Header of the checkpoint file, followed by rangeCount TRANSFER_RANGEs
+			struct FileHeader
+			{
+				uint32_t	magic;				// TRANSFER_CHECKPOINT_MAGIC
+				uint32_t	version;			// TRANSFER_CHECKPOINT_VERSION
+				uint64_t	transferId;			// Id of the transfer
+				uint64_t	totalSize;			// Size of the complete file
+				uint64_t	rangeCount;			// Number of ranges that follow
+			};
+
+			bool						mActive;			// A transfer is being tracked
+			uint64_t					mTransferId;		// Id of the transfer
+			uint64_t					mTotalSize;			// Size of the complete file
+			uint64_t					mReceivedBytes;		// Distinct bytes received
+			std::map<uint64_t, uint64_t> mRanges;			// Received ranges, start to end
+		};
+	}
+}
+
+#endif		// CPP_TRANSFER_CHECKPOINT
@@ -25,12 +25,11 @@ namespace Essentials
 			mBroadcastAddr		= {};
 			mLastReceiveInfo	= new Endpoint();
 			mTimeout.tv_sec		= UDP_DEFAULT_SOCKET_TIMEOUT;
-#if WIN32
-			mTimeout.tv_usec	= UDP_DEFAULT_SOCKET_TIMEOUT * 1000;
-#else
-			mTimeout.tv_usec	= static_cast<__suseconds_t>(UDP_DEFAULT_SOCKET_TIMEOUT) * 1000;
-#endif
+			mTimeout.tv_usec	= 0;
 			mTimeToLive			= 2;
+			mSegmentationOffload	= true;
+			mTimestamps			= false;
+			mHardwareTimestamps	= false;
 
 #ifdef WIN32
 			if (WSAStartup(MAKEWORD(2, 2), &mWsaData) != 0) 
@@ -40,6 +39,9 @@ namespace Essentials
 #endif
 			mSocket				= INVALID_SOCKET;
 			mBroadcastSocket	= INVALID_SOCKET;
+#ifndef WIN32
+			mEpollFD			= epoll_create1(EPOLL_CLOEXEC);
+#endif
 		}
 
 		UDP_Client::UDP_Client(const std::string& clientsAddress, const int16_t clientsPort) : UDP_Client()
@@ -49,11 +51,7 @@ namespace Essentials
 				mLastError = UdpClientError::BAD_ADDRESS;
 			}
 
-			if (ValidatePort(clientsPort) == false)
-			{
-				mLastError = UdpClientError::BAD_PORT;
-			}
-
+			// Every port is valid to bind to, 0 lets the system pick one
 			// Setup mClientAddr
 			memset(reinterpret_cast<char*>(&mClientAddr), 0, sizeof(mClientAddr));
 			mClientAddr.sin_family = AF_INET;
@@ -73,18 +71,17 @@ namespace Essentials
 
 #ifdef WIN32
 			WSACleanup();
+#else
+			if (mEpollFD != -1)
+			{
+				close(mEpollFD);
+			}
 #endif
 		}
 
 		int8_t UDP_Client::ConfigureThisClient(const std::string& address, const int16_t port)
 		{
-			// Validate port number
-			if (ValidatePort(port) == false)
-			{
-				mLastError = UdpClientError::BAD_PORT;
-				return -1;
-			}
-
+			// Every port is valid to bind to, 0 lets the system pick one
 			// Setup mClientAddr
 			memset(reinterpret_cast<char*>(&mClientAddr), 0, sizeof(mClientAddr));
 
@@ -120,7 +117,7 @@ namespace Essentials
 				return -1;
 			}
 
-			if (ValidatePort(port) == false)
+			if (ValidatePort(static_cast<uint16_t>(port)) == false)
 			{
 				mLastError = UdpClientError::BAD_PORT;
 				return -1;
@@ -147,7 +144,7 @@ namespace Essentials
 				return -1;
 			}
 
-			if (!ValidatePort(port))
+			if (!ValidatePort(static_cast<uint16_t>(port)))
 			{
 				mLastError = UdpClientError::BAD_PORT;
 				return -1;
@@ -169,7 +166,7 @@ namespace Essentials
 			mBroadcastAddr.sin_addr.s_addr = INADDR_BROADCAST;
 
 			// set broadcast option
-			int8_t broadcast = 1;
+			int broadcast = 1;
 			if (setsockopt(mBroadcastSocket, SOL_SOCKET, SO_BROADCAST, (char*)&broadcast, sizeof(broadcast)) < 0)
 			{
 				mLastError = UdpClientError::ENABLE_BROADCAST_FAILED;
@@ -197,6 +194,10 @@ namespace Essentials
 				return -1;
 			}
 
+			// Give the kernel room to queue a burst of broadcasts while we are busy, best effort.
+			int receiveBuffer = UDP_LISTENER_RECEIVE_BUFFER;
+			setsockopt(sock, SOL_SOCKET, SO_RCVBUF, reinterpret_cast<const char*>(&receiveBuffer), sizeof(receiveBuffer));
+
 			sockaddr_in addr{};
 			addr.sin_family = AF_INET;
 			addr.sin_port = htons(port);
@@ -211,6 +212,7 @@ namespace Essentials
 			Endpoint ep{ "", port };
 
 			mBroadcastListeners.push_back({sock,addr,ep});
+			WatchSocket(sock, SocketType::BROADCAST_LISTENER, ep);
 
 			return 0;
 		}
@@ -257,7 +259,7 @@ namespace Essentials
 				return -1;
 			}
 
-			if (ValidatePort(groupPort) == false)
+			if (ValidatePort(static_cast<uint16_t>(groupPort)) == false)
 			{
 				mLastError = UdpClientError::BAD_PORT;
 				return -1;
@@ -275,7 +277,7 @@ namespace Essentials
 			}
 
 			// Enable SO_REUSEADDR to allow multiple sockets to bind to the same address
-			int8_t reuseAddr = 1;
+			int reuseAddr = 1;
 			if (setsockopt(sock, SOL_SOCKET, SO_REUSEADDR, (const char*)&reuseAddr, sizeof(reuseAddr)) == SOCKET_ERROR)
 			{
 				closesocket(sock);
@@ -322,6 +324,10 @@ namespace Essentials
 				return -1;
 			}
 
+			// A whole image can arrive on the group, give the kernel room to queue a burst while we are busy. Best effort.
+			int receiveBuffer = UDP_LISTENER_RECEIVE_BUFFER;
+			setsockopt(sock, SOL_SOCKET, SO_RCVBUF, reinterpret_cast<const char*>(&receiveBuffer), sizeof(receiveBuffer));
+
 			// Join the multicast group
 			ip_mreq multicastRequest{};
 			if (inet_pton(AF_INET, groupIP.c_str(), &(multicastRequest.imr_multiaddr)) <= 0)
@@ -362,6 +368,7 @@ namespace Essentials
 #endif
 
 			mMulticastSockets.push_back({ sock, multicastAddr, ep });
+			WatchSocket(sock, SocketType::MULTICAST, ep);
 
 			return 0;
 		}
@@ -405,19 +412,25 @@ namespace Essentials
 			}
 #endif
 			// Set reuseable address. 
-			int8_t opt = 1;
+			int opt = 1;
 			if (setsockopt(mSocket, SOL_SOCKET, SO_REUSEADDR, (const char*)&opt, sizeof(opt)) < 0)
 			{
 				mLastError = UdpClientError::ENABLE_REUSEADDR_FAILED;
 				return -1;
 			}
 
+			// Bulk transfers arrive faster than a busy receiver reads them
+			int receiveBuffer = UDP_LISTENER_RECEIVE_BUFFER;
+			setsockopt(mSocket, SOL_SOCKET, SO_RCVBUF, reinterpret_cast<const char*>(&receiveBuffer), sizeof(receiveBuffer));
+
 			if (bind(mSocket,(sockaddr*)&mClientAddr, sizeof(mClientAddr)) < 0)
 			{
 				mLastError = UdpClientError::BIND_FAILED;
 				return -1;
 			}
 
+			WatchSocket(mSocket, SocketType::UNICAST, { "", static_cast<int16_t>(ntohs(mClientAddr.sin_port)) });
+
 			return 0;
 		}
 
@@ -435,7 +448,7 @@ namespace Essentials
 			return -1;
 		}
 
-		int8_t UDP_Client::SendUnicast(const char* buffer, const uint32_t size)
+		int32_t UDP_Client::SendUnicast(const char* buffer, const uint32_t size)
 		{
 			// verify socket and then send datagram
 			if (mSocket != INVALID_SOCKET)
@@ -456,31 +469,14 @@ namespace Essentials
 			return -1;
 		}
 
-		int8_t UDP_Client::SendUnicast(const char* buffer, const uint32_t size, const std::string& ipAddress, const int16_t port)
+		int32_t UDP_Client::SendUnicast(const char* buffer, const uint32_t size, const std::string& ipAddress, const int16_t port)
 		{
 			// verify socket and then send datagram
 			if (mSocket != INVALID_SOCKET)
 			{
-				if (ValidateIP(ipAddress) == -1)
-				{
-					mLastError = UdpClientError::BAD_ADDRESS;
-					return -1;
-				}
-
-				if (ValidatePort(port) == false)
-				{
-					mLastError = UdpClientError::BAD_PORT;
-					return -1;
-				}
-
-				// Setup mDestinationAddr
 				sockaddr_in sentTo{};
-				memset(reinterpret_cast<char*>(&sentTo), 0, sizeof(sentTo));
-				sentTo.sin_family = AF_INET;
-				sentTo.sin_port = htons(port);
-				if (inet_pton(AF_INET, ipAddress.c_str(), &(sentTo.sin_addr)) <= 0)
+				if (MakeDestination(ipAddress, port, sentTo) < 0)
 				{
-					mLastError = UdpClientError::SET_DESTINATION_FAILED;
 					return -1;
 				}
 
@@ -556,7 +552,89 @@ namespace Essentials
 			return -1;
 		}
 
-		int8_t UDP_Client::ReceiveUnicast(void* buffer, const uint32_t maxSize)
+		int32_t UDP_Client::SendBatch(const OutgoingDatagram* datagrams, const uint32_t count, const SendType type)
+		{
+			switch (type)
+			{
+			case SendType::UNICAST:
+				return mSocket != INVALID_SOCKET ? SendDatagrams(mSocket, mDestinationAddr, datagrams, count, UdpClientError::SEND_FAILED) : -1;
+			case SendType::BROADCAST:
+				return mBroadcastSocket != INVALID_SOCKET ? SendDatagrams(mBroadcastSocket, mBroadcastAddr, datagrams, count, UdpClientError::SEND_BROADCAST_FAILED) : -1;
+			case SendType::MULTICAST:
+			{
+				int32_t numSent = -1;
+				for (const auto& i : mMulticastSockets)
+				{
+					numSent = SendDatagrams(std::get<0>(i), std::get<1>(i), datagrams, count, UdpClientError::SEND_MULTICAST_FAILED);
+					if (numSent < 0)
+					{
+						return -1;
+					}
+				}
+				return numSent;
+			}
+			default: return -1;
+			}
+		}
+
+		int32_t UDP_Client::SendUnicastBatch(const OutgoingDatagram* datagrams, const uint32_t count, const std::string& ipAddress, const int16_t port)
+		{
+			if (mSocket == INVALID_SOCKET)
+			{
+				return -1;
+			}
+
+			sockaddr_in sentTo{};
+			if (MakeDestination(ipAddress, port, sentTo) < 0)
+			{
+				return -1;
+			}
+
+			return SendDatagrams(mSocket, sentTo, datagrams, count, UdpClientError::SEND_FAILED);
+		}
+
+		int32_t UDP_Client::SendSegments(const uint8_t* buffer, const uint32_t size, const uint32_t segmentSize, const SendType type)
+		{
+			switch (type)
+			{
+			case SendType::UNICAST:
+				return mSocket != INVALID_SOCKET ? SendSegmentsTo(mSocket, mDestinationAddr, buffer, size, segmentSize, UdpClientError::SEND_FAILED) : -1;
+			case SendType::BROADCAST:
+				return mBroadcastSocket != INVALID_SOCKET ? SendSegmentsTo(mBroadcastSocket, mBroadcastAddr, buffer, size, segmentSize, UdpClientError::SEND_BROADCAST_FAILED) : -1;
+			case SendType::MULTICAST:
+			{
+				int32_t numSent = -1;
+				for (const auto& i : mMulticastSockets)
+				{
+					numSent = SendSegmentsTo(std::get<0>(i), std::get<1>(i), buffer, size, segmentSize, UdpClientError::SEND_MULTICAST_FAILED);
+					if (numSent < 0)
+					{
+						return -1;
+					}
+				}
+				return numSent;
+			}
+			default: return -1;
+			}
+		}
+
+		int32_t UDP_Client::SendUnicastSegments(const uint8_t* buffer, const uint32_t size, const uint32_t segmentSize, const std::string& ipAddress, const int16_t port)
+		{
+			if (mSocket == INVALID_SOCKET)
+			{
+				return -1;
+			}
+
+			sockaddr_in sentTo{};
+			if (MakeDestination(ipAddress, port, sentTo) < 0)
+			{
+				return -1;
+			}
+
+			return SendSegmentsTo(mSocket, sentTo, buffer, size, segmentSize, UdpClientError::SEND_FAILED);
+		}
+
+		int32_t UDP_Client::ReceiveUnicast(void* buffer, const uint32_t maxSize)
 		{
 			// Store the data source info
 			sockaddr_in sourceAddress{};
@@ -605,9 +683,36 @@ namespace Essentials
 			return sizeRead;
 		}
 
-		int8_t UDP_Client::ReceiveUnicast(void* buffer, const uint32_t maxSize, std::string& recvFromAddr, int16_t& recvFromPort)
+		int32_t UDP_Client::ReceiveUnicast(void* buffer, const uint32_t maxSize, const Deadline deadline)
+		{
+			if (mSocket == INVALID_SOCKET)
+			{
+				return -1;
+			}
+
+			pollfd pfd{};
+			pfd.fd = mSocket;
+			pfd.events = POLLIN;
+
+			// Data can be taken by someone else between the wake up and the read, wait again until the deadline
+			int32_t sizeRead = 0;
+			while (sizeRead == 0)
+			{
+				int32_t waitResult = WaitForSockets(&pfd, 1, deadline);
+				if (waitResult <= 0)
+				{
+					return waitResult;
+				}
+
+				sizeRead = ReceiveUnicast(buffer, maxSize);
+			}
+
+			return sizeRead;
+		}
+
+		int32_t UDP_Client::ReceiveUnicast(void* buffer, const uint32_t maxSize, std::string& recvFromAddr, int16_t& recvFromPort)
 		{
-			int8_t rtn = ReceiveUnicast(buffer, maxSize);
+			int32_t rtn = ReceiveUnicast(buffer, maxSize);
 
 			if (rtn > 0)
 			{
@@ -620,76 +725,31 @@ namespace Essentials
 
 		int8_t UDP_Client::ReceiveBroadcast(void* buffer, const uint32_t maxSize)
 		{
-			if (mBroadcastListeners.size() > 0)
-			{
-				for (const auto& i : mBroadcastListeners)
-				{
-					// Grab the socket and addr info from the vector for use.
-					SOCKET sock = std::get<0>(i);
-					sockaddr_in addr = std::get<1>(i);
-
-					if (sock != INVALID_SOCKET)
-					{
-						// Verify incoming data is available.
-						fd_set readSet{};
-						FD_ZERO(&readSet);
-						FD_SET(sock, &readSet);
-						sockaddr_in recvFrom{};
-						int recvFromSize = sizeof(recvFrom);
-						
-						int selectResult = select((int)sock + 1, &readSet, nullptr, nullptr, &mTimeout);
-						
-						// Catch error
-						if (selectResult == SOCKET_ERROR)
-						{
-							mLastError = UdpClientError::SELECT_READ_ERROR;
-							return 1;
-						}
-
-						// If data is available on this socket, attempt to read it 
-						if (selectResult > 0)
-						{
-#if defined WIN32
-							int32_t receivedBytes = recvfrom(sock, (char*)buffer, maxSize-1, 0, reinterpret_cast<sockaddr*>(&recvFrom), &recvFromSize);
-#else
-							int32_t receivedBytes = recvfrom(mSocket, buffer, static_cast<size_t>(maxSize) - 1, 0, (sockaddr*)&recvFrom, reinterpret_cast<socklen_t*>(&recvFromSize));
-#endif
-
-							if (receivedBytes == SOCKET_ERROR)
-							{
-#ifdef WIN32
-								int errorCode = WSAGetLastError();
-								if (errorCode != WSAEWOULDBLOCK)
-								{
-									mLastError = UdpClientError::RECEIVE_BROADCAST_FAILED;
-									return -1;
-								}
-#else
-								if (errno != EWOULDBLOCK)
-								{
-									mLastError = UdpClientError::RECEIVE_BROADCAST_FAILED;
-									return -1;
-								}
-#endif
-								return 0;
-							}
-
-							char ip[INET_ADDRSTRLEN];
-							inet_ntop(AF_INET, &(recvFrom.sin_addr), ip, INET_ADDRSTRLEN);
-							mLastReceiveInfo->ipAddress = std::string(ip);
-							mLastReceiveInfo->port = ntohs(addr.sin_port);
-							mLastRecvBroadcastPort = mLastReceiveInfo->port;
-							return receivedBytes;
-						}
+			int16_t port = 0;
+			return static_cast<int8_t>(ReceiveBroadcast(buffer, maxSize, port, GetTimeoutDeadline()));
+		}
 
-						// If here, selectResult == 0, so we check next socket. 
-					}
-				}
+		int32_t UDP_Client::ReceiveBroadcast(void* buffer, const uint32_t maxSize, int16_t& port, const Deadline deadline)
+		{
+			if (mBroadcastListeners.empty())
+			{
+				return -1;
+			}
 
-				// If here, for loop completed, and all have no data. 
-				return 0;
+			size_t index = 0;
+			sockaddr_in recvFrom{};
+			int32_t receivedBytes = ReceiveFromFirst(mBroadcastListeners, -1, buffer, maxSize, deadline, UdpClientError::RECEIVE_BROADCAST_FAILED, index, recvFrom);
+			if (receivedBytes > 0)
+			{
+				char ip[INET_ADDRSTRLEN];
+				inet_ntop(AF_INET, &(recvFrom.sin_addr), ip, INET_ADDRSTRLEN);
+				mLastReceiveInfo->ipAddress = std::string(ip);
+				mLastReceiveInfo->port = std::get<2>(mBroadcastListeners[index]).port;
+				mLastRecvBroadcastPort = mLastReceiveInfo->port;
+				port = mLastRecvBroadcastPort;
 			}
-			return -1;
+
+			return receivedBytes;
 		}
 
 		int8_t UDP_Client::ReceiveBroadcast(void* buffer, const uint32_t maxSize, int16_t& port)
@@ -705,184 +765,343 @@ namespace Essentials
 
 		int8_t UDP_Client::ReceiveBroadcastFromListenerPort(void* buffer, const uint32_t maxSize, const int16_t port)
 		{
-			if (mBroadcastListeners.size() > 0)
+			return static_cast<int8_t>(ReceiveBroadcastFromListenerPort(buffer, maxSize, port, GetTimeoutDeadline()));
+		}
+
+		int32_t UDP_Client::ReceiveBroadcastFromListenerPort(void* buffer, const uint32_t maxSize, const int16_t port, const Deadline deadline)
+		{
+			if (mBroadcastListeners.empty())
 			{
-				for (const auto& i : mBroadcastListeners)
-				{
-					// Grab the socket and addr info from the vector for use.
-					SOCKET sock = std::get<0>(i);
-					sockaddr_in addr = std::get<1>(i);
-					Endpoint ep = std::get<2>(i);
+				return -1;
+			}
 
-					// If the ports arent equal, continue to next iteration.
-					if (port != ep.port)
-					{
-						continue;
-					}
+			if (FindBroadcastListener(port) == INVALID_SOCKET)
+			{
+				mLastError = UdpClientError::LISTENER_NOT_FOUND;
+				return -1;
+			}
 
-					if (sock != INVALID_SOCKET)
-					{
-						// Verify incoming data is available.
-						fd_set readSet{};
-						FD_ZERO(&readSet);
-						FD_SET(sock, &readSet);
-						sockaddr_in recvFrom{};
-						int recvFromSize = sizeof(recvFrom);
+			size_t index = 0;
+			sockaddr_in recvFrom{};
+			int32_t receivedBytes = ReceiveFromFirst(mBroadcastListeners, port, buffer, maxSize, deadline, UdpClientError::RECEIVE_BROADCAST_FAILED, index, recvFrom);
+			if (receivedBytes > 0)
+			{
+				char ip[INET_ADDRSTRLEN];
+				inet_ntop(AF_INET, &(recvFrom.sin_addr), ip, INET_ADDRSTRLEN);
+				mLastReceiveInfo->ipAddress = std::string(ip);
+				mLastReceiveInfo->port = port;
+				mLastRecvBroadcastPort = port;
+			}
 
-						int selectResult = select((int)sock + 1, &readSet, nullptr, nullptr, &mTimeout);
+			return receivedBytes;
+		}
 
-						// Catch error
-						if (selectResult == SOCKET_ERROR)
-						{
-							mLastError = UdpClientError::SELECT_READ_ERROR;
-							return 1;
-						}
+		int32_t UDP_Client::ReceiveBroadcastBatch(uint8_t* arena, const uint32_t slotSize, Datagram* datagrams, const uint32_t maxDatagrams, const int16_t port)
+		{
+			return ReceiveBroadcastBatch(arena, slotSize, datagrams, maxDatagrams, port, GetTimeoutDeadline());
+		}
 
-						// If data is available on this socket, attempt to read it 
-						if (selectResult > 0)
-						{
-#if defined WIN32
-							int32_t receivedBytes = recvfrom(sock, (char*)buffer, maxSize - 1, 0, reinterpret_cast<sockaddr*>(&recvFrom), &recvFromSize);
-#else
-							int32_t receivedBytes = recvfrom(mSocket, buffer, static_cast<size_t>(maxSize) - 1, 0, (sockaddr*)&recvFrom, reinterpret_cast<socklen_t*>(&recvFromSize));
-#endif
+		int32_t UDP_Client::ReceiveBroadcastBatch(uint8_t* arena, const uint32_t slotSize, Datagram* datagrams, const uint32_t maxDatagrams, const int16_t port, const Deadline deadline)
+		{
+			if (arena == nullptr || datagrams == nullptr || slotSize == 0 || maxDatagrams == 0)
+			{
+				return -1;
+			}
 
-							if (receivedBytes == SOCKET_ERROR)
-							{
-#ifdef WIN32
-								int errorCode = WSAGetLastError();
-								if (errorCode != WSAEWOULDBLOCK)
-								{
-									mLastError = UdpClientError::RECEIVE_BROADCAST_FAILED;
-									return -1;
-								}
-#else
-								if (errno != EWOULDBLOCK)
-								{
-									mLastError = UdpClientError::RECEIVE_BROADCAST_FAILED;
-									return -1;
-								}
-#endif
-								return 0;
-							}
-
-							char ip[INET_ADDRSTRLEN];
-							inet_ntop(AF_INET, &(recvFrom.sin_addr), ip, INET_ADDRSTRLEN);
-							mLastReceiveInfo->ipAddress = std::string(ip);
-							mLastReceiveInfo->port = ntohs(addr.sin_port);
-							mLastRecvBroadcastPort = mLastReceiveInfo->port;
-							return receivedBytes;
-						}
+			SOCKET sock = FindBroadcastListener(port);
+			if (sock == INVALID_SOCKET)
+			{
+				mLastError = UdpClientError::LISTENER_NOT_FOUND;
+				return -1;
+			}
 
-						// If here, selectResult == 0, so we check next socket. 
-					}
+			// Wait for the first datagram, again if everything queued had to be dropped
+			int32_t received = 0;
+			while (received == 0)
+			{
+				pollfd pfd{};
+				pfd.fd = sock;
+				pfd.events = POLLIN;
+
+				int32_t waitResult = WaitForSockets(&pfd, 1, deadline);
+				if (waitResult <= 0)
+				{
+					return waitResult;
 				}
 
-				// If here, for loop completed, and all have no data. 
-				return 0;
+				// Then take everything already queued behind it
+				received = DrainSocket(sock, arena, slotSize, datagrams, maxDatagrams, UdpClientError::RECEIVE_BROADCAST_FAILED);
 			}
-			return -1;
+
+			if (received > 0)
+			{
+				mLastRecvBroadcastPort = port;
+			}
+
+			return received;
 		}
 
-		int8_t UDP_Client::ReceiveMulticast(void* buffer, const uint32_t maxSize, std::string& multicastGroup)
+		int32_t UDP_Client::WaitForReadable(ReadySocket* ready, const uint32_t maxReady, const Deadline deadline)
 		{
-			if (mMulticastSockets.size() > 0)
+			if (ready == nullptr || maxReady == 0 || mWatchedSockets.empty())
 			{
-				for (const auto& i : mMulticastSockets)
-				{
-					// Grab the socket and addr info from the vector for use.
-					SOCKET sock = std::get<0>(i);
-					sockaddr_in addr = std::get<1>(i);
+				return -1;
+			}
 
-					if (sock != INVALID_SOCKET)
-					{
-						// Verify incoming data is available.
-						fd_set readSet{};
-						FD_ZERO(&readSet);
-						FD_SET(sock, &readSet);
-						sockaddr_in recvFrom{};
-						int recvFromSize = sizeof(recvFrom);
+			int32_t count = 0;
+			while (count == 0 && std::chrono::steady_clock::now() < deadline)
+			{
+#ifdef WIN32
+				// select only takes a relative timeout, round up so the wait never ends just short of the deadline
+				auto remaining = std::chrono::ceil<std::chrono::milliseconds>(deadline - std::chrono::steady_clock::now());
+				count = WaitForReadable(ready, maxReady, static_cast<int32_t>(std::max<int64_t>(0, remaining.count())));
+#else
+				// The epoll set is readable whenever one of its sockets is, ppoll waits on it to the nanosecond
+				pollfd pfd{};
+				pfd.fd = mEpollFD;
+				pfd.events = POLLIN;
 
-						int selectResult = select(0, &readSet, nullptr, nullptr, &mTimeout);
+				count = WaitForSockets(&pfd, 1, deadline);
+				if (count > 0)
+				{
+					count = WaitForReadable(ready, maxReady, 0);
+				}
+				else if (count < 0)
+				{
+					mLastError = UdpClientError::WAIT_FAILED;
+				}
+#endif
+			}
 
-						// Catch error
-						if (selectResult == SOCKET_ERROR)
-						{
-							mLastError = UdpClientError::SELECT_READ_ERROR;
-							return 1;
-						}
+			return count;
+		}
 
-						// If data is available on this socket, attempt to read it 
-						if (selectResult > 0)
-						{
-#if defined WIN32
-							int32_t receivedBytes = recvfrom(sock, (char*)buffer, maxSize - 1, 0, reinterpret_cast<sockaddr*>(&recvFrom), &recvFromSize);
-#else
-							int32_t receivedBytes = recvfrom(mSocket, buffer, static_cast<size_t>(maxSize) - 1, 0, (sockaddr*)&recvFrom, reinterpret_cast<socklen_t*>(&recvFromSize));
-#endif
+		int32_t UDP_Client::WaitForReadable(ReadySocket* ready, const uint32_t maxReady, const int32_t timeoutMSec)
+		{
+			if (ready == nullptr || maxReady == 0 || mWatchedSockets.empty())
+			{
+				return -1;
+			}
+
+			uint32_t count = 0;
 
-							if (receivedBytes == SOCKET_ERROR)
-							{
 #ifdef WIN32
-								int errorCode = WSAGetLastError();
-								if (errorCode != WSAEWOULDBLOCK)
-								{
-									mLastError = UdpClientError::RECEIVE_BROADCAST_FAILED;
-									return -1;
-								}
-#else
-								if (errno != EWOULDBLOCK)
-								{
-									mLastError = UdpClientError::RECEIVE_BROADCAST_FAILED;
-									return -1;
-								}
-#endif
-								return 0;
-							}
+			fd_set readSet{};
+			FD_ZERO(&readSet);
+			for (const auto& watched : mWatchedSockets)
+			{
+				FD_SET(watched.first, &readSet);
+			}
 
-							char address[INET_ADDRSTRLEN];
-							if (inet_ntop(AF_INET, &(addr.sin_addr), address, INET_ADDRSTRLEN) != NULL)
-							{
-								multicastGroup = address;
-							}
+			timeval timeout{};
+			timeout.tv_sec = timeoutMSec / 1000;
+			timeout.tv_usec = (timeoutMSec % 1000) * 1000;
 
-							return receivedBytes;
-						}
+			int selectResult = select(0, &readSet, nullptr, nullptr, timeoutMSec < 0 ? nullptr : &timeout);
+			if (selectResult == SOCKET_ERROR)
+			{
+				mLastError = UdpClientError::WAIT_FAILED;
+				return -1;
+			}
 
-						// If here, selectResult == 0, so we check next socket. 
-					}
+			for (const auto& watched : mWatchedSockets)
+			{
+				if (count < maxReady && FD_ISSET(watched.first, &readSet))
+				{
+					ready[count++] = watched.second;
 				}
-
-				// If here, for loop completed, and all have no data. 
-				return 0;
 			}
-			return -1;
-		}
+#else
+			epoll_event events[UDP_MAX_BATCH_SIZE];
+			int maxEvents = static_cast<int>(std::min(maxReady, UDP_MAX_BATCH_SIZE));
 
-		void UDP_Client::CloseUnicast()
-		{
-			closesocket(mSocket);
-			mSocket = INVALID_SOCKET;
-		}
+			int numEvents = 0;
+			do
+			{
+				numEvents = epoll_wait(mEpollFD, events, maxEvents, timeoutMSec);
+			} while (numEvents == -1 && errno == EINTR);
 
-		void UDP_Client::CloseBroadcastListeners()
-		{
-			closesocket(mBroadcastSocket);
-			mBroadcastSocket = INVALID_SOCKET;
+			if (numEvents == -1)
+			{
+				mLastError = UdpClientError::WAIT_FAILED;
+				return -1;
+			}
 
-			for (const auto& i : mBroadcastListeners)
+			for (int i = 0; i < numEvents; i++)
 			{
-				closesocket(std::get<0>(i));
+				auto watched = mWatchedSockets.find(events[i].data.fd);
+				if (watched != mWatchedSockets.end())
+				{
+					ready[count++] = watched->second;
+				}
 			}
-			
-			mBroadcastListeners.clear();
+#endif
+			return static_cast<int32_t>(count);
 		}
 
-		void UDP_Client::CloseMulticastGroups()
+		int32_t UDP_Client::ReceiveReady(const ReadySocket& ready, void* buffer, const uint32_t maxSize, Endpoint& sender)
 		{
-			for (const auto& i : mMulticastSockets)
+			RxTimestamp received;
+			return ReceiveReady(ready, buffer, maxSize, sender, received);
+		}
+
+		int32_t UDP_Client::ReceiveReady(const ReadySocket& ready, void* buffer, const uint32_t maxSize, Endpoint& sender, RxTimestamp& received)
+		{
+			if (ready.socket == INVALID_SOCKET || buffer == nullptr)
 			{
-				closesocket(std::get<0>(i));
+				return -1;
+			}
+
+			received = RxTimestamp();
+			sockaddr_in recvFrom{};
+#if defined WIN32
+			int recvFromSize = sizeof(recvFrom);
+			int32_t receivedBytes = recvfrom(ready.socket, reinterpret_cast<char*>(buffer), maxSize, 0, reinterpret_cast<sockaddr*>(&recvFrom), &recvFromSize);
+#else
+			// recvmsg rather than recvfrom so the timestamp can come back alongside the data
+			iovec slot{ buffer, maxSize };
+			char control[UDP_TIMESTAMP_CONTROL_SIZE];
+			msghdr message{};
+			message.msg_name = &recvFrom;
+			message.msg_namelen = sizeof(recvFrom);
+			message.msg_iov = &slot;
+			message.msg_iovlen = 1;
+			if (mTimestamps)
+			{
+				message.msg_control = control;
+				message.msg_controllen = sizeof(control);
+			}
+
+			int32_t receivedBytes = static_cast<int32_t>(recvmsg(ready.socket, &message, MSG_DONTWAIT));
+			if (receivedBytes != SOCKET_ERROR)
+			{
+				ReadTimestamp(message, received);
+			}
+#endif
+
+			if (receivedBytes == SOCKET_ERROR)
+			{
+#ifdef WIN32
+				if (WSAGetLastError() != WSAEWOULDBLOCK)
+#else
+				if (errno != EWOULDBLOCK && errno != EAGAIN)
+#endif
+				{
+					mLastError = UdpClientError::READ_FAILED;
+					return -1;
+				}
+				return 0;
+			}
+
+			char ip[INET_ADDRSTRLEN];
+			inet_ntop(AF_INET, &(recvFrom.sin_addr), ip, INET_ADDRSTRLEN);
+			sender.ipAddress = ip;
+			sender.port = ntohs(recvFrom.sin_port);
+			*mLastReceiveInfo = sender;
+
+			if (ready.type == SocketType::BROADCAST_LISTENER)
+			{
+				mLastRecvBroadcastPort = ready.endpoint.port;
+			}
+
+			return receivedBytes;
+		}
+
+		int32_t UDP_Client::ReceiveReadyBatch(const ReadySocket& ready, uint8_t* arena, const uint32_t slotSize, Datagram* datagrams, const uint32_t maxDatagrams)
+		{
+			if (ready.socket == INVALID_SOCKET || arena == nullptr || datagrams == nullptr || slotSize == 0 || maxDatagrams == 0)
+			{
+				return -1;
+			}
+
+			int32_t received = DrainSocket(ready.socket, arena, slotSize, datagrams, maxDatagrams, UdpClientError::READ_FAILED);
+			if (received > 0 && ready.type == SocketType::BROADCAST_LISTENER)
+			{
+				mLastRecvBroadcastPort = ready.endpoint.port;
+			}
+
+			return received;
+		}
+
+#ifndef WIN32
+		int UDP_Client::GetWaitFD() const
+		{
+			return mEpollFD;
+		}
+#else
+		int UDP_Client::GetWaitFD() const
+		{
+			return -1;
+		}
+#endif
+
+		int8_t UDP_Client::ReceiveMulticast(void* buffer, const uint32_t maxSize, std::string& multicastGroup)
+		{
+			return static_cast<int8_t>(ReceiveMulticast(buffer, maxSize, multicastGroup, GetTimeoutDeadline()));
+		}
+
+		int32_t UDP_Client::ReceiveMulticast(void* buffer, const uint32_t maxSize, std::string& multicastGroup, const Deadline deadline)
+		{
+			if (mMulticastSockets.empty())
+			{
+				return -1;
+			}
+
+			size_t index = 0;
+			sockaddr_in recvFrom{};
+			int32_t receivedBytes = ReceiveFromFirst(mMulticastSockets, -1, buffer, maxSize, deadline, UdpClientError::RECEIVE_BROADCAST_FAILED, index, recvFrom);
+			if (receivedBytes > 0)
+			{
+				multicastGroup = std::get<2>(mMulticastSockets[index]).ipAddress;
+			}
+
+			return receivedBytes;
+		}
+
+		int8_t UDP_Client::EnableReceiveTimestamps(const bool hardware)
+		{
+			mTimestamps = true;
+			mHardwareTimestamps = hardware;
+
+			int8_t rtn = 0;
+			for (const auto& watched : mWatchedSockets)
+			{
+				if (ApplyTimestamps(watched.first) < 0)
+				{
+					rtn = -1;
+				}
+			}
+
+			return rtn;
+		}
+
+		void UDP_Client::CloseUnicast()
+		{
+			UnwatchSocket(mSocket);
+			closesocket(mSocket);
+			mSocket = INVALID_SOCKET;
+		}
+
+		void UDP_Client::CloseBroadcastListeners()
+		{
+			closesocket(mBroadcastSocket);
+			mBroadcastSocket = INVALID_SOCKET;
+
+			for (const auto& i : mBroadcastListeners)
+			{
+				UnwatchSocket(std::get<0>(i));
+				closesocket(std::get<0>(i));
+			}
+			
+			mBroadcastListeners.clear();
+		}
+
+		void UDP_Client::CloseMulticastGroups()
+		{
+			for (const auto& i : mMulticastSockets)
+			{
+				UnwatchSocket(std::get<0>(i));
+				closesocket(std::get<0>(i));
 			}
 
 			mMulticastSockets.clear();
@@ -916,11 +1135,12 @@ namespace Essentials
 
 		int8_t UDP_Client::SetTimeout(const int32_t timeoutMSecs)
 		{
+			// Only the part below a second goes in tv_usec, SO_RCVTIMEO rejects anything larger
 			mTimeout.tv_sec = timeoutMSecs / 1000;
 #if WIN32
-			mTimeout.tv_usec = timeoutMSecs * 1000;
+			mTimeout.tv_usec = (timeoutMSecs % 1000) * 1000;
 #else
-			mTimeout.tv_usec = static_cast<__suseconds_t>(timeoutMSecs) * 1000;
+			mTimeout.tv_usec = static_cast<__suseconds_t>(timeoutMSecs % 1000) * 1000;
 #endif
 			return 0;
 		}
@@ -966,9 +1186,560 @@ namespace Essentials
 			return -1;  // Invalid IP address
 		}
 
-		bool UDP_Client::ValidatePort(const int16_t port)
+		SOCKET UDP_Client::FindBroadcastListener(const int16_t port)
+		{
+			for (const auto& i : mBroadcastListeners)
+			{
+				if (std::get<2>(i).port == port)
+				{
+					return std::get<0>(i);
+				}
+			}
+
+			return INVALID_SOCKET;
+		}
+
+		int32_t UDP_Client::DrainSocket(const SOCKET sock, uint8_t* arena, const uint32_t slotSize, Datagram* datagrams, const uint32_t maxDatagrams, const UdpClientError failure)
+		{
+			uint32_t received = 0;
+			sockaddr_in senders[UDP_MAX_BATCH_SIZE];
+
+#ifdef WIN32
+			// No recvmmsg, read one datagram at a time while any are queued
+			while (received < maxDatagrams)
+			{
+				fd_set readSet{};
+				FD_ZERO(&readSet);
+				FD_SET(sock, &readSet);
+
+				timeval timeout{};
+				int selectResult = select(0, &readSet, nullptr, nullptr, &timeout);
+				if (selectResult == SOCKET_ERROR)
+				{
+					mLastError = UdpClientError::SELECT_READ_ERROR;
+					return -1;
+				}
+
+				if (selectResult == 0)
+				{
+					break;
+				}
+
+				int senderSize = sizeof(senders[0]);
+				int receivedBytes = recvfrom(sock, reinterpret_cast<char*>(arena) + static_cast<size_t>(received) * slotSize, slotSize, 0, 
+					reinterpret_cast<sockaddr*>(&senders[0]), &senderSize);
+				if (receivedBytes == SOCKET_ERROR)
+				{
+					// Too big for its slot, the rest of it is gone so drop it and read on
+					if (WSAGetLastError() == WSAEMSGSIZE)
+					{
+						continue;
+					}
+
+					if (WSAGetLastError() != WSAEWOULDBLOCK)
+					{
+						mLastError = failure;
+						return -1;
+					}
+					break;
+				}
+
+				Datagram& datagram = datagrams[received];
+				datagram.data = arena + static_cast<size_t>(received) * slotSize;
+				datagram.size = static_cast<uint32_t>(receivedBytes);
+
+				char ip[INET_ADDRSTRLEN];
+				inet_ntop(AF_INET, &(senders[0].sin_addr), ip, INET_ADDRSTRLEN);
+				datagram.sender.ipAddress = ip;
+				datagram.sender.port = ntohs(senders[0].sin_port);
+				datagram.received = RxTimestamp();
+				received++;
+			}
+#else
+			// Up to UDP_MAX_BATCH_SIZE datagrams per system call. A dropped datagram leaves its slot unused, 
+			// so slots are counted apart from the datagrams handed back.
+			uint32_t slotsUsed = 0;
+			while (slotsUsed < maxDatagrams)
+			{
+				mmsghdr messages[UDP_MAX_BATCH_SIZE];
+				iovec slots[UDP_MAX_BATCH_SIZE];
+				char controls[UDP_MAX_BATCH_SIZE][UDP_TIMESTAMP_CONTROL_SIZE];
+				uint32_t batch = std::min(maxDatagrams - slotsUsed, UDP_MAX_BATCH_SIZE);
+
+				memset(messages, 0, sizeof(mmsghdr) * batch);
+				for (uint32_t i = 0; i < batch; i++)
+				{
+					slots[i].iov_base = arena + static_cast<size_t>(slotsUsed + i) * slotSize;
+					slots[i].iov_len = slotSize;
+					messages[i].msg_hdr.msg_iov = &slots[i];
+					messages[i].msg_hdr.msg_iovlen = 1;
+					messages[i].msg_hdr.msg_name = &senders[i];
+					messages[i].msg_hdr.msg_namelen = sizeof(senders[i]);
+					if (mTimestamps)
+					{
+						messages[i].msg_hdr.msg_control = controls[i];
+						messages[i].msg_hdr.msg_controllen = UDP_TIMESTAMP_CONTROL_SIZE;
+					}
+				}
+
+				int count = recvmmsg(sock, messages, batch, MSG_DONTWAIT, nullptr);
+				if (count == -1)
+				{
+					if (errno == EINTR)
+					{
+						continue;
+					}
+
+					if (errno != EAGAIN && errno != EWOULDBLOCK)
+					{
+						mLastError = failure;
+						return -1;
+					}
+					break;
+				}
+
+				for (int i = 0; i < count; i++)
+				{
+					// Bigger than its slot, what is left would pass for a whole datagram
+					if (messages[i].msg_hdr.msg_flags & MSG_TRUNC)
+					{
+						continue;
+					}
+
+					Datagram& datagram = datagrams[received++];
+					datagram.data = static_cast<uint8_t*>(slots[i].iov_base);
+					datagram.size = messages[i].msg_len;
+
+					char ip[INET_ADDRSTRLEN];
+					inet_ntop(AF_INET, &(senders[i].sin_addr), ip, INET_ADDRSTRLEN);
+					datagram.sender.ipAddress = ip;
+					datagram.sender.port = ntohs(senders[i].sin_port);
+					ReadTimestamp(messages[i].msg_hdr, datagram.received);
+				}
+				slotsUsed += static_cast<uint32_t>(count);
+
+				// A short batch means the queue is empty
+				if (static_cast<uint32_t>(count) < batch)
+				{
+					break;
+				}
+			}
+#endif
+
+			if (received > 0)
+			{
+				*mLastReceiveInfo = datagrams[received - 1].sender;
+			}
+
+			return static_cast<int32_t>(received);
+		}
+
+		int8_t UDP_Client::ApplyTimestamps(const SOCKET sock)
+		{
+#ifdef WIN32
+			// No receive timestamps through winsock, datagrams come back with source NONE
+			mLastError = UdpClientError::ENABLE_TIMESTAMPS_FAILED;
+			return -1;
+#else
+			int flags = SOF_TIMESTAMPING_RX_SOFTWARE | SOF_TIMESTAMPING_SOFTWARE;
+			if (mHardwareTimestamps)
+			{
+				flags |= SOF_TIMESTAMPING_RX_HARDWARE | SOF_TIMESTAMPING_RAW_HARDWARE;
+			}
+
+			if (setsockopt(sock, SOL_SOCKET, SO_TIMESTAMPING, &flags, sizeof(flags)) == 0)
+			{
+				return 0;
+			}
+
+			// Kernels without SO_TIMESTAMPING still have the software stamp alone
+			int enable = 1;
+			if (setsockopt(sock, SOL_SOCKET, SO_TIMESTAMPNS, &enable, sizeof(enable)) == 0)
+			{
+				return 0;
+			}
+
+			mLastError = UdpClientError::ENABLE_TIMESTAMPS_FAILED;
+			return -1;
+#endif
+		}
+
+#ifndef WIN32
+		void UDP_Client::ReadTimestamp(const msghdr& message, RxTimestamp& received)
+		{
+			received = RxTimestamp();
+			if (message.msg_control == nullptr)
+			{
+				return;
+			}
+
+			for (cmsghdr* cmsg = CMSG_FIRSTHDR(&message); cmsg != nullptr; cmsg = CMSG_NXTHDR(const_cast<msghdr*>(&message), cmsg))
+			{
+				if (cmsg->cmsg_level != SOL_SOCKET)
+				{
+					continue;
+				}
+
+				if (cmsg->cmsg_type == SCM_TIMESTAMPING)
+				{
+					// Software stamp first, the raw hardware stamp third, whichever were taken are non zero
+					timespec stamps[3];
+					memcpy(stamps, CMSG_DATA(cmsg), sizeof(stamps));
+					const timespec& stamp = (stamps[2].tv_sec != 0 || stamps[2].tv_nsec != 0) ? stamps[2] : stamps[0];
+					if (stamp.tv_sec != 0 || stamp.tv_nsec != 0)
+					{
+						received.nsec = static_cast<int64_t>(stamp.tv_sec) * 1000000000 + stamp.tv_nsec;
+						received.source = &stamp == &stamps[2] ? TimestampSource::HARDWARE : TimestampSource::SOFTWARE;
+					}
+				}
+				else if (cmsg->cmsg_type == SCM_TIMESTAMPNS)
+				{
+					timespec stamp{};
+					memcpy(&stamp, CMSG_DATA(cmsg), sizeof(stamp));
+					received.nsec = static_cast<int64_t>(stamp.tv_sec) * 1000000000 + stamp.tv_nsec;
+					received.source = TimestampSource::SOFTWARE;
+				}
+			}
+		}
+#endif
+
+		int32_t UDP_Client::WaitForSockets(pollfd* fds, const uint32_t count, const Deadline deadline)
+		{
+			while (true)
+			{
+				auto remaining = std::max(deadline - std::chrono::steady_clock::now(), Deadline::duration::zero());
+
+#ifdef WIN32
+				// WSAPoll takes milliseconds, round up so the wait never ends just short of the deadline
+				int result = WSAPoll(fds, count, static_cast<int>(std::chrono::ceil<std::chrono::milliseconds>(remaining).count()));
+				if (result == SOCKET_ERROR)
+				{
+					mLastError = UdpClientError::SELECT_READ_ERROR;
+					return -1;
+				}
+#else
+				int64_t nanoseconds = std::chrono::duration_cast<std::chrono::nanoseconds>(remaining).count();
+				timespec timeout{};
+				timeout.tv_sec = static_cast<time_t>(nanoseconds / 1000000000);
+				timeout.tv_nsec = static_cast<long>(nanoseconds % 1000000000);
+
+				// The time left is worked out again after a signal, so an interrupted wait still ends on the deadline
+				int result = ppoll(fds, count, &timeout, nullptr);
+				if (result == -1)
+				{
+					if (errno == EINTR)
+					{
+						continue;
+					}
+
+					mLastError = UdpClientError::SELECT_READ_ERROR;
+					return -1;
+				}
+#endif
+
+				return result;
+			}
+		}
+
+		int32_t UDP_Client::ReceiveFromFirst(const std::vector<std::tuple<SOCKET, sockaddr_in, Endpoint>>& sockets, const int32_t port, void* buffer, const uint32_t maxSize,
+			const Deadline deadline, const UdpClientError failure, size_t& index, sockaddr_in& recvFrom)
+		{
+			std::vector<pollfd> fds;
+			std::vector<size_t> owners;
+			for (size_t i = 0; i < sockets.size(); i++)
+			{
+				if (std::get<0>(sockets[i]) != INVALID_SOCKET && (port < 0 || std::get<2>(sockets[i]).port == port))
+				{
+					pollfd pfd{};
+					pfd.fd = std::get<0>(sockets[i]);
+					pfd.events = POLLIN;
+					fds.push_back(pfd);
+					owners.push_back(i);
+				}
+			}
+
+			if (fds.empty())
+			{
+				return 0;
+			}
+
+			while (true)
+			{
+				int32_t waitResult = WaitForSockets(fds.data(), static_cast<uint32_t>(fds.size()), deadline);
+				if (waitResult <= 0)
+				{
+					return waitResult;
+				}
+
+				// Read from the first socket with data, the rest keep theirs for the next call
+				for (size_t i = 0; i < fds.size(); i++)
+				{
+					if (fds[i].revents == 0)
+					{
+						continue;
+					}
+
+#if defined WIN32
+					int recvFromSize = sizeof(recvFrom);
+					int32_t receivedBytes = recvfrom(fds[i].fd, reinterpret_cast<char*>(buffer), maxSize - 1, 0, reinterpret_cast<sockaddr*>(&recvFrom), &recvFromSize);
+#else
+					socklen_t recvFromSize = sizeof(recvFrom);
+					int32_t receivedBytes = recvfrom(fds[i].fd, buffer, static_cast<size_t>(maxSize) - 1, 0, reinterpret_cast<sockaddr*>(&recvFrom), &recvFromSize);
+#endif
+
+					if (receivedBytes == SOCKET_ERROR)
+					{
+#ifdef WIN32
+						if (WSAGetLastError() != WSAEWOULDBLOCK)
+#else
+						if (errno != EWOULDBLOCK && errno != EAGAIN)
+#endif
+						{
+							mLastError = failure;
+							return -1;
+						}
+						continue;
+					}
+
+					index = owners[i];
+					return receivedBytes;
+				}
+			}
+		}
+
+		Deadline UDP_Client::GetTimeoutDeadline() const
+		{
+			return std::chrono::steady_clock::now() + std::chrono::milliseconds(GetTimeoutMSec());
+		}
+
+		int8_t UDP_Client::MakeDestination(const std::string& ipAddress, const int16_t port, sockaddr_in& addr)
+		{
+			if (ValidateIP(ipAddress) == -1)
+			{
+				mLastError = UdpClientError::BAD_ADDRESS;
+				return -1;
+			}
+
+			if (ValidatePort(static_cast<uint16_t>(port)) == false)
+			{
+				mLastError = UdpClientError::BAD_PORT;
+				return -1;
+			}
+
+			memset(reinterpret_cast<char*>(&addr), 0, sizeof(addr));
+			addr.sin_family = AF_INET;
+			addr.sin_port = htons(port);
+			if (inet_pton(AF_INET, ipAddress.c_str(), &(addr.sin_addr)) <= 0)
+			{
+				mLastError = UdpClientError::SET_DESTINATION_FAILED;
+				return -1;
+			}
+
+			return 0;
+		}
+
+		int32_t UDP_Client::SendDatagrams(const SOCKET sock, const sockaddr_in& addr, const OutgoingDatagram* datagrams, const uint32_t count, const UdpClientError failure)
+		{
+			uint32_t sent = 0;
+
+#ifdef WIN32
+			// No sendmmsg, one datagram at a time
+			while (sent < count)
+			{
+				int numSent = sendto(sock, reinterpret_cast<const char*>(datagrams[sent].data), datagrams[sent].size, 0, 
+					reinterpret_cast<const sockaddr*>(&addr), sizeof(addr));
+				if (numSent == SOCKET_ERROR)
+				{
+					if (WSAGetLastError() != WSAEWOULDBLOCK)
+					{
+						mLastError = failure;
+						return -1;
+					}
+					break;
+				}
+				sent++;
+			}
+#else
+			// Up to UDP_MAX_BATCH_SIZE datagrams per system call
+			while (sent < count)
+			{
+				mmsghdr messages[UDP_MAX_BATCH_SIZE];
+				iovec slots[UDP_MAX_BATCH_SIZE];
+				uint32_t batch = std::min(count - sent, UDP_MAX_BATCH_SIZE);
+
+				memset(messages, 0, sizeof(mmsghdr) * batch);
+				for (uint32_t i = 0; i < batch; i++)
+				{
+					slots[i].iov_base = const_cast<uint8_t*>(datagrams[sent + i].data);
+					slots[i].iov_len = datagrams[sent + i].size;
+					messages[i].msg_hdr.msg_iov = &slots[i];
+					messages[i].msg_hdr.msg_iovlen = 1;
+					messages[i].msg_hdr.msg_name = const_cast<sockaddr_in*>(&addr);
+					messages[i].msg_hdr.msg_namelen = sizeof(addr);
+				}
+
+				int numSent = sendmmsg(sock, messages, batch, 0);
+				if (numSent == -1)
+				{
+					if (errno == EINTR)
+					{
+						continue;
+					}
+
+					if (errno != EAGAIN && errno != EWOULDBLOCK)
+					{
+						mLastError = failure;
+						return -1;
+					}
+					break;
+				}
+
+				sent += static_cast<uint32_t>(numSent);
+			}
+#endif
+
+			return static_cast<int32_t>(sent);
+		}
+
+		int32_t UDP_Client::SendSegmentsTo(const SOCKET sock, const sockaddr_in& addr, const uint8_t* buffer, const uint32_t size, const uint32_t segmentSize, const UdpClientError failure)
+		{
+			if (segmentSize == 0)
+			{
+				mLastError = failure;
+				return -1;
+			}
+
+			const uint32_t segments = (size + segmentSize - 1) / segmentSize;
+			uint32_t sent = 0;
+
+#if defined(UDP_SEGMENT)
+			// The kernel cuts each send into datagrams, one trip through the stack for the lot
+			const uint32_t perSend = std::min(UDP_MAX_GSO_SEGMENTS, UDP_MAX_GSO_BYTES / segmentSize);
+			while (mSegmentationOffload && perSend > 1 && segments - sent > 1)
+			{
+				uint32_t batch = std::min(segments - sent, perSend);
+				uint32_t offset = sent * segmentSize;
+				uint32_t length = std::min(batch * segmentSize, size - offset);
+
+				iovec slot{ const_cast<uint8_t*>(buffer + offset), length };
+				char control[CMSG_SPACE(sizeof(uint16_t))] = { 0 };
+				msghdr message{};
+				message.msg_name = const_cast<sockaddr_in*>(&addr);
+				message.msg_namelen = sizeof(addr);
+				message.msg_iov = &slot;
+				message.msg_iovlen = 1;
+				message.msg_control = control;
+				message.msg_controllen = sizeof(control);
+
+				cmsghdr* cmsg = CMSG_FIRSTHDR(&message);
+				cmsg->cmsg_level = SOL_UDP;
+				cmsg->cmsg_type = UDP_SEGMENT;
+				cmsg->cmsg_len = CMSG_LEN(sizeof(uint16_t));
+				uint16_t gsoSize = static_cast<uint16_t>(segmentSize);
+				memcpy(CMSG_DATA(cmsg), &gsoSize, sizeof(gsoSize));
+
+				if (sendmsg(sock, &message, 0) == -1)
+				{
+					if (errno == EINTR)
+					{
+						continue;
+					}
+
+					if (errno == EAGAIN || errno == EWOULDBLOCK)
+					{
+						return static_cast<int32_t>(sent);
+					}
+
+					// Older kernels, devices without checksum offload and segments over the path MTU are refused,
+					// from then on the datagrams go as a batch
+					if (errno == ENOPROTOOPT || errno == EOPNOTSUPP || errno == EIO || errno == EINVAL)
+					{
+						mSegmentationOffload = false;
+						break;
+					}
+
+					mLastError = failure;
+					return -1;
+				}
+
+				sent += batch;
+			}
+#endif
+
+			// Whatever is left goes a datagram at a time, many per system call
+			while (sent < segments)
+			{
+				OutgoingDatagram datagrams[UDP_MAX_BATCH_SIZE];
+				uint32_t batch = std::min(segments - sent, UDP_MAX_BATCH_SIZE);
+				for (uint32_t i = 0; i < batch; i++)
+				{
+					uint32_t offset = (sent + i) * segmentSize;
+					datagrams[i].data = buffer + offset;
+					datagrams[i].size = std::min(segmentSize, size - offset);
+				}
+
+				int32_t numSent = SendDatagrams(sock, addr, datagrams, batch, failure);
+				if (numSent < 0)
+				{
+					return -1;
+				}
+
+				sent += static_cast<uint32_t>(numSent);
+				if (static_cast<uint32_t>(numSent) < batch)
+				{
+					break;
+				}
+			}
+
+			return static_cast<int32_t>(sent);
+		}
+
+		void UDP_Client::WatchSocket(const SOCKET sock, const SocketType type, const Endpoint& endpoint)
+		{
+			if (sock == INVALID_SOCKET)
+			{
+				return;
+			}
+
+			ReadySocket watched;
+			watched.socket = sock;
+			watched.type = type;
+			watched.endpoint = endpoint;
+			mWatchedSockets[sock] = watched;
+
+			// Every receiving socket passes through here, so one opened after timestamps were enabled is stamped too
+			if (mTimestamps)
+			{
+				ApplyTimestamps(sock);
+			}
+
+#ifndef WIN32
+			epoll_event event{};
+			event.events = EPOLLIN;
+			event.data.fd = sock;
+			epoll_ctl(mEpollFD, EPOLL_CTL_ADD, sock, &event);
+#endif
+		}
+
+		void UDP_Client::UnwatchSocket(const SOCKET sock)
+		{
+			if (mWatchedSockets.erase(sock) > 0)
+			{
+#ifndef WIN32
+				epoll_ctl(mEpollFD, EPOLL_CTL_DEL, sock, nullptr);
+#endif
+			}
+		}
+
+		int32_t UDP_Client::GetTimeoutMSec() const
+		{
+			return static_cast<int32_t>(mTimeout.tv_sec * 1000 + mTimeout.tv_usec / 1000);
+		}
+
+		bool UDP_Client::ValidatePort(const uint16_t port)
 		{
-			return (port >= 0 && port <= 65535);
+			// Ports above 32767 are passed around negative in int16_t, callers cast them back first
+			return port != 0;
 		}
 
 	}
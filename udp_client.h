@@ -16,10 +16,17 @@
 #pragma comment(lib, "ws2_32.lib")
 #else
 #include <sys/socket.h>
+#include <netinet/udp.h>				// UDP_SEGMENT
+#include <linux/net_tstamp.h>			// SOF_TIMESTAMPING_* flags
+#include <poll.h>						// Waiting on batch receives
+#include <sys/epoll.h>					// Waiting on every socket at once
+#include <cerrno>						// errno
 #include <netinet/in.h>
 #include <arpa/inet.h>
 #include <unistd.h>
 #include <fcntl.h>
+#ifndef ESSENTIALS_SOCKET_TYPES
+#define ESSENTIALS_SOCKET_TYPES
 typedef int SOCKET;
 typedef struct sockaddr_in SOCKADDR_IN;
 typedef struct sockaddr SOCKADDR;
@@ -28,9 +35,14 @@ const int SOCKET_ERROR = -1;
 const int SD_BOTH = SHUT_RDWR;
 #define closesocket(s) close(s)
 #endif
+#endif
+#include <cstring>						// memset
 #include <map>							// Error enum to strings.
+#include <vector>						// Socket lists
+#include <tuple>						// Socket list entries
 #include <string>						// Strings
 #include <regex>						// Regular expression for ip validation
+#include <chrono>						// Receive deadlines
 //
 //	Defines:
 //          name                        reason defined
@@ -49,6 +61,11 @@ namespace Essentials
 		constexpr static uint8_t	UDP_CLIENT_VERSION_PATCH	= 0;
 		constexpr static uint8_t	UDP_CLIENT_VERSION_BUILD	= 0;
 		constexpr static uint8_t	UDP_DEFAULT_SOCKET_TIMEOUT	= 1;
+		constexpr static uint32_t	UDP_MAX_BATCH_SIZE			= 64;			// Datagrams requested per recvmmsg call
+		constexpr static int		UDP_LISTENER_RECEIVE_BUFFER	= 1024 * 1024;	// Kernel receive buffer for receiving sockets
+		constexpr static uint32_t	UDP_MAX_GSO_SEGMENTS		= 64;			// Datagrams the kernel will cut from one segmented send
+		constexpr static uint32_t	UDP_MAX_GSO_BYTES			= 65507;		// Largest segmented send, the same limit as one datagram
+		constexpr static uint32_t	UDP_TIMESTAMP_CONTROL_SIZE	= 128;			// Ancillary data space per datagram for a receive timestamp
 
 		static std::string UdpClientVersion = "UDP Client v" +
 			std::to_string((uint8_t)UDP_CLIENT_VERSION_MAJOR) + "." +
@@ -92,11 +109,14 @@ namespace Essentials
 			FAILED_TO_SET_TIMEOUT,
 			SELECT_READ_ERROR,
 			RECEIVE_BROADCAST_FAILED,
+			LISTENER_NOT_FOUND,
+			WAIT_FAILED,
 			MULTICAST_NOT_ENABLED,
 			ADD_MULTICAST_GROUP_FAILED,
 			MULTICAST_INTERFACE_ERROR,
 			MULTICAST_BIND_FAILED,
 			MULTICAST_SET_TTL_FAILED,
+			ENABLE_TIMESTAMPS_FAILED,
 		};
 
 		/// @brief Error enum to string map
@@ -126,8 +146,21 @@ namespace Essentials
 			std::string("Error Code " + std::to_string((uint8_t)UdpClientError::SEND_FAILED) + ": Send failed.")},
 			{UdpClientError::READ_FAILED,
 			std::string("Error Code " + std::to_string((uint8_t)UdpClientError::READ_FAILED) + ": Read failed.")},
+			{UdpClientError::SELECT_READ_ERROR,
+			std::string("Error Code " + std::to_string((uint8_t)UdpClientError::SELECT_READ_ERROR) + ": Wait for data failed.")},
+			{UdpClientError::RECEIVE_BROADCAST_FAILED,
+			std::string("Error Code " + std::to_string((uint8_t)UdpClientError::RECEIVE_BROADCAST_FAILED) + ": Receive broadcast failed.")},
+			{UdpClientError::LISTENER_NOT_FOUND,
+			std::string("Error Code " + std::to_string((uint8_t)UdpClientError::LISTENER_NOT_FOUND) + ": No listener on that port.")},
+			{UdpClientError::WAIT_FAILED,
+			std::string("Error Code " + std::to_string((uint8_t)UdpClientError::WAIT_FAILED) + ": Wait on sockets failed.")},
+			{UdpClientError::ENABLE_TIMESTAMPS_FAILED,
+			std::string("Error Code " + std::to_string((uint8_t)UdpClientError::ENABLE_TIMESTAMPS_FAILED) + ": Enable receive timestamps failed.")},
 		};
 
+		/// @brief A point on the monotonic clock a receive gives up at, unaffected by changes to the wall clock
+		using Deadline = std::chrono::steady_clock::time_point;
+
 		/// @brief Represents an endpoint for a connection
 		struct Endpoint
 		{
@@ -135,6 +168,53 @@ namespace Essentials
 			int16_t	port = 0;
 		};
 
+		/// @brief Where a receive timestamp was taken
+		enum class TimestampSource : uint8_t
+		{
+			NONE,		// Not taken, timestamps are off or the platform has none
+			SOFTWARE,	// By the kernel as the datagram came off the driver, on CLOCK_REALTIME
+			HARDWARE,	// By the network card, on the card's own clock
+		};
+
+		/// @brief When a datagram arrived, before it waited in the socket queue
+		struct RxTimestamp
+		{
+			int64_t			nsec = 0;							// Nanoseconds since the epoch of the source's clock
+			TimestampSource	source = TimestampSource::NONE;		// Where it was taken
+		};
+
+		/// @brief A datagram returned by a batch receive
+		struct Datagram
+		{
+			uint8_t*	data = nullptr;		// Start of the datagram within the callers arena
+			uint32_t	size = 0;			// Number of bytes received
+			Endpoint	sender;				// Who sent the datagram
+			RxTimestamp	received;			// When it arrived, if receive timestamps are enabled
+		};
+
+		/// @brief A datagram handed to a batch send
+		struct OutgoingDatagram
+		{
+			const uint8_t*	data = nullptr;		// Start of the datagram
+			uint32_t		size = 0;			// Number of bytes to send
+		};
+
+		/// @brief Kind of socket reported by WaitForReadable
+		enum class SocketType : uint8_t
+		{
+			UNICAST,
+			BROADCAST_LISTENER,
+			MULTICAST,
+		};
+
+		/// @brief A socket with data waiting to be read
+		struct ReadySocket
+		{
+			SOCKET		socket = INVALID_SOCKET;			// Socket that is readable
+			SocketType	type = SocketType::UNICAST;			// What the socket is used for
+			Endpoint	endpoint;							// Listener port, multicast group or unicast port the socket is bound to
+		};
+
 		/// @brief Send Type for the Send Function.
 		enum class SendType : uint8_t
 		{
@@ -158,7 +238,7 @@ namespace Essentials
 
 			/// @brief Configure the address and port of this client
 			/// @param address -[in]- Address of this client
-			/// @param port -[in]- Address of this client
+			/// @param port -[in]- Port of this client, 0 lets the system pick one
 			/// @return 0 if successful, -1 if fails. Call Serial::GetLastError to find out more.
 			int8_t ConfigureThisClient(const std::string& address, const int16_t port);
 
@@ -212,13 +292,13 @@ namespace Essentials
 			/// @param buffer -[in]- Buffer to be sent
 			/// @param size -[in]- Size to be sent
 			/// @return 0+ if successful (number bytes sent), -1 if fails. Call UDP_Client::GetLastError to find out more.
-			int8_t SendUnicast(const char* buffer, const uint32_t size);
+			int32_t SendUnicast(const char* buffer, const uint32_t size);
 
 			/// @brief Send a unicast message to specified ip and port
 			/// @param buffer -[in]- Buffer to be sent
 			/// @param size -[in]- Size to be sent
 			/// @return 0+ if successful (number bytes sent), -1 if fails. Call UDP_Client::GetLastError to find out more.
-			int8_t SendUnicast(const char* buffer, const uint32_t size, const std::string& ipAddress, const int16_t port);
+			int32_t SendUnicast(const char* buffer, const uint32_t size, const std::string& ipAddress, const int16_t port);
 
 			/// @brief Send a broadcast message
 			/// @param buffer -[in]- Buffer to be sent
@@ -233,11 +313,45 @@ namespace Essentials
 			/// @return 0+ if successful (number bytes sent), -1 if fails. Call UDP_Client::GetLastError to find out more.
 			int8_t SendMulticast(const char* buffer, const uint32_t size, const std::string& groupIP = "");
 
+			/// @brief Send many datagrams over a specified socket type, many per system call where the platform allows.
+			/// A non-blocking socket whose buffer fills stops the batch early, the rest can be sent again.
+			/// @param datagrams -[in]- Datagrams to be sent, in order
+			/// @param count -[in]- Number of datagrams
+			/// @param type -[in]- Socket type to send on, multicast goes to every joined group
+			/// @return 0+ if successful (number of datagrams sent), -1 if fails. Call UDP_Client::GetLastError to find out more.
+			int32_t SendBatch(const OutgoingDatagram* datagrams, const uint32_t count, const SendType type);
+
+			/// @brief Send many unicast datagrams to specified ip and port, many per system call where the platform allows
+			/// @param datagrams -[in]- Datagrams to be sent, in order
+			/// @param count -[in]- Number of datagrams
+			/// @param ipAddress -[in]- Address to send to
+			/// @param port -[in]- Port to send to
+			/// @return 0+ if successful (number of datagrams sent), -1 if fails. Call UDP_Client::GetLastError to find out more.
+			int32_t SendUnicastBatch(const OutgoingDatagram* datagrams, const uint32_t count, const std::string& ipAddress, const int16_t port);
+
+			/// @brief Send a buffer cut into segmentSize datagrams, the last may be short. Where the kernel supports UDP 
+			/// segmentation offload a single system call carries up to UDP_MAX_GSO_SEGMENTS of them, otherwise they go as a batch.
+			/// @param buffer -[in]- Datagrams laid end to end
+			/// @param size -[in]- Size of the buffer
+			/// @param segmentSize -[in]- Size of each datagram
+			/// @param type -[in]- Socket type to send on, multicast goes to every joined group
+			/// @return 0+ if successful (number of datagrams sent), -1 if fails. Call UDP_Client::GetLastError to find out more.
+			int32_t SendSegments(const uint8_t* buffer, const uint32_t size, const uint32_t segmentSize, const SendType type);
+
+			/// @brief Send a buffer cut into segmentSize datagrams to specified ip and port, see SendSegments
+			/// @param buffer -[in]- Datagrams laid end to end
+			/// @param size -[in]- Size of the buffer
+			/// @param segmentSize -[in]- Size of each datagram
+			/// @param ipAddress -[in]- Address to send to
+			/// @param port -[in]- Port to send to
+			/// @return 0+ if successful (number of datagrams sent), -1 if fails. Call UDP_Client::GetLastError to find out more.
+			int32_t SendUnicastSegments(const uint8_t* buffer, const uint32_t size, const uint32_t segmentSize, const std::string& ipAddress, const int16_t port);
+
 			/// @brief Receive data from a server
 			/// @param buffer -[out]- Buffer to place received data into
 			/// @param maxSize -[in]- Maximum number of bytes to be read
 			/// @return 0+ if successful (number bytes received), -1 if fails. Call UDP_Client::GetLastError to find out more.
-			int8_t ReceiveUnicast(void* buffer, const uint32_t maxSize);
+			int32_t ReceiveUnicast(void* buffer, const uint32_t maxSize);
 
 			/// @brief Receive data from a server and get the IP and Port of the sender
 			/// @param buffer -[out]- Buffer to place received data into
@@ -245,7 +359,14 @@ namespace Essentials
 			/// @param recvFromAddr -[out]- IP Address of the sender
 			/// @param recvFromPort -[out]- Port of the sender
 			/// @return 0+ if successful (number bytes received), -1 if fails. Call UDP_Client::GetLastError to find out more.
-			int8_t ReceiveUnicast(void* buffer, const uint32_t maxSize, std::string& recvFromAddr, int16_t& recvFromPort);
+			int32_t ReceiveUnicast(void* buffer, const uint32_t maxSize, std::string& recvFromAddr, int16_t& recvFromPort);
+
+			/// @brief Receive data from a server, waiting for it until a deadline
+			/// @param buffer -[out]- Buffer to place received data into
+			/// @param maxSize -[in]- Maximum number of bytes to be read
+			/// @param deadline -[in]- When to stop waiting
+			/// @return 0+ if successful (number bytes received, 0 if the deadline passed), -1 if fails. Call UDP_Client::GetLastError to find out more.
+			int32_t ReceiveUnicast(void* buffer, const uint32_t maxSize, const Deadline deadline);
 
 			/// @brief Receive a broadcast message
 			/// @param buffer -[out]- Buffer to place received data into
@@ -260,6 +381,14 @@ namespace Essentials
 			/// @return 0+ if successful (number bytes received), -1 if fails. Call UDP_Client::GetLastError to find out more.
 			int8_t ReceiveBroadcast(void* buffer, const uint32_t maxSize, int16_t& port);
 
+			/// @brief Receive a broadcast message from whichever listener has one first, waiting on them all until a deadline
+			/// @param buffer -[out]- Buffer to place received data into
+			/// @param maxSize -[in]- Maximum number of bytes to be read
+			/// @param port -[out]- Port the broadcast was received from
+			/// @param deadline -[in]- When to stop waiting
+			/// @return 0+ if successful (number bytes received, 0 if the deadline passed), -1 if fails. Call UDP_Client::GetLastError to find out more.
+			int32_t ReceiveBroadcast(void* buffer, const uint32_t maxSize, int16_t& port, const Deadline deadline);
+
 			/// @brief Receive a broadcast message from a specific listener port
 			/// @param buffer -[out]- Buffer to place received data into
 			/// @param maxSize -[in]- Maximum number of bytes to be read
@@ -267,6 +396,82 @@ namespace Essentials
 			/// @return 0+ if successful (number bytes received), -1 if fails. Call UDP_Client::GetLastError to find out more.
 			int8_t ReceiveBroadcastFromListenerPort(void* buffer, const uint32_t maxSize, const int16_t port);
 
+			/// @brief Receive a broadcast message from a specific listener port, waiting for it until a deadline
+			/// @param buffer -[out]- Buffer to place received data into
+			/// @param maxSize -[in]- Maximum number of bytes to be read
+			/// @param port -[in]- Port of the broadcast to receive from
+			/// @param deadline -[in]- When to stop waiting
+			/// @return 0+ if successful (number bytes received, 0 if the deadline passed), -1 if fails. Call UDP_Client::GetLastError to find out more.
+			int32_t ReceiveBroadcastFromListenerPort(void* buffer, const uint32_t maxSize, const int16_t port, const Deadline deadline);
+
+			/// @brief Receive every waiting broadcast message on a listener port, many per system call where the platform allows.
+			/// Waits up to the read timeout for the first message, then drains what is queued without waiting.
+			/// @param arena -[out]- Buffer the datagrams are placed in, slotSize bytes for each
+			/// @param slotSize -[in]- Space given to each datagram within the arena, larger datagrams are dropped
+			/// @param datagrams -[out]- Filled in with the location, size and sender of each datagram
+			/// @param maxDatagrams -[in]- Number of datagrams the arena and array can hold
+			/// @param port -[in]- Port of the broadcast listener to receive from
+			/// @return 0+ if successful (number of datagrams received), -1 if fails. Call UDP_Client::GetLastError to find out more.
+			int32_t ReceiveBroadcastBatch(uint8_t* arena, const uint32_t slotSize, Datagram* datagrams, const uint32_t maxDatagrams, const int16_t port);
+
+			/// @brief Receive every waiting broadcast message on a listener port, waiting for the first until a deadline
+			/// @param arena -[out]- Buffer the datagrams are placed in, slotSize bytes for each
+			/// @param slotSize -[in]- Space given to each datagram within the arena, larger datagrams are dropped
+			/// @param datagrams -[out]- Filled in with the location, size and sender of each datagram
+			/// @param maxDatagrams -[in]- Number of datagrams the arena and array can hold
+			/// @param port -[in]- Port of the broadcast listener to receive from
+			/// @param deadline -[in]- When to stop waiting
+			/// @return 0+ if successful (number of datagrams received, 0 if the deadline passed), -1 if fails. Call UDP_Client::GetLastError to find out more.
+			int32_t ReceiveBroadcastBatch(uint8_t* arena, const uint32_t slotSize, Datagram* datagrams, const uint32_t maxDatagrams, const int16_t port, const Deadline deadline);
+
+			/// @brief Waits on the unicast socket, every broadcast listener and every multicast group at once.
+			/// A single wait covers them all, so listening on many ports costs one wake up rather than a timeout each.
+			/// @param ready -[out]- Filled in with each socket that has data waiting
+			/// @param maxReady -[in]- Number of entries ready can hold
+			/// @param timeoutMSec -[in]- Milliseconds to wait, 0 to return immediately, -1 to wait until data arrives
+			/// @return 0+ if successful (number of ready sockets, 0 on timeout), -1 if fails. Call UDP_Client::GetLastError to find out more.
+			int32_t WaitForReadable(ReadySocket* ready, const uint32_t maxReady, const int32_t timeoutMSec);
+
+			/// @brief Waits on every watched socket at once until a deadline. Where ppoll is available the wait ends on the
+			/// deadline to the nanosecond rather than rounded to a millisecond.
+			/// @param ready -[out]- Filled in with each socket that has data waiting
+			/// @param maxReady -[in]- Number of entries ready can hold
+			/// @param deadline -[in]- When to stop waiting
+			/// @return 0+ if successful (number of ready sockets, 0 if the deadline passed), -1 if fails. Call UDP_Client::GetLastError to find out more.
+			int32_t WaitForReadable(ReadySocket* ready, const uint32_t maxReady, const Deadline deadline);
+
+			/// @brief Reads one datagram from a socket reported by WaitForReadable without waiting again
+			/// @param ready -[in]- Socket reported by WaitForReadable
+			/// @param buffer -[out]- Buffer to place received data into
+			/// @param maxSize -[in]- Maximum number of bytes to be read
+			/// @param sender -[out]- Who sent the datagram
+			/// @return 0+ if successful (number bytes received), -1 if fails. Call UDP_Client::GetLastError to find out more.
+			int32_t ReceiveReady(const ReadySocket& ready, void* buffer, const uint32_t maxSize, Endpoint& sender);
+
+			/// @brief Reads one datagram from a socket reported by WaitForReadable along with when it arrived
+			/// @param ready -[in]- Socket reported by WaitForReadable
+			/// @param buffer -[out]- Buffer to place received data into
+			/// @param maxSize -[in]- Maximum number of bytes to be read
+			/// @param sender -[out]- Who sent the datagram
+			/// @param received -[out]- When it arrived, source NONE unless receive timestamps are enabled
+			/// @return 0+ if successful (number bytes received), -1 if fails. Call UDP_Client::GetLastError to find out more.
+			int32_t ReceiveReady(const ReadySocket& ready, void* buffer, const uint32_t maxSize, Endpoint& sender, RxTimestamp& received);
+
+			/// @brief Reads every datagram queued on a socket reported by WaitForReadable without waiting, many per system call
+			/// where the platform allows.
+			/// @param ready -[in]- Socket reported by WaitForReadable
+			/// @param arena -[out]- Buffer the datagrams are placed in, slotSize bytes for each
+			/// @param slotSize -[in]- Space given to each datagram within the arena, larger datagrams are dropped
+			/// @param datagrams -[out]- Filled in with the location, size and sender of each datagram
+			/// @param maxDatagrams -[in]- Number of datagrams the arena and array can hold
+			/// @return 0+ if successful (number of datagrams received), -1 if fails. Call UDP_Client::GetLastError to find out more.
+			int32_t ReceiveReadyBatch(const ReadySocket& ready, uint8_t* arena, const uint32_t slotSize, Datagram* datagrams, const uint32_t maxDatagrams);
+
+			/// @brief Get a descriptor that is readable whenever WaitForReadable would report a socket, so the client can
+			/// be serviced from another event loop
+			/// @return descriptor, -1 where not supported
+			int GetWaitFD() const;
+
 			/// @brief Receive a multicast message
 			/// @param buffer -[out]- Buffer to place received data into
 			/// @param maxSize -[in]- Maximum number of bytes to be read
@@ -274,6 +479,21 @@ namespace Essentials
 			/// @return 0+ if successful (number bytes received), -1 if fails. Call UDP_Client::GetLastError to find out more.
 			int8_t ReceiveMulticast(void* buffer, const uint32_t maxSize, std::string& multicastGroup);
 
+			/// @brief Receive a multicast message from whichever group has one first, waiting on them all until a deadline
+			/// @param buffer -[out]- Buffer to place received data into
+			/// @param maxSize -[in]- Maximum number of bytes to be read
+			/// @param multicastGroup -[out]- IP of the group received from
+			/// @param deadline -[in]- When to stop waiting
+			/// @return 0+ if successful (number bytes received, 0 if the deadline passed), -1 if fails. Call UDP_Client::GetLastError to find out more.
+			int32_t ReceiveMulticast(void* buffer, const uint32_t maxSize, std::string& multicastGroup, const Deadline deadline);
+
+			/// @brief Has the kernel stamp every datagram on every receiving socket, those open now and those opened later, 
+			/// with the time it arrived. The stamp comes back with each datagram from ReceiveReady and the batch receives, so 
+			/// the time spent queued in the socket can be told apart from the time on the wire.
+			/// @param hardware -[in]- Ask for network card stamps as well, used where the card and driver have been set up for them
+			/// @return 0 if successful, -1 if fails. Call UDP_Client::GetLastError to find out more.
+			int8_t EnableReceiveTimestamps(const bool hardware = false);
+
 			/// @brief Closes the unicast client and cleans up
 			void CloseUnicast();
 
@@ -317,10 +537,101 @@ namespace Essentials
 			/// @return 1 if valid ipv4, 2 if valid ipv6, else -1 on fail
 			int8_t ValidateIP(const std::string& ip);
 
-			/// @brief Validates a port number is between 0-65535
+			/// @brief Find the socket listening for broadcasts on a port
+			/// @param port -[in]- Port of the listener
+			/// @return socket of the listener, INVALID_SOCKET if not found
+			SOCKET FindBroadcastListener(const int16_t port);
+
+			/// @brief Reads the datagrams queued on a socket without waiting, dropping any too big for a slot
+			/// @param sock -[in]- Socket to read
+			/// @param arena -[out]- Buffer the datagrams are placed in, slotSize bytes for each
+			/// @param slotSize -[in]- Space given to each datagram within the arena, larger datagrams are dropped
+			/// @param datagrams -[out]- Filled in with the location, size and sender of each datagram
+			/// @param maxDatagrams -[in]- Number of datagrams the arena and array can hold
+			/// @param failure -[in]- Error to report if the read fails
+			/// @return 0+ if successful (number of datagrams received), -1 if fails
+			int32_t DrainSocket(const SOCKET sock, uint8_t* arena, const uint32_t slotSize, Datagram* datagrams, const uint32_t maxDatagrams, const UdpClientError failure);
+
+			/// @brief Turns on receive timestamps for one socket
+			/// @param sock -[in]- Socket to stamp
+			/// @return 0 if successful, -1 if fails
+			int8_t ApplyTimestamps(const SOCKET sock);
+
+#ifndef WIN32
+			/// @brief Finds the receive timestamp in a received message's ancillary data
+			/// @param message -[in]- Message as filled in by recvmsg or recvmmsg
+			/// @param received -[out]- Timestamp found, source NONE if there was none
+			static void ReadTimestamp(const msghdr& message, RxTimestamp& received);
+#endif
+
+			/// @brief Waits until one of the sockets is readable or the deadline passes
+			/// @param fds -[in/out]- Sockets to wait on, revents is filled in
+			/// @param count -[in]- Number of sockets
+			/// @param deadline -[in]- When to stop waiting
+			/// @return number of sockets ready, 0 if the deadline passed, -1 if fails
+			int32_t WaitForSockets(pollfd* fds, const uint32_t count, const Deadline deadline);
+
+			/// @brief Reads one datagram from whichever of a list of sockets has one first
+			/// @param sockets -[in]- Broadcast listeners or multicast groups
+			/// @param port -[in]- Only the socket bound to this port, -1 for any
+			/// @param buffer -[out]- Buffer to place received data into
+			/// @param maxSize -[in]- Maximum number of bytes to be read
+			/// @param deadline -[in]- When to stop waiting
+			/// @param failure -[in]- Error to report if the read fails
+			/// @param index -[out]- Entry of sockets the datagram came in on
+			/// @param recvFrom -[out]- Who sent the datagram
+			/// @return 0+ if successful (number bytes received, 0 if the deadline passed), -1 if fails
+			int32_t ReceiveFromFirst(const std::vector<std::tuple<SOCKET, sockaddr_in, Endpoint>>& sockets, const int32_t port, void* buffer, const uint32_t maxSize,
+				const Deadline deadline, const UdpClientError failure, size_t& index, sockaddr_in& recvFrom);
+
+			/// @brief Get the deadline a receive without one waits until, the read timeout from now
+			/// @return deadline
+			Deadline GetTimeoutDeadline() const;
+
+			/// @brief Fills in a unicast address after checking it
+			/// @param ipAddress -[in]- Address to send to
+			/// @param port -[in]- Port to send to
+			/// @param addr -[out]- Address to send to
+			/// @return 0 if successful, -1 if fails
+			int8_t MakeDestination(const std::string& ipAddress, const int16_t port, sockaddr_in& addr);
+
+			/// @brief Sends datagrams to one address, up to UDP_MAX_BATCH_SIZE per system call
+			/// @param sock -[in]- Socket to send on
+			/// @param addr -[in]- Address to send to
+			/// @param datagrams -[in]- Datagrams to be sent, in order
+			/// @param count -[in]- Number of datagrams
+			/// @param failure -[in]- Error to report if the send fails
+			/// @return 0+ if successful (number of datagrams sent), -1 if fails
+			int32_t SendDatagrams(const SOCKET sock, const sockaddr_in& addr, const OutgoingDatagram* datagrams, const uint32_t count, const UdpClientError failure);
+
+			/// @brief Sends a buffer cut into segmentSize datagrams to one address
+			/// @param sock -[in]- Socket to send on
+			/// @param addr -[in]- Address to send to
+			/// @param buffer -[in]- Datagrams laid end to end
+			/// @param size -[in]- Size of the buffer
+			/// @param segmentSize -[in]- Size of each datagram
+			/// @param failure -[in]- Error to report if the send fails
+			/// @return 0+ if successful (number of datagrams sent), -1 if fails
+			int32_t SendSegmentsTo(const SOCKET sock, const sockaddr_in& addr, const uint8_t* buffer, const uint32_t size, const uint32_t segmentSize, const UdpClientError failure);
+
+			/// @brief Adds a socket to the set watched by WaitForReadable
+			/// @param sock -[in]- Socket to watch
+			/// @param type -[in]- What the socket is used for
+			/// @param endpoint -[in]- Endpoint the socket is bound to
+			void WatchSocket(const SOCKET sock, const SocketType type, const Endpoint& endpoint);
+
+			/// @brief Removes a socket from the set watched by WaitForReadable
+			/// @param sock -[in]- Socket to stop watching
+			void UnwatchSocket(const SOCKET sock);
+
+			/// @brief Get the read timeout in milliseconds
+			/// @return read timeout in milliseconds
+			int32_t GetTimeoutMSec() const;
+
+			/// @brief Validates a port number can be sent to, anything but 0
 			/// @param port -[in]- Port number to be validated
 			/// @return true = valid, false = invalid
-			bool ValidatePort(const int16_t port);
+			bool ValidatePort(const uint16_t port);
 
 			// Variables
 			UdpClientError				mLastError;				// Last error for this utility
@@ -331,12 +642,19 @@ namespace Essentials
 			timeval						mTimeout;				// Holds the message receive timeout value in seconds. 
 			int8_t						mTimeToLive;			// Holds the ttl (Time To Live) for multicast messages. IE: How many interface hops they live for: 0-255
 			int16_t						mLastRecvBroadcastPort;	// Holds port of last received broadcast port
+			bool						mSegmentationOffload;	// The kernel accepts UDP_SEGMENT, cleared the first time it refuses
+			bool						mTimestamps;			// Receiving sockets are stamped with arrival time
+			bool						mHardwareTimestamps;	// Network card stamps are asked for as well
 
 #ifdef WIN32
 			WSADATA						mWsaData;				// Winsock data
 #endif
 			SOCKET						mSocket;				// socket FD for this client
 			SOCKET						mBroadcastSocket;		// socket FD for broadcasting
+#ifndef WIN32
+			int							mEpollFD;				// epoll set of every receiving socket
+#endif
+			std::map<SOCKET, ReadySocket>	mWatchedSockets;	// Receiving sockets watched by WaitForReadable
 			std::vector<std::tuple<SOCKET, sockaddr_in, Endpoint>>   mBroadcastListeners;	// Vector of tuples containing the socket and addr info for listening to broadcasts
 			std::vector<std::tuple<SOCKET, sockaddr_in, Endpoint>>   mMulticastSockets;		// Vector of tuples containing the socket and addr info for multicasts
 		};